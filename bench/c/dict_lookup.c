@@ -0,0 +1,40 @@
+/* Baseline for dict_lookup.pb: an open-addressing table keyed by FNV-1a. */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NKEYS 10000
+#define SLOTS 32768
+
+static char keys[NKEYS][16];
+static const char *slot_key[SLOTS];
+static int64_t slot_val[SLOTS];
+
+static uint64_t hash(const char *s) {
+    uint64_t h = 1469598103934665603ull;
+    while (*s) h = (h ^ (unsigned char)*s++) * 1099511628211ull;
+    return h;
+}
+
+static size_t find(const char *k) {
+    size_t i = hash(k) & (SLOTS - 1);
+    while (slot_key[i] && strcmp(slot_key[i], k) != 0) i = (i + 1) & (SLOTS - 1);
+    return i;
+}
+
+int main(void) {
+    for (int i = 0; i < NKEYS; i++) {
+        snprintf(keys[i], sizeof keys[i], "key%d", i);
+        size_t s = find(keys[i]);
+        slot_key[s] = keys[i];
+        slot_val[s] = i;
+    }
+    int64_t total = 0, misses = 0;
+    for (int rep = 0; rep < 160; rep++) {
+        for (int i = 0; i < NKEYS; i++) total += slot_val[find(keys[i])];
+        if (!slot_key[find("absent")]) misses++;
+    }
+    printf("%lld\n%lld\n", (long long)total, (long long)misses);
+    return 0;
+}
@@ -0,0 +1,20 @@
+/* Baseline for exceptions.pb: errors travel back as a return code. */
+#include <stdint.h>
+#include <stdio.h>
+
+static int check(int64_t i, int64_t *out) {
+    if (i % 3 == 0) return -1;
+    *out = i;
+    return 0;
+}
+
+int main(void) {
+    int64_t caught = 0, total = 0;
+    for (int64_t i = 0; i < 2000000; i++) {
+        int64_t v;
+        if (check(i, &v) != 0) caught++;
+        else total += v;
+    }
+    printf("%lld\n%lld\n", (long long)total, (long long)caught);
+    return 0;
+}
@@ -0,0 +1,23 @@
+/* Baseline for file_io.pb: stdio writes, fgets reads. */
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+int main(void) {
+    const char *path = "bench_file_io.txt";
+    FILE *out = fopen(path, "w");
+    if (!out) return 1;
+    for (int64_t i = 0; i < 200000; i++) fprintf(out, "line %lld\n", (long long)i);
+    fclose(out);
+    int64_t count = 0, chars = 0;
+    char line[256];
+    FILE *f = fopen(path, "r");
+    if (!f) return 1;
+    while (fgets(line, sizeof line, f)) {
+        count++;
+        chars += (int64_t)strlen(line);
+    }
+    fclose(f);
+    printf("%lld\n%lld\n", (long long)count, (long long)chars);
+    return 0;
+}
@@ -0,0 +1,31 @@
+/* Baseline for for_each.pb: plain arrays walked by index. */
+#include <stdint.h>
+#include <stdio.h>
+
+#define N 200000
+#define KEYS 1000
+
+static int64_t xs[N], ys[N], counts[KEYS];
+
+int main(void) {
+    for (int64_t i = 0; i < N; i++) {
+        xs[i] = i * 7 % 1000;
+        ys[i] = i % 13;
+    }
+    for (int64_t i = 0; i < KEYS; i++) counts[i] = i;
+    static char text[44 * 100 + 1];
+    for (int i = 0; i < 100; i++)
+        for (int j = 0; j < 44; j++) text[i * 44 + j] = "the quick brown fox jumps over the lazy dog "[j];
+    int64_t total = 0;
+    for (int rep = 0; rep < 20; rep++) {
+        for (int64_t i = 0; i < N; i++) total += xs[i];
+        for (int64_t i = 0; i < N; i++) total += xs[i] * ys[i];
+        for (int64_t i = 0; i < N; i++)
+            if (ys[i] == 0) total += i;
+        for (int64_t i = 0; i < KEYS; i++) total += counts[i];
+        for (const char *c = text; *c; c++)
+            if (*c == 'o') total++;
+    }
+    printf("%lld\n", (long long)total);
+    return 0;
+}
@@ -0,0 +1,15 @@
+/* Baseline for fstrings.pb: snprintf into a stack buffer. */
+#include <stdint.h>
+#include <stdio.h>
+
+int main(void) {
+    int64_t total = 0;
+    const char *name = "bench";
+    char buf[128];
+    for (int64_t i = 0; i < 200000; i++) {
+        total += snprintf(buf, sizeof buf, "%s-%lld: %.1f [%lld]", name, (long long)i, (double)i * 0.5,
+                          (long long)(i % 7));
+    }
+    printf("%lld\n", (long long)total);
+    return 0;
+}
@@ -0,0 +1,24 @@
+/* Baseline for list_ops.pb: a growable int64 array. */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+int main(void) {
+    int64_t total = 0;
+    for (int rep = 0; rep < 20; rep++) {
+        int64_t *xs = NULL;
+        size_t len = 0, cap = 0;
+        for (int64_t i = 0; i < 300000; i++) {
+            if (len == cap) {
+                cap = cap ? cap * 2 : 8;
+                xs = realloc(xs, cap * sizeof *xs);
+                if (!xs) return 1;
+            }
+            xs[len++] = i * 7 % 1000;
+        }
+        for (size_t i = 0; i < len; i++) total += xs[i];
+        free(xs);
+    }
+    printf("%lld\n", (long long)total);
+    return 0;
+}
@@ -0,0 +1,29 @@
+/* Baseline for startup.pb: the tables are static data, as a C tool's would be. */
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+static const int64_t primes[] = {2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37, 41, 43, 47};
+static const char *const units[] = {"B", "KiB", "MiB", "GiB", "TiB", "PiB"};
+static const int64_t limits[3][3] = {{1, 10, 100}, {2, 20, 200}, {3, 30, 300}};
+static const struct { const char *key; int64_t value; } codes[] = {
+    {"ok", 0}, {"warn", 1}, {"fail", 2}, {"skip", 3}, {"todo", 4},
+};
+
+static int64_t code(const char *key) {
+    for (size_t i = 0; i < sizeof codes / sizeof codes[0]; i++)
+        if (strcmp(codes[i].key, key) == 0) return codes[i].value;
+    return -1;
+}
+
+int main(void) {
+    int64_t n = 123456789;
+    size_t i = 0;
+    while (n >= 1024 && i < sizeof units / sizeof units[0] - 1) {
+        n /= 1024;
+        i++;
+    }
+    printf("%lld %s\n", (long long)n, units[i]);
+    printf("%lld\n", (long long)(primes[5] + limits[2][1] + code("warn")));
+    return 0;
+}
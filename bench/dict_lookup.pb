@@ -0,0 +1,20 @@
+# Fill a dict with 10k keys, then hit and miss it many times.
+def main():
+    keys: list[str] = []
+    for i in range(10000):
+        keys.append(f"key{i}")
+    d: dict[str, int] = {}
+    for i in range(len(keys)):
+        d[keys[i]] = i
+    total: int = 0
+    misses: int = 0
+    for rep in range(160):
+        for i in range(len(keys)):
+            total += d[keys[i]]
+        if "absent" not in d:
+            misses += 1
+    print(total)
+    print(misses)
+
+if __name__ == "__main__":
+    main()
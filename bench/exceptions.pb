@@ -0,0 +1,19 @@
+# Raise and catch through a call frame on every third iteration.
+def check(i: int) -> int:
+    if i % 3 == 0:
+        raise ValueError("multiple of three")
+    return i
+
+def main():
+    caught: int = 0
+    total: int = 0
+    for i in range(2000000):
+        try:
+            total += check(i)
+        except ValueError:
+            caught += 1
+    print(total)
+    print(caught)
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,19 @@
+# Write a 200k-line file, then read it back line by line.
+def main():
+    path: str = "bench_file_io.txt"
+    out: file = open(path, "w")
+    for i in range(200000):
+        out.write(f"line {i}\n")
+    out.close()
+    count: int = 0
+    chars: int = 0
+    f: file = open(path, "r")
+    for line in f:
+        count += 1
+        chars += len(line)
+    f.close()
+    print(count)
+    print(chars)
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,32 @@
+# Walk the same containers many times with for-each loops: sums, a zipped
+# dot product, enumerate, and dict and string scans.
+def main():
+    xs: list[int] = []
+    ys: list[int] = []
+    for i in range(200000):
+        xs.append(i * 7 % 1000)
+        ys.append(i % 13)
+    counts: dict[str, int] = {}
+    for i in range(1000):
+        counts[f"k{i}"] = i
+    text: str = ""
+    for i in range(100):
+        text = f"{text}the quick brown fox jumps over the lazy dog "
+    total: int = 0
+    for rep in range(20):
+        for x in xs:
+            total += x
+        for x, y in zip(xs, ys):
+            total += x * y
+        for i, y in enumerate(ys):
+            if y == 0:
+                total += i
+        for k, v in counts.items():
+            total += v
+        for c in text:
+            if c == "o":
+                total += 1
+    print(total)
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,11 @@
+# Format ints, floats and strings into f-strings and measure their length.
+def main():
+    total: int = 0
+    name: str = "bench"
+    for i in range(200000):
+        s: str = f"{name}-{i}: {i * 0.5} [{i % 7}]"
+        total += len(s)
+    print(total)
+
+if __name__ == "__main__":
+    main()
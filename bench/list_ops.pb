@@ -0,0 +1,13 @@
+# Append a few million ints, then sum them back by index.
+def main():
+    total: int = 0
+    for rep in range(20):
+        xs: list[int] = []
+        for i in range(300000):
+            xs.append(i * 7 % 1000)
+        for i in range(len(xs)):
+            total += xs[i]
+    print(total)
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,11 @@
+# Naive doubly recursive Fibonacci.
+def fib(n: int) -> int:
+    if n < 2:
+        return n
+    return fib(n - 1) + fib(n - 2)
+
+def main():
+    print(fib(32))
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,25 @@
+# A short-lived tool: module-level lookup tables and almost no work, so the
+# run time is the program's startup.
+PRIMES: list[int] = [2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37, 41, 43, 47]
+UNITS: list[str] = ["B", "KiB", "MiB", "GiB", "TiB", "PiB"]
+LIMITS: list[list[int]] = [[1, 10, 100], [2, 20, 200], [3, 30, 300]]
+SCALE: int = 1024
+CODES: dict[str, int] = {"ok": 0, "warn": 1, "fail": 2, "skip": 3, "todo": 4}
+LEVELS: dict[str, int] = {"debug": 10, "info": 20, "warning": 30, "error": 40, "critical": 50}
+
+
+def human(n: int) -> str:
+    i: int = 0
+    while n >= SCALE and i < len(UNITS) - 1:
+        n = n // SCALE
+        i += 1
+    unit: str = UNITS[i]
+    return f"{n} {unit}"
+
+
+def main():
+    print(human(123456789))
+    print(PRIMES[5] + LIMITS[2][1] + CODES["warn"])
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,59 @@
+class P:
+    def __init__(self, n: int):
+        self.n = n
+
+def total(xs: list[int]) -> int:
+    t: int = 0
+    for x in xs:
+        t += x
+    return t
+
+def main():
+    xs: list[int] = [1, 2, 3, 4]
+    print(total(xs))
+    for i, x in enumerate(xs, 10):
+        print(i * 100 + x)
+    ys: list[float] = [0.5, 1.5, 2.5]
+    for a, b in zip(xs, ys):
+        print(float(a) + b)
+    d: dict[str, int] = {"a": 1, "b": 2, "c": 3}
+    del d["b"]
+    for k in d:
+        print(k)
+    for k, v in d.items():
+        print(f"{k}={v}")
+    for i, k in enumerate(d):
+        print(i)
+    s: set[int] = {5, 6}
+    for e in s:
+        print(e)
+    for c in "héllo":
+        print(c)
+    for i, c in enumerate("ab"):
+        print(i)
+    grow: list[int] = [1, 2]
+    for g in grow:
+        if g < 4:
+            grow.append(g + 2)
+    print(grow)
+    names: list[str] = ["a", "bb"]
+    for name in names:
+        print(name)
+    for name, x in zip(names, xs):
+        print(f"{name}{x}")
+    tags: set[str] = {"x"}
+    for t in tags:
+        print(t)
+    ps: list[P] = [P(1), P(2)]
+    for p in ps:
+        print(p.n)
+    for x in [7, 8]:
+        print(x)
+        continue
+    for x in xs:
+        if x == 3:
+            break
+        print(x)
+
+if __name__ == "__main__":
+    main()
@@ -1,4 +1,6 @@
 #include "lang.h"
+#define PB_EXC_RuntimeError 0x8e02d7b3u
+
 int64_t counter = 100;
 int64_t Player_hp = 100;
 const char * Player_species = "Human";
@@ -8,8 +10,6 @@ void Player____init__(struct Player * self, int64_t hp, int64_t mp)
     (void)self;
     (void)hp;
     (void)mp;
-    char __fbuf[256];
-    (void)__fbuf;
     self->hp = hp;
     self->mp = mp;
     self->score = 0;
@@ -19,29 +19,21 @@ void Player__heal(struct Player * self, int64_t amount)
 {
     (void)self;
     (void)amount;
-    char __fbuf[256];
-    (void)__fbuf;
     self->hp += amount;
 }
 const char * Player__get_name(struct Player * self)
 {
     (void)self;
-    char __fbuf[256];
-    (void)__fbuf;
     return self->name;
 }
 const char * Player__get_species_one(struct Player * self)
 {
     (void)self;
-    char __fbuf[256];
-    (void)__fbuf;
     return Player_species;
 }
 void Player__add_to_counter(struct Player * self)
 {
     (void)self;
-    char __fbuf[256];
-    (void)__fbuf;
     /* global counter */
     counter += self->hp;
 }
@@ -49,20 +41,16 @@ void Mage____init__(struct Mage * self, int64_t hp)
 {
     (void)self;
     (void)hp;
-    char __fbuf[256];
-    (void)__fbuf;
     Player____init__((struct Player *)self, hp, 150);
-    self->mp = 200;
+    self->base.mp = 200;
 }
 void Mage__cast_spell(struct Mage * self, int64_t spell_cost)
 {
     (void)self;
     (void)spell_cost;
-    char __fbuf[256];
-    (void)__fbuf;
-    if ((self->mp >= spell_cost)) {
+    if ((self->base.mp >= spell_cost)) {
         pb_print_str("Spell cast!");
-        self->mp -= spell_cost;
+        self->base.mp -= spell_cost;
     }
     else  {
         pb_print_str("Not enough mana");
@@ -72,10 +60,8 @@ void Mage__heal(struct Mage * self, int64_t amount)
 {
     (void)self;
     (void)amount;
-    char __fbuf[256];
-    (void)__fbuf;
     self->base.hp += amount;
-    self->mp += (amount / 2);
+    self->base.mp += (amount / 2);
 }
 static inline void Mage__add_to_counter(
     struct Mage * self) {
@@ -93,8 +79,6 @@ int64_t lang_add(int64_t x, int64_t y)
 {
     (void)x;
     (void)y;
-    char __fbuf[256];
-    (void)__fbuf;
     int64_t result = (x + y);
     pb_print_str("Adding numbers:");
     pb_print_int(result);
@@ -104,10 +88,9 @@ int64_t lang_divide(int64_t x, int64_t y)
 {
     (void)x;
     (void)y;
-    char __fbuf[256];
-    (void)__fbuf;
     if ((y == 0)) {
-        pb_raise_msg("RuntimeError", "division by zero");
+        pb_throw_msg("RuntimeError", "division by zero");
+    return (int64_t){0};
     }
     return (x / y);
 }
@@ -115,15 +98,11 @@ int64_t lang_increment(int64_t x, int64_t step)
 {
     (void)x;
     (void)step;
-    char __fbuf[256];
-    (void)__fbuf;
     return (x + step);
 }
 bool lang_is_even(int64_t n)
 {
     (void)n;
-    char __fbuf[256];
-    (void)__fbuf;
     if (((n % 2) == 0)) {
         return true;
     }
@@ -133,18 +112,16 @@ bool lang_is_even(int64_t n)
 }
 int main(void)
 {
-    char __fbuf[256];
-    (void)__fbuf;
     pb_print_str("=== F-String Interpolation ===");
     int64_t value = 42;
     const char * name = "Alice";
-    pb_print_str((snprintf(__fbuf, 256, "Value is %lld", value), __fbuf));
-    pb_print_str((snprintf(__fbuf, 256, "Hello, %s!", name), __fbuf));
+    pb_print_fmt("Value is %" PRId64, value);
+    pb_print_fmt("Hello, %s!", name);
     pb_print_str("=== Global Variable===");
     /* global counter */
-    pb_print_str((snprintf(__fbuf, 256, "Before Update: %lld", counter), __fbuf));
+    pb_print_fmt("Before Update: %" PRId64, counter);
     counter = 200;
-    pb_print_str((snprintf(__fbuf, 256, "After Update: %lld", counter), __fbuf));
+    pb_print_fmt("After Update: %" PRId64, counter);
     pb_print_str("=== Function Call ===");
     int64_t total = lang_add(10, 5);
     int64_t divided = lang_divide(10, 5);
@@ -193,8 +170,7 @@ int main(void)
         pb_print_int(k);
     }
     pb_print_str("=== List and Indexing ===");
-    int64_t __tmp_list_1[] = {100, 200, 300};
-    List_int numbers = (List_int){ .len=3, .data=__tmp_list_1 };
+    List_int numbers = list_int_from_array((int64_t[]){100, 200, 300}, 3);
     int64_t first_number = list_int_get(&numbers, 0);
     pb_print_int(first_number);
     pb_print_int(list_int_get(&numbers, 0));
@@ -208,12 +184,9 @@ int main(void)
     List_bool __tmp_list_4;
     list_bool_init(&__tmp_list_4);
     List_bool arr_bool_empty = __tmp_list_4;
-    double __tmp_list_5[] = {1.1, 2.2, 3.3};
-    List_float arr_float_init = (List_float){ .len=3, .data=__tmp_list_5 };
-    const char * __tmp_list_6[] = {"abc", "def"};
-    List_str arr_str_init = (List_str){ .len=2, .data=__tmp_list_6 };
-    bool __tmp_list_7[] = {true, false};
-    List_bool arr_bool_init = (List_bool){ .len=2, .data=__tmp_list_7 };
+    List_float arr_float_init = list_float_from_array((double[]){1.1, 2.2, 3.3}, 3);
+    List_str arr_str_init = list_str_from_array((const char *[]){"abc", "def"}, 2);
+    List_bool arr_bool_init = list_bool_from_array((bool[]){true, false}, 2);
     pb_print_double(list_float_get(&arr_float_init, 0));
     list_float_print(&arr_float_init);
     pb_print_str(list_str_get(&arr_str_init, 0));
@@ -228,34 +201,31 @@ int main(void)
     list_bool_print(&arr_bool_init);
     pb_print_str("=== List Operations ===");
     pb_print_str("=== Dict Literal and Access ===");
-    Pair_str_int __tmp_dict_1[] = {{"volume", 10}, {"brightness", 75}};
-    Dict_str_int settings = (Dict_str_int){ .len=2, .data=__tmp_dict_1 };
-    pb_print_int(pb_dict_get_str_int(settings, "volume"));
-    pb_print_int(pb_dict_get_str_int(settings, "brightness"));
-    Pair_str_str __tmp_dict_2[] = {{"a", "sth here"}, {"b", "and here"}};
-    Dict_str_str map_str = (Dict_str_str){ .len=2, .data=__tmp_dict_2 };
-    pb_print_str(pb_dict_get_str_str(map_str, "a"));
-    pb_print_str(pb_dict_get_str_str(map_str, "b"));
+    Dict_str_int settings = pb_dict_from_pairs_str_int((Pair_str_int[]){{"volume", 10}, {"brightness", 75}}, 2);
+    pb_print_int(pb_dict_get_str_int(&settings, "volume"));
+    pb_print_int(pb_dict_get_str_int(&settings, "brightness"));
+    Dict_str_str map_str = pb_dict_from_pairs_str_str((Pair_str_str[]){{"a", "sth here"}, {"b", "and here"}}, 2);
+    pb_print_str(pb_dict_get_str_str(&map_str, "a"));
+    pb_print_str(pb_dict_get_str_str(&map_str, "b"));
     pb_print_str("=== Try / Except / Raise ===");
-    PbTryContext __exc_ctx_1;
-    pb_push_try(&__exc_ctx_1);
-    int __exc_flag_1 = setjmp(__exc_ctx_1.env);
-    bool __exc_handled_1 = false;
-    if (__exc_flag_1 == 0) {
+    ++pb_checked_depth;
+    {
         int64_t result = lang_divide(10, 0);
+        if (PB_UNLIKELY(pb_exc_pending)) goto __exc_catch_1;
         pb_print_int(result);
-    pb_pop_try();
-    } else {
-        if (strcmp(pb_current_exc.type, "RuntimeError") == 0) {
+    }
+    __exc_catch_1:
+    --pb_checked_depth;
+    if (PB_UNLIKELY(pb_exc_pending)) {
+        pb_exc_pending = false;
+        if (pb_current_exc.id == PB_EXC_RuntimeError) {
             pb_print_str("Caught division by zero");
             pb_clear_exc();
-            __exc_handled_1 = true;
         }
         else {
             pb_reraise();
         }
     }
-    if (__exc_flag_1 && !__exc_handled_1) pb_reraise();
     pb_print_str("=== Boolean Literals ===");
     bool x = true;
     bool y = false;
@@ -306,15 +276,15 @@ int main(void)
     pb_print_str("=== Explicit Type Conversion ===");
     int64_t i = 10;
     double f = (double)(i);
-    pb_print_str((snprintf(__fbuf, 256, "i: %lld, f: %s", i, pb_format_double(f)), __fbuf));
+    pb_print_fmt("i: %" PRId64 ", f: %s", i, pb_format_double(f));
     double f2 = 3.5;
     int64_t i2 = (int64_t)(f2);
-    pb_print_str((snprintf(__fbuf, 256, "f2: %s, i2: %lld", pb_format_double(f2), i2), __fbuf));
+    pb_print_fmt("f2: %s, i2: %" PRId64, pb_format_double(f2), i2);
     pb_print_str("=== Class Instantiation and Methods ===");
     struct Player __tmp_player_2;
     Player____init__(&__tmp_player_2, 110, 150);
     struct Player * player = &__tmp_player_2;
-    pb_print_str((snprintf(__fbuf, 256, "player.hp: %lld", player->hp), __fbuf));
+    pb_print_fmt("player.hp: %" PRId64, player->hp);
     pb_print_str("Healing player by 50...");
     Player__heal(player, 50);
     pb_print_int(player->hp);
@@ -330,14 +300,14 @@ int main(void)
     Player____init__(&__tmp_player_4, 5678, 150);
     struct Player * player2 = &__tmp_player_4;
     player1->score = 100;
-    pb_print_str((snprintf(__fbuf, 256, "Player1 score: %lld", player1->score), __fbuf));
-    pb_print_str((snprintf(__fbuf, 256, "Player2 score (should be default): %lld", player2->score), __fbuf));
-    pb_print_str((snprintf(__fbuf, 256, "Player class species: %s", Player_species), __fbuf));
-    pb_print_str((snprintf(__fbuf, 256, "Species from player1 (via class attribute): %s", Player__get_species_one(player1)), __fbuf));
+    pb_print_fmt("Player1 score: %" PRId64, player1->score);
+    pb_print_fmt("Player2 score (should be default): %" PRId64, player2->score);
+    pb_print_fmt("Player class species: %s", Player_species);
+    pb_print_fmt("Species from player1 (via class attribute): %s", Player__get_species_one(player1));
     player1->hp = 777;
-    pb_print_str((snprintf(__fbuf, 256, "Player1.hp (instance attribute): %lld", player1->hp), __fbuf));
-    pb_print_str((snprintf(__fbuf, 256, "Player2.hp (instance attribute): %lld", player2->hp), __fbuf));
-    pb_print_str((snprintf(__fbuf, 256, "Player.hp (class attribute): %lld", Player_hp), __fbuf));
+    pb_print_fmt("Player1.hp (instance attribute): %" PRId64, player1->hp);
+    pb_print_fmt("Player2.hp (instance attribute): %" PRId64, player2->hp);
+    pb_print_fmt("Player.hp (class attribute): %" PRId64, Player_hp);
     pb_print_str("Directly setting player.hp to 999");
     player->hp = 999;
     pb_print_int(player->hp);
@@ -345,18 +315,81 @@ int main(void)
     struct Mage __tmp_mage_5;
     Mage____init__(&__tmp_mage_5, 120);
     struct Mage * mage = &__tmp_mage_5;
-    pb_print_str((snprintf(__fbuf, 256, "Mage name: %s", Mage__get_name(mage)), __fbuf));
-    pb_print_str((snprintf(__fbuf, 256, "Mage HP: %lld", mage->base.hp), __fbuf));
-    pb_print_str((snprintf(__fbuf, 256, "Mage MP: %lld", mage->mp), __fbuf));
+    pb_print_fmt("Mage name: %s", Mage__get_name(mage));
+    pb_print_fmt("Mage HP: %" PRId64, mage->base.hp);
+    pb_print_fmt("Mage MP: %" PRId64, mage->base.mp);
     pb_print_str("Mage casts a spell costing 20 mana...");
     Mage__cast_spell(mage, 20);
-    pb_print_str((snprintf(__fbuf, 256, "Remaining MP: %lld", mage->mp), __fbuf));
+    pb_print_fmt("Remaining MP: %" PRId64, mage->base.mp);
     pb_print_str("Mage takes damage and heals...");
     mage->base.hp -= 30;
-    mage->mp -= 10;
-    pb_print_str((snprintf(__fbuf, 256, "HP after damage: %lld", mage->base.hp), __fbuf));
-    pb_print_str((snprintf(__fbuf, 256, "MP after damage: %lld", mage->mp), __fbuf));
+    mage->base.mp -= 10;
+    pb_print_fmt("HP after damage: %" PRId64, mage->base.hp);
+    pb_print_fmt("MP after damage: %" PRId64, mage->base.mp);
     Mage__heal(mage, 40);
-    pb_print_str((snprintf(__fbuf, 256, "HP after healing: %lld", mage->base.hp), __fbuf));
-    pb_print_str((snprintf(__fbuf, 256, "MP after healing: %lld", mage->mp), __fbuf));
+    pb_print_fmt("HP after healing: %" PRId64, mage->base.hp);
+    pb_print_fmt("MP after healing: %" PRId64, mage->base.mp);
 }
+
+#ifdef PB_CONSTRUCTOR
+static const char *const __pb_literals[] = {
+    "Hero",
+    "Spell cast!",
+    "Not enough mana",
+    "Adding numbers:",
+    "division by zero",
+    "=== F-String Interpolation ===",
+    "Alice",
+    "=== Global Variable===",
+    "=== Function Call ===",
+    "=== Function with Default Argument ===",
+    "=== Assert Statement ===",
+    "Assertion passed",
+    "=== Handle Float/Double ===",
+    "=== If/Else ===",
+    "Total is even",
+    "Total is odd",
+    "=== While Loop ===",
+    "=== For Loop with range(0, 3) ===",
+    "=== For Loop with range(2) ===",
+    "=== Break and Continue ===",
+    "=== List and Indexing ===",
+    "abc",
+    "def",
+    "some string",
+    "=== List Operations ===",
+    "=== Dict Literal and Access ===",
+    "volume",
+    "brightness",
+    "a",
+    "sth here",
+    "b",
+    "and here",
+    "=== Try / Except / Raise ===",
+    "Caught division by zero",
+    "=== Boolean Literals ===",
+    "x is True and y is False",
+    "=== If/Elif/Else ===",
+    "zero",
+    "five",
+    "other",
+    "=== Pass Statement ===",
+    "Pass block completed",
+    "=== Is / Is Not Operators ===",
+    "a is b",
+    "a is not 20",
+    "=== Augmented Assignment ===",
+    "=== Explicit Type Conversion ===",
+    "=== Class Instantiation and Methods ===",
+    "Healing player by 50...",
+    "Adding player's hp to global counter...",
+    "Updated counter:",
+    "=== Class vs Instance Variables ===",
+    "Directly setting player.hp to 999",
+    "=== Inheritance: Mage Subclass ===",
+    "Mage casts a spell costing 20 mana...",
+    "Mage takes damage and heals...",
+};
+static PbInternBlock __pb_literal_block = {__pb_literals, 56, NULL};
+PB_CONSTRUCTOR static void __pb_register_literals(void) { pb_intern_register(&__pb_literal_block); }
+#endif
@@ -1,6 +1,7 @@
 #pragma once
 #include "pb_runtime.h"
 extern int64_t counter;
+#define PB_INIT_lang() ((void)0)
 typedef struct Player {
     int64_t hp;
     const char * species;
@@ -11,7 +12,6 @@ typedef struct Player {
 typedef struct Mage {
     Player base;
     const char * power;
-    int64_t mp;
 } Mage;
 int64_t lang_add(int64_t x, int64_t y);
 int64_t lang_divide(int64_t x, int64_t y);
@@ -0,0 +1,398 @@
+"""Benchmark runner for the PB toolchain.
+
+Every ``bench/<name>.pb`` is also a valid Python program, so each benchmark
+runs three ways:
+
+* **pb-<profile>** – the compiled program, built once per optimization
+  profile in ``main.BUILD_PROFILES``;
+* **cpython** – the same source under the interpreter running this script;
+* **c** – the hand-written baseline ``bench/c/<name>.c`` built with ``-O2``,
+  when one exists.
+
+Each variant runs ``repeat`` times. The report gives the median and p95 wall
+time and the peak resident set size of the program. Every variant's
+output must match the CPython run, so a fast but wrong build cannot pass as a
+speedup. The results are saved as JSON; pass an earlier file as ``baseline``
+to print the change in median time for each variant.
+
+`compile_benchmark` times the compiler itself instead: each front-end
+phase (lex, parse, type check, codegen) on a generated module of ``lines``
+lines, saved and compared the same way.
+"""
+
+import datetime
+import json
+import math
+import os
+import platform
+import shutil
+import statistics
+import subprocess
+import sys
+import tempfile
+import time
+
+from codegen import CodeGen
+from lexer import Lexer
+from main import BUILD_PROFILES, build, get_build_output_path
+from optimizer import fold_constants
+from parser import Parser
+from type_checker import TypeChecker
+
+ROOT_DIR = os.path.abspath(os.path.join(os.path.dirname(__file__), ".."))
+BENCH_DIR = os.path.join(ROOT_DIR, "bench")
+C_BASELINE_FLAGS = ["-std=c99", "-O2"]
+
+
+class BenchError(Exception):
+    pass
+
+
+def discover(bench_dir: str = BENCH_DIR, names: list[str] | None = None) -> list[str]:
+    """Paths of the benchmarks in `bench_dir`, all of them or just `names`."""
+    found = {os.path.splitext(f)[0]: os.path.join(bench_dir, f)
+             for f in sorted(os.listdir(bench_dir)) if f.endswith(".pb")}
+    if not names:
+        return list(found.values())
+    missing = [n for n in names if n not in found]
+    if missing:
+        raise BenchError(f"Unknown benchmark(s): {', '.join(missing)} (have: {', '.join(found)})")
+    return [found[n] for n in names]
+
+
+def percentile(samples: list[float], pct: float) -> float:
+    """Nearest-rank percentile: the smallest sample with `pct`% at or below it."""
+    ordered = sorted(samples)
+    rank = max(1, math.ceil(pct / 100 * len(ordered)))
+    return ordered[rank - 1]
+
+
+# Peak RSS has to come from a small parent: Linux carries the RSS high-water
+# mark of a process across exec, so anything forked from this interpreter
+# would report at least the interpreter's own size. The probe forks the
+# program, times it and writes "<exit code> <ns> <peak KiB>" to argv[1].
+MAXRSS_PROBE = r"""
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+int main(int argc, char **argv) {
+    if (argc < 3) return 2;
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    pid_t pid = fork();
+    if (pid == 0) {
+        execvp(argv[2], argv + 2);
+        _exit(127);
+    }
+    int status;
+    struct rusage usage;
+    if (pid < 0 || wait4(pid, &status, 0, &usage) < 0) return 2;
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    FILE *f = fopen(argv[1], "w");
+    if (!f) return 2;
+    long long ns = (long long)(t1.tv_sec - t0.tv_sec) * 1000000000LL + (t1.tv_nsec - t0.tv_nsec);
+    int code = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+    fprintf(f, "%d %lld %ld\n", code, ns, usage.ru_maxrss);
+    return fclose(f) != 0;
+}
+"""
+
+
+def maxrss_probe(out_dir: str) -> str | None:
+    """Build the RSS probe into `out_dir` once; None where it cannot work."""
+    if os.name == "nt":
+        return None
+    probe = os.path.join(out_dir, "maxrss")
+    src = probe + ".c"
+    current = None
+    if os.path.isfile(src):
+        with open(src) as f:
+            current = f.read()
+    if not os.path.isfile(probe) or current != MAXRSS_PROBE:
+        with open(src, "w") as f:
+            f.write(MAXRSS_PROBE)
+        result = subprocess.run(["gcc", *C_BASELINE_FLAGS, src, "-o", probe], capture_output=True, text=True)
+        if result.returncode != 0:
+            raise BenchError(f"RSS probe failed to build:\n{result.stderr}")
+    return probe
+
+
+def run_once(cmd: list[str], cwd: str, probe: str | None) -> tuple[float, int | None, str]:
+    """
+    Run `cmd` once, through `probe` when there is one. Returns its wall time
+    in seconds, its peak RSS in KiB (None without a probe) and its stdout.
+    A non-zero exit raises.
+    """
+    with tempfile.TemporaryDirectory() as tmp:
+        stats = os.path.join(tmp, "stats")
+        start = time.perf_counter()
+        result = subprocess.run([probe, stats, *cmd] if probe else cmd, cwd=cwd, capture_output=True, text=True)
+        elapsed, rss, code = time.perf_counter() - start, None, result.returncode
+        if probe and code == 0:
+            with open(stats) as f:
+                code, ns, rss = (int(v) for v in f.read().split())
+            # ru_maxrss is KiB on Linux and bytes on macOS
+            elapsed, rss = ns / 1e9, rss // 1024 if sys.platform == "darwin" else rss
+    if code != 0:
+        raise BenchError(f"{' '.join(cmd)} exited with code {code}: {result.stderr.strip()}")
+    return elapsed, rss, result.stdout
+
+
+def measure(cmd: list[str], repeat: int, cwd: str, probe: str | None = None) -> dict:
+    """Run `cmd` `repeat` times and summarize the runs."""
+    times, rss_samples, output = [], [], None
+    for _ in range(repeat):
+        elapsed, rss, out = run_once(cmd, cwd, probe)
+        if output is not None and out != output:
+            raise BenchError(f"{' '.join(cmd)} printed different output on different runs")
+        output = out
+        times.append(elapsed)
+        if rss is not None:
+            rss_samples.append(rss)
+    return {
+        "median_s": statistics.median(times),
+        "p95_s": percentile(times, 95),
+        "peak_rss_kb": max(rss_samples) if rss_samples else None,
+        "runs_s": times,
+        "output": output,
+    }
+
+
+def build_pb(pb_path: str, profile: str, out_dir: str) -> str:
+    """Build `pb_path` under `profile` and copy the executable to `out_dir`."""
+    name = os.path.splitext(os.path.basename(pb_path))[0]
+    with open(pb_path) as f:
+        source = f.read()
+    # The PGO training run inherits the cwd: keep its scratch files in out_dir too
+    cwd = os.getcwd()
+    os.chdir(out_dir)
+    try:
+        ok, _ = build(source, pb_path, name, profile=profile)
+    finally:
+        os.chdir(cwd)
+    if not ok:
+        raise BenchError(f"{name}: build failed under profile {profile}")
+    suffix = ".exe" if os.name == "nt" else ""
+    exe = os.path.join(out_dir, f"{name}-{profile}{suffix}")
+    shutil.copy2(get_build_output_path(name) + suffix, exe)
+    return exe
+
+
+def build_c(c_path: str, out_dir: str) -> str:
+    name = os.path.splitext(os.path.basename(c_path))[0]
+    exe = os.path.join(out_dir, f"{name}-c" + (".exe" if os.name == "nt" else ""))
+    result = subprocess.run(["gcc", *C_BASELINE_FLAGS, c_path, "-o", exe], capture_output=True, text=True)
+    if result.returncode != 0:
+        raise BenchError(f"{name}: C baseline failed to build:\n{result.stderr}")
+    return exe
+
+
+def environment() -> dict:
+    """What the numbers depend on besides the code, recorded with the results."""
+    gcc = subprocess.run(["gcc", "--version"], capture_output=True, text=True).stdout.splitlines()
+    commit = subprocess.run(["git", "rev-parse", "--short", "HEAD"], cwd=ROOT_DIR,
+                            capture_output=True, text=True).stdout.strip()
+    return {
+        "date": datetime.datetime.now(datetime.timezone.utc).isoformat(timespec="seconds"),
+        "commit": commit or None,
+        "python": platform.python_version(),
+        "gcc": gcc[0] if gcc else None,
+        "machine": platform.machine(),
+        "system": platform.system(),
+        "cpus": os.cpu_count(),
+    }
+
+
+def run_benchmarks(names: list[str] | None = None, profiles: list[str] | None = None, repeat: int = 5,
+                   out_path: str | None = None, baseline: str | None = None,
+                   bench_dir: str = BENCH_DIR, verbose: bool = False) -> dict:
+    """
+    Build and time every benchmark (or just `names`) under `profiles`
+    (default: all of them), CPython and the C baseline. Writes the results
+    to `out_path` (default build/bench/results.json), prints a table and
+    returns the results.
+    """
+    profiles = profiles or list(BUILD_PROFILES)
+    out_dir = get_build_output_path("bench")
+    os.makedirs(out_dir, exist_ok=True)
+    probe = maxrss_probe(out_dir)
+    results = []
+    for pb_path in discover(bench_dir, names):
+        name = os.path.splitext(os.path.basename(pb_path))[0]
+        variants = [(f"pb-{p}", lambda p=p: [build_pb(pb_path, p, out_dir)]) for p in profiles]
+        variants.append(("cpython", lambda: [sys.executable, pb_path]))
+        c_path = os.path.join(bench_dir, "c", f"{name}.c")
+        if os.path.isfile(c_path):
+            variants.append(("c", lambda: [build_c(c_path, out_dir)]))
+
+        rows = []
+        for impl, make_cmd in variants:
+            cmd = make_cmd()
+            if verbose: print(f"{name} [{impl}]: {' '.join(cmd)}")
+            # Scratch files the benchmarks write land next to the executables
+            rows.append({"bench": name, "impl": impl, **measure(cmd, repeat, out_dir, probe)})
+
+        expected = next(r["output"] for r in rows if r["impl"] == "cpython")
+        for row in rows:
+            if row["output"] != expected:
+                raise BenchError(f"{name} [{row['impl']}] printed something other than CPython")
+            del row["output"]
+        results.extend(rows)
+
+    report = {"environment": environment(), "repeat": repeat, "results": results}
+    out_path = out_path or os.path.join(out_dir, "results.json")
+    with open(out_path, "w") as f:
+        json.dump(report, f, indent=2)
+        f.write("\n")
+
+    previous = None
+    if baseline:
+        with open(baseline) as f:
+            previous = {(r["bench"], r["impl"]): r for r in json.load(f)["results"]}
+    print(format_table(results, previous))
+    print(f"Results written to {out_path}")
+    return report
+
+
+def format_table(results: list[dict], previous: dict | None = None) -> str:
+    """
+    One line per run variant. `vs cpython` is the CPython median over this
+    variant's median. With `previous`, `vs base` is this median over the
+    baseline's median, so values above 1.0 are regressions.
+    """
+    cpython = {r["bench"]: r["median_s"] for r in results if r["impl"] == "cpython"}
+    header = f"{'bench':<14}{'impl':<14}{'median ms':>11}{'p95 ms':>10}{'rss MiB':>10}{'vs cpython':>12}"
+    if previous is not None:
+        header += f"{'vs base':>10}"
+    lines = [header, "-" * len(header)]
+    for r in results:
+        rss = f"{r['peak_rss_kb'] / 1024:.1f}" if r["peak_rss_kb"] is not None else "-"
+        line = (f"{r['bench']:<14}{r['impl']:<14}{r['median_s'] * 1e3:>11.2f}{r['p95_s'] * 1e3:>10.2f}"
+                f"{rss:>10}{cpython[r['bench']] / r['median_s']:>11.1f}x")
+        if previous is not None:
+            old = previous.get((r["bench"], r["impl"]))
+            line += f"{r['median_s'] / old['median_s']:>10.2f}" if old else f"{'new':>10}"
+        lines.append(line)
+    return "\n".join(lines)
+
+
+# One generated function: loops, branches, lists, dicts, f-strings, a
+# constructor, try/except and a call to the previous function
+GENERATED_FUNCTION = """\
+def f{i}(n: int, scale: float) -> int:
+    total: int = {i}
+    xs: list[int] = []
+    d: dict[str, int] = {{}}
+    for k in range(n):
+        xs.append(k * 3 % 7)
+        if k % 2 == 0 and k > 1:
+            total += xs[k] - 1
+        elif k % 3 == 1:
+            total -= k // 2
+        else:
+            total = total + int(scale * {weight}.5)
+    d[f"key{{n}}"] = total
+    p: Point = Point(total, -n)
+    try:
+        if total < 0:
+            raise ValueError("negative")
+    except ValueError:
+        total = -total
+    label: str = f"f{{n}}: {{total}} {{scale}}"
+    total += len(label) + p.norm1() + d[f"key{{n}}"]
+    total += {call}
+    return total
+
+"""
+
+GENERATED_HEADER = """\
+class Point:
+    def __init__(self, x: int, y: int):
+        self.x = x
+        self.y = y
+
+    def norm1(self) -> int:
+        return self.x * self.x + self.y * self.y
+
+"""
+
+
+def generate_module(lines: int) -> str:
+    """A valid PB (and Python) module of about `lines` lines for `compile_benchmark`."""
+    parts = [GENERATED_HEADER]
+    count = GENERATED_HEADER.count("\n") + 4
+    i = 0
+    while count < lines or i == 0:
+        # every fifth function starts a new call chain, so the recursion stays shallow
+        call = f"f{i - 1}(n - 1, scale)" if i % 5 else "1"
+        parts.append(GENERATED_FUNCTION.format(i=i, weight=i % 10 + 1, call=call))
+        count += GENERATED_FUNCTION.count("\n")
+        i += 1
+    parts.append(f"def main():\n    print(f{i - 1}(3, 0.5))\n\n"
+                 "if __name__ == \"__main__\":\n    main()\n")
+    return "".join(parts)
+
+
+COMPILE_PHASES = ("lex", "parse", "check", "fold", "codegen")
+
+
+def compile_benchmark(lines: int = 50000, repeat: int = 3, out_path: str | None = None,
+                      baseline: str | None = None) -> dict:
+    """
+    Time each front-end phase on `generate_module(lines)`, `repeat` times.
+    Writes the results to `out_path` (default build/bench/compile.json),
+    prints a table and returns the results.
+    """
+    source = generate_module(lines)
+    times: dict[str, list[float]] = {phase: [] for phase in COMPILE_PHASES}
+    for _ in range(repeat):
+        start = time.perf_counter()
+        tokens = Lexer(source).tokenize()
+        lexed = time.perf_counter()
+        program = Parser(tokens).parse()
+        parsed = time.perf_counter()
+        TypeChecker().check(program)
+        checked = time.perf_counter()
+        fold_constants(program)
+        folded = time.perf_counter()
+        CodeGen().generate(program)
+        done = time.perf_counter()
+        marks = (start, lexed, parsed, checked, folded, done)
+        for phase, begin, end in zip(COMPILE_PHASES, marks, marks[1:]):
+            times[phase].append(end - begin)
+
+    n_lines = source.count("\n")
+    results = [{"bench": "compile", "impl": phase, "median_s": statistics.median(runs),
+                "p95_s": percentile(runs, 95), "peak_rss_kb": None, "runs_s": runs} for phase, runs in times.items()]
+    total = sum(r["median_s"] for r in results)
+    report = {"environment": environment(), "repeat": repeat, "lines": n_lines, "tokens": len(tokens),
+              "lines_per_s": n_lines / total, "results": results}
+    out_dir = get_build_output_path("bench")
+    os.makedirs(out_dir, exist_ok=True)
+    out_path = out_path or os.path.join(out_dir, "compile.json")
+    with open(out_path, "w") as f:
+        json.dump(report, f, indent=2)
+        f.write("\n")
+
+    previous = None
+    if baseline:
+        with open(baseline) as f:
+            previous = {(r["bench"], r["impl"]): r for r in json.load(f)["results"]}
+    header = f"{'phase':<10}{'median ms':>11}{'p95 ms':>10}"
+    if previous is not None:
+        header += f"{'vs base':>10}"
+    table = [header, "-" * len(header)]
+    for r in results:
+        line = f"{r['impl']:<10}{r['median_s'] * 1e3:>11.1f}{r['p95_s'] * 1e3:>10.1f}"
+        if previous is not None:
+            old = previous.get(("compile", r["impl"]))
+            line += f"{r['median_s'] / old['median_s']:>10.2f}" if old else f"{'new':>10}"
+        table.append(line)
+    print("\n".join(table))
+    print(f"{n_lines} lines, {len(tokens)} tokens: {report['lines_per_s']:.0f} lines/s")
+    print(f"Results written to {out_path}")
+    return report
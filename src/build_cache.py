@@ -0,0 +1,209 @@
+"""Content-hash build cache for the PB toolchain.
+
+Three layers, all stored under ``build/.cache``:
+
+* **Modules** – the lexed, parsed and type-checked result of a ``.pb`` file,
+  pickled together with the source hash and the cache keys of every module
+  it imported. An entry is reused when the source is unchanged and each
+  dependency still resolves to a module with the recorded key, so editing one
+  module invalidates it and its importers only.
+* **Generated C** – the ``.h``/``.c`` text for a module key plus the codegen
+  options.
+* **Objects** – ``.o`` files keyed by the C text, the text of every header it
+  includes (followed transitively) and the compiler flags; see
+  :func:`object_key`.
+
+Every key also folds in :func:`compiler_fingerprint`, so editing the compiler
+itself invalidates everything.
+"""
+
+import hashlib
+import json
+import os
+import pickle
+import re
+
+SRC_DIR = os.path.dirname(os.path.abspath(__file__))
+
+_fingerprint: str | None = None
+
+
+def _sha(*parts: str | bytes) -> str:
+    h = hashlib.sha256()
+    for part in parts:
+        h.update(part if isinstance(part, bytes) else part.encode("utf-8"))
+        h.update(b"\0")
+    return h.hexdigest()
+
+
+def compiler_fingerprint() -> str:
+    """Hash of the compiler sources and runtime header."""
+    global _fingerprint
+    if _fingerprint is None:
+        names = sorted(n for n in os.listdir(SRC_DIR) if n.endswith(".py") or n == "pb_runtime.h")
+        parts = []
+        for name in names:
+            with open(os.path.join(SRC_DIR, name), "rb") as f:
+                parts += [name, f.read()]
+        _fingerprint = _sha(*parts)
+    return _fingerprint
+
+
+_INCLUDE_RE = re.compile(r'^\s*#\s*include\s+"([^"]+)"', re.MULTILINE)
+
+
+def object_key(c_path: str, include_dirs: list[str], flags: list[str]) -> str:
+    """
+    Key for the object compiled from `c_path`: its text, every quoted
+    ``#include`` it reaches (searched next to the including file, then in
+    `include_dirs`) and the compile flags. Unresolvable includes are left
+    to the compiler and do not contribute.
+    """
+    parts = [compiler_fingerprint(), " ".join(flags)]
+    seen: set[str] = set()
+    stack = [os.path.abspath(c_path)]
+    while stack:
+        path = stack.pop()
+        if path in seen:
+            continue
+        seen.add(path)
+        with open(path, "r", encoding="utf-8", errors="replace") as f:
+            text = f.read()
+        parts += [path, text]
+        for inc in _INCLUDE_RE.findall(text):
+            for base in [os.path.dirname(path), *include_dirs]:
+                candidate = os.path.abspath(os.path.join(base, inc))
+                if os.path.isfile(candidate):
+                    stack.append(candidate)
+                    break
+    return _sha(*parts)
+
+
+def file_key(paths: list[str], *extra: str) -> str:
+    """Key over the contents of `paths` plus `extra` strings."""
+    parts = list(extra)
+    for path in paths:
+        with open(path, "rb") as f:
+            parts += [path, f.read()]
+    return _sha(*parts)
+
+
+def read_stamp(path: str) -> str | None:
+    """Return the key recorded next to a build output, if any."""
+    try:
+        with open(path + ".key", "r", encoding="utf-8") as f:
+            return f.read().strip()
+    except OSError:
+        return None
+
+
+def write_stamp(path: str, key: str | None) -> None:
+    """Record (or with None, drop) the key a build output was made from."""
+    stamp = path + ".key"
+    if key is None:
+        if os.path.exists(stamp):
+            os.remove(stamp)
+        return
+    with open(stamp, "w", encoding="utf-8") as f:
+        f.write(key)
+
+
+def write_if_changed(path: str, text: str) -> bool:
+    """Write `text` unless the file already holds it; True if written."""
+    try:
+        with open(path, "r", encoding="utf-8") as f:
+            if f.read() == text:
+                return False
+    except OSError:
+        pass
+    with open(path, "w", encoding="utf-8") as f:
+        f.write(text)
+    return True
+
+
+class ModuleCache:
+    """Per-module AST and generated-C cache (see module docstring)."""
+
+    def __init__(self, cache_dir: str):
+        self.cache_dir = cache_dir
+        os.makedirs(os.path.join(cache_dir, "modules"), exist_ok=True)
+        os.makedirs(os.path.join(cache_dir, "gen"), exist_ok=True)
+        self.hits = 0
+        self.misses = 0
+
+    def _entry_path(self, path: str, module_name: str) -> str:
+        return os.path.join(self.cache_dir, "modules", _sha(os.path.abspath(path), module_name) + ".pkl")
+
+    @staticmethod
+    def _key(source: str, module_name: str, dep_keys: list) -> str:
+        return _sha(compiler_fingerprint(), module_name, source, json.dumps(dep_keys))
+
+    def lookup(self, path: str, source: str, module_name: str, load_dep):
+        """
+        Return ``(key, value)`` for a valid entry, else None.
+
+        `load_dep(name_parts)` must load a dependency the same way the
+        uncached pass would and return its key; it raises
+        ModuleNotFoundError for names that do not resolve.
+        """
+        try:
+            with open(self._entry_path(path, module_name), "rb") as f:
+                entry = pickle.load(f)
+        except (OSError, EOFError, pickle.UnpicklingError, AttributeError, ImportError):
+            self.misses += 1
+            return None
+        if entry.get("fingerprint") != compiler_fingerprint() or entry.get("source") != _sha(source):
+            self.misses += 1
+            return None
+
+        from module_loader import ModuleNotFoundError
+        for name, key in entry["deps"]:
+            try:
+                current = load_dep(name)
+            except ModuleNotFoundError:
+                current = None
+            if current != key:
+                self.misses += 1
+                return None
+        self.hits += 1
+        return entry["key"], entry["value"]
+
+    def store(self, path: str, source: str, module_name: str, deps: list, value) -> str:
+        """
+        Save `value` for this module; `deps` lists ``(name_parts, key)``
+        for every import probe made, with key None for names that did not
+        resolve. Returns the module key.
+        """
+        key = self._key(source, module_name, [[list(n), k] for n, k in deps])
+        entry = {
+            "fingerprint": compiler_fingerprint(),
+            "source": _sha(source),
+            "deps": [(list(n), k) for n, k in deps],
+            "key": key,
+            "value": value,
+        }
+        tmp = self._entry_path(path, module_name) + ".tmp"
+        with open(tmp, "wb") as f:
+            pickle.dump(entry, f, protocol=pickle.HIGHEST_PROTOCOL)
+        os.replace(tmp, self._entry_path(path, module_name))
+        return key
+
+    def _gen_path(self, key: str, options: str) -> str:
+        return os.path.join(self.cache_dir, "gen", _sha(key, options) + ".json")
+
+    def generated(self, key: str | None, options: str) -> tuple[str, str] | None:
+        """Cached ``(h_code, c_code)`` for a module key and codegen options."""
+        if key is None:
+            return None
+        try:
+            with open(self._gen_path(key, options), "r", encoding="utf-8") as f:
+                data = json.load(f)
+        except (OSError, ValueError):
+            return None
+        return data["h"], data["c"]
+
+    def store_generated(self, key: str | None, options: str, h_code: str, c_code: str) -> None:
+        if key is None:
+            return
+        with open(self._gen_path(key, options), "w", encoding="utf-8") as f:
+            json.dump({"h": h_code, "c": c_code}, f)
@@ -1,18 +1,20 @@
 from __future__ import annotations
 import logging
 import functools
+import dataclasses
 from typing import List, Optional, Set, Any
 from lang_ast import (
     Program, FunctionDef, ClassDef, VarDecl, AssignStmt, AugAssignStmt,
     IfStmt, WhileStmt, ForStmt, ReturnStmt, ExprStmt, GlobalStmt,
-    TryExceptStmt, RaiseStmt, AssertStmt, BreakStmt, ContinueStmt,
+    TryExceptStmt, RaiseStmt, DelStmt, AssertStmt, BreakStmt, ContinueStmt,
     ImportStmt,
     ImportFromStmt,
     Expr, Identifier, Literal, StringLiteral, FStringLiteral, FStringText, FStringExpr,
-    BinOp, UnaryOp, CallExpr, AttributeExpr, IndexExpr,
+    BinOp, UnaryOp, CallExpr, AttributeExpr, IndexExpr, SliceExpr,
     ListExpr, SetExpr, DictExpr, EllipsisLiteral,
     Parameter, FunctionDef, PassStmt,
 )
+from type_checker import NUMERIC_LIST_BUILTINS
 
 # ───────────────────────── Logging Setup ─────────────────────────
 logging.basicConfig(
@@ -58,12 +60,80 @@ def debug(func):
 
     return wrapper
 
+# Value types that never point into arena memory
+ARENA_SCALAR_TYPES = {"int", "float", "bool", "None"}
+# Builtins that never retain their arguments
+ARENA_SAFE_BUILTINS = {"print", "len", "int", "float", "bool", "str", "hex", "intern", "range", "open", "set",
+                       "sum", "min", "max", "dot", "prefix_sum", "vadd", "vsub", "vmul", "sorted",
+                       "parallel_for", "atomic"}
+# Container methods that store their argument in the container
+ARENA_STORING_METHODS = {"append", "add", "insert", "extend"}
+# Builtins that can never change the length of a list
+LIST_LEN_SAFE_BUILTINS = {"print", "len", "int", "float", "bool", "str", "hex", "intern", "range", "open", "set",
+                          "sum", "min", "max", "dot", "prefix_sum", "vadd", "vsub", "vmul", "sorted"}
+
+# Builtins that never raise a PB exception (their failures abort)
+EXC_SAFE_BUILTINS = {"print", "len", "int", "float", "bool", "str", "hex", "intern", "range", "set",
+                     "sum", "prefix_sum", "sorted", "parallel_for", "spawn", "atomic"}
+# Container methods that never raise a PB exception
+EXC_SAFE_METHODS = {"append", "reserve", "insert", "extend", "sort", "count", "remove_all", "pop",
+                    "add", "discard", "union", "intersection", "difference", "join"}
+
+# Under --instrument, what a function's body is renamed to behind its timed wrapper
+TIMED_BODY_SUFFIX = "__pb_body"
+
+def _exc_id(type_name: str) -> int:
+    """FNV-1a of an exception type name, as computed by `pb_exc_id`."""
+    h = 2166136261
+    for byte in type_name.encode("utf-8"):
+        h = ((h ^ byte) * 16777619) & 0xFFFFFFFF
+    return h
+
+# Per node class, the fields that may hold child nodes; None for non-nodes
+_CHILD_FIELDS: dict[type, Optional[tuple[str, ...]]] = {}
+
+def _child_fields(cls: type) -> Optional[tuple[str, ...]]:
+    try:
+        return _CHILD_FIELDS[cls]
+    except KeyError:
+        names = None
+        if dataclasses.is_dataclass(cls):
+            names = tuple(f.name for f in dataclasses.fields(cls) if f.name != "inferred_type")
+        _CHILD_FIELDS[cls] = names
+        return names
+
+def _iter_exprs(node: Any):
+    """Yield every expression node nested in ``node`` (itself included), in pre-order."""
+    stack = [node]
+    while stack:
+        node = stack.pop()
+        if isinstance(node, list):
+            stack.extend(reversed(node))
+            continue
+        names = _child_fields(type(node))
+        if names is None:
+            continue
+        yield node
+        stack.extend(getattr(node, name) for name in reversed(names))
+
+
 class CodeGen:
     """Translate a typed AST (`lang_ast.Program`) into a full C99 file."""
 
     INDENT = "    "
 
-    def __init__(self) -> None:
+    def __init__(self, arena_scope: Optional[str] = None, unchecked: bool = False,
+                 instrument: bool = False) -> None:
+        # None, "function" or "loop": where to reset the runtime arena
+        self._arena_scope: Optional[str] = arena_scope
+        # Emit every list element access as a raw `.data[i]`, no bounds check
+        self._unchecked: bool = unchecked
+        # Wrap every function in PB_PROF_* timing hooks (see _emit_timed_wrapper)
+        self._instrument: bool = instrument
+        # (list name, index variable) pairs proven in bounds by an enclosing loop
+        self._safe_indices: list[tuple[str, str]] = []
+        self._fn_arena_mark: Optional[str] = None
+        self._fn_arena_ret_type: Optional[str] = None
         self._lines: List[str] = []
         self._indent: int = 0
         self._runtime_emitted: bool = False
@@ -74,12 +144,14 @@ class CodeGen:
         self._function_defaults: dict[str, list[str|None]] = {}
         self._function_returns: dict[str, Optional[str]] = {}
         self._tmp_counter: int = 0
+        # `_stmt` nesting, and object temporaries waiting for the top-level statement
+        self._stmt_depth: int = 0
+        self._object_temps: list[str] = []
         self._tmp_list_counter: int = 0
-        self._tmp_dict_counter: int = 0
-        self._tmp_set_counter: int = 0
 
-        # Track generic container instantiations
-        self._needed_list_types: set[tuple[str, str]] = set()
+        # Track generic container instantiations. Lists keep insertion
+        # order so an element list type is declared before lists of it.
+        self._needed_list_types: dict[str, str] = {}
         self._needed_dict_types: set[tuple[str, str]] = set()
         self._needed_set_types: set[tuple[str, str]] = set()
 
@@ -87,14 +159,26 @@ class CodeGen:
         self._instance_fields: dict[str, dict[str, str]] = {}
         self._class_bases: dict[str, Optional[str]] = {}
         self._direct_fields: dict[str, set[str]] = {}
+        self._field_order: dict[str, list[tuple[str, str]]] = {}
+        self._soa_classes: set[str] = set()
+        # ids of constructor calls whose object goes to a pool, and of the
+        # discarded removals that free one (see `_plan_object_escapes`)
+        self._escaping_ctors: set[int] = set()
+        self._freed_removals: set[int] = set()
+        self._param_leaks: dict[int, set[int]] = {}
+        self._fn_defs: dict[str, FunctionDef] = {}
 
         # Map class name to ClassDef for attribute lookups
         self._class_map: dict[str, ClassDef] = {}
 
         self._modules: dict[str, str] = {}  # alias -> real module name
 
-        # Lines that should execute before main to initialize globals
-        self._global_init_lines: list[str] = []
+        # (C target, value, object storage or None) for each global the
+        # module's init function sets, run on first use of its globals
+        self._global_inits: list[tuple[str, Expr, Optional[str]]] = []
+        # Globals (and class-level field names) that function sets
+        self._lazy_globals: set[str] = set()
+        self._lazy_static_attrs: set[str] = set()
 
         # Names of all classes in the current program
         self._class_names: set[str] = set()
@@ -102,6 +186,26 @@ class CodeGen:
         # Track which imported functions originate from native modules
         self._native_functions: dict[str, bool] = {}
 
+        # Exception lowering: functions that may raise, the ones that pass
+        # exceptions back to their caller through `pb_exc_pending`, and
+        # where the code being generated sends a pending exception (None:
+        # nowhere, it cannot be pending; "return": to the caller; else the
+        # label of the enclosing checked try).
+        self._raising_fns: set[str] = set()
+        self._checked_fns: set[str] = set()
+        self._exc_target: Optional[str] = None
+        self._exc_target_used: bool = False
+        self._exc_ret_type: str = "void"
+        self._exc_ids: dict[str, int] = {}
+        # parallel_for chunk functions, emitted ahead of the definitions
+        self._range_trampolines: dict[str, list[str]] = {}
+        # every string literal of the module, as C source, in first-use order
+        self._string_literals: dict[str, None] = {}
+        # setjmp tries open in the current function, and how many were open
+        # when each enclosing loop began: a return/break must pop the rest
+        self._open_trys: int = 0
+        self._loop_open_trys: list[int] = []
+
     def _attr_full_name(self, expr: Expr) -> str | None:
         if isinstance(expr, Identifier):
             return expr.name
@@ -112,6 +216,44 @@ class CodeGen:
             return f"{base}.{expr.attr}"
         return None
 
+    def _plan_class_layouts(self) -> None:
+        """Decide which instance fields each class struct stores, and in what order.
+
+        A field inherited from the base lives only in the embedded ``base``,
+        even when the subclass assigns or redeclares it, so base and subclass
+        methods share one copy. Own fields (class-body declarations, then
+        attributes assigned through ``self``) are ordered by alignment so
+        bools pack at the tail instead of padding between 8-byte members.
+        Only assigned fields are read through the instance (``_direct_fields``);
+        a declaration nobody assigns reads the class attribute.
+        """
+        self._direct_fields = {}
+        self._field_order = {}
+        self._soa_classes = {cls.name for cls in self._classes if "soa" in cls.decorators}
+        stored: dict[str, set[str]] = {}  # every field a class's struct holds, bases included
+        for cls in self._classes:
+            if cls.base in stored:
+                base_fields = stored[cls.base]
+            else:
+                base_fields = set(self._instance_fields.get(cls.base, {})) if cls.base else set()
+            fields = {f.name: f.declared_type for f in cls.fields}
+            for name, ty in self._instance_fields.get(cls.name, {}).items():
+                fields.setdefault(name, ty)
+            own = [(name, ty) for name, ty in fields.items() if name not in base_fields]
+            own.sort(key=lambda field: -self._c_align(field[1]))  # stable: keeps source order
+            self._field_order[cls.name] = own
+            assigned = self._instance_fields.get(cls.name, {})
+            self._direct_fields[cls.name] = {name for name, _ in own if name in assigned}
+            stored[cls.name] = base_fields | {name for name, _ in own}
+
+    def _soa_columns(self, name: str) -> list[tuple[str, str]]:
+        """The fields an ``@soa`` list stores: those objects assign through ``self``."""
+        return [(f, ty) for f, ty in self._field_order.get(name, []) if f in self._direct_fields[name]]
+
+    def _c_align(self, pb_type: str) -> int:
+        """Alignment of ``pb_type``'s C representation; everything but bool is 8."""
+        return 1 if pb_type == "bool" else 8
+
     def _find_class_attr_origin(self, class_name: str, attr: str) -> Optional[str]:
         """Return the class that defines ``attr`` by walking bases."""
         c = class_name
@@ -122,40 +264,49 @@ class CodeGen:
             c = self._class_bases.get(c)
         return None
 
+    def _index_program(self, program: Program) -> None:
+        """Top-level lookups the per-call and per-loop paths would otherwise rescan the module for."""
+        # name -> module prefix of its `from ... import`; a later import wins
+        self._imported_from: dict[str, str] = {}
+        for stmt in program.body:
+            if isinstance(stmt, ImportFromStmt):
+                for alias_obj in stmt.names or []:
+                    self._imported_from[alias_obj.asname or alias_obj.name] = "_".join(stmt.module)
+        self._global_var_names = {g.name for g in program.body if isinstance(g, VarDecl)}
+
     def generate(self, program: Program) -> str:
         """Generate the complete C source for ``program``."""
         self._program = program
         self._modules = getattr(program, "import_aliases", {}).copy()
         self._native_modules = getattr(program, "native_modules", {})
         self._native_functions = getattr(program, "native_functions", {})
+        self._index_program(program)
         self._lines.clear()
         self._indent = 0
         self._runtime_emitted = False
         self._needed_list_types.clear()
         self._needed_dict_types.clear()
         self._needed_set_types.clear()
-        self._global_init_lines.clear()
+        self._global_inits.clear()
 
         self._classes = [d for d in program.body if isinstance(d, ClassDef)]
         self._instance_fields = getattr(program, "inferred_instance_fields", {})
         self._class_bases = {cls.name: cls.base for cls in self._classes}
         self._class_names = {cls.name for cls in self._classes}
         self._class_map = {cls.name: cls for cls in self._classes}
-        self._direct_fields = {}
-        for cls in self._classes:
-            base_fields = set(self._instance_fields.get(cls.base, {})) if cls.base else set()
-            declared = {f.name for f in cls.fields}
-            assigned_here = self._assigned_fields_in_class(cls)
-            direct = set()
-            for field in self._instance_fields.get(cls.name, {}):
-                if field not in base_fields or field in assigned_here or field in declared:
-                    direct.add(field)
-            self._direct_fields[cls.name] = direct
+        self._plan_class_layouts()
+
+        self._exc_ids.clear()
+        self._range_trampolines.clear()
+        self._string_literals.clear()
+        self._plan_exception_lowering(program)
+        self._plan_object_escapes(program)
+        self._plan_module_init(program)
 
         self._emit_headers_and_runtime(False, include_self=True, include_runtime=False)
+        types_at = len(self._lines)
         self._emit_global_decls(program)
         self._emit_class_statics(program)
-        self._emit_global_init_func()
 
         # Definitions
         for stmt in program.body:
@@ -167,14 +318,39 @@ class CodeGen:
                 else:
                     self._emit_function(stmt)
             # top-level VarDecl or Assign go to globals, already handled
+        self._emit_global_init_func()
+        exc_ids = [f"#define PB_EXC_{name} 0x{i:08x}u" for name, i in sorted(self._exc_ids.items())]
+        trampolines = [line for lines in self._range_trampolines.values() for line in lines]
+        self._lines[types_at:types_at] = (self._specialization_lines() + exc_ids + ([""] if exc_ids else [])
+                                          + trampolines)
+        self._lines += self._literal_block_lines()
         return "\n".join(self._lines)
 
+    def _literal_block_lines(self) -> list[str]:
+        """
+        Hand the module's string literals to the runtime intern table (see
+        pb_intern_register), so `intern(s)` returns the literal for its text.
+        """
+        if not self._string_literals:
+            return []
+        return [
+            "",
+            "#ifdef PB_CONSTRUCTOR",
+            "static const char *const __pb_literals[] = {",
+            *(f"    {lit}," for lit in self._string_literals),
+            "};",
+            f"static PbInternBlock __pb_literal_block = {{__pb_literals, {len(self._string_literals)}, NULL}};",
+            "PB_CONSTRUCTOR static void __pb_register_literals(void) { pb_intern_register(&__pb_literal_block); }",
+            "#endif",
+        ]
+
     def generate_header(self, program: Program) -> str:
         """Generate a C header file (.h) for a given PB module AST."""
         self._program = program
         self._modules = getattr(program, "import_aliases", {}).copy()
         self._native_modules = getattr(program, "native_modules", {})
         self._native_functions = getattr(program, "native_functions", {})
+        self._index_program(program)
         self._lines.clear()
         self._indent = 0
         self._runtime_emitted = False
@@ -190,22 +366,17 @@ class CodeGen:
         self._class_bases = {cls.name: cls.base for cls in self._classes}
         self._class_names = {cls.name for cls in self._classes}
         self._class_map = {cls.name: cls for cls in self._classes}
-        self._direct_fields = {}
-        for cls in self._classes:
-            base_fields = set(self._instance_fields.get(cls.base, {})) if cls.base else set()
-            declared = {f.name for f in cls.fields}
-            assigned_here = self._assigned_fields_in_class(cls)
-            direct = set()
-            for field in self._instance_fields.get(cls.name, {}):
-                if field not in base_fields or field in assigned_here or field in declared:
-                    direct.add(field)
-            self._direct_fields[cls.name] = direct
+        self._plan_class_layouts()
+        self._plan_module_init(program)
 
         self._emit_headers_and_runtime(True, include_self=False, include_runtime=True)
+        types_at = len(self._lines)
         self._emit_global_externs(program)
+        self._emit_module_init_decl(program)
         self._emit_class_structs(program)
         self._emit_function_prototypes(program)
 
+        self._lines[types_at:types_at] = self._specialization_lines()
         return "\n".join(self._lines)
 
     def _emit_global_externs(self, program: Program) -> None:
@@ -307,7 +478,9 @@ class CodeGen:
             "float": "double",
             "bool": "bool",
             "str": "const char *",
-            "file": "PbFile",
+            "file": "PbFile *",
+            "future": "PbFuture *",
+            "atomic": "PbAtomic *",
         }
         if pb_type in tbl:
             return tbl[pb_type]
@@ -321,9 +494,11 @@ class CodeGen:
             if pb_type in mapping:
                 return mapping[pb_type]
             elem = pb_type[5:-1].strip()
+            if elem in self._soa_classes:
+                return f"Soa_{elem}"
             c_elem = self._c_type(elem)
             name = self._sanitize(elem)
-            self._needed_list_types.add((name, c_elem))
+            self._needed_list_types.setdefault(name, c_elem)
             return f"List_{name}"
         if pb_type.startswith("set[") and pb_type.endswith("]"):
             mapping = {
@@ -358,11 +533,6 @@ class CodeGen:
 
     def _emit_class_structs(self, program: Program) -> None:
         """Emit structs (with single inheritance) for each ClassDef in the program."""
-        # inside _emit_class_structs
-        # declared  = {fld.name for fld in stmt.fields}         # explicit fields
-        # inherited = fields from base classes (handled via _instance_fields)
-
-
         for stmt in program.body:
             if not isinstance(stmt, ClassDef):
                 continue
@@ -380,41 +550,63 @@ class CodeGen:
             if stmt.base:
                 self._emit(f"{stmt.base} base;")
 
-            # All VarDecls in stmt.fields become instance fields
-            for fld in stmt.fields:
-                c_ty = self._c_type(fld.declared_type)
-                # logger.info(f"[struct] {stmt.name}: explicit field '{fld.name}' as '{c_ty}'")
-                self._emit(f"{c_ty} {fld.name};")
-
-            declared = {fld.name for fld in stmt.fields}
-            instance_fields = self._instance_fields.get(stmt.name, {})
-            base_fields = set()
-            if stmt.base:
-                base_fields = set(self._instance_fields.get(stmt.base, {}))
-            assigned_here = self._assigned_fields_in_class(stmt)
-
-            actually_emitted: set[str] = set(declared)
-
-            for field_name in instance_fields:
-                pb_type = instance_fields[field_name]
-                if field_name in base_fields and field_name not in assigned_here:
-                    continue
-                if field_name in declared:
-                    continue
-                c_type = self._c_type(pb_type)
-                self._emit(f"{c_type} {field_name};")
-                actually_emitted.add(field_name)
+            for field_name, pb_type in self._field_order.get(name, []):
+                self._emit(f"{self._c_type(pb_type)} {field_name};")
 
             self._indent -= 1
             self._emit(f"}} {name};")
             self._emit()
+            if name in self._soa_classes:
+                self._emit_soa_list(name)
 
-            self._direct_fields[name] = actually_emitted
-            self._class_bases[name] = stmt.base
+    def _emit_soa_list(self, name: str) -> None:
+        """
+        Emit ``Soa_<name>``, the layout of ``list[<name>]`` for an ``@soa``
+        class: one array per field, so a loop over a few fields streams only
+        those arrays. ``append`` copies the object's fields into the next slot
+        of each; ``xs[i].f`` is ``xs.f[i]``. Class attributes get no array.
+        """
+        fields = self._soa_columns(name)
+        fn = f"soa_{name}"
+        lines = [
+            "typedef struct {",
+            f"{self.INDENT}int64_t len;",
+            f"{self.INDENT}int64_t capacity;",
+            *(f"{self.INDENT}{self._c_type(ty)} *{f};" for f, ty in fields),
+            f"}} Soa_{name};",
+            f"static inline void {fn}_init(Soa_{name} *s) {{",
+            f"{self.INDENT}memset(s, 0, sizeof *s);",
+            "}",
+            f"static inline void {fn}_reserve(Soa_{name} *s, int64_t n) {{",
+            f"{self.INDENT}if (n <= s->capacity) return;",
+            f"{self.INDENT}int64_t cap;",
+            *(f"{self.INDENT}cap = s->capacity; s->{f} = pb_list_grow(s->{f}, s->len, &cap, n, sizeof *s->{f}, \"{name}.{f}\");"
+              for f, _ in fields),
+            f"{self.INDENT}s->capacity = n;",
+            "}",
+            f"static inline int64_t {fn}_index(const Soa_{name} *s, int64_t index) {{",
+            f"{self.INDENT}if (PB_UNLIKELY((uint64_t)index >= (uint64_t)s->len))",
+            f"{self.INDENT * 2}pb_index_error(\"{name}\", \"get\", index, s->len, s);",
+            f"{self.INDENT}return index;",
+            "}",
+            f"static inline void {fn}_append(Soa_{name} *s, const struct {name} *obj) {{",
+            f"{self.INDENT}if (PB_UNLIKELY(s->len >= s->capacity))",
+            f"{self.INDENT * 2}{fn}_reserve(s, pb_list_next_capacity(s->len, s->capacity));",
+            *(f"{self.INDENT}s->{f}[s->len] = obj->{f};" for f, _ in fields),
+            f"{self.INDENT}s->len++;",
+            "}",
+        ]
+        for line in lines:
+            self._emit(line)
+        self._emit()
 
 
     def _emit_global_decls(self, program: Program) -> None:
-        """Emit global variables at top-level."""
+        """
+        Emit global variables at top-level. Those with a static initializer
+        are complete here; the rest are assigned by the module's init
+        function (see _plan_module_init).
+        """
         if self._globals_emitted:
             return
         self._globals_emitted = True
@@ -422,22 +614,120 @@ class CodeGen:
             if isinstance(stmt, VarDecl):
                 c_ty = self._c_type(stmt.declared_type)
                 name = self._mangle_global_name(stmt.name)
-                if isinstance(stmt.value, CallExpr) and isinstance(stmt.value.func, Identifier) and stmt.value.func.name in self._class_names:
+                if self._is_class_construction(stmt.value):
                     class_name = stmt.value.func.name
                     self._tmp_counter += 1
                     tmp = f"__tmp_{class_name.lower()}_{self._tmp_counter}"
                     self._emit(f"struct {class_name} {tmp};")
                     self._emit(f"{c_ty} {name};")
-                    args = [self._expr(a) for a in stmt.value.args]
-                    call = f"{class_name}____init__(&{tmp}{', ' if args else ''}{', '.join(args)})";
-                    self._global_init_lines.append(f"{call};")
-                    self._global_init_lines.append(f"{name} = &{tmp};")
+                    self._global_inits.append((name, stmt.value, tmp))
+                elif stmt.name in self._lazy_globals:
+                    self._emit(f"{c_ty} {name};")
+                    self._global_inits.append((name, stmt.value, None))
                 else:
-                    init = self._expr(stmt.value)
-                    self._emit(f"{c_ty} {name} = {init};")
+                    self._emit(f"{c_ty} {name} = {self._static_initializer(stmt.value)};")
         if self._globals_emitted:
             self._emit()
 
+    def _is_class_construction(self, value: Optional[Expr]) -> bool:
+        return (isinstance(value, CallExpr) and isinstance(value.func, Identifier)
+                and value.func.name in self._class_names)
+
+    def _static_initializer(self, value: Expr) -> Optional[str]:
+        """
+        C constant initializer for a global bound to `value`, or None if it
+        has to be computed at run time. Folded literals qualify, and so do
+        lists of them (nested ones too) and empty containers. A list points
+        at a static array with capacity 0, i.e. borrowed storage that its
+        first growth copies out (see pb_list_grow).
+        """
+        if isinstance(value, (Literal, StringLiteral)):
+            return self._expr(value)
+        if isinstance(value, ListExpr):
+            if not value.elements:
+                return "{0}"
+            elems = [self._static_initializer(x) for x in value.elements]
+            if None in elems:
+                return None
+            return f"{{{len(elems)}, 0, ({self._c_type(value.elem_type)}[]){{{', '.join(elems)}}}}}"
+        if isinstance(value, DictExpr) and not value.keys or isinstance(value, SetExpr) and not value.elements:
+            return "{0}"
+        return None
+
+    def _plan_module_init(self, program: Program) -> None:
+        """
+        Split the module's globals into those with a static initializer,
+        which are data in the executable and cost nothing at startup, and
+        the rest, which `<module>__init_globals` sets on first use: every
+        function that touches one of them starts with PB_INIT_<module>().
+        Objects built by a constructor call, class-level ones included, are
+        always set at run time.
+        """
+        self._lazy_globals = {
+            s.name for s in program.body
+            if isinstance(s, VarDecl)
+            and (self._is_class_construction(s.value) or self._static_initializer(s.value) is None)
+        }
+        self._lazy_static_attrs = {
+            f.name for cls in self._classes for f in cls.fields if self._is_class_construction(f.value)
+        }
+
+    def _module_c_name(self, module: Optional[str] = None) -> str:
+        return (module or self._get_module_name()).replace(".", "_")
+
+    def _init_guards(self, nodes: Any, include_self: bool = True) -> list[str]:
+        """
+        PB_INIT_<module>(); for every module whose globals `nodes` read or
+        write. Call targets are skipped: a module's functions guard
+        themselves.
+        """
+        imported = getattr(self._program, "imported_globals", {})
+        lazy_self = bool(self._lazy_globals or self._lazy_static_attrs)
+        modules: list[str] = []
+
+        def need(module: str) -> None:
+            if module == self._get_module_name() and not (include_self and lazy_self):
+                return
+            if self._native_modules.get(module, False) or module in modules:
+                return
+            modules.append(module)
+
+        callees: set[int] = set()
+        for node in _iter_exprs(nodes):
+            if isinstance(node, CallExpr):
+                callees.add(id(node.func))
+            elif id(node) in callees:
+                continue
+            elif isinstance(node, Identifier):
+                if node.name in self._lazy_globals:
+                    need(self._get_module_name())
+                elif node.name in imported:
+                    need(imported[node.name])
+            elif isinstance(node, AttributeExpr):
+                full = self._attr_full_name(node.obj)
+                if full in self._modules:
+                    need(self._modules[full])
+                elif node.attr in self._lazy_static_attrs:
+                    need(self._get_module_name())
+        return [f"PB_INIT_{self._module_c_name(m)}();" for m in modules]
+
+    def _emit_module_init_decl(self, program: Program) -> None:
+        """
+        Header side of _plan_module_init: importers reach the module's
+        globals through PB_INIT_<module>(), a no-op for a module with none
+        to set at run time.
+        """
+        if not (any(isinstance(s, VarDecl) for s in program.body) or self._lazy_static_attrs):
+            return
+        mod = self._module_c_name()
+        if self._lazy_globals or self._lazy_static_attrs:
+            self._emit(f"extern PbModuleInit {mod}__module;")
+            self._emit(f"void {mod}__init_globals(void);")
+            self._emit(f"#define PB_INIT_{mod}() PB_INIT_MODULE({mod})")
+        else:
+            self._emit(f"#define PB_INIT_{mod}() ((void)0)")
+        self._emit()
+
     def _emit_function_prototypes(self, program: Program) -> None:
         """Emit prototypes for every function the code-gen will create."""
         # — top-level (non-main) functions —
@@ -477,7 +767,7 @@ class CodeGen:
         self._emit()
 
 
-    def _func_proto(self, fn: FunctionDef) -> str:
+    def _func_proto(self, fn: FunctionDef, suffix: str = "") -> str:
         ret = self._c_type(fn.return_type)
         params = []
         for p in fn.params:
@@ -491,23 +781,23 @@ class CodeGen:
         if not name.startswith("main") and "__" not in name:
             name = f"{self._get_module_name()}_{name}"
 
-        return f"{ret} {name}({', '.join(params)})"
+        return f"{ret} {name}{suffix}({', '.join(params)})"
 
     def _emit_function(self, fn: FunctionDef) -> None:
         """Emit a standard (non-main) function definition."""
         mangled_name = self._mangle_function_name(fn.name)
 
-        self._emit(self._func_proto(fn))
+        if self._instrument:
+            self._emit("static " + self._func_proto(fn, TIMED_BODY_SUFFIX))
+        else:
+            self._emit(self._func_proto(fn))
 
         # keep metadata for print() type-picking
         self._function_returns[mangled_name] = fn.return_type or "None"
         
         # … and their default literals (or None if no default)
         # record defaults *only* for the real parameters (skip `self`)
-        self._function_defaults[mangled_name] = [
-            (arg.default.raw if arg.default else None)
-            for arg in fn.params
-        ]
+        self._function_defaults[mangled_name] = [self._default_arg(fn.name, arg) for arg in fn.params]
         # record parameter names …
         self._function_params[mangled_name] = [arg.name for arg in fn.params]
 
@@ -519,30 +809,673 @@ class CodeGen:
             if p.name:                      # skip the synthetic “void”
                 self._emit(f"(void){p.name};")
 
-        self._emit("char __fbuf[256];")
-        self._emit("(void)__fbuf;")
+        for line in self._init_guards(fn.body):
+            self._emit(line)
+        self._open_function_arena(fn)
+        self._exc_target = "return" if fn.name in self._checked_fns else None
+        self._exc_ret_type = self._c_type(fn.return_type)
         # declare parameters are already in C signature
         for stmt in fn.body:
             self._emit(self._stmt(stmt))
         # ensure void return
         if fn.return_type is None:
-            self._emit("return;")
+            self._emit(self._generate_ReturnStmt(ReturnStmt(None)))
+        else:
+            self._close_function_arena(fn)
+        self._fn_arena_mark = None
+        self._exc_target = None
         self._indent -= 1
         self._emit("}")
         self._emit()
+        if self._instrument:
+            self._emit_timed_wrapper(self._func_proto(fn), [p.name for p in fn.params])
 
     def _emit_main(self, fn: FunctionDef) -> None:
         """Map PB `main()` → `int main(void)`."""
-        self._emit("int main(void)")
+        self._emit(f"static int main{TIMED_BODY_SUFFIX}(void)" if self._instrument else "int main(void)")
         self._emit("{")
         self._indent += 1
-        self._emit("char __fbuf[256];")
-        self._emit("(void)__fbuf;")
+        for line in self._init_guards(fn.body):
+            self._emit(line)
+        self._open_function_arena(fn, c_return="int")
+        self._exc_target = None
+        self._exc_ret_type = "int"
         for stmt in fn.body:
             self._emit(self._stmt(stmt))
+        self._close_function_arena(fn)
+        if self._instrument and not (fn.body and isinstance(fn.body[-1], ReturnStmt)):
+            self._emit("return 0;")   # only `main` itself may fall off its end
+        self._fn_arena_mark = None
         self._indent -= 1
         self._emit("}")
         self._emit()
+        if self._instrument:
+            self._emit_timed_wrapper("int main(void)", [])
+
+    def _emit_timed_wrapper(self, proto: str, args: list[str]) -> None:
+        """
+        Under `--instrument` a function's body is emitted as a static
+        `<name>__pb_body`; this emits the real `proto` around it, timed by
+        PB_PROF_ENTER/EXIT. One exit hook then covers every way out of the
+        body, `return`s and pending-flag propagation alike; frames a longjmp
+        skips are closed by the runtime.
+        """
+        name = proto[:proto.index("(")].split()[-1]
+        ret_type = proto[:proto.index(name + "(")].strip()
+        record = f"pb_prof_{name}"
+        call = f"{name}{TIMED_BODY_SUFFIX}({', '.join(args)});"
+        self._emit(f'PB_PROF_FN({record}, "{name}")')
+        self._emit(proto)
+        self._emit("{")
+        self._indent += 1
+        self._emit(f"PB_PROF_ENTER({record});")
+        if ret_type == "void":
+            self._emit(call)
+            self._emit("PB_PROF_EXIT();")
+        else:
+            self._emit(f"{ret_type} __ret = {call}")
+            self._emit("PB_PROF_EXIT();")
+            self._emit("return __ret;")
+        self._indent -= 1
+        self._emit("}")
+        self._emit()
+
+    # --- Arena scopes ---
+
+    def _open_function_arena(self, fn: FunctionDef, c_return: Optional[str] = None) -> None:
+        """Take an arena mark on entry when `fn` lets no arena memory escape."""
+        self._fn_arena_mark = None
+        if self._arena_scope != "function":
+            return
+        if (fn.return_type or "None") not in ARENA_SCALAR_TYPES:
+            return
+        if not self._arena_scope_is_safe(fn.body, {p.name for p in fn.params}):
+            return
+        self._fn_arena_mark = "__arena_mark"
+        self._fn_arena_ret_type = c_return or self._c_type(fn.return_type)
+        self._emit("PbArenaMark __arena_mark = pb_arena_mark(pb_current_arena);")
+
+    def _close_function_arena(self, fn: FunctionDef) -> None:
+        """Reset the arena where `fn` falls off its end; each `return` resets its own."""
+        if self._fn_arena_mark and not (fn.body and isinstance(fn.body[-1], ReturnStmt)):
+            self._emit(f"pb_arena_reset(pb_current_arena, {self._fn_arena_mark});")
+
+    def _with_loop_arena(self, lines: list[str], body: list, loop_locals: set[str]) -> list[str]:
+        """Reset the arena at the top of every iteration and after the loop."""
+        if self._arena_scope != "loop" or not self._arena_scope_is_safe(body, set(loop_locals)):
+            return lines
+        self._tmp_counter += 1
+        mark = f"__arena_loop_{self._tmp_counter}"
+        reset = f"pb_arena_reset(pb_current_arena, {mark});"
+        return [
+            f"PbArenaMark {mark} = pb_arena_mark(pb_current_arena);",
+            lines[0],
+            self.INDENT + reset,
+            *lines[1:],
+            reset,
+        ]
+
+    def _arena_scope_is_safe(self, body: list, local_names: set[str]) -> bool:
+        """
+        Conservative escape check for an arena scope: true if no statement in
+        ``body`` can keep a pointer to memory allocated inside the scope once
+        it ends, i.e. nothing non-scalar is returned, stored into a name
+        declared outside the scope, an attribute, an item, a non-local
+        container, or handed to user code that might retain it. Any call
+        into user code counts as unsafe: it may store what it allocates.
+        """
+        def scalar(e: Optional[Expr]) -> bool:
+            return e is None or self._get_expr_type(e) in ARENA_SCALAR_TYPES
+
+        def calls_safe(e: Any) -> bool:
+            for node in _iter_exprs(e):
+                if not isinstance(node, CallExpr):
+                    continue
+                # user code may store what it allocates itself, whatever it is passed
+                risky = [a for a in node.args if not scalar(a) and not isinstance(a, StringLiteral)]
+                f = node.func
+                if isinstance(f, Identifier):
+                    if f.name in ARENA_SAFE_BUILTINS or f.name in self._class_names:
+                        continue
+                    return False
+                if isinstance(f, AttributeExpr):
+                    obj_type = self._get_expr_type(f.obj) or ""
+                    if obj_type.split("[")[0] in ("list", "set", "dict") or obj_type == "file":
+                        if not risky or f.attr not in ARENA_STORING_METHODS:
+                            continue
+                        if isinstance(f.obj, Identifier) and f.obj.name in local_names:
+                            continue
+                    return False
+            return True
+
+        def walk(stmts: list) -> bool:
+            for st in stmts:
+                if isinstance(st, VarDecl):
+                    local_names.add(st.name)
+                    if not calls_safe(st.value):
+                        return False
+                elif isinstance(st, (AssignStmt, AugAssignStmt)):
+                    tgt = st.target
+                    if isinstance(tgt, Identifier):
+                        if tgt.name not in local_names and not scalar(st.value):
+                            return False
+                    elif not scalar(st.value) or (isinstance(tgt, IndexExpr) and not scalar(tgt.index)):
+                        return False
+                    if not (calls_safe(tgt) and calls_safe(st.value)):
+                        return False
+                elif isinstance(st, ReturnStmt):
+                    if not scalar(st.value) or not calls_safe(st.value):
+                        return False
+                elif isinstance(st, GlobalStmt):
+                    local_names.difference_update(st.names)
+                elif isinstance(st, IfStmt):
+                    for br in st.branches:
+                        if not (calls_safe(br.condition) and walk(br.body)):
+                            return False
+                elif isinstance(st, WhileStmt):
+                    if not (calls_safe(st.condition) and walk(st.body)):
+                        return False
+                elif isinstance(st, ForStmt):
+                    local_names.update([st.var_name] + st.extra_vars)
+                    if not (calls_safe(st.iterable) and walk(st.body)):
+                        return False
+                elif isinstance(st, TryExceptStmt):
+                    local_names.update(b.alias for b in st.except_blocks if b.alias)
+                    blocks = [st.try_body, *(b.body for b in st.except_blocks), st.finally_body or []]
+                    if not all(walk(b) for b in blocks):
+                        return False
+                elif isinstance(st, ExprStmt):
+                    if not calls_safe(st.expr):
+                        return False
+                elif isinstance(st, RaiseStmt):
+                    # the exception object outlives the scope it is raised in
+                    if st.exception is not None:
+                        return False
+                elif isinstance(st, (AssertStmt, DelStmt)):
+                    e = st.condition if isinstance(st, AssertStmt) else st.target
+                    if not calls_safe(e):
+                        return False
+            return True
+
+        return walk(body)
+
+    # --- Object escapes ---
+
+    def _plan_object_escapes(self, program: Program) -> None:
+        """
+        Decide where each constructor call puts its object. One that cannot
+        outlive its function stays a stack temporary. One that may (it is
+        returned, stored in a container, attribute or global, aliased, or
+        passed where the callee keeps it) comes from the runtime's object
+        pools. A callee keeps an argument when its parameter escapes the same
+        way, which is settled per function and iterated to a fixpoint.
+
+        A local list that owns its objects (every element was constructed
+        straight into it and none is ever read out as a whole value or
+        shared with another list) frees them to the pool when a discarded
+        `pop()` or `swap_remove()` drops them.
+        """
+        fns = [s for s in program.body if isinstance(s, FunctionDef)]
+        fns += [m for cls in self._classes for m in cls.methods]
+        self._fn_defs = {s.name: s for s in program.body if isinstance(s, FunctionDef)}
+        self._param_leaks = {id(fn): set() for fn in fns}
+        changed = True
+        while changed:
+            changed = False
+            for fn in fns:
+                names, _, _, elems, _, _ = self._object_flow(fn)
+                # a list parameter whose elements are read out leaks them too
+                leaks = {i for i, p in enumerate(fn.params) if p.name in names or p.name in elems}
+                if leaks - self._param_leaks[id(fn)]:
+                    self._param_leaks[id(fn)] |= leaks
+                    changed = True
+
+        self._escaping_ctors = set()
+        self._freed_removals = set()
+        for fn in fns:
+            names, ctors, bindings, elems, impure, removals = self._object_flow(fn)
+            nodes = list(_iter_exprs(fn.body))
+            globals_ = {g for st in nodes if isinstance(st, GlobalStmt) for g in st.names}
+            self._escaping_ctors |= ctors
+            self._escaping_ctors |= {id(c) for name, c in bindings if name in names or name in globals_}
+            owned = {
+                st.name for st in nodes
+                if isinstance(st, VarDecl) and isinstance(st.value, ListExpr) and not st.value.elements
+                and st.declared_type[5:-1] in self._class_map and st.declared_type[5:-1] not in self._soa_classes
+            }
+            owned -= names | elems | impure | globals_
+            owned = {xs for xs in owned if sum(
+                1 for st in nodes
+                if isinstance(st, (VarDecl, AssignStmt)) and self._binds(st, xs)) == 1}
+            self._freed_removals |= {id(call) for xs, call in removals if xs in owned}
+
+    @staticmethod
+    def _binds(st: Any, name: str) -> bool:
+        if isinstance(st, VarDecl):
+            return st.name == name
+        return isinstance(st.target, Identifier) and st.target.name == name
+
+    def _callee_leaks(self, e: CallExpr) -> tuple[Optional[bool], Optional[list[bool]]]:
+        """
+        For a call `e`, whether the receiver object escapes (None when there is
+        no receiver object) and, per argument, whether it does. None in place
+        of the list means an unknown callee: every argument escapes.
+        """
+        f = e.func
+
+        def params_of(fn: Optional[FunctionDef], skip: int) -> Optional[list[bool]]:
+            if fn is None:
+                return None
+            leaks = self._param_leaks.get(id(fn))
+            if leaks is None:
+                return None
+            return [skip + i in leaks for i in range(len(e.args))]
+
+        if isinstance(f, Identifier):
+            if f.name in self._class_map:
+                init = self._resolve_method(f.name, "__init__")
+                return None, params_of(init, 1) if init else []
+            if f.name in ("print", "len"):
+                return None, [False] * len(e.args)
+            return None, params_of(self._fn_defs.get(f.name), 0)
+
+        if isinstance(f, AttributeExpr):
+            obj = f.obj
+            if isinstance(obj, Identifier) and obj.name in self._class_map:
+                return None, params_of(self._resolve_method(obj.name, f.attr), 0)
+            obj_type = self._value_type(obj) or ""
+            if obj_type in self._class_map:
+                m = self._resolve_method(obj_type, f.attr)
+                if m is None:
+                    return True, None
+                return 0 in self._param_leaks.get(id(m), {0}), params_of(m, 1)
+            if obj_type.startswith("list[") and obj_type[5:-1] in self._soa_classes and f.attr == "append":
+                return False, [False]  # the fields are copied out
+            if obj_type.split("[")[0] in ("list", "set", "dict"):
+                if f.attr in ("index", "count", "remove", "remove_all", "discard", "reserve", "swap_remove"):
+                    return False, [False] * len(e.args)
+                return False, None
+            if obj_type in ("file", "future", "atomic"):
+                return False, None
+        return True, None
+
+    def _resolve_method(self, class_name: str, method: str) -> Optional[FunctionDef]:
+        """The method a call on a `class_name` object runs; dispatch is static."""
+        c = class_name
+        while c:
+            cls = self._class_map.get(c)
+            if cls is None:
+                return None
+            for m in cls.methods:
+                if m.name == method:
+                    return m
+            c = cls.base
+        return None
+
+    def _object_flow(self, fn: FunctionDef):
+        """
+        One pass over `fn` for `_plan_object_escapes`. Returns the names used
+        where their value may escape, the constructor calls that escape
+        directly, the `(name, constructor)` pairs that bind a local, the lists
+        whose elements may escape, the lists holding anything but fresh
+        objects, and the `(list, call)` pairs of discarded removals.
+        """
+        names: set[str] = set()
+        ctors: set[int] = set()
+        bindings: list[tuple[str, CallExpr]] = []
+        elems: set[str] = set()
+        impure: set[str] = set()
+        removals: list[tuple[str, CallExpr]] = []
+        loops: list[tuple[str, str]] = []  # (loop variable, list it walks)
+
+        def is_ctor(e: Any) -> bool:
+            return isinstance(e, CallExpr) and isinstance(e.func, Identifier) and e.func.name in self._class_map
+
+        def visit(e: Any, safe: bool) -> None:
+            """Walk `e`; `safe` means its value cannot escape from this position."""
+            if isinstance(e, Identifier):
+                if not safe:
+                    names.add(e.name)
+            elif isinstance(e, AttributeExpr):
+                visit(e.obj, True)
+            elif isinstance(e, IndexExpr):
+                if not safe and isinstance(e.base, Identifier):
+                    elems.add(e.base.name)
+                visit(e.base, True)
+                visit(e.index, True)
+            elif isinstance(e, CallExpr):
+                if is_ctor(e) and not safe:
+                    ctors.add(id(e))
+                receiver, params = self._callee_leaks(e)
+                f = e.func
+                if isinstance(f, AttributeExpr):
+                    if isinstance(f.obj, Identifier) and (self._value_type(f.obj) or "").startswith("list["):
+                        xs = f.obj.name
+                        if f.attr in ("pop", "swap_remove") and not safe:
+                            elems.add(xs)
+                        if f.attr in ("append", "insert") and not is_ctor(e.args[-1]) or f.attr == "extend":
+                            impure.add(xs)
+                    if receiver is not None:
+                        visit(f.obj, not receiver)
+                for i, arg in enumerate(e.args):
+                    visit(arg, params is not None and i < len(params) and not params[i])
+            elif isinstance(e, (BinOp, UnaryOp)):
+                for child in (getattr(e, "left", None), getattr(e, "right", None), getattr(e, "operand", None)):
+                    if child is not None:
+                        visit(child, True)
+            elif isinstance(e, list):
+                for child in e:
+                    visit(child, False)
+            elif (fields := _child_fields(type(e))) is not None:
+                for name in fields:
+                    child = getattr(e, name)
+                    if isinstance(child, list) or _child_fields(type(child)) is not None:
+                        visit(child, False)
+
+        def bind(name: str, value: Any) -> None:
+            if is_ctor(value):
+                bindings.append((name, value))
+                visit(value, True)
+            else:
+                visit(value, False)
+
+        def walk(stmts: list) -> None:
+            for st in stmts:
+                if isinstance(st, VarDecl):
+                    bind(st.name, st.value)
+                elif isinstance(st, AssignStmt):
+                    if isinstance(st.target, Identifier):
+                        bind(st.target.name, st.value)
+                    else:
+                        if isinstance(st.target, IndexExpr) and isinstance(st.target.base, Identifier):
+                            impure.add(st.target.base.name)
+                        visit(st.target, True)
+                        visit(st.value, False)
+                elif isinstance(st, AugAssignStmt):
+                    visit(st.target, True)
+                    visit(st.value, True)
+                elif isinstance(st, ReturnStmt):
+                    visit(st.value, False)
+                elif isinstance(st, ExprStmt):
+                    call = st.expr
+                    if (isinstance(call, CallExpr) and isinstance(call.func, AttributeExpr)
+                            and call.func.attr in ("pop", "swap_remove") and isinstance(call.func.obj, Identifier)):
+                        removals.append((call.func.obj.name, call))
+                    visit(call, True)
+                elif isinstance(st, IfStmt):
+                    for br in st.branches:
+                        visit(br.condition, True)
+                        walk(br.body)
+                elif isinstance(st, WhileStmt):
+                    visit(st.condition, True)
+                    walk(st.body)
+                elif isinstance(st, ForStmt):
+                    for var, seq in self._loop_elements(st):
+                        if isinstance(seq, Identifier):
+                            loops.append((var, seq.name))
+                    for src in self._loop_sources(st):
+                        visit(src, True)
+                    walk(st.body)
+                elif isinstance(st, TryExceptStmt):
+                    walk(st.try_body)
+                    for block in st.except_blocks:
+                        walk(block.body)
+                    walk(st.finally_body or [])
+                elif isinstance(st, (AssertStmt, DelStmt)):
+                    visit(st.condition if isinstance(st, AssertStmt) else st.target, True)
+                elif isinstance(st, RaiseStmt):
+                    visit(st.exception, False)
+
+        walk(fn.body)
+        # a loop variable is each element in turn
+        elems |= {xs for var, xs in loops if var in names}
+        return names, ctors, bindings, elems, impure, removals
+
+    # --- Exception lowering ---
+
+    def _plan_exception_lowering(self, program: Program) -> None:
+        """
+        Find the functions that may raise and, among them, the ones that can
+        report an exception to their caller by setting `pb_exc_pending` and
+        returning. A function qualifies when every statement that may raise
+        is one `_exc_checkable` knows how to check right after it; a raise
+        from the runtime (an index or key error, a closed file) could only
+        longjmp, so code that might hit one keeps setjmp handlers.
+        """
+        bodies: dict[str, list] = {}
+        for stmt in program.body:
+            if isinstance(stmt, FunctionDef) and stmt.name != "main":
+                bodies[stmt.name] = stmt.body
+            elif isinstance(stmt, ClassDef):
+                for m in stmt.methods:
+                    bodies[f"{stmt.name}__{m.name}"] = m.body
+        self._exc_bodies = bodies
+
+        self._raising_fns = set()
+        changed = True
+        while changed:
+            changed = False
+            for key, body in bodies.items():
+                if key not in self._raising_fns and self._exc_may_raise(body):
+                    self._raising_fns.add(key)
+                    changed = True
+
+        # Assume every raising function qualifies, then drop the ones that
+        # do not until nothing changes (recursion keeps its assumption)
+        self._checked_fns = set(self._raising_fns)
+        changed = True
+        while changed:
+            changed = False
+            for key in sorted(self._checked_fns):
+                if not self._exc_checkable(bodies[key], in_try=False):
+                    self._checked_fns.discard(key)
+                    changed = True
+
+    def _exc_method_key(self, class_name: str, method: str) -> Optional[str]:
+        """`Class__method` of the class that defines ``method`` for ``class_name``."""
+        c: Optional[str] = class_name
+        while c:
+            cls = self._class_map.get(c)
+            if cls is None:
+                return None
+            if any(m.name == method for m in cls.methods):
+                return f"{c}__{method}"
+            c = cls.base
+        return None
+
+    def _exc_callee(self, call: CallExpr) -> Optional[str]:
+        """
+        The local function ``call`` runs, as a key of `_exc_bodies`; ""
+        for builtins, container methods and constructors without
+        `__init__` that never raise; None when the callee may raise
+        outside our control (the runtime, another module).
+        """
+        f = call.func
+        if isinstance(f, Identifier):
+            if f.name in self._class_map:
+                return self._exc_method_key(f.name, "__init__") or ""
+            if f.name in self._exc_bodies and f.name not in self._class_map:
+                return f.name
+            if f.name in EXC_SAFE_BUILTINS and not self._is_imported_name(f.name):
+                return ""
+            return None
+        if isinstance(f, AttributeExpr):
+            obj = f.obj
+            if isinstance(obj, Identifier) and obj.name in self._class_map:
+                return self._exc_method_key(obj.name, f.attr)
+            obj_type = self._value_type(obj) or ""
+            if obj_type.split("[")[0] in ("list", "set", "dict"):
+                return "" if f.attr in EXC_SAFE_METHODS else None
+            if obj_type in self._class_map:
+                return self._exc_method_key(obj_type, f.attr)
+        return None
+
+    def _is_imported_name(self, name: str) -> bool:
+        return name in self._imported_from
+
+    def _exc_scan(self, e: Optional[Expr]) -> Optional[list[CallExpr]]:
+        """
+        Calls in ``e`` to local functions that may raise, or None if ``e``
+        may raise some other way: a bounds- or key-checked index, a call
+        that `_exc_callee` cannot follow, a constructor that raises.
+        """
+        calls: list[CallExpr] = []
+        for node in _iter_exprs(e):
+            if isinstance(node, IndexExpr):
+                t = self._get_expr_type(node) or ""
+                if not (t.startswith("list[") and self._index_is_unchecked(node.base, node.index)):
+                    return None
+            elif isinstance(node, CallExpr):
+                key = self._exc_callee(node)
+                if key is None:
+                    return None
+                if key in self._raising_fns:
+                    if isinstance(node.func, Identifier) and node.func.name in self._class_map:
+                        return None   # constructors run ahead of the statement
+                    calls.append(node)
+        return calls
+
+    def _exc_may_raise(self, body: list) -> bool:
+        """True if running ``body`` may raise, as far as `_exc_scan` can tell."""
+        for st in body:
+            if isinstance(st, (RaiseStmt, DelStmt)):
+                return True
+            if isinstance(st, ForStmt):
+                if self._get_expr_type(st.iterable) == "file":
+                    return True
+                if any(self._exc_scan(src) != [] for src in self._loop_sources(st)):
+                    return True
+                if self._exc_in_range_loop(st, lambda: self._exc_may_raise(st.body)):
+                    return True
+                continue
+            nested: list[list] = []
+            exprs: list = []
+            if isinstance(st, IfStmt):
+                exprs = [br.condition for br in st.branches]
+                nested = [br.body for br in st.branches]
+            elif isinstance(st, WhileStmt):
+                exprs, nested = [st.condition], [st.body]
+            elif isinstance(st, TryExceptStmt):
+                nested = [st.try_body, *(b.body for b in st.except_blocks), st.finally_body or []]
+            elif isinstance(st, (ExprStmt, VarDecl, AssignStmt, AugAssignStmt, ReturnStmt, AssertStmt)):
+                exprs = [getattr(st, f) for f in ("expr", "value", "target", "condition") if hasattr(st, f)]
+            for e in exprs:
+                if self._exc_scan(e) != []:
+                    return True
+            if any(self._exc_may_raise(b) for b in nested):
+                return True
+        return False
+
+    def _exc_in_range_loop(self, st: ForStmt, check) -> bool:
+        """Run ``check`` with the lists `st` indexes in bounds marked safe, as codegen will."""
+        if not (isinstance(st.iterable, CallExpr) and getattr(st.iterable.func, "name", "") == "range"):
+            return check()
+        safe = [(name, st.var_name) for name in self._range_safe_lists(st)]
+        self._safe_indices.extend(safe)
+        try:
+            return check()
+        finally:
+            del self._safe_indices[len(self._safe_indices) - len(safe):]
+
+    def _exc_call_site(self, e: Optional[Expr]) -> Optional[CallExpr]:
+        """The call at the top of ``e`` when it is the only one in ``e`` that may raise."""
+        calls = self._exc_scan(e)
+        if calls and calls[0] is e and len(calls) == 1:
+            return e
+        return None
+
+    def _exc_checkable(self, body: list, in_try: bool, loop_depth: int = 0) -> bool:
+        """
+        True if every exception ``body`` can raise would be checked for right
+        after the statement raising it: a `raise`, or a call to a function in
+        `_checked_fns` that is itself a whole expression statement, the value
+        of a declaration, an assignment to a name or a return. ``in_try`` is
+        set for the body of a checked try, which may not be left early.
+        """
+        def clean(e: Optional[Expr]) -> bool:
+            return self._exc_scan(e) == []
+
+        def call_ok(e: Optional[Expr]) -> bool:
+            if clean(e):
+                return True
+            call = self._exc_call_site(e)
+            return call is not None and self._exc_callee(call) in self._checked_fns
+
+        def exits(stmts: list) -> bool:
+            return any(isinstance(n, (ReturnStmt, BreakStmt, ContinueStmt)) for n in _iter_exprs(stmts))
+
+        for st in body:
+            if isinstance(st, ExprStmt):
+                ok = call_ok(st.expr)
+            elif isinstance(st, VarDecl):
+                ok = call_ok(st.value)
+            elif isinstance(st, (AssignStmt, AugAssignStmt)):
+                if isinstance(st.target, Identifier):
+                    ok = call_ok(st.value)
+                else:
+                    ok = clean(st.target) and clean(st.value)
+            elif isinstance(st, ReturnStmt):
+                ok = not in_try and call_ok(st.value)
+            elif isinstance(st, (BreakStmt, ContinueStmt)):
+                ok = not in_try or loop_depth > 0
+            elif isinstance(st, RaiseStmt):
+                exc = st.exception
+                if isinstance(exc, CallExpr) and isinstance(exc.func, Identifier) \
+                        and exc.func.name not in self._class_map and len(exc.args) == 1:
+                    exc = exc.args[0]   # `raise ValueError("msg")` only evaluates the message
+                ok = clean(exc)
+            elif isinstance(st, AssertStmt):
+                ok = clean(st.condition)
+            elif isinstance(st, (PassStmt, GlobalStmt)):
+                ok = True
+            elif isinstance(st, IfStmt):
+                ok = all(clean(br.condition) and self._exc_checkable(br.body, in_try, loop_depth)
+                         for br in st.branches)
+            elif isinstance(st, WhileStmt):
+                ok = clean(st.condition) and self._exc_checkable(st.body, in_try, loop_depth + 1)
+            elif isinstance(st, ForStmt) and isinstance(st.iterable, CallExpr) \
+                    and getattr(st.iterable.func, "name", "") == "range":
+                ok = all(clean(a) for a in st.iterable.args) and self._exc_in_range_loop(
+                    st, lambda: self._exc_checkable(st.body, in_try, loop_depth + 1))
+            elif isinstance(st, ForStmt) and self._get_expr_type(st.iterable) != "file":
+                ok = all(clean(src) for src in self._loop_sources(st)) and self._exc_checkable(
+                    st.body, in_try, loop_depth + 1)
+            elif isinstance(st, TryExceptStmt):
+                # a setjmp try shields the code in its body, not its handlers
+                ok = self._exc_try_is_checked(st) or not (in_try and exits(st.try_body))
+                ok = ok and all(self._exc_checkable(b, in_try, loop_depth)
+                                for b in [*(b.body for b in st.except_blocks), st.finally_body or []])
+            else:
+                ok = False
+            if not ok:
+                return False
+        return True
+
+    def _exc_try_is_checked(self, st: TryExceptStmt) -> bool:
+        """True if ``st`` can use a pending-flag handler instead of setjmp."""
+        return self._exc_checkable(st.try_body, in_try=True)
+
+    def _exc_propagate(self) -> str:
+        """Send the pending exception to `_exc_target`."""
+        if self._exc_target == "return":
+            if self._exc_ret_type == "void":
+                return "return;"
+            return f"return ({self._exc_ret_type}){{0}};"
+        self._exc_target_used = True
+        return f"goto {self._exc_target};"
+
+    def _exc_check(self) -> str:
+        return f"if (PB_UNLIKELY(pb_exc_pending)) {self._exc_propagate()}"
+
+    def _exc_checked_call(self, e: Optional[Expr]) -> bool:
+        """True if ``e`` is a call whose exception must be checked for here."""
+        if self._exc_target is None or not isinstance(e, CallExpr):
+            return False
+        return self._exc_call_site(e) is not None and self._exc_callee(e) in self._checked_fns
+
+    def _exc_type_id(self, name: str) -> str:
+        self._exc_ids[name] = _exc_id(name)
+        return f"PB_EXC_{name}"
 
     def _find_base_init(self, cls: ClassDef):
         """
@@ -622,9 +1555,7 @@ class CodeGen:
                     params_code = ", ".join(f"{self._c_type(p.type)} {p.name}" for p in params)
 
                     mangled = f"{cls.name}__{m}"
-                    self._function_defaults[mangled] = [
-                        (p.default.raw if p.default else None) for p in method.params
-                    ]
+                    self._function_defaults[mangled] = [self._default_arg(mangled, p) for p in method.params]
                     self._function_params[mangled] = [p.name for p in method.params]
                     self._emit(
                         f"static inline {ret_c} {cls.name}__{m}(")
@@ -639,7 +1570,29 @@ class CodeGen:
                     self._emit()
 
     def _stmt(self, st: Any) -> str:
-        """Translate one AST statement → C, returning a full C statement/block."""
+        """Translate one AST statement → C, returning a full C statement/block.
+
+        Setup lines the expression generators `_emit` (temporaries, constructor
+        calls) are taken back out of the output and put right before the
+        statement, so a nested statement's setup runs inside its own block.
+        Object temporaries are declared before the enclosing top-level
+        statement instead, so they outlive the block that fills them.
+        """
+        mark = len(self._lines)
+        self._stmt_depth += 1
+        try:
+            code = self._dispatch_stmt(st)
+        finally:
+            self._stmt_depth -= 1
+        cut = len(self.INDENT * self._indent)
+        setup = [line[cut:] for line in self._lines[mark:]]
+        del self._lines[mark:]
+        if self._stmt_depth == 0:
+            setup = self._object_temps + setup
+            self._object_temps = []
+        return "\n".join(setup + [code])
+
+    def _dispatch_stmt(self, st: Any) -> str:
         # Dispatch to specific generator methods based on node type
         if isinstance(st, ExprStmt): return self._generate_ExprStmt(st.expr)
         if isinstance(st, AssignStmt): return self._generate_AssignStmt(st)
@@ -653,6 +1606,7 @@ class CodeGen:
         if isinstance(st, ContinueStmt): return self._generate_ContinueStmt(st)
         if isinstance(st, AssertStmt): return self._generate_AssertStmt(st)
         if isinstance(st, RaiseStmt): return self._generate_RaiseStmt(st)
+        if isinstance(st, DelStmt): return self._generate_DelStmt(st)
         if isinstance(st, GlobalStmt): return self._generate_GlobalStmt(st)
         if isinstance(st, TryExceptStmt): return self._generate_TryExceptStmt(st)
         if isinstance(st, VarDecl): return self._generate_VarDecl(st)
@@ -667,11 +1621,23 @@ class CodeGen:
         if isinstance(expr, CallExpr) and \
            isinstance(expr.func, Identifier) and expr.func.name == "print":
             return self._generate_print_call(expr)
+        if self._exc_checked_call(expr):
+            return f"{self._expr(expr)};\n{self._exc_check()}"
+        if id(expr) in self._freed_removals:
+            # the list owned the object and nothing else refers to it
+            cls = self._get_expr_type(expr.func.obj)[5:-1]
+            return f"pb_obj_free({self._expr(expr)}, sizeof(struct {cls}));"
         return self._expr(expr) + ";"
 
     def _get_expr_type(self, expr: Expr) -> Optional[str]:
         return getattr(expr, "inferred_type", None)
 
+    def _value_type(self, expr: Expr) -> Optional[str]:
+        """Type of the value `expr` produces; an IndexExpr records its container type."""
+        if isinstance(expr, IndexExpr):
+            return expr.elem_type
+        return self._get_expr_type(expr)
+
     def _generate_print_call(self, ce: CallExpr) -> str:
 
         def _print_function_for_type(t: str) -> str:
@@ -703,12 +1669,18 @@ class CodeGen:
         lines: list[str] = []
 
         for arg in ce.args:
+            # print(f"...") formats straight to stdout, no string is built
+            if isinstance(arg, FStringLiteral):
+                fmt, fargs, _ = self._fstring_format(arg)
+                lines.append(f"pb_print_fmt({', '.join([fmt] + fargs)});")
+                continue
+
             arg_expr = self._expr(arg)
             print_arg = arg_expr
             t = self._get_expr_type(arg)
 
-            # Always prefer explicit string forms for string literals and f-strings
-            if isinstance(arg, (StringLiteral, FStringLiteral)):
+            # Always prefer explicit string forms for string literals
+            if isinstance(arg, StringLiteral):
                 lines.append(f"pb_print_str({arg_expr});")
                 continue
 
@@ -718,18 +1690,10 @@ class CodeGen:
             # - AttributeExpr   self.hp, obj.name
             # - IndexExpr       arr[0], d["x"]
             # - CallExpr        get_name()
-            if isinstance(arg, Identifier):
-                if t and (t.startswith("list[") or t.startswith("set[")):
-                    print_arg = f"&{print_arg}"
-
             if isinstance(arg, IndexExpr):
                 base_type = self._get_expr_type(arg.base)
                 if base_type and base_type.startswith("dict["):
                     value_type = _extract_dict_value_type(base_type)
-                    func = f"pb_dict_get_str_{value_type}"
-                    key = self._expr(arg.index)
-                    base = self._expr(arg.base)
-                    print_arg = f"{func}({base}, {key})"
                     t = value_type
                 elif base_type and base_type.startswith("list["):
                     t = arg.elem_type
@@ -737,6 +1701,10 @@ class CodeGen:
             if not t:
                 raise RuntimeError(f"No inferred type for: {arg}")
 
+            if t and (t.startswith("list[") or t.startswith("set[")):
+                # e.g. print(a.union(b)): rvalues are spilled, the printer needs an lvalue
+                print_arg = self._addr_of(arg, arg_expr)
+
             print_func = _print_function_for_type(t)
             lines.append(f"{print_func}({print_arg});")
 
@@ -746,27 +1714,33 @@ class CodeGen:
         if not isinstance(st.target, (Identifier, AttributeExpr, IndexExpr)):
             raise RuntimeError(f"Unsupported assignment target: {type(st.target).__name__}")
 
-        tgt = self._expr(st.target)
-        val = self._expr(st.value)
-
-        # target is list
-        # x = [1]
+        # target is a list or dict element
+        # xs[i] = v, d["k"] = v
         if isinstance(st.target, IndexExpr):
-            list_type = st.inferred_type
-            base_name = st.target.base.name
+            container_type = st.inferred_type
+            val = self._expr(st.value)
             index_val = self._expr(st.target.index)
+            is_list = bool(container_type and container_type.startswith("list["))
+            if is_list and self._index_is_unchecked(st.target.base, st.target.index):
+                return f"{self._expr(st.target.base)}.data[{index_val}] = {val};"
+            base = self._addr_of(st.target.base)
 
-            if list_type == "list[int]":
-                return f"list_int_set(&{base_name}, {index_val}, {val});"
-            if list_type == "list[str]":
-                return f"list_str_set(&{base_name}, {index_val}, {val});"
-            if list_type == "list[float]":
-                return f"list_float_set(&{base_name}, {index_val}, {val});"
-            if list_type == "list[bool]":
-                return f"list_bool_set(&{base_name}, {index_val}, {val});"
+            if container_type and container_type.startswith("dict["):
+                return f"pb_dict_set_str_{st.target.elem_type}({base}, {index_val}, {val});"
+            if is_list:
+                return f"{self._list_fn(container_type)}_set({base}, {index_val}, {val});"
 
+        tgt = self._expr(st.target)
+        val = self._expr(st.value)
+        if self._exc_checked_call(st.value):
+            # like Python, leave the target alone when the call raises
+            return self._exc_checked_assign(tgt, "=", st.value, val)
         return f"{tgt} = {val};"
 
+    def _exc_checked_assign(self, tgt: str, op: str, value: Expr, val: str) -> str:
+        c_ty = self._c_type(self._get_expr_type(value))
+        return f"{{\n{self.INDENT}{c_ty} __val = {val};\n{self.INDENT}{self._exc_check()}\n{self.INDENT}{tgt} {op} __val;\n}}"
+
     def _generate_AugAssignStmt(self, st: AugAssignStmt) -> str:
         tgt = self._expr(st.target)
         val = self._expr(st.value)
@@ -775,9 +1749,35 @@ class CodeGen:
         if op.endswith("="): op = op[:-1]
         # integer‐div replacement
         if op == "//": op = "/"
+        if self._exc_checked_call(st.value):
+            return self._exc_checked_assign(tgt, f"{op}=", st.value, val)
         return f"{tgt} {op}= {val};"
 
     def _generate_ReturnStmt(self, st: ReturnStmt) -> str:
+        pops = self._try_pops(self._open_trys)
+        if pops and not self._fn_arena_mark:
+            # leaving a setjmp try: the value is computed under its handler
+            if st.value is None:
+                return f"{pops}\nreturn;"
+            return (
+                f"{{\n{self.INDENT}{self._exc_ret_type} __ret = {self._expr(st.value)};\n"
+                f"{self.INDENT}{pops}\n{self.INDENT}return __ret;\n}}"
+            )
+        if self._fn_arena_mark:
+            # the value is scalar, so it survives the reset
+            reset = f"pb_arena_reset(pb_current_arena, {self._fn_arena_mark});"
+            if pops:
+                reset = f"{pops}\n{self.INDENT}{reset}"
+            if st.value is None:
+                return f"{reset}\nreturn;"
+            ret_type = self._fn_arena_ret_type
+            # a raised exception object lives past the mark: keep it
+            check = f"{self.INDENT}if (PB_UNLIKELY(pb_exc_pending)) return __ret;\n" \
+                if self._exc_checked_call(st.value) else ""
+            return (
+                f"{{\n{self.INDENT}{ret_type} __ret = {self._expr(st.value)};\n"
+                f"{check}{self.INDENT}{reset}\n{self.INDENT}return __ret;\n}}"
+            )
         ret = "" if st.value is None else " " + self._expr(st.value)
         return f"return{ret};"
 
@@ -801,13 +1801,15 @@ class CodeGen:
         lines = [f"while ({cond}) {{"]
 
         # 2) translate every statement inside the while-body
+        self._loop_open_trys.append(self._open_trys)
         for sub in st.body:
             # prepend exactly one extra indent level so nested code lines up
             lines.append(self.INDENT + self._stmt(sub))
+        self._loop_open_trys.pop()
 
         # 3) close the block
         lines.append("}")
-        return "\n".join(lines)
+        return "\n".join(self._with_loop_arena(lines, st.body, set()))
 
     def _generate_ForStmt(self, st: ForStmt) -> str:
         # only support: for var in range(stop) or range(start, stop)
@@ -821,62 +1823,374 @@ class CodeGen:
                 start = self._expr(args[0])
                 stop  = self._expr(args[1])
 
-            # build the for-loop header
-            lines = [f"for (int64_t {st.var_name} = {start}; {st.var_name} < {stop}; ++{st.var_name}) {{"]
-            # inject body statements
+            # build the for-loop header; like Python, evaluate the bound once
+            # (a plain variable is re-read only while the body cannot rebind it)
+            var = st.var_name
+            if isinstance(args[-1], Literal) or (
+                isinstance(args[-1], Identifier) and not self._assigns_name(st.body, args[-1].name)
+            ):
+                lines = [f"for (int64_t {var} = {start}; {var} < {stop}; ++{var}) {{"]
+            else:
+                self._tmp_counter += 1
+                bound = f"__stop_{self._tmp_counter}"
+                lines = [f"for (int64_t {var} = {start}, {bound} = {stop}; {var} < {bound}; ++{var}) {{"]
+            # the trip count is known: size appended-to lists once up front
+            trips = f"({stop} - {start})" if start != "0" else stop
+            hints = [
+                f"{self._list_fn(lst_type)}_reserve(&{name}, {name}.len + {count} * {trips});"
+                for name, lst_type, count in self._range_append_hints(st)
+            ]
+            # inject body statements, indexing proven-safe lists directly
+            safe = [(name, var) for name in self._range_safe_lists(st)]
+            self._safe_indices.extend(safe)
+            self._loop_open_trys.append(self._open_trys)
             for s in st.body:
                 lines.append(self.INDENT + self._stmt(s))
+            self._loop_open_trys.pop()
+            del self._safe_indices[len(self._safe_indices) - len(safe):]
             lines.append("}")
-            return "\n".join(lines)
+            return "\n".join(hints + self._with_loop_arena(lines, st.body, {var}))
+        elif self._get_expr_type(loop) == "file":
+            return self._generate_file_lines_loop(st)
+        return self._generate_foreach(st)
+
+    def _loop_kind(self, st: ForStmt) -> Optional[str]:
+        """"enumerate", "zip" or "items" for the iterables the checker unpacks, else None."""
+        it = st.iterable
+        if isinstance(it, CallExpr) and it.inferred_type in ("enumerate", "zip", "items"):
+            return it.inferred_type
+        return None
+
+    def _loop_sources(self, st: ForStmt) -> list[Expr]:
+        """The expressions the for loop `st` evaluates once, before its first iteration."""
+        it = st.iterable
+        kind = self._loop_kind(st)
+        if kind in ("enumerate", "zip") or isinstance(it, CallExpr) and getattr(it.func, "name", "") == "range":
+            return list(it.args)
+        if kind == "items":
+            return [it.func.obj]
+        return [it]
+
+    def _loop_elements(self, st: ForStmt) -> list[tuple[str, Expr]]:
+        """Each variable of the for-each loop `st` bound to elements of a sequence, with that sequence."""
+        it = st.iterable
+        kind = self._loop_kind(st)
+        if kind == "enumerate":
+            return [(st.extra_vars[0], it.args[0])]
+        if kind == "zip":
+            return list(zip([st.var_name] + st.extra_vars, it.args))
+        if kind == "items":
+            return [(st.extra_vars[0], it.func.obj)]
+        return [(st.var_name, it)]
+
+    def _loop_keeps_storage(self, body: list, seq: Expr) -> bool:
+        """
+        True if running `body` cannot move or resize the elements of the
+        container `seq`, so a loop over it may hoist its data and end
+        pointers. A local name qualifies unless the body calls a method on
+        it or seq is no local (a global or an attribute) and the body calls
+        user code. Item assignment keeps the storage, and rebinding the name
+        leaves the loop on the old container, as in Python.
+        """
+        if not isinstance(seq, (Identifier, AttributeExpr)):
+            return True   # a temporary nothing else can reach
+        target = self._attr_full_name(seq)
+        local = isinstance(seq, Identifier) and seq.name not in self._global_var_names
+        for node in _iter_exprs(body):
+            if isinstance(node, CallExpr):
+                f = node.func
+                if isinstance(f, AttributeExpr) and self._attr_full_name(f.obj) == target:
+                    return False
+                if not local and not (isinstance(f, Identifier) and f.name in LIST_LEN_SAFE_BUILTINS):
+                    return False
+        return True
+
+    def _generate_foreach(self, st: ForStmt) -> str:
+        """
+        `for x in xs` over a list, set, dict (its keys) or str, and
+        `for ... in` enumerate(...), zip(...) or d.items(). Each sequence is
+        evaluated once. Lists and sets are walked by pointer up to a hoisted
+        end pointer, with no bounds checks: a counted loop GCC can unroll
+        and vectorize. A body that may resize a container it walks gets an
+        index loop that rereads the length instead. Dicts skip deleted
+        entries, and strings are walked by character.
+        """
+        it = st.iterable
+        kind = self._loop_kind(st)
+        names = [st.var_name] + st.extra_vars
+        lines: list[str] = []
+        self._tmp_counter += 1
+        n = self._tmp_counter
+
+        sources = self._loop_sources(st)
+        start = sources.pop() if kind == "enumerate" and len(sources) == 2 else None
+        seqs: list[tuple[str, str]] = []   # (C expression, PB type) of each sequence
+        for src in sources:
+            code, pb_type = self._expr(src), self._get_expr_type(src)
+            if not isinstance(src, (Identifier, AttributeExpr)) and pb_type != "str":
+                tmp = f"__seq_{n}_{len(seqs)}"
+                lines.append(f"{self._c_type(pb_type)} {tmp} = {code};")
+                code = tmp
+            seqs.append((code, pb_type))
+        if kind == "enumerate":
+            count = f"__count_{n}"
+            lines.append(f"int64_t {count} = {self._expr(start) if start else '0'};")
+        stable = all(self._loop_keeps_storage(st.body, src) for _, src in self._loop_elements(st))
+
+        # `head` opens the loop; `bind` starts the body by binding the loop
+        # variables; an element is fetched by `at(k)` for the k-th sequence
+        seq, seq_type = seqs[0]
+        decl = lambda name, pb_type, value: f"{self._c_type(pb_type)} {name} = {value};"
+        # a cursor over T is `T *`, spelled base type plus stars so the end
+        # pointer declared beside it (`*__end`) gets the same type for str
+        # and object elements, whose C types are pointers themselves
+        stars = lambda pb_type: "*" * (self._c_type(pb_type).count("*") + 1)
+        ptr = lambda pb_type: f"{self._c_type(pb_type).rstrip(' *')} {stars(pb_type)}"
+        elem_vars = names[1:] if kind == "enumerate" else names
+        bind: list[str] = []
+        if seq_type == "str":
+            cursor = f"__chars_{n}"
+            head = f"for (const char *{cursor} = {seq}; *{cursor};) {{"
+            bind.append(f"const char *{elem_vars[0]} = pb_str_next_char(&{cursor});")
+        elif seq_type.startswith("dict["):
+            pair = "Pair_" + self._c_type(seq_type)[len("Dict_"):]
+            value_type = seq_type[len("dict[str, "):-1]
+            if stable:
+                cursor = f"__entry_{n}"
+                head = (f"for ({pair} *{cursor} = {seq}.data, *__end_{n} = {cursor} + {seq}.index.used; "
+                        f"{cursor} != __end_{n}; ++{cursor}) {{")
+                entry = f"{cursor}->"
+            else:
+                i = f"__i_{n}"
+                head = f"for (int64_t {i} = 0; {i} < {seq}.index.used; ++{i}) {{"
+                entry = f"{seq}.data[{i}]."
+            bind.append(f"if ({entry}key == NULL) continue;   /* deleted */")
+            bind.append(f"const char *{elem_vars[0]} = {entry}key;")
+            if kind == "items":
+                bind.append(decl(names[1], value_type, f"{entry}value"))
+        elif stable:
+            cursors = [f"__it_{n}_{k}" for k in range(len(seqs))]
+            elem_types = [t[t.index("[") + 1:-1] for _, t in seqs]
+            if len(seqs) == 1:
+                head = (f"for ({ptr(elem_types[0])}{cursors[0]} = {seq}.data, "
+                        f"{stars(elem_types[0])}__end_{n} = {cursors[0]} + {seq}.len; {cursors[0]} != __end_{n}; ++{cursors[0]}) {{")
+            else:
+                trips = f"__n_{n}"
+                lines.append(f"int64_t {trips} = {seq}.len;")
+                for code, _ in seqs[1:]:
+                    lines.append(f"if ({code}.len < {trips}) {trips} = {code}.len;")
+                for cursor, (code, _), elem in zip(cursors[1:], seqs[1:], elem_types[1:]):
+                    lines.append(f"{ptr(elem)}{cursor} = {code}.data;")
+                steps = ", ".join(f"++{c}" for c in cursors)
+                head = (f"for ({ptr(elem_types[0])}{cursors[0]} = {seq}.data, "
+                        f"{stars(elem_types[0])}__end_{n} = {cursors[0]} + {trips}; {cursors[0]} != __end_{n}; {steps}) {{")
+            bind += [decl(v, t, f"*{c}") for v, t, c in zip(elem_vars, elem_types, cursors)]
         else:
-            # fallback for other iterables
-            return "/* unsupported for-loop */"
-        return f"for(int64_t {st.var_name}={start}; {st.var_name}<{stop}; ++{st.var_name}) {{ /* ... */ }}"
+            i = f"__i_{n}"
+            elem_types = [t[t.index("[") + 1:-1] for _, t in seqs]
+            bounds = " && ".join(f"{i} < {code}.len" for code, _ in seqs)
+            head = f"for (int64_t {i} = 0; {bounds}; ++{i}) {{"
+            bind += [decl(v, t, f"{code}.data[{i}]") for v, t, (code, _) in zip(elem_vars, elem_types, seqs)]
+        if kind == "enumerate":
+            bind.append(f"int64_t {names[0]} = {count}++;")
+        # silence -Wunused-variable for loop variables the body never reads
+        bind += [f"(void){v};" for v in names]
+
+        body = [head] + [self.INDENT + line for line in bind]
+        self._loop_open_trys.append(self._open_trys)
+        for s in st.body:
+            body.append(self.INDENT + self._stmt(s))
+        self._loop_open_trys.pop()
+        body.append("}")
+        return "\n".join(lines + self._with_loop_arena(body, st.body, set(names)))
     
+    def _generate_file_lines_loop(self, st: ForStmt) -> str:
+        """
+        `for line in f`: each line is handed out in place from the file's
+        line buffer and is overwritten by the next one, so it is copied into
+        the arena only when the body might keep it past its iteration.
+        """
+        self._tmp_counter += 1
+        file_var = f"__file_{self._tmp_counter}"
+        var = st.var_name
+        lines = [
+            f"PbFile *{file_var} = {self._expr(st.iterable)};",
+            f"for (const char *{var}; ({var} = pb_file_next_line({file_var})) != NULL;) {{",
+        ]
+        if not self._arena_scope_is_safe(st.body, {var}):
+            lines.append(self.INDENT + f"{var} = pb_arena_strdup(pb_current_arena, {var});")
+        self._loop_open_trys.append(self._open_trys)
+        for s in st.body:
+            lines.append(self.INDENT + self._stmt(s))
+        self._loop_open_trys.pop()
+        lines.append("}")
+        return "\n".join(lines[:1] + self._with_loop_arena(lines[1:], st.body, {var}))
+
+    def _range_safe_lists(self, st: ForStmt) -> list[str]:
+        """
+        Lists that the range loop `st` provably indexes in bounds with its
+        loop variable: the loop is `for i in range(len(xs))` (or starts at a
+        literal >= 0), and the body never rebinds `i` or `xs` nor changes
+        the length of `xs`: no method calls on it and, when `xs` is a
+        module global, no calls into user code. Lists are passed by value,
+        so callees cannot resize a local one.
+        """
+        args = st.iterable.args
+        if len(args) == 2 and not (isinstance(args[0], Literal) and args[0].raw.isdigit()):
+            return []
+        stop = args[-1]
+        if not (isinstance(stop, CallExpr) and isinstance(stop.func, Identifier) and stop.func.name == "len"
+                and len(stop.args) == 1 and isinstance(stop.args[0], Identifier)):
+            return []
+        xs = stop.args[0].name
+        if not (self._get_expr_type(stop.args[0]) or "").startswith("list["):
+            return []
+
+        if self._assigns_name(st.body, st.var_name) or self._assigns_name(st.body, xs):
+            return []
+        is_global = xs in self._global_var_names
+        for node in _iter_exprs(st.body):
+            if isinstance(node, CallExpr):
+                f = node.func
+                if isinstance(f, AttributeExpr) and isinstance(f.obj, Identifier) and f.obj.name == xs:
+                    return []
+                if is_global and not (isinstance(f, Identifier) and f.name in LIST_LEN_SAFE_BUILTINS):
+                    return []
+        return [xs]
+
+    def _range_append_hints(self, st: ForStmt) -> list[tuple[str, str, int]]:
+        """
+        Lists a `for i in range(...)` body appends to on every iteration, as
+        ``(name, list type, appends per iteration)``. Only top-level
+        ``xs.append(...)`` statements count, on a list that lives outside the
+        loop, and only for bounds that are plain names or literals (they are
+        read twice) in a body with no break or return, so reserving
+        ``len + count * trips`` never overshoots a loop that runs to the end.
+        """
+        def pure(arg: Expr) -> bool:
+            return isinstance(arg, (Literal, Identifier))
+
+        if not all(pure(a) for a in st.iterable.args):
+            return []
+        for node in _iter_exprs(st.body):
+            if isinstance(node, (BreakStmt, ReturnStmt)):
+                return []
+
+        counts: dict[str, int] = {}
+        types: dict[str, str] = {}
+        for s in st.body:
+            call = s.expr if isinstance(s, ExprStmt) else None
+            if not (isinstance(call, CallExpr) and isinstance(call.func, AttributeExpr)):
+                continue
+            obj = call.func.obj
+            obj_type = self._get_expr_type(obj) or ""
+            if call.func.attr != "append" or not isinstance(obj, Identifier) or not obj_type.startswith("list["):
+                continue
+            if self._assigns_name(st.body, obj.name):
+                continue
+            counts[obj.name] = counts.get(obj.name, 0) + 1
+            types[obj.name] = obj_type
+        return [(name, types[name], n) for name, n in counts.items()]
+
+    @staticmethod
+    def _assigns_name(body: list, name: str) -> bool:
+        """True if any statement nested in `body` (re)binds `name`."""
+        for node in _iter_exprs(body):
+            if isinstance(node, (AssignStmt, AugAssignStmt)):
+                if isinstance(node.target, Identifier) and node.target.name == name:
+                    return True
+            elif isinstance(node, VarDecl) and node.name == name:
+                return True
+            elif isinstance(node, ForStmt) and name in [node.var_name] + node.extra_vars:
+                return True
+        return False
+
+    def _index_is_unchecked(self, base: Expr, index: Expr) -> bool:
+        """True if `base[index]` on a list may skip the bounds check."""
+        if self._unchecked:
+            return True
+        return (isinstance(base, Identifier) and isinstance(index, Identifier)
+                and (base.name, index.name) in self._safe_indices)
+
     def _generate_BreakStmt(self, st: BreakStmt) -> str:
-        return "break;"
+        return self._loop_exit("break;")
 
     def _generate_ContinueStmt(self, st: ContinueStmt) -> str:
-        return "continue;"
+        return self._loop_exit("continue;")
+
+    def _loop_exit(self, jump: str) -> str:
+        """A break/continue first pops the setjmp tries it jumps out of."""
+        inside = self._open_trys - self._loop_open_trys[-1] if self._loop_open_trys else 0
+        pops = self._try_pops(inside)
+        return f"{{ {pops} {jump} }}" if pops else jump
+
+    @staticmethod
+    def _try_pops(count: int) -> str:
+        return " ".join(["pb_pop_try();"] * count)
 
     def _generate_AssertStmt(self, st: AssertStmt) -> str:
         cond = self._expr(st.condition)
         return f"if(!({cond})) pb_fail(\"Assertion failed\");"
 
     def _generate_RaiseStmt(self, st: RaiseStmt) -> str:
-        if st.exception is None:
-            return "pb_reraise();"
-
-        exc = st.exception
+        # under a checked handler the raise returns with pb_exc_pending set
+        checked = self._exc_target is not None
+        code = "pb_reraise();" if st.exception is None else self._raise_call(st.exception, checked)
+        if checked:
+            return f"{code}\n{self._exc_propagate()}"
+        return code
+
+    def _raise_call(self, exc: Expr, checked: bool) -> str:
+        raise_msg = "pb_throw_msg" if checked else "pb_raise_msg"
         if isinstance(exc, CallExpr) and isinstance(exc.func, Identifier):
             name = exc.func.name
 
-            # Exception *instance* → pb_raise_obj
+            # Exception *instance* → pb_raise_obj; the handler may be in a
+            # caller, so the object goes in the arena rather than this frame
             if name in self._structs_emitted:
-                val = self._expr(exc)
+                self._tmp_counter += 1
+                obj = f"__exc_obj_{self._tmp_counter}"
+                args = ", ".join([obj] + self._ctor_args(name, exc))
                 etype = exc.inferred_type or name
-                return f'pb_raise_obj("{etype}", {val});'
+                return (
+                    f"struct {name} *{obj} = pb_arena_alloc(pb_current_arena, sizeof *{obj});\n"
+                    f"{name}____init__({args});\n"
+                    f'pb_raise_obj("{etype}", {obj});'
+                )
 
             # `raise ValueError("msg")`-style → pb_raise_msg
             elif len(exc.args) == 1:
                 msg = self._expr(exc.args[0])
-                return f'pb_raise_msg("{name}", {msg});'
+                return f'{raise_msg}("{name}", {msg});'
 
         val = self._expr(exc)
         etype = exc.inferred_type or "Exception"
         if etype == "str":
-            return f'pb_raise_msg("{etype}", {val});'
+            return f'{raise_msg}("{etype}", {val});'
         return f'pb_raise_obj("{etype}", {val});'
 
+    def _generate_DelStmt(self, st: DelStmt) -> str:
+        target = st.target
+        base = self._addr_of(target.base)
+        key = self._expr(target.index)
+        return f"if (!pb_dict_del_str_{target.elem_type}({base}, {key})) pb_raise_msg(\"KeyError\", {key});"
+
     def _generate_GlobalStmt(self, st: GlobalStmt) -> str:
         names = ", ".join(st.names)
         return f"/* global {names} */"
 
     def _generate_TryExceptStmt(self, st: TryExceptStmt) -> str:
+        if self._exc_try_is_checked(st):
+            return self._generate_checked_try(st)
+
         self._tmp_counter += 1
         ctx = f"__exc_ctx_{self._tmp_counter}"
         flag = f"__exc_flag_{self._tmp_counter}"
         handled = f"__exc_handled_{self._tmp_counter}"
+        # a re-raise reaches the enclosing checked handler, if any, by return
+        reraise = "pb_reraise();"
+        if self._exc_target is not None:
+            reraise = f"{{ pb_reraise(); {self._exc_propagate()} }}"
 
         lines = [
             f"PbTryContext {ctx};",
@@ -885,40 +2199,100 @@ class CodeGen:
             f"bool {handled} = false;",
             f"if ({flag} == 0) {{",
         ]
+        outer = self._exc_target
+        self._exc_target = None   # everything in here unwinds by longjmp
+        self._open_trys += 1
         for s in st.try_body:
             lines.append(self.INDENT + self._stmt(s))
+        self._open_trys -= 1
+        self._exc_target = outer
         lines.append(f"pb_pop_try();")
         lines.append("} else {")
 
-        first = True
-        for block in st.except_blocks:
+        lines += self._except_clauses(st, handled)
+        if st.except_blocks:
+            lines.append(self.INDENT + "else {")
+            lines.append(self.INDENT*2 + reraise)
+            lines.append(self.INDENT + "}")
+        else:
+            lines.append(self.INDENT + reraise)
+        lines.append("}")
+
+        if st.finally_body:
+            for s in st.finally_body:
+                lines.append(self._stmt(s))
+
+        lines.append(f"if ({flag} && !{handled}) {reraise}")
+        return "\n".join(lines)
+
+    def _except_clauses(self, st: TryExceptStmt, handled: Optional[str]) -> list[str]:
+        """`if`/`else if` chain running the except block that matches the current exception."""
+        lines = []
+        for i, block in enumerate(st.except_blocks):
             cond = "1"
             if block.exc_type:
-                cond = f'strcmp(pb_current_exc.type, \"{block.exc_type}\") == 0'
-            prefix = "if" if first else "else if"
+                cond = f"pb_current_exc.id == {self._exc_type_id(block.exc_type)}"
+            prefix = "if" if i == 0 else "else if"
             lines.append(self.INDENT + f"{prefix} ({cond}) {{")
             if block.alias:
                 cty = block.exc_type or "Exception"
                 lines.append(self.INDENT*2 + f"struct {cty} * {block.alias} = (struct {cty} *)pb_current_exc.value;")
             for s in block.body:
-                lines.append(self.INDENT*2 + self._stmt(s))
+                lines.append(self._indented(self._stmt(s), 2))
             lines.append(self.INDENT*2 + "pb_clear_exc();")
-            lines.append(self.INDENT*2 + f"{handled} = true;")
-            lines.append(self.INDENT + "}")
-            first = False
-        if st.except_blocks:
-            lines.append(self.INDENT + "else {")
-            lines.append(self.INDENT*2 + "pb_reraise();")
+            if handled:
+                lines.append(self.INDENT*2 + f"{handled} = true;")
             lines.append(self.INDENT + "}")
-        else:
-            lines.append(self.INDENT + "pb_reraise();")
-        lines.append("}")
+        return lines
 
-        if st.finally_body:
-            for s in st.finally_body:
-                lines.append(self._stmt(s))
+    def _indented(self, code: str, levels: int) -> str:
+        return "\n".join(self.INDENT * levels + line for line in code.splitlines())
 
-        lines.append(f"if ({flag} && !{handled}) pb_reraise();")
+    def _generate_checked_try(self, st: TryExceptStmt) -> str:
+        """
+        Lower ``st`` without setjmp: every raise in its body is followed by a
+        check of `pb_exc_pending` that jumps to the handlers, so entering the
+        block only bumps `pb_checked_depth`, which tells `pb_raise_obj` and
+        friends to return instead of longjmp-ing.
+        """
+        self._tmp_counter += 1
+        label = f"__exc_catch_{self._tmp_counter}"
+        unhandled = f"__exc_unhandled_{self._tmp_counter}"
+
+        outer, outer_used = self._exc_target, self._exc_target_used
+        self._exc_target, self._exc_target_used = label, False
+        body = [self._indented(self._stmt(s), 1) for s in st.try_body]
+        raises = self._exc_target_used
+        self._exc_target, self._exc_target_used = outer, outer_used
+        finally_lines = [self._stmt(s) for s in st.finally_body or []]
+        if not raises:
+            # nothing in the body can raise: the handlers are dead code
+            return "\n".join(["{", *body, "}", *finally_lines])
+
+        reraise = "pb_reraise();"
+        if self._exc_target is not None:
+            reraise = f"{{ pb_reraise(); {self._exc_propagate()} }}"
+        catch_all = any(b.exc_type is None for b in st.except_blocks)
+        lines = []
+        if finally_lines and not catch_all:
+            lines.append(f"bool {unhandled} = false;")
+        lines += ["++pb_checked_depth;", *(["PB_PROF_CHECKED_TRY();"] if self._instrument else []),
+                  "{", *body, "}", f"{label}:", "--pb_checked_depth;",
+                  "if (PB_UNLIKELY(pb_exc_pending)) {", self.INDENT + "pb_exc_pending = false;"]
+        lines += self._except_clauses(st, None)
+        if not catch_all:
+            if finally_lines:
+                rest = f"{unhandled} = true;"
+            else:
+                rest = reraise
+            if st.except_blocks:
+                lines += [self.INDENT + "else {", self.INDENT*2 + rest, self.INDENT + "}"]
+            else:
+                lines.append(self.INDENT + rest)
+        lines.append("}")
+        lines += finally_lines
+        if finally_lines and not catch_all:
+            lines.append(f"if ({unhandled}) {reraise}")
         return "\n".join(lines)
 
     def _generate_VarDecl(self, st: VarDecl) -> str:
@@ -927,6 +2301,8 @@ class CodeGen:
             return f"{c_ty} {st.name};"
     
         val = self._expr(st.value)
+        if self._exc_checked_call(st.value):
+            return f"{c_ty} {st.name} = {val};\n{self._exc_check()}"
         return f"{c_ty} {st.name} = {val};"
 
     def _expr(self, e: Expr) -> str:
@@ -941,6 +2317,7 @@ class CodeGen:
         if isinstance(e, CallExpr): return self._generate_CallExpr(e)
         if isinstance(e, AttributeExpr): return self._generate_AttributeExpr(e)
         if isinstance(e, IndexExpr): return self._generate_IndexExpr(e)
+        if isinstance(e, SliceExpr): return self._generate_SliceExpr(e)
         if isinstance(e, ListExpr): return self._generate_ListExpr(e)
         if isinstance(e, SetExpr): return self._generate_SetExpr(e)
         if isinstance(e, DictExpr): return self._generate_DictExpr(e)
@@ -955,6 +2332,8 @@ class CodeGen:
         raw = e.raw
         if raw and raw[0].isdigit():
             raw = raw.replace("_", "")
+        if raw.startswith("-"):
+            return f"({raw})"   # a folded negative constant
         return raw
 
     def _c_escape(self, text: str) -> str:
@@ -966,49 +2345,78 @@ class CodeGen:
         )
 
     def _generate_StringLiteral(self, e: StringLiteral) -> str:
-        return f'"{self._c_escape(e.value)}"'
+        lit = f'"{self._c_escape(e.value)}"'
+        self._string_literals[lit] = None
+        return lit
 
-    def _generate_FStringLiteral(self, e: FStringLiteral) -> str:
+    # Upper bound on the formatted width of each placeholder type
+    _FSTRING_WIDTH = {"int": 20, "bool": 5, "float": 24, "str": 32}
+
+    def _fstring_format(self, e: FStringLiteral) -> tuple[str, list[str], str]:
         """
-        Generate C code for an f-string using snprintf and a shared buffer.
-        It builds a format string and argument list based on inferred types.
+        Lower an f-string to a printf format (as C source, possibly spliced
+        with PRId64), its argument list and a C expression estimating the
+        formatted length. Plain `str` names contribute their exact strlen.
         """
-        buf = "__fbuf"
-        fmt_parts = []
-        args = []
+        pieces: list[str] = []
+        cur: list[str] = []
+        args: list[str] = []
+        static_len = 0
+        dynamic: list[str] = []
 
-        specs = {
-            "int": "%lld",
-            "str": "%s",
-            "bool": "%s"
-        }
+        def flush() -> None:
+            if cur:
+                pieces.append('"' + "".join(cur) + '"')
+                cur.clear()
 
         for part in e.parts:
             if isinstance(part, FStringText):
-                escaped = self._c_escape(part.text).replace("%", "%%")
-                fmt_parts.append(escaped)
+                cur.append(self._c_escape(part.text).replace("%", "%%"))
+                static_len += len(part.text.encode("utf-8"))
             elif isinstance(part, FStringExpr):
                 inner = self._expr(part.expr)
                 ty = self._get_expr_type(part.expr)
 
-                if ty == "bool":
-                    fmt_parts.append(specs["bool"])
+                if ty == "int":
+                    cur.append("%")
+                    flush()
+                    pieces.append("PRId64")
+                    args.append(inner)
+                elif ty == "bool":
+                    cur.append("%s")
                     args.append(f"(({inner}) ? \"True\" : \"False\")")
                 elif ty == "float":
-                    fmt_parts.append("%s")
+                    cur.append("%s")
                     args.append(f"pb_format_double({inner})")
-                elif ty in specs:
-                    fmt_parts.append(specs[ty])
+                elif ty == "str":
+                    cur.append("%s")
                     args.append(inner)
+                    if isinstance(part.expr, (Identifier, AttributeExpr, StringLiteral)):
+                        dynamic.append(f"strlen({inner})")
+                        continue
                 else:
-                    fmt_parts.append("<?>")
-                    args.append("/* unsupported */")
+                    cur.append("<?>")
+                    continue
+                static_len += self._FSTRING_WIDTH[ty]
+        flush()
 
-        fmt = "".join(fmt_parts)
-        fmt_str = f'"{fmt}"'
-        arg_str = ", ".join(args) or "0"
+        fmt = " ".join(pieces) or '""'
+        hint = " + ".join(([str(static_len)] if static_len or not dynamic else []) + dynamic)
+        return fmt, args, hint
 
-        return f'(snprintf({buf}, 256, {fmt_str}, {arg_str}), {buf})'
+    def _generate_FStringLiteral(self, e: FStringLiteral) -> str:
+        """
+        Generate C code for an f-string: one exact-size allocation from the
+        runtime arena, sized by a compile-time estimate (see pb_fstring).
+        """
+        fmt, args, hint = self._fstring_format(e)
+        if not args:
+            # nothing to format: the f-string is just a literal
+            text = "".join(
+                self._c_escape(p.text) if isinstance(p, FStringText) else "<?>" for p in e.parts
+            )
+            return f'"{text}"'
+        return f"pb_fstring({hint}, {fmt}, {', '.join(args)})"
 
     def _generate_Identifier(self, e: Identifier) -> str:
         return e.name
@@ -1029,9 +2437,34 @@ class CodeGen:
             return f"({left} == {right})"
         if op == "is not":
             return f"({left} != {right})"
+        if op in ("in", "not in"):
+            return self._generate_membership(e)
+        if op in ("==", "!=", "<", "<=", ">", ">=") and "str" in (self._get_expr_type(e.left),
+                                                                 self._get_expr_type(e.right)):
+            # by value, as in Python; pb_str_eq tries the pointers first
+            if op == "==":
+                return f"pb_str_eq({left}, {right})"
+            if op == "!=":
+                return f"!pb_str_eq({left}, {right})"
+            return f"(strcmp({left}, {right}) {op} 0)"
         # default
         return f"({left} {op} {right})"
 
+    def _generate_membership(self, e: BinOp) -> str:
+        """Lower `x in c` / `x not in c` to the container's hashed lookup."""
+        needle = self._expr(e.left)
+        container_type = self._get_expr_type(e.right)
+        container = self._addr_of(e.right)
+        if container_type.startswith("set["):
+            test = f"set_{container_type[4:-1]}_contains({container}, {needle})"
+        elif container_type.startswith("list["):
+            # a linear scan; vectorized for list[int] and list[float]
+            test = f"{self._list_fn(container_type)}_contains({container}, {needle})"
+        else:
+            val_type = container_type[len("dict[str,"):-1].strip()
+            test = f"pb_dict_contains_str_{val_type}({container}, {needle})"
+        return f"!{test}" if e.op == "not in" else test
+
     def _generate_UnaryOp(self, e: UnaryOp) -> str:
         operand = self._expr(e.operand)
         if e.op == "not":
@@ -1065,35 +2498,32 @@ class CodeGen:
                     args = ", ".join(passed_args)
                     return f"{mangled}({args})"
 
-            obj_type = self._get_expr_type(obj)
+            obj_type = self._value_type(obj)
             if obj_type and obj_type.startswith("list[") and obj_type.endswith("]"):
-                elem = obj_type[5:-1]
-                if attr == "append":
-                    func = {
-                        'int': 'list_int_append',
-                        'float': 'list_float_append',
-                        'bool': 'list_bool_append',
-                        'str': 'list_str_append',
-                    }[elem]
+                fn = self._list_fn(obj_type)
+                if attr in ("append", "remove", "reserve", "remove_all", "swap_remove"):
+                    arg = self._expr(e.args[0])
+                    return f"{fn}_{attr}({self._addr_of(obj, obj_expr)}, {arg})"
+                if attr in ("pop", "sort"):
+                    return f"{fn}_{attr}({self._addr_of(obj, obj_expr)})"
+                if attr in ("index", "count"):
                     arg = self._expr(e.args[0])
-                    return f"{func}(&{obj_expr}, {arg})"
-                if attr == "pop":
-                    func = {
-                        'int': 'list_int_pop',
-                        'float': 'list_float_pop',
-                        'bool': 'list_bool_pop',
-                        'str': 'list_str_pop',
-                    }[elem]
-                    return f"{func}(&{obj_expr})"
-                if attr == "remove":
-                    func = {
-                        'int': 'list_int_remove',
-                        'float': 'list_float_remove',
-                        'bool': 'list_bool_remove',
-                        'str': 'list_str_remove',
-                    }[elem]
+                    return f"{fn}_{attr}({self._addr_of(obj, obj_expr)}, {arg})"
+                if attr == "insert":
+                    index = self._expr(e.args[0])
+                    arg = self._expr(e.args[1])
+                    return f"{fn}_insert({self._addr_of(obj, obj_expr)}, {index}, {arg})"
+                if attr == "extend":
+                    other = self._addr_of(e.args[0])
+                    return f"{fn}_extend({self._addr_of(obj, obj_expr)}, {other})"
+            if obj_type and obj_type.startswith("set[") and obj_type.endswith("]"):
+                elem = obj_type[4:-1]
+                if attr in ("add", "discard"):
                     arg = self._expr(e.args[0])
-                    return f"{func}(&{obj_expr}, {arg})"
+                    return f"set_{elem}_{attr}(&{obj_expr}, {arg})"
+                if attr in ("union", "intersection", "difference"):
+                    other = self._addr_of(e.args[0])
+                    return f"set_{elem}_{attr}({self._addr_of(obj)}, {other})"
 
             # Special case: Class.__init__ → Class____init__
             if attr == "__init__" and isinstance(obj, Identifier):
@@ -1126,18 +2556,16 @@ class CodeGen:
                 var = f"__tmp_{class_name.lower()}_{self._tmp_counter}"
                 init_func = f"{class_name}____init__"
 
-                actual_args = [self._expr(arg) for arg in e.args]
-                expected = self._function_params.get(init_func, [])
-                # pad using the actual defaults from the .pb AST
-                defaults = self._function_defaults.get(init_func, [])
-                # skip the 'self' slot at index 0
-                for i in range(len(actual_args) + 1, len(defaults)):
-                    if defaults[i] is None:
-                        raise RuntimeError(f"Missing default for parameter {i+1} of {init_func}")
-                    actual_args.append(defaults[i])
-
-                args = ", ".join(actual_args)
-                self._emit(f"struct {class_name} {var};")
+                if id(e) in self._escaping_ctors:
+                    args = ", ".join([var] + self._ctor_args(class_name, e))
+                    self._emit(f"struct {class_name} *{var} = pb_obj_alloc(sizeof(struct {class_name}));")
+                    self._emit(f"{init_func}({args});")
+                    return var
+                args = ", ".join(self._ctor_args(class_name, e))
+                if self._stmt_depth:
+                    self._object_temps.append(f"struct {class_name} {var};")
+                else:
+                    self._emit(f"struct {class_name} {var};")
                 if args:
                     self._emit(f"{init_func}(&{var}, {args});")
                 else:
@@ -1146,24 +2574,7 @@ class CodeGen:
 
             # Normal function call — also handle defaults
             fn_name = e.func.name
-            mangled = self._mangle_function_name(fn_name)
-
-            # Try to detect imported functions
-            imported_from = None
-            for stmt in getattr(self._program, "body", []):
-                if isinstance(stmt, ImportFromStmt):
-                    mod_prefix = "_".join(stmt.module)
-                    for alias_obj in stmt.names or []:
-                        alias_name = alias_obj.asname or alias_obj.name
-                        if fn_name == alias_name:
-                            imported_from = mod_prefix
-                            break
-            if imported_from:
-                mod_name = imported_from.replace("_", ".")
-                if self._native_modules.get(mod_name, False) or self._native_functions.get(fn_name, False):
-                    mangled = fn_name
-                else:
-                    mangled = f"{imported_from}_{fn_name}"
+            mangled, imported_from = self._function_symbol(fn_name)
 
             if mangled in self._function_params:
                 passed_args = [self._expr(arg) for arg in e.args]
@@ -1174,20 +2585,43 @@ class CodeGen:
                 args = ", ".join(self._expr(arg) for arg in e.args)
                 return f"{mangled}({args})"
 
+            if fn_name == "parallel_for":
+                bounds = [self._expr(a) for a in e.args[0].args]
+                start, stop = bounds if len(bounds) == 2 else ["0", bounds[0]]
+                return f"pb_parallel_for({start}, {stop}, {self._range_trampoline(e.args[1].name)})"
+            if fn_name == "spawn":
+                target, _ = self._function_symbol(e.args[0].name)
+                return f"pb_spawn({target}, {self._expr(e.args[1])})"
+            if fn_name == "atomic":
+                return f"pb_atomic_new({self._expr(e.args[0])})"
+
             if fn_name == "open":
                 arg0 = self._expr(e.args[0])
                 arg1 = self._expr(e.args[1])
-                return f"pb_open({arg0}, {arg1})"
+                buffering = self._expr(e.args[2]) if len(e.args) > 2 else "-1"
+                return f"pb_open({arg0}, {arg1}, {buffering})"
+
+            if fn_name == "set":
+                elem = e.inferred_type[4:-1]
+                return f"set_{elem}_from_list({self._addr_of(e.args[0])})"
 
             if fn_name == "len":
                 arg = self._expr(e.args[0])
-                arg_type = e.args[0].inferred_type
+                arg_type = self._value_type(e.args[0])
                 if arg_type == "str":
                     return f"(int64_t)strlen({arg})"
                 if arg_type.startswith("list[") or arg_type.startswith("set[") or arg_type.startswith("dict["):
                     return f"{arg}.len"
                 raise RuntimeError(f"len() not supported for {arg_type}")
 
+            if fn_name == "sorted":
+                return f"{self._list_fn(e.inferred_type)}_sorted({self._addr_of(e.args[0])})"
+
+            if fn_name in NUMERIC_LIST_BUILTINS:
+                list_fn = self._list_fn(self._get_expr_type(e.args[0]))
+                args = ", ".join(self._addr_of(arg) for arg in e.args)
+                return f"{list_fn}_{fn_name}({args})"
+
             # --- Built-int type conversions ---
             if fn_name == "int":
                 if e.args[0].inferred_type == "float":
@@ -1224,6 +2658,8 @@ class CodeGen:
                     return f"pb_format_hex({self._expr(e.args[0])})"
                 else:
                     raise RuntimeError(f"`{fn_name}` conversion to `{e.args[0].inferred_type}` not supported yet!")
+            if fn_name == "intern":
+                return f"pb_intern({self._expr(e.args[0])})"
 
         # Method call: player.get_name() → Player__get_name(player)
         if isinstance(e.func, AttributeExpr):
@@ -1232,13 +2668,25 @@ class CodeGen:
 
             obj_type = self._get_expr_type(e.func.obj)
             if obj_type == "file":
-                if method_name == "read":
-                    return f"pb_file_read({obj_expr})"
+                if method_name in ("read", "mmap"):
+                    return f"pb_file_{method_name}({obj_expr})"
                 if method_name == "write":
+                    if e.args and isinstance(e.args[0], StringLiteral) and "\0" not in e.args[0].value:
+                        # literal length is known here; skip the strlen
+                        lit = self._expr(e.args[0])
+                        size = len(e.args[0].value.encode("utf-8"))
+                        return f"pb_file_write_bytes({obj_expr}, {lit}, {size})"
                     arg = self._expr(e.args[0]) if e.args else "\"\""
                     return f"pb_file_write({obj_expr}, {arg})"
-                if method_name == "close":
-                    return f"pb_file_close({obj_expr})"
+                if method_name == "writelines":
+                    return f"pb_file_writelines({obj_expr}, {self._addr_of(e.args[0])})"
+                if method_name in ("flush", "close"):
+                    return f"pb_file_{method_name}({obj_expr})"
+            if obj_type == "future" and method_name == "join":
+                return f"pb_future_join({obj_expr})"
+            if obj_type == "atomic":
+                args = "".join(f", {self._expr(a)}" for a in e.args)
+                return f"pb_atomic_{method_name}({obj_expr}{args})"
 
             class_type = self._get_expr_type(e.func.obj)
             if class_type:
@@ -1256,12 +2704,66 @@ class CodeGen:
         args = ", ".join(self._expr(a) for a in e.args)
         return f"{fn}({args})"
 
+    def _function_symbol(self, fn_name: str) -> tuple[str, str | None]:
+        """C name of the function `fn_name` names here, and its module prefix if imported."""
+        mangled = self._mangle_function_name(fn_name)
+        imported_from = getattr(self, "_imported_from", {}).get(fn_name)
+        if imported_from:
+            mod_name = imported_from.replace("_", ".")
+            if self._native_modules.get(mod_name, False) or self._native_functions.get(fn_name, False):
+                mangled = fn_name
+            else:
+                mangled = f"{imported_from}_{fn_name}"
+        return mangled, imported_from
+
+    def _range_trampoline(self, fn_name: str) -> str:
+        """
+        `parallel_for` hands the pool a chunk function: a plain range loop
+        calling `fn_name`, so the per-index call is direct and inlinable.
+        """
+        target, _ = self._function_symbol(fn_name)
+        name = f"__range_{target}"
+        if name not in self._range_trampolines:
+            self._range_trampolines[name] = [
+                f"static void {name}(int64_t __lo, int64_t __hi)",
+                "{",
+                f"{self.INDENT}for (int64_t __i = __lo; __i < __hi; ++__i) {target}(__i);",
+                "}",
+                "",
+            ]
+        return name
+
+    def _ctor_args(self, class_name: str, e: CallExpr) -> list[str]:
+        """Arguments for `Class____init__` after `self`, padded with defaults."""
+        init_func = f"{class_name}____init__"
+        actual_args = [self._expr(arg) for arg in e.args]
+        # pad using the actual defaults from the .pb AST
+        defaults = self._function_defaults.get(init_func, [])
+        # skip the 'self' slot at index 0
+        for i in range(len(actual_args) + 1, len(defaults)):
+            if defaults[i] is None:
+                raise RuntimeError(f"Missing default for parameter {i+1} of {init_func}")
+            actual_args.append(defaults[i])
+        return actual_args
+
     def _generate_AttributeExpr(self, e: AttributeExpr) -> str:
         if isinstance(e.obj, Identifier) and e.obj.name in self._class_map:
             origin = self._find_class_attr_origin(e.obj.name, e.attr)
             if origin:
                 return f"{origin}_{e.attr}"
 
+        if isinstance(e.obj, IndexExpr) and self._value_type(e.obj) in self._soa_classes:
+            cls = self._value_type(e.obj)
+            if e.attr not in self._direct_fields.get(cls, set()):
+                return f"{self._find_class_attr_origin(cls, e.attr)}_{e.attr}"
+            # xs[i].f on an @soa list is slot i of the f array
+            base, index = e.obj.base, e.obj.index
+            xs = self._expr(base)
+            idx = self._expr(index)
+            if not self._index_is_unchecked(base, index):
+                idx = f"{self._list_fn(self._get_expr_type(e.obj))}_index({self._addr_of(base, xs)}, {idx})"
+            return f"{xs}.{e.attr}[{idx}]"
+
         obj = self._expr(e.obj)
         attr = e.attr
 
@@ -1269,11 +2771,11 @@ class CodeGen:
         if obj_full and obj_full in self._modules:
             return attr
 
-        if isinstance(e.obj, Identifier):
-            if e.obj.name in self._modules:
+        if isinstance(e.obj, (Identifier, IndexExpr)):
+            if isinstance(e.obj, Identifier) and e.obj.name in self._modules:
                 return attr
 
-            cls = self._get_expr_type(e.obj)
+            cls = self._value_type(e.obj)
             if cls:
                 depth = 0
                 c = cls
@@ -1299,20 +2801,21 @@ class CodeGen:
         idx  = self._expr(e.index)
 
         t = self._get_expr_type(e)
+        if t and t.startswith("dict[") and t.endswith("]"):
+            return f"pb_dict_get_str_{e.elem_type}({self._addr_of(e.base)}, {idx})"
         if t and t.startswith("list[") and t.endswith("]"):
-            etype = e.elem_type or t[5:-1]
-            func = {
-                'int': 'list_int_get',
-                'float': 'list_float_get',
-                'bool': 'list_bool_get',
-                'str': 'list_str_get',
-            }.get(etype)
-            if func:
-                return f"{func}(&{base}, {idx})"
-            return f"{base}.data[{idx}]"
+            if self._index_is_unchecked(e.base, e.index):
+                return f"{base}.data[{idx}]"
+            return f"{self._list_fn(t)}_get({self._addr_of(e.base, base)}, {idx})"
 
         return f"{base}.data[{idx}]"
     
+    def _generate_SliceExpr(self, e: SliceExpr) -> str:
+        """`xs[a:b]` copies into a new list; an omitted stop runs to the end."""
+        start = self._expr(e.start) if e.start is not None else "0"
+        stop = self._expr(e.stop) if e.stop is not None else "INT64_MAX"
+        return f"{self._list_fn(e.inferred_type)}_slice({self._addr_of(e.base)}, {start}, {stop})"
+
     def _generate_ListExpr(self, e: ListExpr) -> str:
         self._tmp_list_counter += 1
         buf_name = f"__tmp_list_{self._tmp_list_counter}"
@@ -1322,80 +2825,71 @@ class CodeGen:
 
         if not e.elements:
             self._emit(f"{list_c_type} {buf_name};")
-            self._emit(f"list_{e.elem_type}_init(&{buf_name});")
+            self._emit(f"{self._list_fn(e.inferred_type)}_init(&{buf_name});")
             return buf_name
-        else:
-            elems = ", ".join(self._expr(x) for x in e.elements)
-            self._emit(f"{elem_c_type} {buf_name}[] = {{{elems}}};")
-            return f"({list_c_type}){{ .len={len(e.elements)}, .data={buf_name} }}"
+        # Elements are copied into the arena, so the literal may outlive
+        # this frame; the first append moves it to owned storage
+        elems = ", ".join(self._expr(x) for x in e.elements)
+        return f"{self._list_fn(e.inferred_type)}_from_array(({elem_c_type}[]){{{elems}}}, {len(e.elements)})"
 
     def _generate_SetExpr(self, e: SetExpr) -> str:
-        self._tmp_set_counter += 1
-        buf_name = f"__tmp_set_{self._tmp_set_counter}"
-
         elem_c_type = self._c_type(e.elem_type)
         set_c_type = self._c_type(e.inferred_type)
 
         if not e.elements:
-            self._emit(f"{elem_c_type} {buf_name}[1] = {{0}};")
-            return f"({set_c_type}){{ .len=0, .data={buf_name} }}"
-        else:
-            unique_codes = []
-            seen = set()
-            for el in e.elements:
-                code = self._expr(el)
-                if code not in seen:
-                    seen.add(code)
-                    unique_codes.append(code)
-
-            elems = ", ".join(unique_codes)
-            self._emit(f"{elem_c_type} {buf_name}[] = {{{elems}}};")
-            return f"({set_c_type}){{ .len={len(unique_codes)}, .data={buf_name} }}"
+            return f"({set_c_type}){{0}}"
 
-    def _generate_DictExpr(self, e: DictExpr) -> str:
-        self._tmp_dict_counter += 1
-        buf_name = f"__tmp_dict_{self._tmp_dict_counter}"
+        elems = ", ".join(self._expr(x) for x in e.elements)
+        if e.elem_type not in ("int", "float", "bool", "str"):
+            # No hashing for user types: a plain element array, unindexed
+            return f"({set_c_type}){{ .len={len(e.elements)}, .data=({elem_c_type}[]){{{elems}}} }}"
+
+        # Duplicates are dropped at runtime by value, not by source text
+        return f"set_{e.elem_type}_from_array(({elem_c_type}[]){{{elems}}}, {len(e.elements)})"
 
+    def _generate_DictExpr(self, e: DictExpr) -> str:
         dict_c_type = self._c_type(e.inferred_type)
+        if not e.keys:
+            return f"({dict_c_type}){{0}}"
 
+        # One bulk insert sized for every pair, instead of growing per key
+        pair_type = f"Pair_str_{e.elem_type}"
         pairs = ", ".join(
             f'{{{self._expr(k)}, {self._expr(v)}}}' for k, v in zip(e.keys, e.values)
         )
-        if not pairs:
-            self._emit(f"Pair_str_{e.elem_type} {buf_name}[1] = {{0}};")
-            return f"({dict_c_type}){{ .len=0, .data={buf_name} }}" 
-
-        self._emit(f"Pair_str_{e.elem_type} {buf_name}[] = {{{pairs}}};")
-        return f"({dict_c_type}){{ .len={len(e.keys)}, .data={buf_name} }}"
-
-        # Not working with GCC C99
-        # specialized to dict[str,int]
-        # pairs = ", ".join(f'{{"{self._expr(k)}",{self._expr(v)}}}' for k,v in zip(e.keys,e.values))
-        # return f"((Dict_str_int){{ .len={len(e.keys)}, .data=(Pair_str_int[]){{{pairs}}} }})"
-
+        return f"pb_dict_from_pairs_str_{e.elem_type}(({pair_type}[]){{{pairs}}}, {len(e.keys)})"
 
     # --- Helper Methods ---
 
-    def _assigned_fields_in_class(self, cls: ClassDef) -> set[str]:
-        fields: set[str] = set()
-
-        def walk(stmt):
-            if isinstance(stmt, AssignStmt):
-                if isinstance(stmt.target, AttributeExpr):
-                    if isinstance(stmt.target.obj, Identifier) and stmt.target.obj.name == "self":
-                        fields.add(stmt.target.attr)
-            elif hasattr(stmt, "body") and isinstance(stmt.body, list):
-                for s in stmt.body:
-                    walk(s)
-            elif hasattr(stmt, "branches"):
-                for br in stmt.branches:
-                    for s in br.body:
-                        walk(s)
-
-        for m in cls.methods:
-            for st in m.body:
-                walk(st)
-        return fields
+    def _addr_of(self, e: Expr, code: Optional[str] = None) -> str:
+        """
+        Return a C pointer to the value of ``e``; rvalues are spilled into a
+        temporary. `code` is ``e`` already generated, to avoid emitting its
+        temporaries twice. List elements are addressed through the
+        bounds-checked ``list_*_at``.
+        """
+        if isinstance(e, IndexExpr):
+            base_type = self._value_type(e.base)
+            if base_type and base_type.startswith("list["):
+                idx = self._expr(e.index)
+                if self._index_is_unchecked(e.base, e.index):
+                    return f"&{self._expr(e.base)}.data[{idx}]"
+                return f"{self._list_fn(base_type)}_at({self._addr_of(e.base)}, {idx})"
+        if code is None:
+            code = self._expr(e)
+        if isinstance(e, (Identifier, AttributeExpr, IndexExpr)):
+            return f"&{code}"
+        self._tmp_counter += 1
+        tmp = f"__tmp_val_{self._tmp_counter}"
+        self._emit(f"{self._c_type(self._get_expr_type(e))} {tmp} = {code};")
+        return f"&{tmp}"
+
+    def _list_fn(self, list_type: str) -> str:
+        """Prefix of the runtime functions for ``list_type``, e.g. ``list_int``."""
+        c_type = self._c_type(list_type)
+        if c_type.startswith("Soa_"):
+            return "soa_" + c_type[len("Soa_"):]
+        return "list_" + c_type[len("List_"):]
 
     def _emit_class_statics(self, program: Program) -> None:
         """Emit class-level variables like Player_species = ..."""
@@ -1413,30 +2907,53 @@ class CodeGen:
                             self._emit(f'double {stmt.name}_{field.name} = {raw};')
                         else:
                             self._emit(f'int64_t {stmt.name}_{field.name} = {raw};')
-                    elif isinstance(field.value, CallExpr) and isinstance(field.value.func, Identifier) and field.value.func.name in self._class_names:
+                    elif self._is_class_construction(field.value):
                         class_name = field.value.func.name
                         self._tmp_counter += 1
                         tmp = f"__tmp_{class_name.lower()}_{self._tmp_counter}"
                         self._emit(f"struct {class_name} {tmp};")
                         self._emit(f"struct {class_name} * {stmt.name}_{field.name};")
-                        args = [self._expr(a) for a in field.value.args]
-                        call = f"{class_name}____init__(&{tmp}{', ' if args else ''}{', '.join(args)})";
-                        self._global_init_lines.append(f"{call};")
-                        self._global_init_lines.append(f"{stmt.name}_{field.name} = &{tmp};")
+                        self._global_inits.append((f"{stmt.name}_{field.name}", field.value, tmp))
 
     def _emit_global_init_func(self) -> None:
-        if not self._global_init_lines:
+        """
+        The module's lazy initializer, which PB_INIT_MODULE runs once, on
+        first use. It follows the definitions so that calls in it resolve
+        like calls anywhere else.
+        """
+        if not self._global_inits:
             return
-        func_name = f"{self._get_module_name()}__init_globals"
-        self._emit(f"__attribute__((constructor)) static void {func_name}(void)")
+        mod = self._module_c_name()
+        self._emit(f"PbModuleInit {mod}__module;")
+        self._emit()
+        self._emit(f"void {mod}__init_globals(void)")
         self._emit("{")
         self._indent += 1
-        for line in self._global_init_lines:
+        for line in self._init_guards([value for _, value, _ in self._global_inits], include_self=False):
             self._emit(line)
+        for target, value, tmp in self._global_inits:
+            if tmp is None:
+                self._emit(f"{target} = {self._expr(value)};")
+                continue
+            args = [self._expr(a) for a in value.args]
+            self._emit(f"{value.func.name}____init__(&{tmp}{', ' if args else ''}{', '.join(args)});")
+            self._emit(f"{target} = &{tmp};")
         self._indent -= 1
         self._emit("}")
         self._emit()
 
+    def _default_arg(self, fn_name: str, param: Parameter) -> Optional[str]:
+        """
+        C expression call sites pass for an omitted `param`. Defaults are
+        folded before codegen, so anything left that is not a literal
+        cannot be evaluated at the call site.
+        """
+        if param.default is None:
+            return None
+        if not isinstance(param.default, (Literal, StringLiteral)):
+            raise RuntimeError(f"Default for parameter '{param.name}' of '{fn_name}' must be a constant")
+        return self._expr(param.default)
+
     def _apply_defaults(self, mangled_name: str, passed_args: list[str]) -> list[str]:
         """
         Given a mangled function name and a list of already generated argument expressions (as strings),
@@ -1458,15 +2975,36 @@ class CodeGen:
     # ------------------------------------------------------------------
     def generate_types_header(self) -> str:
         """Generate type specialization declarations for pb_gen_types.h."""
+        lines = self._specialization_lines()
+        return "\n".join(lines) + ("\n" if lines else "")
+
+    def _specialization_lines(self) -> list[str]:
+        """
+        Declarations for every container type used beyond the runtime's
+        built-in ones. Each is guarded, so a module's .c and every header
+        that includes it may declare the same type.
+        """
         lines: list[str] = []
-        for name, c_ty in sorted(self._needed_list_types):
-            lines.append(f"PB_DECLARE_LIST({name}, {c_ty})")
+
+        def guarded(kind: str, name: str, body: list[str]) -> None:
+            guard = f"PB_{kind}_{name}_DEFINED"
+            lines.extend([f"#ifndef {guard}", f"#define {guard}", *body, "#endif"])
+
+        for name, c_ty in self._needed_list_types.items():
+            if c_ty == "const char *":
+                eq = "PB_EQ_STR"
+            elif c_ty.endswith("*") or c_ty in ("int64_t", "double", "bool"):
+                eq = "PB_EQ_VALUE"
+            else:
+                eq = "PB_EQ_BYTES"
+            guarded("LIST", name, [f"PB_DECLARE_LIST({name}, {c_ty})", f"PB_DEFINE_LIST({name}, {c_ty}, {eq})"])
         for name, c_ty in sorted(self._needed_set_types):
-            lines.append(f"PB_DECLARE_SET({name}, {c_ty})")
+            guarded("SET", name, [f"PB_DECLARE_SET({name}, {c_ty})"])
         for name, c_ty in sorted(self._needed_dict_types):
-            lines.append(f"PB_DECLARE_DICT({name}, {c_ty})")
-        return "\n".join(lines) + ("\n" if lines else "")
-
+            guarded("DICT", name, [f"PB_DECLARE_DICT({name}, {c_ty})"])
+        if lines:
+            lines.append("")
+        return lines
 
 if __name__ == "__main__":
     import sys
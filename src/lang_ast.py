@@ -24,6 +24,7 @@ class Program:
 
     #  class_name → field_name → pb_type
     inferred_instance_fields: dict[str, dict[str, str]] = field(default_factory=dict)
+    cache_key: str | None = None    # set when compiled through a build cache
 
 # ---------------------------------------------------------------------------
 # Statements
@@ -52,6 +53,7 @@ class ClassDef:
     base: Optional[str]             # single inheritance only
     fields: List["VarDecl"]         # field decls (VarDecl) 
     methods: List["FunctionDef"]    # methods (FunctionDef)
+    decorators: List[str] = field(default_factory=list)  # e.g. ["soa"]
 
 
 @dataclass
@@ -104,6 +106,7 @@ class ForStmt:
     iterable: Expr             # e.g. range(...)
     body: List[Stmt]
     elem_type: Optional[str] = None
+    extra_vars: List[str] = field(default_factory=list)   # `for i, x in ...`: the names after the first
 
 
 @dataclass
@@ -125,6 +128,11 @@ class RaiseStmt:
     exception: Optional[Expr]
 
 
+@dataclass
+class DelStmt:
+    target: Expr                 # IndexExpr on a dict, e.g. del d["k"]
+
+
 @dataclass
 class ReturnStmt:
     value: Optional[Expr]        # None means no expression
@@ -261,6 +269,14 @@ class IndexExpr:
     elem_type: Optional[str] = None     # For value type
 
 
+@dataclass
+class SliceExpr:
+    base: Expr
+    start: Optional[Expr]               # None when omitted: xs[:b]
+    stop: Optional[Expr]                # None when omitted: xs[a:]
+    inferred_type: Optional[str] = None
+
+
 @dataclass
 class ListExpr:
     elements: List[Expr]
@@ -301,6 +317,7 @@ Stmt = Union[
     TryExceptStmt,
     ExceptBlock,
     RaiseStmt,
+    DelStmt,
     ReturnStmt,
     AssertStmt,
     BreakStmt,
@@ -323,6 +340,7 @@ Expr = Union[
     CallExpr,
     AttributeExpr,
     IndexExpr,
+    SliceExpr,
     ListExpr,
     SetExpr,
     DictExpr,
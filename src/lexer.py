@@ -15,13 +15,14 @@ class TokenType(Enum):
     GLOBAL = auto(); IMPORT = auto(); FROM = auto(); CLASS = auto(); ASSERT = auto()
     TRUE = auto(); FALSE = auto(); NONE = auto()
     TRY = auto(); EXCEPT = auto(); FINALLY = auto(); RAISE = auto(); AS = auto()
+    DEL = auto()
 
     # Symbols
     COLON = auto(); COMMA = auto(); LPAREN = auto(); RPAREN = auto()
     LBRACKET = auto(); RBRACKET = auto(); LBRACE = auto(); RBRACE = auto()
     ASSIGN = auto(); PLUS = auto(); MINUS = auto(); STAR = auto(); SLASH = auto()
     PERCENT = auto(); FLOORDIV = auto(); DOT = auto(); SEMICOLON = auto(); PIPE = auto();
-    ELLIPSIS = auto()
+    ELLIPSIS = auto(); AT = auto()
 
     ## augmented assignment
     PLUSEQ = auto(); MINUSEQ = auto(); STAREQ = auto(); SLASHEQ = auto()
@@ -74,6 +75,8 @@ class LexerError(Exception):
 
 # Helper to decode Python-style string literals (supports raw and triple quotes)
 def _decode_string(text: str) -> str:
+    if "\\" not in text and text[0] in "\"'" and text[1:2] != text[0]:
+        return text[1:-1]   # a plain one-line literal with no escapes
     return ast.literal_eval(text)
 
 # ───────────────────────── keywords ──────────────────────────
@@ -103,6 +106,7 @@ KEYWORDS = {
     "finally": TokenType.FINALLY,
     "as": TokenType.AS,
     "raise": TokenType.RAISE,
+    "del": TokenType.DEL,
     "True": TokenType.TRUE,
     "False": TokenType.FALSE,
     "None": TokenType.NONE,
@@ -145,6 +149,7 @@ TOKEN_REGEX = [
     (re.compile(r'>'), TokenType.GT),
     (re.compile(r'\.'), TokenType.DOT),
     (re.compile(r'\|'), TokenType.PIPE),
+    (re.compile(r'@'), TokenType.AT),
     
     # numeric literals (underscore allowed)
     (re.compile(r"0[xX][0-9a-fA-F][0-9a-fA-F_]*"), TokenType.INT_LIT),
@@ -165,6 +170,18 @@ TOKEN_REGEX = [
     (re.compile(r'[A-Za-z_][A-Za-z0-9_]*'), TokenType.IDENTIFIER),
 ]
 
+# The table as one alternation, tried in table order: a match's lastindex
+# picks its token type, so every token costs a single regex call.
+assert all(regex.groups == 0 for regex, _ in TOKEN_REGEX)
+MASTER_REGEX = re.compile("|".join(f"({regex.pattern})" for regex, _ in TOKEN_REGEX))
+MASTER_TYPES = [None] + [ttype for _, ttype in TOKEN_REGEX]
+
+OPENING_BRACKETS = (TokenType.LPAREN, TokenType.LBRACKET, TokenType.LBRACE)
+CLOSING_BRACKETS = (TokenType.RPAREN, TokenType.RBRACKET, TokenType.RBRACE)
+NUMBER_TYPES = (TokenType.INT_LIT, TokenType.FLOAT_LIT)
+# First characters that can begin an f-string or a triple-quoted string
+STRING_PREFIX_CHARS = frozenset("rRfF\"'")
+
 WHITESPACE = re.compile(r'[ \t]*')
 
 def split_comment(line: str) -> tuple[str, str | None, int | None]:
@@ -175,6 +192,8 @@ def split_comment(line: str) -> tuple[str, str | None, int | None]:
     the comment starts. If no comment is present, returns the line and ``None``
     values.
     """
+    if "#" not in line:
+        return line, None, None
     result = []
     in_string = False
     string_char = ''
@@ -246,64 +265,34 @@ class Lexer:
             if ch in " \t":
                 pos += 1; continue
 
-            # multi-line raw string
-            if line.startswith(('r"""', 'R"""', "r'''", "R'''"), pos):
-                quote = line[pos+1]
-                value, remainder, raw_line = self._scan_multiline_string(line, pos, True, quote, line[pos])
-                self.tokens.append(Token(TokenType.STRING_LIT, value, self.line_num, pos + 1))
-                line = remainder.rstrip()
-                raw = raw_line
-                length = len(line)
-                pos = 0
-                continue
-
-            # multi-line normal string
-            if line.startswith('"""', pos) or line.startswith("'''", pos):
-                quote = line[pos]
-                value, remainder, raw_line = self._scan_multiline_string(line, pos, False, quote)
-                self.tokens.append(Token(TokenType.STRING_LIT, value, self.line_num, pos + 1))
-                line = remainder.rstrip()
-                raw = raw_line
-                length = len(line)
-                pos = 0
-                continue
-
-            if (ch in 'fF') and pos + 1 < length and line[pos+1] in ('"', "'"):
-                    pos = self._scan_fstring(line, pos)
+            if ch in STRING_PREFIX_CHARS:
+                # multi-line raw string
+                if line.startswith(('r"""', 'R"""', "r'''", "R'''"), pos):
+                    quote = line[pos+1]
+                    value, remainder, raw_line = self._scan_multiline_string(line, pos, True, quote, line[pos])
+                    self.tokens.append(Token(TokenType.STRING_LIT, value, self.line_num, pos + 1))
+                    line = remainder.rstrip()
+                    raw = raw_line
+                    length = len(line)
+                    pos = 0
                     continue
 
-            for regex, ttype in TOKEN_REGEX:
-                m = regex.match(line, pos)
-                if not m:
+                # multi-line normal string
+                if line.startswith('"""', pos) or line.startswith("'''", pos):
+                    quote = line[pos]
+                    value, remainder, raw_line = self._scan_multiline_string(line, pos, False, quote)
+                    self.tokens.append(Token(TokenType.STRING_LIT, value, self.line_num, pos + 1))
+                    line = remainder.rstrip()
+                    raw = raw_line
+                    length = len(line)
+                    pos = 0
                     continue
 
-                text, value = m.group(0), m.group(0)
-
-                # promote keywords
-                if ttype == TokenType.IDENTIFIER and value in KEYWORDS:
-                    ttype = KEYWORDS[value]
-
-                # numeric literals – strip underscores
-                elif ttype in (TokenType.INT_LIT, TokenType.FLOAT_LIT):
-                    value = value.replace("_", "")
-
-                # plain strings – decode escapes
-                elif ttype == TokenType.STRING_LIT:
-                    value = _decode_string(value)
-
-                # emit
-                self.tokens.append(Token(ttype, value, self.line_num, pos + 1))
+                if (ch in 'fF') and pos + 1 < length and line[pos+1] in ('"', "'"):
+                    pos = self._scan_fstring(line, pos)
+                    continue
 
-                if ttype in (TokenType.LPAREN, TokenType.LBRACKET, TokenType.LBRACE):
-                    self.bracket_depth += 1
-                elif ttype in (TokenType.RPAREN, TokenType.RBRACKET, TokenType.RBRACE):
-                    if self.bracket_depth > 0:
-                        self.bracket_depth -= 1
-                pos = m.end()
-                break
-            else:
-                snippet = line[pos:pos + 10]
-                raise LexerError(f"Unknown token {snippet!r}", self.line_num, pos + 1)
+            pos = self._scan_token(line, pos, self.line_num, 0)
 
         if comment is not None:
             self.tokens.append(Token(TokenType.COMMENT, comment, self.line_num, comment_col))
@@ -320,37 +309,31 @@ class Lexer:
         length = len(expr)
 
         while pos < length:
-            ch = expr[pos]
-
-            if ch in ' \t\r\n':
+            if expr[pos] in ' \t\r\n':
                 pos += 1
                 continue
-
-            for regex, ttype in TOKEN_REGEX:
-                m = regex.match(expr, pos)
-                if not m:
-                    continue
-                text = m.group(0)
-                value = text
-                # promote keywords
-                if ttype == TokenType.IDENTIFIER and value in KEYWORDS:
-                    ttype = KEYWORDS[value]
-                elif ttype in (TokenType.INT_LIT, TokenType.FLOAT_LIT):
-                    value = value.replace("_", "")
-                elif ttype == TokenType.STRING_LIT:
-                    value = _decode_string(value)
-
-                self.tokens.append(Token(ttype, value, base_line, base_col + pos + 1))
-                pos = m.end()
-                if ttype in (TokenType.LPAREN, TokenType.LBRACKET, TokenType.LBRACE):
-                    self.bracket_depth += 1
-                elif ttype in (TokenType.RPAREN, TokenType.RBRACKET, TokenType.RBRACE):
-                    if self.bracket_depth > 0:
-                        self.bracket_depth -= 1
-                break
-            else:
-                snippet = expr[pos:pos + 10]
-                raise LexerError(f"Unknown token in f-string expression: {snippet!r}", base_line, base_col + pos + 1)
+            pos = self._scan_token(expr, pos, base_line, base_col, "in f-string expression")
+
+    def _scan_token(self, text: str, pos: int, line: int, base_col: int, where: str = "") -> int:
+        """Emit the token starting at `text[pos]`; returns the position after it."""
+        m = MASTER_REGEX.match(text, pos)
+        if m is None:
+            snippet = text[pos:pos + 10]
+            raise LexerError(f"Unknown token {where + ': ' if where else ''}{snippet!r}", line, base_col + pos + 1)
+        ttype = MASTER_TYPES[m.lastindex]
+        value = m.group()
+        if ttype is TokenType.IDENTIFIER:
+            ttype = KEYWORDS.get(value, ttype)     # promote keywords
+        elif ttype in NUMBER_TYPES:
+            value = value.replace("_", "")
+        elif ttype is TokenType.STRING_LIT:
+            value = _decode_string(value)
+        elif ttype in OPENING_BRACKETS:
+            self.bracket_depth += 1
+        elif ttype in CLOSING_BRACKETS and self.bracket_depth > 0:
+            self.bracket_depth -= 1
+        self.tokens.append(Token(ttype, value, line, base_col + pos + 1))
+        return m.end()
 
     # helpers -----------------------------------------------------
     def _emit_indentation(self, width: int):
@@ -422,7 +405,7 @@ class Lexer:
             # enter expression
             if ch == '{':
                 if buf:
-                    self._emit_literal(buf, col)
+                    self._emit_literal(buf, col, quote_char)
                 expr_end, expr = self._extract_braced_expression(line, pos)
                 # Tokenize expr inside braces normally with _tokenize_expr
                 self._emit_token(TokenType.LBRACE, '{', pos + 1)  # emit opening brace as operator
@@ -432,10 +415,15 @@ class Lexer:
                 col = pos + 1
                 continue
 
+            # keep escapes whole so an escaped quote does not end the string
+            if ch == '\\' and pos + 1 < len(line):
+                buf.append(line[pos:pos + 2])
+                pos += 2; continue
+
             # closing quote?
             if ch == quote_char:
                 if buf:
-                    self._emit_literal(buf, col)
+                    self._emit_literal(buf, col, quote_char)
                 self._emit_token(TokenType.FSTRING_END, quote_char, pos + 1)
                 return pos + 1
 
@@ -445,9 +433,9 @@ class Lexer:
         raise self._syntax_error("Unterminated f-string", pos)
 
 
-    def _emit_literal(self, buf: list[str], col: int) -> None:
-        """Emit FSTRING_MIDDLE token from accumulated literal text."""
-        text = ''.join(buf)
+    def _emit_literal(self, buf: list[str], col: int, quote_char: str) -> None:
+        """Emit FSTRING_MIDDLE token from accumulated literal text, escapes decoded."""
+        text = _decode_string(quote_char + ''.join(buf) + quote_char)
         self._emit_token(TokenType.FSTRING_MIDDLE, text, col)
         buf.clear()
 
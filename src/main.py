@@ -2,6 +2,7 @@ import os
 import subprocess
 import argparse
 import shutil
+from concurrent.futures import ThreadPoolExecutor
 from pprint import pprint
 
 from lexer import Lexer, LexerError
@@ -10,10 +11,27 @@ from parser import Parser, ParserError
 from codegen import CodeGen
 from module_loader import load_module
 from type_checker import TypeChecker, TypeError
-from pb_pipeline import compile_code_to_c_and_h 
+from pb_pipeline import compile_code_to_c_and_h, generate_c_and_h
+from build_cache import ModuleCache, object_key, file_key, read_stamp, write_stamp, write_if_changed
 
 RICH_PRINT = False
 
+# Optimization profiles, applied to both pb_runtime.a and the module compile.
+# LTO objects are built "fat" so the archive still links without -flto, and
+# with -flto the hot runtime helpers (list_*_get, ...) inline into modules.
+BUILD_PROFILES = {
+    "debug":   ["-O0", "-g"],
+    "release": ["-O2", "-flto", "-ffat-lto-objects"],
+    "native":  ["-O3", "-march=native", "-flto", "-ffat-lto-objects"],
+    "pgo":     ["-O3", "-flto", "-ffat-lto-objects"],
+}
+
+# The runtime keeps its state per thread and locks what threads share.
+THREAD_FLAGS = [] if os.name == "nt" else ["-pthread"]
+
+# --instrument: the runtime's counters and the generated timing hooks
+INSTRUMENT_FLAGS = ["-DPB_INSTRUMENT"]
+
 def pretty_print_code(code: str, lexer="c"):
     """
     Pretty print code using the rich library.
@@ -36,7 +54,8 @@ def enable_rich():
 
 def compile_to_c(
     source_code: str, pb_path: str, output_file: str = "out.c", 
-    verbose: bool = False, debug: bool = False
+    verbose: bool = False, debug: bool = False, arena_scope: str | None = None, cache: ModuleCache | None = None,
+    unchecked: bool = False, instrument: bool = False
 ):
     basename = os.path.splitext(os.path.basename(pb_path))[0]
     h_code, c_code, ast, loaded_modules = compile_code_to_c_and_h(
@@ -47,36 +66,54 @@ def compile_to_c(
         pretty_print_code=pretty_print_code,
         pprint=pprint,
         import_support=True,
-        pb_path=pb_path
+        pb_path=pb_path,
+        arena_scope=arena_scope,
+        cache=cache,
+        unchecked=unchecked,
+        instrument=instrument
     )
     if ast is None:
         return (False, None, {})
     output_h_path = get_build_output_path(output_file.replace(".c", ".h"))
-    with open(output_h_path, "w") as f:
-        f.write(h_code)
+    write_if_changed(output_h_path, h_code)
     output_c_path = get_build_output_path(output_file)
-    with open(output_c_path, "w") as f:
-        f.write(c_code)
+    write_if_changed(output_c_path, c_code)
     if verbose: print(f"C code written to {output_c_path}")
     return (True, ast, loaded_modules)
 
 
-def build(source_code: str, pb_path: str, output_file: str, verbose: bool = False, debug: bool = False):
+def build(source_code: str, pb_path: str, output_file: str, verbose: bool = False, debug: bool = False,
+          arena_scope: str | None = None, profile: str = "debug", use_cache: bool = True,
+          unchecked: bool = False, instrument: bool = False):
+    """
+    Compile `source_code` and its imports into an executable. With
+    `use_cache`, unchanged modules skip parsing/type checking/codegen, only
+    objects whose inputs changed are recompiled, and pb_runtime.a is rebuilt
+    only when its sources or flags change (see build_cache). `instrument`
+    builds the runtime and every module with PB_INSTRUMENT, so the program
+    prints a profile at exit.
+    """
     if not debug: check_gcc_installed(verbose)
 
+    build_dir = os.path.abspath(os.path.join(os.path.dirname(__file__), "..", "build"))
+    cache = ModuleCache(os.path.join(build_dir, ".cache")) if use_cache else None
+
     # Compile entry point to C
-    success, ast, loaded_modules = compile_to_c(source_code, pb_path, f"{output_file}.c", verbose=verbose, debug=debug)
+    success, ast, loaded_modules = compile_to_c(
+        source_code, pb_path, f"{output_file}.c", verbose=verbose, debug=debug, arena_scope=arena_scope,
+        cache=cache, unchecked=unchecked, instrument=instrument
+    )
     if not success:
         print("Skipping GCC build because type checking failed.")
         return False, None
 
     # For each module, generate .c and .h
-    build_dir = os.path.abspath(os.path.join(os.path.dirname(__file__), "..", "build"))
     module_c_files = []
     for mod in loaded_modules.values():
         if not hasattr(mod, "program"):
             continue  # Defensive: only process modules with AST
-        c_file = write_module_code_files(mod, build_dir, verbose, debug)
+        c_file = write_module_code_files(mod, build_dir, verbose, debug, arena_scope=arena_scope, cache=cache,
+                                         unchecked=unchecked, instrument=instrument)
         if c_file:
             module_c_files.append(c_file)
 
@@ -85,17 +122,36 @@ def build(source_code: str, pb_path: str, output_file: str, verbose: bool = Fals
 
     exe_file = get_build_output_path(output_file) + (".exe" if os.name == "nt" else "")
 
-    runtime_header = get_build_output_path("pb_runtime.h")
-    runtime_lib = get_build_output_path("pb_runtime.a")
+    extra_flags = INSTRUMENT_FLAGS if instrument else []
+    if profile == "pgo":
+        ok = build_pgo(module_c_files, exe_file, build_dir, loaded_modules, verbose=verbose, debug=debug,
+                       extra_flags=extra_flags)
+        return (True, loaded_modules) if ok else (False, None)
+
+    opt_flags = [*BUILD_PROFILES[profile], *extra_flags]
+    if not build_runtime_library(verbose=verbose, debug=debug, cflags=opt_flags, force=not use_cache):
+        return False, None
+
+    if cache is not None and verbose:
+        print(f"Module cache: {cache.hits} hit(s), {cache.misses} miss(es)")
+    if compile_executable(module_c_files, exe_file, build_dir, loaded_modules,
+                          opt_flags, get_build_output_path("pb_runtime.a"), verbose=verbose,
+                          force=not use_cache):
+        return True, loaded_modules
+    return False, None
 
-    # -- Disabled while still prototyping
-    # Check if runtime library exists
-    # if not os.path.isfile(runtime_lib):
-        # if verbose: print("Runtime library not found; building it now...")
-        # build_runtime_library(verbose=verbose, debug=debug)    
-    build_runtime_library(verbose=verbose, debug=debug)    
 
+def compile_executable(module_c_files: list[str], exe_file: str, build_dir: str, loaded_modules,
+                       opt_flags: list[str], runtime_lib: str, verbose: bool = False,
+                       obj_dir: str | None = None, force: bool = False) -> bool:
+    """
+    Compile each module C file to its own object under `obj_dir` (default
+    build/obj), in parallel across cores, then link them with `runtime_lib`.
+    Unless `force`, objects whose key (build_cache.object_key) is unchanged
+    are reused, and the link is skipped when no input changed.
+    """
     include_dirs, lib_dirs, link_flags = collect_vendor_build_info(loaded_modules)
+    obj_dir = obj_dir or os.path.join(build_dir, "obj")
 
     flags = [
         "-Wall",        # common warnings
@@ -103,32 +159,116 @@ def build(source_code: str, pb_path: str, output_file: str, verbose: bool = Fals
         "-Wconversion", # warns about implicit type conversions
         "-Wpedantic",   # enforces ISO C standard
     ]
+    cflags = ["-std=c99", *flags, *THREAD_FLAGS, *opt_flags]
+    include_args = ["-I", build_dir, *["-I" + idir for idir in include_dirs.keys()]]
+
+    jobs = []
+    for c_path in module_c_files:
+        rel = os.path.splitext(os.path.relpath(c_path, build_dir))[0]
+        obj = os.path.join(obj_dir, rel + ".o")
+        jobs.append((c_path, obj, object_key(c_path, [build_dir, *include_dirs.keys()], cflags)))
+
+    def compile_object(job) -> str | None:
+        c_path, obj, key = job
+        if not force and os.path.isfile(obj) and read_stamp(obj) == key:
+            return None
+        os.makedirs(os.path.dirname(obj), exist_ok=True)
+        write_stamp(obj, None)
+        compile_cmd = ["gcc", *cflags, "-c", c_path, "-o", obj, *include_args]
+        if verbose: print("Compile command:", " ".join(compile_cmd))
+        result = subprocess.run(compile_cmd, capture_output=True, text=True)
+        if result.returncode != 0:
+            return result.stderr
+        write_stamp(obj, key)
+        return None
+
+    with ThreadPoolExecutor(max_workers=os.cpu_count() or 1) as pool:
+        errors = [err for err in pool.map(compile_object, jobs) if err is not None]
+    if errors:
+        print(f"GCC build failed ({len(errors)} of {len(jobs)} module(s))")
+        print("Error output: " + "\n".join(errors))
+        return False
 
-    compile_cmd = [
-        "gcc", "-std=c99",
-        *flags,
-        *module_c_files,
+    objects = [obj for _, obj, _ in jobs]
+    link_cmd = [
+        "gcc", *cflags,
+        *objects,
         "-o", exe_file,
-        "-I", build_dir,
-        *["-I" + idir for idir in include_dirs.keys()],
         *["-L" + ldir for ldir in lib_dirs.keys()],
         *link_flags.keys(),
         runtime_lib,
     ]
-    if verbose: print("Compile command:", " ".join(compile_cmd))
-
-    result = subprocess.run(compile_cmd, capture_output=True, text=True)
+    link_key = file_key([runtime_lib], *link_cmd, *[key for _, _, key in jobs])
+    if not force and os.path.isfile(exe_file) and read_stamp(exe_file) == link_key:
+        if verbose: print(f"Up to date: {exe_file}")
+        return True
+
+    write_stamp(exe_file, None)
+    if verbose: print("Link command:", " ".join(link_cmd))
+    result = subprocess.run(link_cmd, capture_output=True, text=True)
     if result.returncode == 0:
+        write_stamp(exe_file, link_key)
         if verbose: print(f"Built: {exe_file}")
-        return True, loaded_modules
-    else:
-        print(f"GCC build failed (exit code {result.returncode})")
-        print(f"Error output: {result.stderr}")
-        return False, None
+        return True
+    print(f"GCC build failed (exit code {result.returncode})")
+    print(f"Error output: {result.stderr}")
+    return False
 
 
-def run(source_code: str, pb_path: str, output_file: str, verbose: bool = False, debug: bool = False):
-    success, loaded_modules = build(source_code, pb_path, output_file, verbose=verbose, debug=debug)
+def build_pgo(module_c_files: list[str], exe_file: str, build_dir: str, loaded_modules,
+              verbose: bool = False, debug: bool = False, extra_flags: list[str] | None = None) -> bool:
+    """
+    Two-stage profile-guided build: compile runtime and modules with
+    -fprofile-generate, run that binary once as the training workload, then
+    rebuild both with -fprofile-use. Both stages build in build/pgo, since
+    GCC names profile files after the output paths; only the optimized
+    archive and executable are copied to the normal outputs.
+    """
+    pgo_dir = os.path.join(build_dir, "pgo")
+    shutil.rmtree(pgo_dir, ignore_errors=True)
+    os.makedirs(pgo_dir)
+    base = [*BUILD_PROFILES["pgo"], *(extra_flags or [])]
+    pgo_exe = os.path.join(pgo_dir, os.path.basename(exe_file))
+    pgo_lib = os.path.join(pgo_dir, "pb_runtime.a")
+
+    gen_flags = [*base, f"-fprofile-generate={pgo_dir}"]
+    if not build_runtime_library(verbose=verbose, debug=debug, cflags=gen_flags, out_dir=pgo_dir, force=True):
+        return False
+    pgo_obj = os.path.join(pgo_dir, "obj")
+    if not compile_executable(module_c_files, pgo_exe, build_dir, loaded_modules,
+                              gen_flags, pgo_lib, verbose=verbose, obj_dir=pgo_obj, force=True):
+        return False
+
+    if verbose: print("PGO training run:", pgo_exe)
+    train = subprocess.run([pgo_exe], stdout=subprocess.DEVNULL, stderr=subprocess.PIPE, text=True)
+    if train.returncode != 0:
+        print(f"PGO training run exited with code {train.returncode}; using the partial profile")
+
+    # Functions the training run never reached are optimized normally
+    use_flags = [*base, f"-fprofile-use={pgo_dir}", "-fprofile-correction", "-Wno-missing-profile"]
+    if not build_runtime_library(verbose=verbose, debug=debug, cflags=use_flags, out_dir=pgo_dir, force=True):
+        return False
+    if not compile_executable(module_c_files, pgo_exe, build_dir, loaded_modules,
+                              use_flags, pgo_lib, verbose=verbose, obj_dir=pgo_obj, force=True):
+        return False
+    # The copies are profile-specific: drop their stamps so the next
+    # non-PGO build replaces them
+    runtime_lib = get_build_output_path("pb_runtime.a")
+    shutil.copy2(pgo_lib, runtime_lib)
+    write_stamp(runtime_lib, None)
+    shutil.copy2(os.path.join(pgo_dir, "pb_runtime.h"), get_build_output_path("pb_runtime.h"))
+    shutil.copy2(pgo_exe, exe_file)
+    write_stamp(exe_file, None)
+    return True
+
+
+def run(source_code: str, pb_path: str, output_file: str, verbose: bool = False, debug: bool = False,
+        arena_scope: str | None = None, profile: str = "debug", use_cache: bool = True,
+        unchecked: bool = False, instrument: bool = False):
+    success, loaded_modules = build(
+        source_code, pb_path, output_file, verbose=verbose, debug=debug, arena_scope=arena_scope,
+        profile=profile, use_cache=use_cache, unchecked=unchecked, instrument=instrument
+    )
     if not success:
         print("Skipping run because compilation failed.")
         return
@@ -136,7 +276,8 @@ def run(source_code: str, pb_path: str, output_file: str, verbose: bool = False,
     # exe_file = output_file + (".exe" if os.name == "nt" else "")
     exe_file = get_build_output_path(output_file) + (".exe" if os.name == "nt" else "")
 
-    has_vendor = any(getattr(mod, "native_binding", False) for mod in loaded_modules.values())
+    # bindings implemented by the runtime itself (stdlib `random`) need no library at run time
+    has_vendor = any(getattr(mod, "native_binding", False) and _links_libraries(mod) for mod in loaded_modules.values())
     if has_vendor:
         print("Run disabled: Native/vendor modules detected. Please run the binary manually.")
         print(f"    {exe_file}")
@@ -148,13 +289,20 @@ def run(source_code: str, pb_path: str, output_file: str, verbose: bool = False,
     if verbose: print("\n")
 
 
+def _links_libraries(mod_symbol) -> bool:
+    md = getattr(mod_symbol, "vendor_metadata", None) or {}
+    return bool(md.get("lib_dirs") or md.get("link_flags"))
+
+
 def get_build_output_path(output_file: str) -> str:
     build_dir = os.path.abspath(os.path.join(os.path.dirname(__file__), "..", "build"))
     os.makedirs(build_dir, exist_ok=True)
     return os.path.join(build_dir, output_file)
 
 
-def write_module_code_files(mod_symbol, build_dir, verbose: bool = False, debug: bool = False):
+def write_module_code_files(mod_symbol, build_dir, verbose: bool = False, debug: bool = False,
+                            arena_scope: str | None = None, cache: ModuleCache | None = None,
+                            unchecked: bool = False, instrument: bool = False):
     if getattr(mod_symbol, "native_binding", False):
         if verbose:
             print(f"Skipping code generation for native binding module: {mod_symbol.name}")
@@ -168,57 +316,68 @@ def write_module_code_files(mod_symbol, build_dir, verbose: bool = False, debug:
 
     h_path = os.path.join(mod_dir, f"{basename}.h")
     c_path = os.path.join(mod_dir, f"{basename}.c")
-    codegen = CodeGen()
-    h_code = codegen.generate_header(mod_symbol.program)
+    h_code, c_code = generate_c_and_h(mod_symbol.program, arena_scope, cache, mod_symbol.cache_key,
+                                      unchecked=unchecked, instrument=instrument)
     if debug: print(f"Module HEADER: {basename}.h\n"); pretty_print_code(h_code, "c"); print(f"{'-'*80}\n")
-    c_code = codegen.generate(mod_symbol.program)
     if debug: print(f"Module CODE: {basename}.c\n"); pretty_print_code(c_code, "c"); print(f"{'-'*80}\n")
 
-    with open(h_path, "w") as f:
-        f.write(h_code)
-    with open(c_path, "w") as f:
-        f.write(c_code)
+    write_if_changed(h_path, h_code)
+    write_if_changed(c_path, c_code)
     return c_path  # return path for later GCC command
 
 
-def build_runtime_library(verbose: bool = False, debug: bool = False):
+def build_runtime_library(verbose: bool = False, debug: bool = False, profile: str = "debug",
+                          cflags: list[str] | None = None, out_dir: str | None = None,
+                          force: bool = True) -> bool:
     """
     Builds the PB runtime into a static library (pb_runtime.a)
     and copies the header to the build directory.
+    `cflags` overrides the flags of `profile`; `out_dir` defaults to build/.
+    Unless `force`, an archive built from the same sources and flags is kept.
     """
     this_dir = os.path.dirname(os.path.abspath(__file__))
     root_dir = os.path.abspath(os.path.join(this_dir, ".."))
     src_c = os.path.join(this_dir, "pb_runtime.c")
     src_h = os.path.join(this_dir, "pb_runtime.h")
-    build_dir = os.path.join(root_dir, "build")
+    build_dir = out_dir or os.path.join(root_dir, "build")
     os.makedirs(build_dir, exist_ok=True)
+    if cflags is None:
+        cflags = BUILD_PROFILES[profile]
 
     lib_path = os.path.join(build_dir, "pb_runtime.a")
     header_dest = os.path.join(build_dir, "pb_runtime.h")
 
     if not os.path.isfile(src_c):
         print(f"pb_runtime.c not found at: {src_c}")
-        return
+        return False
+
+    key = file_key([src_c, src_h], *THREAD_FLAGS, *cflags)
+    if not force and os.path.isfile(lib_path) and os.path.isfile(header_dest) and read_stamp(lib_path) == key:
+        if verbose: print(f"PB runtime up to date: {lib_path}")
+        return True
+    write_stamp(lib_path, None)
 
     # Compile to object file
     obj_path = os.path.join(build_dir, "pb_runtime.o")
-    compile_cmd = ["gcc", "-std=c99", "-c", src_c, "-o", obj_path]
+    compile_cmd = ["gcc", "-std=c99", *THREAD_FLAGS, *cflags, "-c", src_c, "-o", obj_path]
     if verbose: print("PB Runtime compile command:", " ".join(compile_cmd))
 
     result = subprocess.run(compile_cmd, capture_output=True, text=True)
     if result.returncode != 0:
         print(f"Compilation failed:\n{result.stderr}")
-        return
+        return False
 
     # Archive into static library
     # lib_path = os.path.join(build_dir, "libpbruntime.a")
-    ar_cmd = ["ar", "rcs", lib_path, obj_path]
+    # LTO objects need the plugin-aware archiver for their symbol index
+    archiver = "gcc-ar" if "-flto" in cflags and shutil.which("gcc-ar") else "ar"
+    ar_cmd = [archiver, "rcs", lib_path, obj_path]
     if verbose: print("Archive command:", " ".join(ar_cmd))
 
     result = subprocess.run(ar_cmd, capture_output=True, text=True)
     if result.returncode != 0:
         print(f"Archiving failed:\n{result.stderr}")
-        return
+        return False
 
     if verbose:
         print(f"Built static library: {lib_path}")
@@ -227,6 +386,8 @@ def build_runtime_library(verbose: bool = False, debug: bool = False):
     shutil.copy2(src_h, header_dest)
     if verbose:
         print(f"Copied pb_runtime.h to: {header_dest}")
+    write_stamp(lib_path, key)
+    return True
 
 
 def check_gcc_installed(verbose):
@@ -275,11 +436,41 @@ def collect_vendor_build_info(loaded_modules):
 
 def main():
     parser = argparse.ArgumentParser(description="PB Language Toolchain")
-    parser.add_argument("command", choices=["toc", "build", "run", "buildlib"], help="Action to perform")
-    parser.add_argument("file", nargs="?", help="Path to .pb source file")
+    parser.add_argument("command", choices=["toc", "build", "run", "buildlib", "bench"],
+                        help="Action to perform")
+    parser.add_argument("file", nargs="?",
+                        help="Path to .pb source file (bench: comma-separated benchmark names, default all)")
     parser.add_argument("-v", "--verbose", action="store_true", help="Enable verbose output")
     parser.add_argument("-d", "--debug", action="store_true", help="Enable debug output")
     parser.add_argument("-r", "--rich", action="store_true", help="Pretty print with rich")
+    parser.add_argument("--arena", choices=["function", "loop"], default=None,
+                        help="Free runtime temporaries (strings, error messages) at the end of "
+                             "each function body or loop iteration")
+    parser.add_argument("--profile", choices=list(BUILD_PROFILES), default="debug",
+                        help="Optimization profile for the runtime and the program: debug (-O0 -g), "
+                             "release (-O2, LTO), native (-O3, LTO, -march=native) or "
+                             "pgo (-O3, LTO, trained on one run of the program)")
+    parser.add_argument("--unchecked", action="store_true",
+                        help="Skip bounds checks on all list element accesses "
+                             "(out-of-range indices are undefined behaviour)")
+    parser.add_argument("--instrument", action="store_true",
+                        help="Count list grows, dict probes, raises and try depth in the runtime, time "
+                             "every function, and print the profile at exit (to stderr, or to the file "
+                             "in PB_PROFILE_OUT)")
+    parser.add_argument("--no-cache", action="store_true",
+                        help="Rebuild every module, object and the runtime instead of reusing "
+                             "unchanged build outputs")
+    parser.add_argument("--repeat", type=int, default=5, help="bench: runs per program and variant")
+    parser.add_argument("--profiles", default=",".join(BUILD_PROFILES),
+                        help="bench: comma-separated build profiles to time (default all)")
+    parser.add_argument("--json", default=None,
+                        help="bench: where to save the results (default build/bench/results.json)")
+    parser.add_argument("--baseline", default=None,
+                        help="bench: an earlier results file to compare median times against")
+    parser.add_argument("--compile", action="store_true",
+                        help="bench: time the compiler's lex, parse, type check and codegen phases on a "
+                             "generated module instead of running the benchmark programs")
+    parser.add_argument("--lines", type=int, default=50000, help="bench --compile: size of the generated module")
     args = parser.parse_args()
 
     if args.rich:
@@ -287,7 +478,19 @@ def main():
     
     try:
         if args.command == "buildlib":
-            build_runtime_library(verbose=args.verbose, debug=args.debug)
+            build_runtime_library(verbose=args.verbose, debug=args.debug, profile=args.profile)
+            return
+
+        if args.command == "bench" and args.compile:
+            from bench import compile_benchmark
+            compile_benchmark(args.lines, repeat=args.repeat, out_path=args.json, baseline=args.baseline)
+            return
+
+        if args.command == "bench":
+            from bench import run_benchmarks
+            names = args.file.split(",") if args.file else None
+            run_benchmarks(names, args.profiles.split(","), repeat=args.repeat, out_path=args.json,
+                           baseline=args.baseline, verbose=args.verbose)
             return
 
         if not args.file or not args.file.endswith(".pb"):
@@ -306,11 +509,16 @@ def main():
         output_filename = os.path.basename(output_path)
 
         if args.command == "toc":
-            compile_to_c(code, pb_path, f"{output_filename}.c", verbose=args.verbose, debug=args.debug)
+            compile_to_c(code, pb_path, f"{output_filename}.c", verbose=args.verbose, debug=args.debug,
+                         arena_scope=args.arena, unchecked=args.unchecked, instrument=args.instrument)
         elif args.command == "build":
-            build(code, pb_path, output_filename, verbose=args.verbose, debug=args.debug)
+            build(code, pb_path, output_filename, verbose=args.verbose, debug=args.debug,
+                  arena_scope=args.arena, profile=args.profile, use_cache=not args.no_cache,
+                  unchecked=args.unchecked, instrument=args.instrument)
         elif args.command == "run":
-            run(code, pb_path, output_filename, verbose=args.verbose, debug=args.debug)
+            run(code, pb_path, output_filename, verbose=args.verbose, debug=args.debug,
+                arena_scope=args.arena, profile=args.profile, use_cache=not args.no_cache,
+                unchecked=args.unchecked, instrument=args.instrument)
 
     except Exception as e:
         print(f"{type(e).__name__}: {e}")
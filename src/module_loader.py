@@ -4,6 +4,7 @@ from lexer import Lexer
 from parser import Parser
 from lang_ast import ImportStmt, ImportFromStmt, FunctionDef, ClassDef, VarDecl
 from type_checker import TypeChecker, ModuleSymbol
+from optimizer import fold_constants
 
 
 root = os.path.abspath(os.path.join(os.path.dirname(__file__), ".."))
@@ -64,10 +65,12 @@ def resolve_module(module_name: list[str], search_paths: list[str] = None) -> st
         search_paths = [os.getcwd()]
     rel_path = os.path.join(*module_name) + ".pb"
     rel_path2 = os.path.join(*module_name, module_name[-1] + ".pb")
+    # foo/foo.pb is the file of package `foo`, never a submodule `foo.foo`
+    is_package_file = len(module_name) >= 2 and module_name[-1] == module_name[-2]
     for base in search_paths:
         candidate = os.path.join(base, rel_path)
         candidate2 = os.path.join(base, rel_path2)
-        if os.path.isfile(candidate):
+        if os.path.isfile(candidate) and not is_package_file:
             return os.path.abspath(candidate)
         if os.path.isfile(candidate2):
             return os.path.abspath(candidate2)
@@ -79,7 +82,8 @@ def resolve_module(module_name: list[str], search_paths: list[str] = None) -> st
     )
 
 
-def load_module(module_name: list[str], search_paths: list[str], loaded_modules: dict, verbose: bool = False) -> ModuleSymbol:
+def load_module(module_name: list[str], search_paths: list[str], loaded_modules: dict, verbose: bool = False,
+                cache=None) -> ModuleSymbol:
     """
     Loads, parses, and type-checks a PB module, recursively resolving its imports.
     Caches loaded modules in loaded_modules to avoid redundant work and handle import cycles.
@@ -88,6 +92,8 @@ def load_module(module_name: list[str], search_paths: list[str], loaded_modules:
         module_name: List of identifiers for the module (e.g., ["foo", "bar"]).
         search_paths: Directories to search for the .pb file.
         loaded_modules: Dict[module_name_tuple, ModuleSymbol] for already loaded modules.
+        cache: Optional build_cache.ModuleCache; a valid entry replaces
+            Steps 2-4 and the result carries its `cache_key`.
 
     Returns:
         ModuleSymbol populated with exports.
@@ -104,14 +110,8 @@ def load_module(module_name: list[str], search_paths: list[str], loaded_modules:
 
     native = is_native_binding(filepath)
 
-    # Step 2: Parse file
     with open(filepath, "r", encoding="utf-8") as f:
         source = f.read()
-    tokens = Lexer(source).tokenize()
-    program = Parser(tokens).parse()
-
-    # Step 3: Type check, including imports
-    checker = TypeChecker(native_module=native)
 
     base_search_paths = get_std_vendor_paths()
     this_module_dir = os.path.dirname(filepath)
@@ -120,35 +120,71 @@ def load_module(module_name: list[str], search_paths: list[str], loaded_modules:
     for p in base_search_paths + [this_module_dir] + search_paths:
         if p not in child_search_paths:
             child_search_paths.append(p)
+
+    dotted = ".".join(module_name)
+    if cache is not None:
+        hit = cache.lookup(
+            filepath, source, dotted,
+            lambda dep: load_module(dep, child_search_paths, loaded_modules, verbose, cache).cache_key,
+        )
+        if hit is not None:
+            if verbose: print(f"Cached: {module_name} -> {filepath}")
+            mod_symbol = hit[1]
+            mod_symbol.cache_key = hit[0]
+            loaded_modules[name_tuple] = mod_symbol
+            return mod_symbol
+
+    # Every import probe, as (name, key or None when it does not resolve)
+    deps: list[tuple[list[str], str | None]] = []
+
+    def load_dep(dep_name: list[str]) -> ModuleSymbol:
+        try:
+            sym = load_module(dep_name, child_search_paths, loaded_modules, verbose, cache)
+        except ModuleNotFoundError:
+            deps.append((dep_name, None))
+            raise
+        deps.append((dep_name, sym.cache_key))
+        return sym
+
+    # Step 2: Parse file
+    tokens = Lexer(source).tokenize()
+    program = Parser(tokens).parse()
+
+    # Step 3: Type check, including imports
+    checker = TypeChecker(native_module=native)
     if verbose: print(f"Loading: {module_name} from {search_paths} -> {filepath}")
 
     # Register imports (recursive)
     for stmt in program.body:
         if isinstance(stmt, ImportStmt):
             alias_name = stmt.alias or ".".join(stmt.module)
-            mod_symbol = load_module(stmt.module, child_search_paths, loaded_modules, verbose)
+            mod_symbol = load_dep(stmt.module)
             if verbose:
                 print(f"Loaded module: {alias_name}, exports: {mod_symbol.exports}")
             checker.modules[alias_name] = mod_symbol
         elif isinstance(stmt, ImportFromStmt):
             mod_symbol = None
             if stmt.is_wildcard:
-                mod_symbol = load_module(stmt.module, child_search_paths, loaded_modules, verbose)
+                mod_symbol = load_dep(stmt.module)
+                checker.imported_modules[mod_symbol.name] = mod_symbol
                 for name, kind in mod_symbol.exports.items():
                     if kind == "function" and name in mod_symbol.functions:
                         checker.functions[name] = mod_symbol.functions[name]
                         checker.native_functions[name] = mod_symbol.native_binding
                     else:
                         checker.env[name] = kind
+                        if kind not in ("function", "class"):
+                            checker.imported_globals[name] = mod_symbol.name
             else:
                 for alias_obj in stmt.names or []:
                     name = alias_obj.name
                     asname = alias_obj.asname or name
                     try:
-                        sub_mod = load_module(stmt.module + [name], child_search_paths, loaded_modules, verbose)
+                        sub_mod = load_dep(stmt.module + [name])
                     except ModuleNotFoundError:
                         if mod_symbol is None:
-                            mod_symbol = load_module(stmt.module, child_search_paths, loaded_modules, verbose)
+                            mod_symbol = load_dep(stmt.module)
+                            checker.imported_modules[mod_symbol.name] = mod_symbol
                         if name not in mod_symbol.exports:
                             raise ModuleNotFoundError(
                                 f"Module '{'.'.join(stmt.module)}' has no export '{name}'"
@@ -159,10 +195,13 @@ def load_module(module_name: list[str], search_paths: list[str], loaded_modules:
                             checker.native_functions[asname] = mod_symbol.native_binding
                         else:
                             checker.env[asname] = kind
+                            if kind not in ("function", "class"):
+                                checker.imported_globals[asname] = mod_symbol.name
                     else:
                         checker.modules[asname] = sub_mod
 
     checker.check(program)
+    fold_constants(program)
 
     # Step 4: Collect exports (functions, classes, globals)
     exports = {}
@@ -178,12 +217,13 @@ def load_module(module_name: list[str], search_paths: list[str], loaded_modules:
             exports[stmt.name] = stmt.declared_type
 
     vendor_metadata = None
-    if "vendor" in filepath.split(os.sep):
+    if native or "vendor" in filepath.split(os.sep):
+        # a native stdlib module ships its headers the same way a vendor one does
         vendor_metadata = load_vendor_metadata(filepath)
 
-    program.module_name = ".".join(module_name)
+    program.module_name = dotted
     mod_symbol = ModuleSymbol(
-        name=".".join(module_name),
+        name=dotted,
         program=program,
         path=filepath,
         exports=exports,
@@ -191,5 +231,7 @@ def load_module(module_name: list[str], search_paths: list[str], loaded_modules:
         vendor_metadata=vendor_metadata,
         native_binding=native,
     )
+    if cache is not None:
+        mod_symbol.cache_key = cache.store(filepath, source, dotted, deps, mod_symbol)
     loaded_modules[name_tuple] = mod_symbol
     return mod_symbol
@@ -0,0 +1,346 @@
+"""
+PB Constant Folding
+===================
+
+An AST pass that runs after type checking and before codegen. It works on
+the typed tree in place, through `fold_constants(program)`:
+
+- Arithmetic and comparisons on `int`, `float` and `bool` literals are
+  evaluated, and so are `==`/`!=` between constant strings. Integer `/`, `//` and `%` truncate towards zero, as the
+  generated C does. Nothing is folded if it would overflow int64, divide by
+  zero or produce a non-finite float, so the program fails at run time
+  exactly as before.
+- `and`/`or` with a constant left operand short-circuit at compile time.
+- F-string placeholders holding constants become text. An f-string with
+  no placeholders left becomes a plain string literal, so no `pb_fstring`
+  call runs.
+- Module globals of a scalar type whose initializer folds to a constant,
+  and which are never rebound anywhere in the module, are substituted at
+  every read. Their declarations stay, so importers still link against
+  them. `str` constants are substituted only inside f-strings and string
+  comparisons, where they fold away.
+- `if` branches whose condition folds to `False` are removed. A branch
+  that folds to `True` drops every branch after it. `while False:` loops
+  are removed.
+- Parameter defaults are folded the same way, so call sites get a literal
+  and not the default expression.
+
+The C compiler cannot do this on its own: f-strings lower to runtime
+`snprintf` calls, and module globals are external symbols it has to reload.
+"""
+
+import ast
+import dataclasses
+import math
+from typing import Any, Optional
+
+from lang_ast import (
+    Program, FunctionDef, ClassDef, Parameter, GlobalStmt, VarDecl, AssignStmt, AugAssignStmt,
+    IfStmt, IfBranch, WhileStmt, ForStmt, ExceptBlock, DelStmt, PassStmt, ImportStmt, ImportAlias,
+    Identifier, Literal, StringLiteral, FStringLiteral, FStringText, FStringExpr, BinOp, UnaryOp,
+)
+
+INT64_MIN = -(1 << 63)
+INT64_MAX = (1 << 63) - 1
+
+# Stands for "not a compile-time constant": None is a PB value
+NOT_CONST = object()
+# Returned by the statement folder for a statement that folds away
+REMOVED = object()
+
+CONST_GLOBAL_TYPES = ("int", "float", "bool", "str")
+# Fields of statement nodes that hold a block of statements
+STMT_LIST_FIELDS = ("body", "try_body", "finally_body")
+
+
+# node class -> the names of its child fields, or None for a non-node
+_FIELDS: dict[type, Optional[tuple[str, ...]]] = {}
+
+
+def _fields(cls: type) -> Optional[tuple[str, ...]]:
+    try:
+        return _FIELDS[cls]
+    except KeyError:
+        names = None
+        if dataclasses.is_dataclass(cls):
+            names = tuple(f.name for f in dataclasses.fields(cls) if f.name != "inferred_type")
+        _FIELDS[cls] = names
+        return names
+
+
+def _const_value(e: Any) -> Any:
+    """The Python value of a numeric or bool literal, else NOT_CONST."""
+    if not isinstance(e, Literal):
+        return NOT_CONST
+    if e.raw == "True":
+        return True
+    if e.raw == "False":
+        return False
+    try:
+        value = ast.literal_eval(e.raw)
+    except (ValueError, SyntaxError):
+        return NOT_CONST
+    if isinstance(value, bool) or not isinstance(value, (int, float)):
+        return NOT_CONST
+    return value
+
+
+def _make_literal(value: Any) -> Optional[Literal]:
+    """A typed literal for `value`, or None when it has no exact C literal."""
+    if isinstance(value, bool):
+        return Literal("True" if value else "False", inferred_type="bool")
+    if isinstance(value, int):
+        # INT64_MIN has no C literal: its magnitude does not fit
+        return Literal(str(value), inferred_type="int") if INT64_MIN < value <= INT64_MAX else None
+    if isinstance(value, float) and math.isfinite(value):
+        raw = repr(value)
+        if "." not in raw:
+            raw = raw.replace("e", ".0e", 1)   # 1e-05: keep a float-looking lexeme
+        return Literal(raw, inferred_type="float")
+    return None
+
+
+def _c_div(a: int, b: int) -> int:
+    """Integer division as C does it: the quotient truncates towards zero."""
+    q = abs(a) // abs(b)
+    return q if (a < 0) == (b < 0) else -q
+
+
+def _fold_arith(op: str, a: Any, b: Any) -> Any:
+    if isinstance(a, bool) or isinstance(b, bool):
+        return NOT_CONST
+    if isinstance(a, int) and isinstance(b, int):
+        if op in ("/", "//", "%"):
+            if b == 0:
+                return NOT_CONST
+            q = _c_div(a, b)
+            return q if op != "%" else a - b * q
+        return {"+": a + b, "-": a - b, "*": a * b}[op]
+    # float arithmetic: C promotes the int operand, as Python does
+    if op in ("//", "%"):
+        return NOT_CONST
+    if op == "/":
+        return a / b if b != 0 else NOT_CONST
+    return {"+": a + b, "-": a - b, "*": a * b}[op]
+
+
+COMPARISONS = {
+    "==": lambda a, b: a == b, "!=": lambda a, b: a != b,
+    "<": lambda a, b: a < b, "<=": lambda a, b: a <= b,
+    ">": lambda a, b: a > b, ">=": lambda a, b: a >= b,
+}
+
+
+def _fstring_text(e: Any) -> Optional[str]:
+    """How a constant placeholder prints, as `pb_fstring` would format it."""
+    if isinstance(e, StringLiteral):
+        return e.value
+    value = _const_value(e)
+    if value is NOT_CONST:
+        return None
+    if isinstance(value, bool):
+        return "True" if value else "False"
+    if isinstance(value, float):
+        return repr(value) if math.isfinite(value) else None
+    return str(value)
+
+
+def _rebound_names(program: Program) -> dict[str, int]:
+    """How many times each name is bound anywhere in `program`."""
+    counts: dict[str, int] = {}
+
+    def bind(name: Optional[str]) -> None:
+        if name:
+            counts[name] = counts.get(name, 0) + 1
+
+    stack: list[Any] = [program.body]
+    while stack:
+        node = stack.pop()
+        if isinstance(node, list):
+            stack.extend(node)
+            continue
+        fields = _fields(type(node))
+        if fields is None:
+            continue
+        if isinstance(node, (VarDecl, FunctionDef, ClassDef, Parameter)):
+            bind(node.name)
+        elif isinstance(node, (AssignStmt, AugAssignStmt, DelStmt)) and isinstance(node.target, Identifier):
+            bind(node.target.name)
+        elif isinstance(node, ForStmt):
+            for name in [node.var_name] + node.extra_vars:
+                bind(name)
+        elif isinstance(node, ExceptBlock):
+            bind(node.alias)
+        elif isinstance(node, GlobalStmt):
+            for name in node.names:
+                bind(name)
+        elif isinstance(node, ImportStmt):
+            bind(node.alias or ".".join(node.module))
+        elif isinstance(node, ImportAlias):
+            bind(node.asname or node.name)
+        stack.extend(getattr(node, name) for name in fields)
+    return counts
+
+
+class ConstantFolder:
+    """Folds one module's AST; see the module docstring for what it rewrites."""
+
+    def __init__(self, program: Program) -> None:
+        self.program = program
+        self.rebound = _rebound_names(program)
+        # global name -> the literal every read of it folds to
+        self.consts: dict[str, Literal | StringLiteral] = {}
+
+    def run(self) -> Program:
+        # in source order: a global is only readable after its declaration
+        for stmt in self.program.body:
+            self.stmt(stmt)   # top-level statements never fold away
+            if isinstance(stmt, VarDecl):
+                self._record_const(stmt)
+        return self.program
+
+    def _record_const(self, decl: VarDecl) -> None:
+        if decl.declared_type not in CONST_GLOBAL_TYPES or self.rebound.get(decl.name, 0) != 1:
+            return
+        if decl.declared_type == "str":
+            if isinstance(decl.value, StringLiteral):
+                self.consts[decl.name] = decl.value
+            return
+        value = _const_value(decl.value)
+        if value is NOT_CONST:
+            return
+        literal = _make_literal(value)
+        if literal is not None and literal.inferred_type == decl.declared_type:
+            self.consts[decl.name] = literal
+
+    # ── statements ──
+
+    def body(self, stmts: list) -> list:
+        out = [s for s in (self.stmt(st) for st in stmts) if s is not REMOVED]
+        return out if out or not stmts else [PassStmt()]
+
+    def stmt(self, st: Any) -> Any:
+        if isinstance(st, IfStmt):
+            return self._if(st)
+        if isinstance(st, WhileStmt):
+            st.condition = self.expr(st.condition)
+            if _const_value(st.condition) is False:
+                return REMOVED
+            st.body = self.body(st.body)
+            return st
+        self._children(st)
+        return st
+
+    def _if(self, st: IfStmt) -> Any:
+        branches: list[IfBranch] = []
+        for br in st.branches:
+            cond = None if br.condition is None else self.expr(br.condition)
+            value = NOT_CONST if cond is None else _const_value(cond)
+            if value is False:
+                continue   # never taken
+            if value is True or cond is None:
+                # taken whenever it is reached: nothing after it can run
+                cond = cond if not branches else None
+                branches.append(IfBranch(cond, self.body(br.body)))
+                break
+            branches.append(IfBranch(cond, self.body(br.body)))
+        if not branches:
+            return REMOVED
+        if branches[0].condition is None:
+            # only the else is left: keep it as a block so C scoping is unchanged
+            branches[0].condition = Literal("True", inferred_type="bool")
+        st.branches = branches
+        return st
+
+    def _children(self, node: Any) -> None:
+        """Fold every node held by `node`, statement lists through `body`."""
+        for name in _fields(type(node)) or ():
+            child = getattr(node, name)
+            if isinstance(child, list):
+                setattr(node, name, self.body(child) if name in STMT_LIST_FIELDS else [self.expr(c) for c in child])
+            elif _fields(type(child)) is not None:
+                setattr(node, name, self.expr(child))
+
+    # ── expressions ──
+
+    def expr(self, e: Any) -> Any:
+        """The folded form of `e`; nodes that are not expressions fold their children."""
+        if isinstance(e, Identifier):
+            const = self.consts.get(e.name)
+            if isinstance(const, Literal):
+                return Literal(const.raw, inferred_type=const.inferred_type)
+            return e
+        if isinstance(e, BinOp):
+            return self._binop(e)
+        if isinstance(e, UnaryOp):
+            e.operand = self.expr(e.operand)
+            value = _const_value(e.operand)
+            if value is NOT_CONST:
+                return e
+            if e.op == "not" and isinstance(value, bool):
+                return _make_literal(not value)
+            if e.op == "-" and not isinstance(value, bool):
+                return _make_literal(-value) or e
+            return e
+        if isinstance(e, FStringLiteral):
+            return self._fstring(e)
+        if _fields(type(e)) is not None:
+            self._children(e)
+        return e
+
+    def _binop(self, e: BinOp) -> Any:
+        e.left = self.expr(e.left)
+        e.right = self.expr(e.right)
+        a, b = _const_value(e.left), _const_value(e.right)
+        if e.op in ("and", "or"):
+            if isinstance(a, bool):
+                # `False and x` / `True or x` never evaluate x, in C either
+                return e.left if a == (e.op == "or") else e.right
+            return e
+        if e.op in ("==", "!=") and "str" in (getattr(e.left, "inferred_type", None),
+                                              getattr(e.right, "inferred_type", None)):
+            sa, sb = self._str_const(e.left), self._str_const(e.right)
+            if sa is None or sb is None:
+                return e
+            return _make_literal((sa == sb) == (e.op == "=="))
+        if a is NOT_CONST or b is NOT_CONST:
+            return e
+        if e.op in ("+", "-", "*", "/", "//", "%"):
+            value = _fold_arith(e.op, a, b)
+            return e if value is NOT_CONST else _make_literal(value) or e
+        if e.op in COMPARISONS:
+            return _make_literal(COMPARISONS[e.op](a, b))
+        return e
+
+    def _str_const(self, e: Any) -> Optional[str]:
+        """The text of a string literal or `str` constant global, else None."""
+        if isinstance(e, Identifier) and isinstance(self.consts.get(e.name), StringLiteral):
+            e = self.consts[e.name]
+        return e.value if isinstance(e, StringLiteral) else None
+
+    def _fstring(self, e: FStringLiteral) -> Any:
+        parts: list[FStringText | FStringExpr] = []
+        for part in e.parts:
+            if isinstance(part, FStringExpr):
+                inner = part.expr
+                if isinstance(inner, Identifier) and isinstance(self.consts.get(inner.name), StringLiteral):
+                    inner = self.consts[inner.name]
+                part.expr = self.expr(inner)
+                text = _fstring_text(part.expr) if part.format_spec is None else None
+                if text is None:
+                    parts.append(part)
+                    continue
+                part = FStringText(text)
+            if parts and isinstance(parts[-1], FStringText):
+                parts[-1] = FStringText(parts[-1].text + part.text)
+            else:
+                parts.append(part)
+        if all(isinstance(p, FStringText) for p in parts):
+            return StringLiteral("".join(p.text for p in parts), inferred_type="str")
+        e.parts = parts
+        return e
+
+
+def fold_constants(program: Program) -> Program:
+    """Run the constant folding pass over a type-checked `program`, in place."""
+    return ConstantFolder(program).run()
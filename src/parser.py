@@ -31,11 +31,13 @@ from lang_ast import (
     GlobalStmt,
     AssertStmt,
     RaiseStmt,
+    DelStmt,
     TryExceptStmt,
     ExceptBlock,
     CallExpr,
     AttributeExpr,
     IndexExpr,
+    SliceExpr,
     ListExpr,
     SetExpr,
     DictExpr,
@@ -58,16 +60,24 @@ class ParserError(Exception):
     pass
 
 
+# Tokens that can continue an expression, checked before trying each case so
+# the common "nothing follows" path costs one lookup
+POSTFIX_STARTS = (TokenType.LPAREN, TokenType.DOT, TokenType.LBRACKET)
+COMPARISON_STARTS = (
+    TokenType.EQ, TokenType.NOTEQ, TokenType.LT, TokenType.LTE, TokenType.GT, TokenType.GTE,
+    TokenType.IS, TokenType.IN, TokenType.NOT,
+)
+
+
 class Parser:
     def __init__(self, tokens: List[Token]):
-        self.comments: List[Comment] = [
-            Comment(t.value, t.line, t.column)
-            for t in tokens
-            if t.type == TokenType.COMMENT
-        ]
-        self.tokens: List[Token] = [
-            t for t in tokens if t.type not in (TokenType.COMMENT, TokenType.NL)
-        ]
+        self.comments: List[Comment] = []
+        self.tokens: List[Token] = []
+        for t in tokens:
+            if t.type is TokenType.COMMENT:
+                self.comments.append(Comment(t.value, t.line, t.column))
+            elif t.type is not TokenType.NL:
+                self.tokens.append(t)
         self.pos: int = 0
         self.loop_depth: int = 0      # > 0 → inside while/for
         self.fn_depth:   int = 0      # > 0 → inside def
@@ -77,15 +87,17 @@ class Parser:
         return self.tokens[self.pos]
 
     def advance(self) -> None:
-        if not self.at_end():
+        if self.tokens[self.pos].type is not TokenType.EOF:
             self.pos += 1
 
     def check(self, *types) -> bool:
-        return self.current().type in types
+        return self.tokens[self.pos].type in types
 
     def match(self, *types: TokenType) -> bool:
-        if self.current().type in types:
-            self.advance()
+        ttype = self.tokens[self.pos].type
+        if ttype in types:
+            if ttype is not TokenType.EOF:
+                self.pos += 1
             return True
         return False
 
@@ -101,14 +113,15 @@ class Parser:
         return tok
 
     def expect(self, type_: TokenType) -> Token:
-        tok = self.current()
-        if tok.type != type_:
+        tok = self.tokens[self.pos]
+        if tok.type is not type_:
             raise ParserError(f"Expected `{type_.name}`, got `{tok.type.name}` at line: {tok.line}, col: {tok.column}, token: `{tok.value}`")
-        self.advance()
+        if type_ is not TokenType.EOF:
+            self.pos += 1
         return tok
 
     def at_end(self) -> bool:
-        return self.current().type == TokenType.EOF
+        return self.tokens[self.pos].type is TokenType.EOF
 
     # ───────────────────────── entry‑point ─────────────────────────
 
@@ -271,8 +284,10 @@ class Parser:
           AttributeExpr ::= Expr "." Identifier
         - Indexing: expr[expr]
           IndexExpr ::= Expr "[" Expr "]"
+        - Slicing: expr[a:b], either bound optional
+          SliceExpr ::= Expr "[" [Expr] ":" [Expr] "]"
         """
-        while True:
+        while self.tokens[self.pos].type in POSTFIX_STARTS:
             if self.match(TokenType.LPAREN):
                 args = []
                 if not self.check(TokenType.RPAREN):
@@ -287,12 +302,14 @@ class Parser:
                 expr = AttributeExpr(obj=expr, attr=attr_token.value)
 
             elif self.match(TokenType.LBRACKET):
-                index = self.parse_expr()
-                self.expect(TokenType.RBRACKET)
-                expr = IndexExpr(base=expr, index=index)
-
-            else:
-                break
+                index = None if self.check(TokenType.COLON) else self.parse_expr()
+                if self.match(TokenType.COLON):
+                    stop = None if self.check(TokenType.RBRACKET) else self.parse_expr()
+                    self.expect(TokenType.RBRACKET)
+                    expr = SliceExpr(base=expr, start=index, stop=stop)
+                else:
+                    self.expect(TokenType.RBRACKET)
+                    expr = IndexExpr(base=expr, index=index)
 
         return expr
 
@@ -431,15 +448,19 @@ class Parser:
             a != b
             a < b
             a is b
+            k in d
+            k not in d
             1 < x < 10
 
         Grammar fragment::
 
-            Comparison ::= ArithExpr ( ("==" | "!=" | "<" | "<=" | ">" | ">=" | "is" | "is not") ArithExpr )*
+            Comparison ::= ArithExpr ( ("==" | "!=" | "<" | "<=" | ">" | ">=" | "is" | "is not" | "in" | "not in") ArithExpr )*
 
         AST target: nested ``BinOp`` expressions combined with ``and`` for chained comparisons.
         """
         left = self.parse_arith_expr()
+        if self.tokens[self.pos].type not in COMPARISON_STARTS:
+            return left
 
         ops: list[str] = []
         comparators: list[Expr] = [left]
@@ -449,6 +470,10 @@ class Parser:
                 self.advance()  # 'is'
                 self.advance()  # 'not'
                 ops.append("is not")
+            elif self.current().type == TokenType.NOT and self.peek().type == TokenType.IN:
+                self.advance()  # 'not'
+                self.advance()  # 'in'
+                ops.append("not in")
             elif self.current().type in (
                 TokenType.EQ,
                 TokenType.NOTEQ,
@@ -457,6 +482,7 @@ class Parser:
                 TokenType.GT,
                 TokenType.GTE,
                 TokenType.IS,
+                TokenType.IN,
             ):
                 op_token = self.current()
                 self.advance()
@@ -559,7 +585,7 @@ class Parser:
         if tok.type in (TokenType.IMPORT, TokenType.FROM):
             return self.parse_import_stmt()
 
-        if tok.type == TokenType.CLASS:
+        if tok.type in (TokenType.CLASS, TokenType.AT):
             return self.parse_class_def()
 
         if tok.type == TokenType.DEF:
@@ -577,6 +603,9 @@ class Parser:
         if tok.type == TokenType.RAISE:
             return self.parse_raise_stmt()
 
+        if tok.type == TokenType.DEL:
+            return self.parse_del_stmt()
+
         if tok.type == TokenType.TRY:
             return self.parse_try_except_stmt()
 
@@ -799,11 +828,14 @@ class Parser:
         """Parse a for-in loop
 
         Grammar fragment:
-        ForStmt ::= \"for\" Identifier \"in\" Expression \":\" NEWLINE INDENT { Statement } DEDENT
-        AST target: ForStmt(var, iterable, body)
+        ForStmt ::= \"for\" Identifier { \",\" Identifier } \"in\" Expression \":\" NEWLINE INDENT { Statement } DEDENT
+        AST target: ForStmt(var, iterable, body, extra_vars=[...])
         """
         self.expect(TokenType.FOR)
         var = self.expect(TokenType.IDENTIFIER).value
+        extra_vars: List[str] = []
+        while self.match(TokenType.COMMA):
+            extra_vars.append(self.expect(TokenType.IDENTIFIER).value)
         self.expect(TokenType.IN)
         iterable = self.parse_expr()
         self.expect(TokenType.COLON)
@@ -823,7 +855,7 @@ class Parser:
             body.append(self.parse_statement())
         self.loop_depth -= 1
 
-        return ForStmt(var, iterable, body)
+        return ForStmt(var, iterable, body, extra_vars=extra_vars)
 
     def parse_break_stmt(self) -> BreakStmt:
         """Parse a break statement
@@ -984,10 +1016,20 @@ class Parser:
         """Parse a class definition with optional single inheritance
 
         Grammar:
-        ClassDef ::= "class" Identifier [ "(" Identifier ")" ] ":" NEWLINE INDENT { Statement } DEDENT
+        ClassDef ::= { "@" Identifier NEWLINE }
+                     "class" Identifier [ "(" Identifier ")" ] ":" NEWLINE INDENT { Statement } DEDENT
 
-        AST: ClassDef(name, base, fields, methods)
+        AST: ClassDef(name, base, fields, methods, decorators)
         """
+        decorators: List[str] = []
+        while self.match(TokenType.AT):
+            decorators.append(self.expect(TokenType.IDENTIFIER).value)
+            self.expect(TokenType.NEWLINE)
+            while self.match(TokenType.NEWLINE):
+                pass
+        if decorators and not self.check(TokenType.CLASS):
+            tok = self.current()
+            raise ParserError(f"Decorators are only supported on classes at line: {tok.line}, col: {tok.column}")
         self.expect(TokenType.CLASS)
         name = self.expect(TokenType.IDENTIFIER).value
 
@@ -1028,7 +1070,7 @@ class Parser:
         if not (fields or methods or is_empty_with_pass):
             raise ParserError(f"class '{name}' has no body (line {self.current().line})")
 
-        return ClassDef(name, base, fields, methods)
+        return ClassDef(name, base, fields, methods, decorators)
 
     def parse_global_stmt(self) -> GlobalStmt:
         """Parse a global declaration statement
@@ -1076,6 +1118,18 @@ class Parser:
         self.expect(TokenType.NEWLINE)
         return RaiseStmt(expr)
 
+    def parse_del_stmt(self) -> DelStmt:
+        """Parse a del statement
+
+        Grammar:
+        DelStmt ::= "del" Expr NEWLINE
+        AST: DelStmt(target)
+        """
+        self.expect(TokenType.DEL)
+        target = self.parse_expr()
+        self.expect(TokenType.NEWLINE)
+        return DelStmt(target)
+
     def parse_try_except_stmt(self) -> TryExceptStmt:
         """Parse a try/except statement
 
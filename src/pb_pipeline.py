@@ -4,28 +4,47 @@ from lexer import Lexer, LexerError
 from parser import Parser, ParserError
 from type_checker import TypeChecker, TypeError
 from codegen import CodeGen
+from optimizer import fold_constants
 from lang_ast import ImportStmt, ImportFromStmt, ImportAlias, Program, Stmt
 from module_loader import load_module, ModuleNotFoundError
 from module_loader import get_std_vendor_paths, is_native_binding
 
 
-def process_imports(ast: Program, pb_path: str, verbose: bool = False):
+def entry_search_paths(pb_path: str) -> list[str]:
+    """Import search paths of an entry module: stdlib, vendor, its own dir."""
+    return get_std_vendor_paths() + [os.path.dirname(os.path.abspath(pb_path))]
+
+
+def process_imports(ast: Program, pb_path: str, verbose: bool = False, cache=None,
+                    deps: list | None = None, loaded_modules: dict | None = None):
     """
     Resolves import statements in the AST and returns:
         - a TypeChecker with registered modules
         - a loaded_modules dict
+    With a build cache, every import probe is appended to `deps` as
+    (name, key or None), the form ModuleCache.store expects. Pass the
+    `loaded_modules` of an earlier pass in the same build so the modules it
+    already loaded are not loaded and checked again.
     """
-    loaded_modules = {}
+    loaded_modules = {} if loaded_modules is None else loaded_modules
     checker = TypeChecker()
-    entry_dir = os.path.dirname(os.path.abspath(pb_path))
-    search_paths = get_std_vendor_paths() + [entry_dir]
+    search_paths = entry_search_paths(pb_path)
     expanded: list[Stmt] = []
 
+    def load(name: list[str]):
+        try:
+            sym = load_module(name, search_paths, loaded_modules, verbose, cache)
+        except ModuleNotFoundError:
+            if deps is not None: deps.append((name, None))
+            raise
+        if deps is not None: deps.append((name, sym.cache_key))
+        return sym
+
     for stmt in getattr(ast, "body", []):
         if isinstance(stmt, ImportFromStmt) and not stmt.is_wildcard:
             for alias_obj in stmt.names or []:
                 try:
-                    load_module(stmt.module + [alias_obj.name], search_paths, loaded_modules, verbose)
+                    load(stmt.module + [alias_obj.name])
                 except ModuleNotFoundError:
                     expanded.append(ImportFromStmt(module=stmt.module[:], names=[alias_obj], is_wildcard=False, loc=stmt.loc))
                 else:
@@ -38,30 +57,34 @@ def process_imports(ast: Program, pb_path: str, verbose: bool = False):
     for stmt in getattr(ast, "body", []):
         if isinstance(stmt, ImportStmt):
             alias = stmt.alias or ".".join(stmt.module)
-            mod_symbol = load_module(stmt.module, search_paths, loaded_modules, verbose)
+            mod_symbol = load(stmt.module)
             if verbose:
                 print(f"Registering module '{alias}' with exports: {mod_symbol.exports}")
             checker.modules[alias] = mod_symbol
         elif isinstance(stmt, ImportFromStmt):
             mod_symbol = None
             if stmt.is_wildcard:
-                mod_symbol = load_module(stmt.module, search_paths, loaded_modules, verbose)
+                mod_symbol = load(stmt.module)
+                checker.imported_modules[mod_symbol.name] = mod_symbol
                 for name, kind in mod_symbol.exports.items():
                     if kind == "function" and name in mod_symbol.functions:
                         checker.functions[name] = mod_symbol.functions[name]
                         checker.native_functions[name] = mod_symbol.native_binding
                     else:
                         checker.env[name] = kind
+                        if kind not in ("function", "class"):
+                            checker.imported_globals[name] = mod_symbol.name
                 stmt.names = [ImportAlias(n) for n in mod_symbol.exports.keys()]
             else:
                 for alias_obj in stmt.names or []:
                     name = alias_obj.name
                     asname = alias_obj.asname or name
                     try:
-                        sub_mod = load_module(stmt.module + [name], search_paths, loaded_modules, verbose)
+                        sub_mod = load(stmt.module + [name])
                     except ModuleNotFoundError:
                         if mod_symbol is None:
-                            mod_symbol = load_module(stmt.module, search_paths, loaded_modules, verbose)
+                            mod_symbol = load(stmt.module)
+                            checker.imported_modules[mod_symbol.name] = mod_symbol
                         if name not in mod_symbol.exports:
                             raise ModuleNotFoundError(
                                 f"Module '{'.'.join(stmt.module)}' has no export '{name}'"
@@ -72,6 +95,8 @@ def process_imports(ast: Program, pb_path: str, verbose: bool = False):
                             checker.native_functions[asname] = mod_symbol.native_binding
                         else:
                             checker.env[asname] = kind
+                            if kind not in ("function", "class"):
+                                checker.imported_globals[asname] = mod_symbol.name
                     else:
                         checker.modules[asname] = sub_mod
 
@@ -86,8 +111,23 @@ def compile_code_to_ast(
     pretty_print_code=None, 
     pprint=None,
     import_support: bool = True,
-    pb_path: str | None= None
+    pb_path: str | None= None,
+    cache=None
 ) -> tuple[Program | None, dict]:
+    use_cache = cache is not None and import_support and pb_path is not None
+    # Shared by the cache check and process_imports: each module loads once per build
+    loaded_modules: dict = {}
+    if use_cache:
+        search_paths = entry_search_paths(pb_path)
+        hit = cache.lookup(
+            pb_path, source_code, module_name,
+            lambda dep: load_module(dep, search_paths, loaded_modules, verbose, cache).cache_key,
+        )
+        if hit is not None:
+            ast = hit[1]
+            ast.cache_key = hit[0]
+            return ast, loaded_modules
+
     lexer = Lexer(source_code)
     tokens = lexer.tokenize()
     if debug and pprint:
@@ -99,19 +139,20 @@ def compile_code_to_ast(
         print("PARSER AST:\n"); pprint(ast); print(f"{'-'*80}\n")
 
     checker = TypeChecker(native_module=is_native_binding(pb_path) if pb_path else False)
-    loaded_modules = {}
+    deps: list = []
 
     if import_support and pb_path is not None:
-        checker, loaded_modules = process_imports(ast, pb_path, verbose=verbose)
-    else:
-        checker = TypeChecker(native_module=is_native_binding(pb_path) if pb_path else False)
-        loaded_modules = {}
+        checker, loaded_modules = process_imports(ast, pb_path, verbose=verbose, cache=cache if use_cache else None,
+                                                  deps=deps, loaded_modules=loaded_modules)
 
     checker.check(ast)
+    fold_constants(ast)
     if debug and pprint:
         print("TYPED ENRICHED AST:\n"); pprint(ast); print(f"{'-'*80}\n")
 
     ast.module_name = module_name
+    if use_cache:
+        ast.cache_key = cache.store(pb_path, source_code, module_name, deps, ast)
     return ast, loaded_modules
 
 def compile_code_to_c_and_h(
@@ -122,21 +163,39 @@ def compile_code_to_c_and_h(
     pretty_print_code=None,
     pprint=None,
     import_support: bool = True,
-    pb_path: str | None = None
+    pb_path: str | None = None,
+    arena_scope: str | None = None,
+    cache=None,
+    unchecked: bool = False,
+    instrument: bool = False
 ) -> tuple[str | None, str | None, Program | None, dict]:
     ast, loaded_modules = compile_code_to_ast(
-        source_code, module_name, debug, verbose, pretty_print_code, pprint, import_support, pb_path
+        source_code, module_name, debug, verbose, pretty_print_code, pprint, import_support, pb_path, cache
     )
     if ast is None:
         return None, None, None, loaded_modules
     if pb_path and is_native_binding(pb_path):
         # Skip code generation for native bindings
         return None, None, ast, loaded_modules
-    codegen = CodeGen()
-    h_code = codegen.generate_header(ast)
-    c_code = codegen.generate(ast)
+    h_code, c_code = generate_c_and_h(ast, arena_scope, cache, ast.cache_key, unchecked=unchecked,
+                                      instrument=instrument)
     if debug and pretty_print_code:
         print("PB CODE:\n"); pretty_print_code(source_code, "py"); print(f"{'-'*80}\n")
         print(f"H CODE: {module_name}.h\n"); pretty_print_code(h_code, "c"); print(f"{'-'*80}\n")
         print(f"C CODE: {module_name}.c\n"); pretty_print_code(c_code, "c"); print(f"{'-'*80}\n")
     return h_code, c_code, ast, loaded_modules
+
+
+def generate_c_and_h(program: Program, arena_scope: str | None = None, cache=None,
+                     key: str | None = None, unchecked: bool = False,
+                     instrument: bool = False) -> tuple[str, str]:
+    """Run codegen for `program`, reusing output cached under its module key."""
+    options = f"arena={arena_scope};unchecked={unchecked};instrument={instrument}"
+    if cache is not None and (cached := cache.generated(key, options)) is not None:
+        return cached
+    codegen = CodeGen(arena_scope=arena_scope, unchecked=unchecked, instrument=instrument)
+    h_code = codegen.generate_header(program)
+    c_code = codegen.generate(program)
+    if cache is not None:
+        cache.store_generated(key, options, h_code, c_code)
+    return h_code, c_code
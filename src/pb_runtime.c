@@ -1,87 +1,662 @@
+/* POSIX file APIs (fileno, fstat, mmap) for the file section; the rest
+ * of the runtime is plain C99. */
+#if !defined(_WIN32) && !defined(_DEFAULT_SOURCE)
+#define _DEFAULT_SOURCE
+#endif
+
 #include "pb_runtime.h"
 
-/* Utility: portable strdup replacement */
+#if defined(__unix__) || defined(__APPLE__)
+#include <errno.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#if !defined(MAP_ANONYMOUS) && defined(MAP_ANON)
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+#define PB_HAVE_MMAP 1
+#define PB_HAVE_PTHREAD 1
+#endif
+
+/* ------------ SHARED STATE ------------- */
+
+/* Almost all runtime state is per thread (PB_THREAD_LOCAL). What is left
+ * is shared by every thread: the list of files with buffered writes and
+ * the one-time at-exit registration, both guarded here.                */
+#if PB_HAVE_PTHREAD
+static pthread_mutex_t pb_shared_lock = PTHREAD_MUTEX_INITIALIZER;
+#define PB_SHARED_LOCK()   pthread_mutex_lock(&pb_shared_lock)
+#define PB_SHARED_UNLOCK() pthread_mutex_unlock(&pb_shared_lock)
+#else
+#define PB_SHARED_LOCK()   ((void)0)
+#define PB_SHARED_UNLOCK() ((void)0)
+#endif
+
+static void pb_flush_all_files(void);
+
+static void pb_exit_flush(void) {
+    pb_flush_all_files();
+    pb_out_flush();   /* only the exiting thread's buffer; see pb_thread_exit */
+}
+
+static void pb_register_exit_flush(void) {
+    static bool registered = false;
+    PB_SHARED_LOCK();
+    if (!registered) registered = atexit(pb_exit_flush) == 0;
+    PB_SHARED_UNLOCK();
+}
+
+/* Utility: portable strdup replacement, backed by the current arena */
 static char *pb_strdup(const char *s) {
-    size_t len = strlen(s);
-    char *copy = malloc(len + 1);
-    if (!copy) {
-        pb_fail("Out of memory in pb_strdup");
+    return pb_arena_strdup(pb_current_arena, s);
+}
+
+/* ------------ OUTPUT ------------- */
+
+static PB_THREAD_LOCAL char *pb_out_buf = NULL;
+static PB_THREAD_LOCAL size_t pb_out_len = 0;
+static PB_THREAD_LOCAL bool pb_out_ready = false;
+static PB_THREAD_LOCAL bool pb_out_lines = false;
+
+// First write on this thread: allocate its buffer, register the at-exit
+// flush and read PB_LINE_BUFFERED.
+static void pb_out_setup(void) {
+    pb_out_buf = malloc(PB_OUT_BUF_SIZE);
+    if (!pb_out_buf) pb_fail("Failed to allocate the output buffer");
+    pb_out_ready = true;
+    pb_register_exit_flush();
+    const char *env = getenv("PB_LINE_BUFFERED");
+    if (env && *env && strcmp(env, "0") != 0) pb_out_lines = true;
+}
+
+// Make room for `n` more bytes; false if the request exceeds the buffer.
+static inline bool pb_out_reserve(size_t n) {
+    if (!pb_out_ready) pb_out_setup();
+    if (PB_OUT_BUF_SIZE - pb_out_len >= n) return true;
+    pb_out_flush();
+    return n <= PB_OUT_BUF_SIZE;
+}
+
+void pb_out_flush(void) {
+    if (pb_out_len > 0) {
+        fwrite(pb_out_buf, 1, pb_out_len, stdout);
+        pb_out_len = 0;
     }
-    memcpy(copy, s, len + 1);
-    return copy;
+    fflush(stdout);
+}
+
+void pb_out_set_line_buffered(bool on) {
+    if (!pb_out_ready) pb_out_setup();
+    pb_out_lines = on;
+}
+
+void pb_out_write(const char *s, size_t n) {
+    if (!pb_out_reserve(n)) {
+        fwrite(s, 1, n, stdout);      // larger than the whole buffer
+        return;
+    }
+    memcpy(pb_out_buf + pb_out_len, s, n);
+    pb_out_len += n;
+}
+
+void pb_out_str(const char *s) { pb_out_write(s, strlen(s)); }
+
+void pb_out_char(char c) {
+    pb_out_reserve(1);
+    pb_out_buf[pb_out_len++] = c;
+}
+
+void pb_out_int(int64_t x) {
+    pb_out_reserve(PB_FMT_BUF);
+    pb_out_len += pb_format_int_to(pb_out_buf + pb_out_len, x);
+}
+
+void pb_out_double(double x) {
+    pb_out_reserve(PB_FMT_BUF);
+    pb_out_len += pb_format_double_to(pb_out_buf + pb_out_len, x);
+}
+
+// End of a printed line: the only point where line mode flushes.
+static inline void pb_out_endline(void) {
+    pb_out_char('\n');
+    if (pb_out_lines) pb_out_flush();
 }
 
 /* ------------ PRINT ------------- */
 
-// PRId64 is a format macro from the C standard header <inttypes.h>
-void pb_print_int(int64_t x)   { printf("%" PRId64 "\n", x); }
-void pb_print_double(double x)
-{
-    if (x == (int64_t)x) {
-        printf("%.1f\n", x);  // 50.0 (preserve .0)
+void pb_print_int(int64_t x)    { pb_out_int(x); pb_out_endline(); }
+void pb_print_double(double x)  { pb_out_double(x); pb_out_endline(); }
+void pb_print_str(const char *s){ pb_out_str(s); pb_out_endline(); }
+void pb_print_bool(bool b)      { pb_out_str(b ? "True" : "False"); pb_out_endline(); }
+
+// Formats straight into the output buffer; only text longer than the
+// whole buffer goes through a temporary allocation.
+void pb_print_fmt(const char *fmt, ...) {
+    va_list ap, ap2;
+    va_start(ap, fmt);
+    va_copy(ap2, ap);
+    pb_out_reserve(1);
+    size_t room = PB_OUT_BUF_SIZE - pb_out_len;
+    int n = vsnprintf(pb_out_buf + pb_out_len, room, fmt, ap);
+    va_end(ap);
+    if (n < 0) {
+        va_end(ap2);
+        pb_fail("pb_print_fmt: formatting failed");
+    }
+    if ((size_t)n < room) {
+        pb_out_len += (size_t)n;
+    } else if (pb_out_reserve((size_t)n + 1)) {
+        vsnprintf(pb_out_buf + pb_out_len, (size_t)n + 1, fmt, ap2);
+        pb_out_len += (size_t)n;
     } else {
-        printf("%.15g\n", x); // Python-like float precision
+        char *tmp = malloc((size_t)n + 1);
+        if (!tmp) pb_fail("Out of memory in pb_print_fmt");
+        vsnprintf(tmp, (size_t)n + 1, fmt, ap2);
+        pb_out_write(tmp, (size_t)n);
+        free(tmp);
     }
+    va_end(ap2);
+    pb_out_endline();
 }
-void pb_print_str(const char *s){ printf("%s\n", s); }
-void pb_print_bool(bool b)     { printf("%s\n", b ? "True" : "False"); }
-
-const char *pb_format_double(double x) {
-    static char bufs[4][32];
-    static int i = 0;
-    i = (i + 1) % 4;
 
-    if (x == (int64_t)x) {
-        snprintf(bufs[i], sizeof(bufs[i]), "%.1f", x);  // 50.0 (preserve .0)
+static const char pb_digit_pairs[201] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+    "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+// Decimal conversion two digits at a time, written back-to-front.
+size_t pb_format_int_to(char *buf, int64_t x) {
+    char tmp[PB_FMT_BUF];
+    char *p = tmp + sizeof(tmp);
+    uint64_t v = x < 0 ? 0 - (uint64_t)x : (uint64_t)x;
+
+    while (v >= 100) {
+        unsigned d = (unsigned)(v % 100) * 2;
+        v /= 100;
+        *--p = pb_digit_pairs[d + 1];
+        *--p = pb_digit_pairs[d];
+    }
+    if (v >= 10) {
+        unsigned d = (unsigned)v * 2;
+        *--p = pb_digit_pairs[d + 1];
+        *--p = pb_digit_pairs[d];
     } else {
-        snprintf(bufs[i], sizeof(bufs[i]), "%.15g", x); // Python-like float precision
+        *--p = (char)('0' + v);
     }
+    if (x < 0) *--p = '-';
 
-    return bufs[i];
+    size_t n = (size_t)(tmp + sizeof(tmp) - p);
+    memcpy(buf, p, n);
+    buf[n] = '\0';
+    return n;
 }
 
-const char *pb_format_int(int64_t x) {
-    static char bufs[4][32];
-    static int i = 0;
-    i = (i + 1) % 4;
+// Python repr() of a float: the shortest digit string that reads back to
+// the same double, in fixed notation for 1e-4 <= |x| < 1e16 and
+// exponent notation ("1e+16", "2.5e-05") otherwise.
+size_t pb_format_double_to(char *buf, double x) {
+    if (x != x) { memcpy(buf, "nan", 4); return 3; }
+    if (x - x != 0) {
+        if (x > 0) { memcpy(buf, "inf", 4); return 3; }
+        memcpy(buf, "-inf", 5); return 4;
+    }
 
-    snprintf(bufs[i], sizeof(bufs[i]), "%" PRId64, x);
-    return bufs[i];
-}
+    // Integral values below 1e16 print as the integer plus ".0"
+    if (x > -1e16 && x < 1e16 && x == (double)(int64_t)x) {
+        size_t n;
+        if (x == 0 && 1 / x < 0) { buf[0] = '-'; buf[1] = '0'; n = 2; }
+        else n = pb_format_int_to(buf, (int64_t)x);
+        memcpy(buf + n, ".0", 3);
+        return n + 2;
+    }
 
-const char *pb_format_hex(int64_t x) {
-    static char bufs[4][32];
-    static int i = 0;
-    i = (i + 1) % 4;
+    // Short decimals (x * 10^k integral, at most 15 significant digits):
+    // a candidate that divides back to x exactly is the unique 15-digit
+    // match, so it is also the shortest. Print it as a scaled integer.
+    double ax = x < 0 ? -x : x;
+    if (ax >= 1e-4 && ax < 1e15) {
+        static const double pow10[] = { 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8 };
+        for (int k = 0; k < 8; ++k) {
+            double m = ax * pow10[k];
+            if (m >= 1e15) break;
+            if (m != (double)(int64_t)m || m / pow10[k] != ax) continue;
+            char digits[PB_FMT_BUF];
+            int nd = (int)pb_format_int_to(digits, (int64_t)m);
+            int frac = k + 1;
+            while (frac > 1 && digits[nd - 1] == '0') { --nd; --frac; }
+            char *p = buf;
+            if (x < 0) *p++ = '-';
+            if (nd <= frac) {
+                *p++ = '0';
+                *p++ = '.';
+                for (int i = nd; i < frac; ++i) *p++ = '0';
+                memcpy(p, digits, (size_t)nd);
+                p += nd;
+            } else {
+                memcpy(p, digits, (size_t)(nd - frac));
+                p += nd - frac;
+                *p++ = '.';
+                memcpy(p, digits + nd - frac, (size_t)frac);
+                p += frac;
+            }
+            *p = '\0';
+            return (size_t)(p - buf);
+        }
+    }
+
+    // 15 significant digits always round-trip when the value has a short
+    // representation; 17 are always enough. Subnormals carry less
+    // precision, so their search starts at a single digit.
+    char sci[PB_FMT_BUF];
+    bool subnormal = x > -2.2250738585072014e-308 && x < 2.2250738585072014e-308;
+    for (int prec = subnormal ? 0 : 14; prec <= 16; ++prec) {
+        snprintf(sci, sizeof(sci), "%.*e", prec, x);
+        if (prec == 16 || strtod(sci, NULL) == x) break;
+    }
 
+    // sci is "[-]d.ddddde[+-]XX": split into sign, digits and exponent
+    const char *s = sci;
+    bool neg = *s == '-';
+    if (neg) ++s;
+    char digits[20];
+    int nd = 0;
+    for (; *s != 'e'; ++s)
+        if (*s != '.') digits[nd++] = *s;
+    int exp10 = atoi(s + 1);
+    while (nd > 1 && digits[nd - 1] == '0') --nd;
+
+    char *p = buf;
+    if (neg) *p++ = '-';
+    if (exp10 < -4 || exp10 >= 16) {
+        *p++ = digits[0];
+        if (nd > 1) {
+            *p++ = '.';
+            memcpy(p, digits + 1, (size_t)nd - 1);
+            p += nd - 1;
+        }
+        p += sprintf(p, "e%c%02d", exp10 < 0 ? '-' : '+', exp10 < 0 ? -exp10 : exp10);
+    } else if (exp10 < 0) {
+        *p++ = '0';
+        *p++ = '.';
+        for (int i = -1; i > exp10; --i) *p++ = '0';
+        memcpy(p, digits, (size_t)nd);
+        p += nd;
+        *p = '\0';
+    } else {
+        for (int i = 0; i <= exp10 || i < nd; ++i) {
+            if (i == exp10 + 1) *p++ = '.';
+            *p++ = i < nd ? digits[i] : '0';
+        }
+        if (nd <= exp10 + 1) { *p++ = '.'; *p++ = '0'; }
+        *p = '\0';
+    }
+    return (size_t)(p - buf);
+}
+
+size_t pb_format_hex_to(char *buf, int64_t x) {
     if (x < 0) {
         uint32_t val = (uint32_t)(-x);
-        snprintf(bufs[i], sizeof(bufs[i]), "-0x%08" PRIx32, val);
-    } else {
-        uint32_t val = (uint32_t)x;
-        snprintf(bufs[i], sizeof(bufs[i]), "0x%08" PRIx32, val);
+        return (size_t)snprintf(buf, PB_FMT_BUF, "-0x%08" PRIx32, val);
     }
-    return bufs[i];
+    return (size_t)snprintf(buf, PB_FMT_BUF, "0x%08" PRIx32, (uint32_t)x);
+}
+
+// Arena-backed variants: every call returns its own exact-size string,
+// so any number of them can be live at once (f-strings, str(), hex()).
+static const char *pb_format_copy(const char *buf, size_t n) {
+    char *out = pb_arena_alloc(pb_current_arena, n + 1);
+    memcpy(out, buf, n + 1);
+    return out;
+}
+
+const char *pb_format_double(double x) {
+    char buf[PB_FMT_BUF];
+    return pb_format_copy(buf, pb_format_double_to(buf, x));
+}
+
+const char *pb_format_int(int64_t x) {
+    char buf[PB_FMT_BUF];
+    return pb_format_copy(buf, pb_format_int_to(buf, x));
+}
+
+const char *pb_format_hex(int64_t x) {
+    char buf[PB_FMT_BUF];
+    return pb_format_copy(buf, pb_format_hex_to(buf, x));
 }
 
 
 /* ------------ ERROR HANDLING ------------- */
 
-// Immediately exit the program with an error message.
-// Used for unrecoverable internal or memory-related errors.
-void pb_fail(const char *msg) {
+static PB_THREAD_LOCAL PbFailHandler pb_fail_handler = NULL;
+
+void pb_set_fail_handler(PbFailHandler handler) {
+    pb_fail_handler = handler;
+}
+
+// Immediately exit the program with an error message, unless this thread
+// installed a handler. Used for unrecoverable internal or memory-related
+// errors and for uncaught exceptions.
+PB_NORETURN void pb_fail(const char *msg) {
+    pb_out_flush();
+    if (pb_fail_handler) pb_fail_handler(msg);
     fprintf(stderr, "%s\n", msg);
     exit(EXIT_FAILURE);
 }
 
+/* ------------ THREADS ------------- */
+
+void pb_thread_exit(void) {
+    pb_out_flush();
+    free(pb_out_buf);
+    pb_out_buf = NULL;
+    pb_out_ready = false;
+    pb_arena_free(&pb_thread_arena);
+}
+
+/* ------------ ARENA ------------- */
+
+struct PbArenaChunk {
+    PbArenaChunk *prev;
+    size_t size;            /* payload bytes */
+    size_t used;
+};
+
+/* Payload starts after the header, rounded up to the arena alignment. */
+#define PB_ARENA_HDR \
+    ((sizeof(PbArenaChunk) + PB_ARENA_ALIGN - 1) / PB_ARENA_ALIGN * PB_ARENA_ALIGN)
+#define PB_ARENA_PAYLOAD(c) ((char *)(c) + PB_ARENA_HDR)
+
+PB_THREAD_LOCAL PbArena pb_thread_arena = {NULL, NULL, PB_ARENA_CHUNK_SIZE};
+
+void pb_arena_init(PbArena *a, size_t chunk_size) {
+    a->head = NULL;
+    a->spare = NULL;
+    a->chunk_size = chunk_size;
+}
+
+// Chain a fresh chunk with room for at least `size` bytes.
+static void pb_arena_grow(PbArena *a, size_t size) {
+    size_t regular = a->chunk_size ? a->chunk_size : PB_ARENA_CHUNK_SIZE;
+    PbArenaChunk *c;
+    if (a->spare && a->spare->size >= size) {
+        c = a->spare;
+        a->spare = NULL;
+    } else {
+        size_t payload = size > regular ? size : regular;
+        c = malloc(PB_ARENA_HDR + payload);
+        if (!c) pb_fail("Out of memory in pb_arena_alloc");
+        c->size = payload;
+    }
+    c->used = 0;
+    c->prev = a->head;
+    a->head = c;
+}
+
+void *pb_arena_alloc(PbArena *a, size_t size) {
+    size = (size + PB_ARENA_ALIGN - 1) & ~(size_t)(PB_ARENA_ALIGN - 1);
+    PbArenaChunk *c = a->head;
+    if (!c || c->size - c->used < size) {
+        pb_arena_grow(a, size);
+        c = a->head;
+    }
+    void *p = PB_ARENA_PAYLOAD(c) + c->used;
+    c->used += size;
+    return p;
+}
+
+char *pb_arena_strdup(PbArena *a, const char *s) {
+    size_t len = strlen(s);
+    char *copy = pb_arena_alloc(a, len + 1);
+    memcpy(copy, s, len + 1);
+    return copy;
+}
+
+PbArenaMark pb_arena_mark(const PbArena *a) {
+    PbArenaMark m = {a->head, a->head ? a->head->used : 0};
+    return m;
+}
+
+void pb_arena_reset(PbArena *a, PbArenaMark mark) {
+    while (a->head != mark.chunk) {
+        PbArenaChunk *c = a->head;
+        a->head = c->prev;
+        /* Keep one chunk around so a loop that allocates past a chunk
+         * boundary every iteration does not hit malloc each time.     */
+        if (!a->spare || c->size > a->spare->size) {
+            free(a->spare);
+            a->spare = c;
+        } else {
+            free(c);
+        }
+    }
+    if (a->head) a->head->used = mark.used;
+}
+
+void pb_arena_free(PbArena *a) {
+    PbArenaMark start = {NULL, 0};
+    pb_arena_reset(a, start);
+    free(a->spare);
+    a->spare = NULL;
+}
+
+/* ------------ OBJECT POOLS ------------- */
+
+PB_THREAD_LOCAL PbPool pb_pools[PB_POOL_MAX_SIZE / PB_POOL_GRANULE];
+
+// Start a fresh slab for `pool` and return its first `slot`-byte object;
+// the rest of the previous slab's tail is too small and stays unused.
+void *pb_pool_refill(PbPool *pool, size_t slot) {
+    char *slab = malloc(PB_POOL_SLAB_SIZE);
+    if (!slab) pb_fail("Out of memory in pb_obj_alloc");
+    pool->bump = slab + slot;
+    pool->end = slab + PB_POOL_SLAB_SIZE;
+    return slab;
+}
+
+void *pb_obj_alloc_large(size_t size) {
+    void *p = malloc(size);
+    if (!p) pb_fail("Out of memory in pb_obj_alloc");
+    return p;
+}
+
+// Give back the unused tail of the most recent allocation `p` (of
+// `size` bytes), keeping only `keep` bytes.
+static void pb_arena_shrink_last(PbArena *a, void *p, size_t size, size_t keep) {
+    PbArenaChunk *c = a->head;
+    if (!c) return;
+    size_t align = PB_ARENA_ALIGN - 1;
+    size_t start = (size_t)((char *)p - PB_ARENA_PAYLOAD(c));
+    if (((start + size + align) & ~align) == c->used) {
+        c->used = (start + keep + align) & ~align;
+    }
+}
+
+/* ------------ STRINGS ------------- */
+
+const char *pb_fstring(size_t size_hint, const char *fmt, ...) {
+    va_list ap;
+    size_t cap = size_hint + 1;
+    char *buf = pb_arena_alloc(pb_current_arena, cap);
+
+    va_start(ap, fmt);
+    int n = vsnprintf(buf, cap, fmt, ap);
+    va_end(ap);
+    if (n < 0) pb_fail("Invalid format in pb_fstring");
+
+    size_t need = (size_t)n + 1;
+    if (need <= cap) {
+        pb_arena_shrink_last(pb_current_arena, buf, cap, need);
+        return buf;
+    }
+
+    /* The estimate was short: format again into an exact-size block. */
+    pb_arena_shrink_last(pb_current_arena, buf, cap, 0);
+    buf = pb_arena_alloc(pb_current_arena, need);
+    va_start(ap, fmt);
+    vsnprintf(buf, need, fmt, ap);
+    va_end(ap);
+    return buf;
+}
+
+#define PB_CHAR1(c) {(char)(c), 0}
+#define PB_CHAR8(c) PB_CHAR1(c), PB_CHAR1((c) + 1), PB_CHAR1((c) + 2), PB_CHAR1((c) + 3), \
+                    PB_CHAR1((c) + 4), PB_CHAR1((c) + 5), PB_CHAR1((c) + 6), PB_CHAR1((c) + 7)
+#define PB_CHAR32(c) PB_CHAR8(c), PB_CHAR8((c) + 8), PB_CHAR8((c) + 16), PB_CHAR8((c) + 24)
+
+const char pb_ascii_chars[128][2] = {PB_CHAR32(0), PB_CHAR32(32), PB_CHAR32(64), PB_CHAR32(96)};
+
+const char *pb_str_next_utf8(const char **p) {
+    const unsigned char *s = (const unsigned char *)*p;
+    /* the lead byte gives the length; a stray continuation byte stands alone */
+    size_t n = s[0] >= 0xf0 ? 4 : s[0] >= 0xe0 ? 3 : s[0] >= 0xc0 ? 2 : 1;
+    size_t len = 1;
+    while (len < n && (s[len] & 0xc0) == 0x80) len++;
+    char *out = pb_arena_alloc(pb_current_arena, len + 1);
+    memcpy(out, s, len);
+    out[len] = '\0';
+    *p += len;
+    return out;
+}
+
+/* ------------ INTERNING ------------- */
+
+/* Open addressing over `pb_intern_cap` (a power of two) slots, at most half
+ * full; a NULL `str` marks an empty slot. Everything here is guarded by
+ * the shared lock.                                                    */
+typedef struct {
+    const char *str;
+    uint64_t hash;
+} PbInternSlot;
+
+static PbInternSlot *pb_intern_slots = NULL;
+static int64_t pb_intern_cap = 0, pb_intern_len = 0;
+static PbInternBlock *pb_intern_pending = NULL;   /* registered, not yet in the table */
+
+void pb_intern_register(PbInternBlock *block) {
+    PB_SHARED_LOCK();
+    block->next = pb_intern_pending;
+    pb_intern_pending = block;
+    PB_SHARED_UNLOCK();
+}
+
+/* The slot holding the text of `s`, or the empty slot where it belongs. */
+static PbInternSlot *pb_intern_find(const char *s, uint64_t hash) {
+    uint64_t mask = (uint64_t)pb_intern_cap - 1;
+    for (uint64_t i = hash & mask;; i = (i + 1) & mask) {
+        PbInternSlot *slot = &pb_intern_slots[i];
+        if (!slot->str || (slot->hash == hash && pb_str_eq(slot->str, s))) return slot;
+    }
+}
+
+static void pb_intern_grow(void) {
+    PbInternSlot *old = pb_intern_slots;
+    int64_t old_cap = pb_intern_cap;
+    pb_intern_cap = old_cap ? 2 * old_cap : 256;
+    pb_intern_slots = calloc((size_t)pb_intern_cap, sizeof *pb_intern_slots);
+    if (!pb_intern_slots) pb_fail("Failed to allocate the intern table");
+    for (int64_t i = 0; i < old_cap; ++i)
+        if (old[i].str) *pb_intern_find(old[i].str, old[i].hash) = old[i];
+    free(old);
+}
+
+/* The canonical pointer for `s`. New text is copied unless `is_static`,
+ * where `s` itself (a literal) becomes canonical.                      */
+static const char *pb_intern_add(const char *s, bool is_static) {
+    uint64_t hash = pb_hash_str(s);
+    if (2 * (pb_intern_len + 1) > pb_intern_cap) pb_intern_grow();
+    PbInternSlot *slot = pb_intern_find(s, hash);
+    if (!slot->str) {
+        if (!is_static) {
+            size_t size = strlen(s) + 1;
+            char *copy = malloc(size);
+            if (!copy) pb_fail("Failed to allocate an interned string");
+            s = memcpy(copy, s, size);
+        }
+        slot->str = s;
+        slot->hash = hash;
+        pb_intern_len++;
+    }
+    return slot->str;
+}
+
+const char *pb_intern(const char *s) {
+    PB_SHARED_LOCK();
+    for (PbInternBlock *b = pb_intern_pending; b; b = b->next)
+        for (int64_t i = 0; i < b->n; ++i) pb_intern_add(b->strs[i], true);
+    pb_intern_pending = NULL;
+    const char *out = pb_intern_add(s, false);
+    PB_SHARED_UNLOCK();
+    return out;
+}
+
+/* ------------ MODULE INIT ------------- */
+
+/* One lock serializes every module init. The thread holding it may start
+ * further inits from inside one (a module's globals calling into another
+ * module); `pb_init_depth` counts those so it neither relocks nor swaps
+ * arenas twice. While inits run, the thread's arena is the shared
+ * `pb_module_arena`, which is never reset.                            */
+#if PB_HAVE_PTHREAD
+static pthread_mutex_t pb_init_lock = PTHREAD_MUTEX_INITIALIZER;
+#define PB_INIT_LOCK()   pthread_mutex_lock(&pb_init_lock)
+#define PB_INIT_UNLOCK() pthread_mutex_unlock(&pb_init_lock)
+#else
+#define PB_INIT_LOCK()   ((void)0)
+#define PB_INIT_UNLOCK() ((void)0)
+#endif
+
+static PbArena pb_module_arena;
+static PB_THREAD_LOCAL int pb_init_depth = 0;
+
+void pb_module_init(PbModuleInit *m, void (*init)(void)) {
+    if (pb_init_depth == 0) PB_INIT_LOCK();
+    if (m->state == PB_MODULE_UNINIT) {
+        m->state = PB_MODULE_RUNNING;
+        PbArena caller = pb_thread_arena;
+        if (pb_init_depth++ == 0) pb_thread_arena = pb_module_arena;
+        init();
+        if (--pb_init_depth == 0) {
+            pb_module_arena = pb_thread_arena;
+            pb_thread_arena = caller;
+        }
+        __atomic_store_n(&m->state, PB_MODULE_READY, __ATOMIC_RELEASE);
+    }
+    if (pb_init_depth == 0) PB_INIT_UNLOCK();
+}
+
 /* ------------ EXCEPTION SUPPORT ------------- */
 
-PbTryContext *pb_current_try = NULL;             // Top of try context stack
-PbException pb_current_exc = {NULL, NULL};       // Current active exception
+PB_THREAD_LOCAL PbTryContext *pb_current_try = NULL;             // Top of try context stack
+PB_THREAD_LOCAL PbException pb_current_exc = {0, NULL, NULL, NULL};  // Current active exception
+PB_THREAD_LOCAL int pb_checked_depth = 0;
+PB_THREAD_LOCAL bool pb_exc_pending = false;
 
 #define PB_MAX_TRY_DEPTH 256
 
-int pb_try_depth = 0;
+static PB_THREAD_LOCAL int pb_try_depth = 0;
+
+/* Counter updates, compiled out unless PB_INSTRUMENT (see INSTRUMENTATION) */
+#ifdef PB_INSTRUMENT
+#define PB_STAT(x) x
+static void pb_prof_raise(const char *type);
+static void pb_prof_probe(uint64_t probes);
+static void pb_prof_list_grow(uint64_t bytes);
+static void pb_prof_try_depth(void);
+static void pb_prof_unwind(void);
+#else
+#define PB_STAT(x) ((void)0)
+#endif
+
+uint32_t pb_exc_id(const char *type) {
+    uint32_t h = 2166136261u;
+    for (const unsigned char *p = (const unsigned char *)type; *p; ++p) {
+        h ^= *p;
+        h *= 16777619u;
+    }
+    return h;
+}
 
 // Push a try context onto the stack
 void pb_push_try(PbTryContext *ctx) {
@@ -90,7 +665,9 @@ void pb_push_try(PbTryContext *ctx) {
         pb_fail("Maximum try depth exceeded");
     }
     ctx->prev = pb_current_try;
+    ctx->checked_depth = pb_checked_depth;
     pb_current_try = ctx;
+    PB_STAT(pb_prof_try_depth());
 }
 
 // Pop the top try context
@@ -100,98 +677,78 @@ void pb_pop_try(void) {
     pb_try_depth--;
 }
 
-void pb_raise_msg(const char *type, const char *msg)
-{
+static void pb_set_exc(const char *type, void *value, const char *msg) {
+    PB_STAT(pb_prof_raise(type));
+    pb_current_exc.id    = pb_exc_id(type);
     pb_current_exc.type  = type;
-    pb_current_exc.value = (void *)msg;       /* stored only for re-raise */
+    pb_current_exc.value = value;
+    pb_current_exc.msg   = msg;
+}
 
+// True if a checked handler was entered after the innermost setjmp one.
+static bool pb_checked_handler_is_innermost(void) {
+    return pb_checked_depth > (pb_current_try ? pb_current_try->checked_depth : 0);
+}
+
+// Jump to the innermost setjmp handler, or abort when there is none.
+PB_NORETURN static void pb_unwind(void) {
     if (pb_current_try) {
+        PB_STAT(pb_prof_unwind());
         PbTryContext *ctx = pb_current_try;
         pb_current_try    = ctx->prev;
+        pb_try_depth--;
         longjmp(ctx->env, 1);
     }
 
     /* Uncaught ⇒ abort the program with a readable message */
     char buf[512];
-    snprintf(buf, sizeof(buf), "%s: %s", type, msg);
+    if (pb_current_exc.msg)
+        snprintf(buf, sizeof(buf), "%s: %s", pb_current_exc.type, pb_current_exc.msg);
+    else
+        snprintf(buf, sizeof(buf), "Uncaught exception of type %s", pb_current_exc.type);
     pb_fail(buf);                             /* pb_fail must not return */
 }
 
-void pb_raise_obj(const char *type, void *obj)
-{
-    pb_current_exc.type  = type;
-    pb_current_exc.value = obj;
-
-    if (pb_current_try) {
-        PbTryContext *ctx = pb_current_try;
-        pb_current_try    = ctx->prev;
-        longjmp(ctx->env, 1);
+// Hand the current exception to the innermost handler.
+static void pb_dispatch_exc(void) {
+    if (pb_checked_handler_is_innermost()) {
+        pb_exc_pending = true;
+        return;
     }
+    pb_unwind();
+}
 
-    /* Uncaught ⇒ fetch msg from the struct’s first slot */
-    const char *msg = obj ? *((const char **)obj) : NULL;
-
-    char buf[512];
-    if (msg)
-        snprintf(buf, sizeof(buf), "%s: %s", type, msg);
-    else
-        snprintf(buf, sizeof(buf), "Uncaught exception of type %s", type);
+PB_NORETURN void pb_raise_msg(const char *type, const char *msg)
+{
+    pb_set_exc(type, (void *)msg, msg);
+    /* Code generated for checked handlers never reaches a runtime raise. */
+    if (PB_UNLIKELY(pb_checked_handler_is_innermost())) {
+        char buf[512];
+        snprintf(buf, sizeof(buf), "%s: %s (raised inside a checked try block)", type, msg);
+        pb_fail(buf);
+    }
+    pb_unwind();
+}
 
-    pb_fail(buf);
+void pb_throw_msg(const char *type, const char *msg)
+{
+    pb_set_exc(type, (void *)msg, msg);
+    pb_dispatch_exc();
 }
 
-/**
- * Raise a runtime exception of a given type with an optional value.
- *
- * This function triggers non-local control flow using setjmp/longjmp to
- * unwind to the nearest active try-except block. It should only be used
- * for recoverable, language-level exceptions (not internal runtime errors).
- *
- * If no try context is active, the exception is considered uncaught and the
- * program is terminated via pb_fail().
- *
- * @param type   A string identifying the exception type (e.g. "ValueError").
- * @param value  An optional payload (e.g. a string or struct pointer).
- */
-// void pb_raise(const char *type, void *value) {
-//     // consider to define known error types as global constants (e.g., extern const char *PB_EXC_IOERROR)
-//     // const char *PB_EXC_IOERROR = "IOError";
-//     // const char *PB_EXC_VALUEERROR = "ValueError";
-//     // and codegen would do: if (strcmp(pb_current_exc.type, PB_EXC_VALUEERROR) == 0)
-//     pb_current_exc.type = type;
-//     pb_current_exc.value = value;
-//     if (pb_current_try) {
-//         PbTryContext *ctx = pb_current_try;
-//         pb_current_try = ctx->prev;
-//         longjmp(ctx->env, 1);
-//     } else {
-//         const char *msg = NULL;
-
-//         /* Heuristic: if value looks like a C string, treat it as such   */
-//         if (value && strlen((const char *)value) < 256)
-//             msg = (const char *)value;
-
-//         /* Otherwise, assume an Exception-like struct whose first field
-//            is a const char *msg and read it through a generic pointer    */
-//         else if (value)
-//             msg = *((const char **)value);
-
-//         if (msg) {
-//             char buf[512];
-//             snprintf(buf, sizeof(buf), "%s: %s", type, msg);
-//             pb_fail(buf);
-//         } else {
-//             char buf[256];
-//             snprintf(buf, sizeof(buf), "Uncaught exception of type %s", type);
-//             pb_fail(buf);
-//         }
-//     }
-// }
+void pb_raise_obj(const char *type, void *obj)
+{
+    /* Uncaught ⇒ report the msg from the struct’s first slot */
+    pb_set_exc(type, obj, obj ? *((const char **)obj) : NULL);
+    pb_dispatch_exc();
+}
 
 // Clear the current exception state
 void pb_clear_exc(void) {
+    pb_current_exc.id = 0;
     pb_current_exc.type = NULL;
     pb_current_exc.value = NULL;
+    pb_current_exc.msg = NULL;
 }
 
 // Re-raise the current exception
@@ -199,44 +756,811 @@ void pb_reraise(void) {
     if (!pb_current_exc.type) {
         pb_fail("Cannot re-raise: no active exception");
     }
-    pb_raise_obj(pb_current_exc.type, pb_current_exc.value);
+    pb_dispatch_exc();
+}
+
+/* ------------ INSTRUMENTATION ------------- */
+
+#ifdef PB_INSTRUMENT
+
+#include <time.h>
+
+/* rdtsc where there is one, calibrated against the monotonic clock at
+ * exit; elsewhere the ticks are nanoseconds already.                  */
+static uint64_t pb_prof_clock_ns(void) {
+#if defined(__unix__) || defined(__APPLE__)
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+#else
+    return (uint64_t)((double)clock() * (1e9 / CLOCKS_PER_SEC));
+#endif
+}
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+static inline uint64_t pb_prof_ticks(void) { return __builtin_ia32_rdtsc(); }
+#else
+static inline uint64_t pb_prof_ticks(void) { return pb_prof_clock_ns(); }
+#endif
+
+#define PB_PROF_MAX_RAISE_TYPES 32
+
+/* A call on the timing stack. `try_depth` is the setjmp depth at entry:
+ * unwinding to a handler at depth d abandons every frame entered at d
+ * or deeper.                                                          */
+typedef struct {
+    PbProfFn *fn;
+    uint64_t start;
+    uint64_t child_ticks;
+    int try_depth;
+} PbProfFrame;
+
+typedef struct {
+    uint64_t list_grows, list_bytes;
+    uint64_t dict_lookups, dict_probes, dict_max_probe;
+    int try_high;
+    struct { const char *type; uint32_t id; uint64_t count; } raises[PB_PROF_MAX_RAISE_TYPES];
+    int raise_types;
+    uint64_t other_raises;
+} PbProfStats;
+
+static PB_THREAD_LOCAL PbProfStats pb_stats;
+static PB_THREAD_LOCAL PbProfFn *pb_prof_fns = NULL;
+static PB_THREAD_LOCAL PbProfFrame *pb_prof_stack = NULL;
+static PB_THREAD_LOCAL int64_t pb_prof_len = 0, pb_prof_cap = 0;
+static PB_THREAD_LOCAL uint64_t pb_prof_start_ticks, pb_prof_start_ns;
+
+/* Every thread that enters a timed function registers its counters, so
+ * the report at exit sums them all. Pool workers never exit, so their
+ * thread-locals outlive the report.                                   */
+typedef struct PbProfThread {
+    PbProfStats *stats;
+    PbProfFn **fns;
+    struct PbProfThread *next;
+} PbProfThread;
+static PbProfThread *pb_prof_threads = NULL;
+
+static void pb_prof_dump(void);
+
+static void pb_prof_grow(void) {
+    if (!pb_prof_stack) {
+        pb_prof_start_ns = pb_prof_clock_ns();
+        pb_prof_start_ticks = pb_prof_ticks();
+        static bool registered = false;
+        PbProfThread *t = malloc(sizeof *t);
+        if (!t) pb_fail("Failed to register the thread's profile");
+        t->stats = &pb_stats;
+        t->fns = &pb_prof_fns;
+        PB_SHARED_LOCK();
+        t->next = pb_prof_threads;
+        pb_prof_threads = t;
+        if (!registered) registered = atexit(pb_prof_dump) == 0;
+        PB_SHARED_UNLOCK();
+    }
+    pb_prof_cap = pb_prof_cap ? pb_prof_cap * 2 : 256;
+    PbProfFrame *grown = realloc(pb_prof_stack, (size_t)pb_prof_cap * sizeof *grown);
+    if (!grown) pb_fail("Failed to grow the profiling stack");
+    pb_prof_stack = grown;
+}
+
+void pb_prof_enter(PbProfFn *fn) {
+    if (PB_UNLIKELY(pb_prof_len == pb_prof_cap)) pb_prof_grow();
+    if (fn->calls++ == 0) {
+        fn->next = pb_prof_fns;
+        pb_prof_fns = fn;
+    }
+    fn->active++;
+    PbProfFrame *f = &pb_prof_stack[pb_prof_len++];
+    f->fn = fn;
+    f->child_ticks = 0;
+    f->try_depth = pb_try_depth;
+    f->start = pb_prof_ticks();
+}
+
+static void pb_prof_pop(uint64_t now) {
+    PbProfFrame *f = &pb_prof_stack[--pb_prof_len];
+    uint64_t spent = now - f->start;
+    f->fn->self_ticks += spent - f->child_ticks;
+    if (--f->fn->active == 0) f->fn->total_ticks += spent;
+    if (pb_prof_len > 0) pb_prof_stack[pb_prof_len - 1].child_ticks += spent;
+}
+
+void pb_prof_exit(void) {
+    pb_prof_pop(pb_prof_ticks());
+}
+
+// Close the frames a longjmp to the innermost handler is about to skip.
+static void pb_prof_unwind(void) {
+    uint64_t now = pb_prof_ticks();
+    while (pb_prof_len > 0 && pb_prof_stack[pb_prof_len - 1].try_depth >= pb_try_depth) pb_prof_pop(now);
+}
+
+static void pb_prof_try_depth(void) {
+    int depth = pb_try_depth + pb_checked_depth;
+    if (depth > pb_stats.try_high) pb_stats.try_high = depth;
+}
+
+void pb_prof_checked_try(void) {
+    pb_prof_try_depth();
+}
+
+static void pb_prof_count_raises(PbProfStats *s, const char *type, uint32_t id, uint64_t n) {
+    for (int i = 0; i < s->raise_types; ++i) {
+        if (s->raises[i].id == id) {
+            s->raises[i].count += n;
+            return;
+        }
+    }
+    if (s->raise_types == PB_PROF_MAX_RAISE_TYPES) {
+        s->other_raises += n;
+        return;
+    }
+    s->raises[s->raise_types].type = type;
+    s->raises[s->raise_types].id = id;
+    s->raises[s->raise_types++].count = n;
+}
+
+static void pb_prof_raise(const char *type) {
+    pb_prof_count_raises(&pb_stats, type, pb_exc_id(type), 1);
+}
+
+static void pb_prof_list_grow(uint64_t bytes) {
+    pb_stats.list_grows++;
+    pb_stats.list_bytes += bytes;
+}
+
+// One dict lookup that inspected `probes` slots.
+static void pb_prof_probe(uint64_t probes) {
+    pb_stats.dict_lookups++;
+    pb_stats.dict_probes += probes;
+    if (probes > pb_stats.dict_max_probe) pb_stats.dict_max_probe = probes;
+}
+
+static int pb_prof_by_self(const void *a, const void *b) {
+    uint64_t x = ((const PbProfFn *)a)->self_ticks, y = ((const PbProfFn *)b)->self_ticks;
+    return x < y ? 1 : x > y ? -1 : 0;
+}
+
+static void pb_prof_add_stats(PbProfStats *all, const PbProfStats *s) {
+    all->list_grows += s->list_grows;
+    all->list_bytes += s->list_bytes;
+    all->dict_lookups += s->dict_lookups;
+    all->dict_probes += s->dict_probes;
+    if (s->dict_max_probe > all->dict_max_probe) all->dict_max_probe = s->dict_max_probe;
+    if (s->try_high > all->try_high) all->try_high = s->try_high;
+    all->other_raises += s->other_raises;
+    for (int i = 0; i < s->raise_types; ++i)
+        pb_prof_count_raises(all, s->raises[i].type, s->raises[i].id, s->raises[i].count);
+}
+
+static void pb_prof_dump(void) {
+    /* frames still open (main, or everything under pb_fail) end now */
+    uint64_t now = pb_prof_ticks();
+    while (pb_prof_len > 0) pb_prof_pop(now);
+    uint64_t elapsed_ns = pb_prof_clock_ns() - pb_prof_start_ns;
+    double ns_per_tick = now > pb_prof_start_ticks && elapsed_ns > 0
+        ? (double)elapsed_ns / (double)(now - pb_prof_start_ticks) : 1.0;
+
+    /* sum every thread's counters; each has its own record per function */
+    PbProfStats all = {0};
+    size_t records = 0;
+    PB_SHARED_LOCK();
+    for (PbProfThread *t = pb_prof_threads; t; t = t->next) {
+        pb_prof_add_stats(&all, t->stats);
+        for (PbProfFn *fn = *t->fns; fn; fn = fn->next) records++;
+    }
+    PbProfFn *fns = records ? malloc(records * sizeof *fns) : NULL;
+    size_t n = 0;
+    for (PbProfThread *t = pb_prof_threads; t && fns; t = t->next) {
+        for (PbProfFn *fn = *t->fns; fn; fn = fn->next) {
+            size_t i = 0;
+            while (i < n && strcmp(fns[i].name, fn->name) != 0) i++;
+            if (i == n) fns[n++] = (PbProfFn){fn->name, 0, 0, 0, 0, NULL};
+            fns[i].calls += fn->calls;
+            fns[i].self_ticks += fn->self_ticks;
+            fns[i].total_ticks += fn->total_ticks;
+        }
+    }
+    PB_SHARED_UNLOCK();
+
+    FILE *out = stderr;
+    const char *path = getenv("PB_PROFILE_OUT");
+    if (path && *path && !(out = fopen(path, "w"))) out = stderr;
+
+    fprintf(out, "== PB profile ==\n");
+    fprintf(out, "list grows:     %" PRIu64 " (%" PRIu64 " bytes allocated)\n",
+            all.list_grows, all.list_bytes);
+    fprintf(out, "dict lookups:   %" PRIu64 " (%.2f probes each, longest %" PRIu64 ")\n",
+            all.dict_lookups,
+            all.dict_lookups ? (double)all.dict_probes / (double)all.dict_lookups : 0.0,
+            all.dict_max_probe);
+    fprintf(out, "try depth max:  %d\n", all.try_high);
+    uint64_t raises = all.other_raises;
+    for (int i = 0; i < all.raise_types; ++i) raises += all.raises[i].count;
+    fprintf(out, "raises:         %" PRIu64 "\n", raises);
+    for (int i = 0; i < all.raise_types; ++i)
+        fprintf(out, "  %12" PRIu64 "  %s\n", all.raises[i].count, all.raises[i].type);
+    if (all.other_raises)
+        fprintf(out, "  %12" PRIu64 "  (other types)\n", all.other_raises);
+
+    uint64_t self_sum = 0;
+    for (size_t i = 0; i < n; ++i) self_sum += fns[i].self_ticks;
+    if (n) {
+        qsort(fns, n, sizeof *fns, pb_prof_by_self);
+        fprintf(out, "\n  %%self     self ms    total ms        calls  function\n");
+        for (size_t i = 0; i < n; ++i) {
+            fprintf(out, "%7.2f %11.3f %11.3f %12" PRIu64 "  %s\n",
+                    self_sum ? 100.0 * (double)fns[i].self_ticks / (double)self_sum : 0.0,
+                    (double)fns[i].self_ticks * ns_per_tick / 1e6,
+                    (double)fns[i].total_ticks * ns_per_tick / 1e6,
+                    fns[i].calls, fns[i].name);
+        }
+    }
+    free(fns);
+    if (out != stderr) fclose(out);
+    else fflush(stderr);
+}
+
+#endif /* PB_INSTRUMENT */
+
+/* ------------ TASKS ------------- */
+
+typedef struct PbTask PbTask;
+struct PbTask {
+    void (*run)(PbTask *task);
+    PbTask *next;    /* link in the shared queue */
+    int done;        /* set, with release, once run() has returned */
+};
+
+PbAtomic *pb_atomic_new(int64_t value) {
+    PbAtomic *a = malloc(sizeof *a);
+    if (!a) pb_fail("Failed to allocate atomic");
+    a->value = value;
+    return a;
+}
+
+// Run a task outside the caller's try blocks and current exception.
+static void pb_run_task(PbTask *t) {
+    PbTryContext *try_top = pb_current_try;
+    PbException exc = pb_current_exc;
+    int checked = pb_checked_depth, depth = pb_try_depth;
+    pb_current_try = NULL;
+    pb_checked_depth = pb_try_depth = 0;
+    t->run(t);
+    pb_current_try = try_top;
+    pb_current_exc = exc;
+    pb_checked_depth = checked;
+    pb_try_depth = depth;
+#if defined(__GNUC__)
+    __atomic_store_n(&t->done, 1, __ATOMIC_RELEASE);
+#else
+    t->done = 1;
+#endif
+}
+
+#if PB_HAVE_PTHREAD && defined(__GNUC__)
+#include <sched.h>
+
+#define PB_DEQUE_CAP 1024    /* a push onto a full deque runs the task inline */
+
+/* Chase-Lev deque. Only the owner moves `bottom`; thieves race each
+ * other, and the owner for the last task, with a CAS on `top`.        */
+typedef struct {
+    int64_t top;
+    char pad[64 - sizeof(int64_t)];   /* keep thieves off the owner's line */
+    int64_t bottom;
+    PbTask *slots[PB_DEQUE_CAP];
+} PbDeque;
+
+static struct {
+    int size;                 /* threads running tasks, the starter included */
+    PbDeque *deques;          /* [0] is the starter's, then one per worker */
+    pthread_mutex_t lock;     /* guards `inject_*` and sleeping */
+    pthread_cond_t wake;
+    PbTask *inject_head, *inject_tail;
+    int sleepers;
+    int64_t queued;           /* pushed and not yet taken */
+} pb_pool = {0, NULL, PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, NULL, NULL, 0, 0};
+
+static pthread_once_t pb_pool_once = PTHREAD_ONCE_INIT;
+static PB_THREAD_LOCAL PbDeque *pb_own_deque = NULL;
+static PB_THREAD_LOCAL unsigned pb_steal_from = 0;
+
+static bool pb_deque_push(PbDeque *d, PbTask *t) {
+    int64_t b = __atomic_load_n(&d->bottom, __ATOMIC_RELAXED);
+    int64_t top = __atomic_load_n(&d->top, __ATOMIC_ACQUIRE);
+    if (b - top >= PB_DEQUE_CAP) return false;
+    __atomic_store_n(&d->slots[b & (PB_DEQUE_CAP - 1)], t, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    __atomic_store_n(&d->bottom, b + 1, __ATOMIC_RELAXED);
+    return true;
+}
+
+static PbTask *pb_deque_pop(PbDeque *d) {
+    int64_t b = __atomic_load_n(&d->bottom, __ATOMIC_RELAXED) - 1;
+    __atomic_store_n(&d->bottom, b, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    int64_t top = __atomic_load_n(&d->top, __ATOMIC_RELAXED);
+    if (top > b) {
+        __atomic_store_n(&d->bottom, b + 1, __ATOMIC_RELAXED);
+        return NULL;
+    }
+    PbTask *t = __atomic_load_n(&d->slots[b & (PB_DEQUE_CAP - 1)], __ATOMIC_RELAXED);
+    if (top == b) {
+        /* the last task: beat the thieves to it */
+        if (!__atomic_compare_exchange_n(&d->top, &top, top + 1, false,
+                                         __ATOMIC_SEQ_CST, __ATOMIC_RELAXED))
+            t = NULL;
+        __atomic_store_n(&d->bottom, b + 1, __ATOMIC_RELAXED);
+    }
+    return t;
+}
+
+static PbTask *pb_deque_steal(PbDeque *d) {
+    int64_t top = __atomic_load_n(&d->top, __ATOMIC_ACQUIRE);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    int64_t b = __atomic_load_n(&d->bottom, __ATOMIC_ACQUIRE);
+    if (top >= b) return NULL;
+    PbTask *t = __atomic_load_n(&d->slots[top & (PB_DEQUE_CAP - 1)], __ATOMIC_RELAXED);
+    if (!__atomic_compare_exchange_n(&d->top, &top, top + 1, false,
+                                     __ATOMIC_SEQ_CST, __ATOMIC_RELAXED))
+        return NULL;
+    return t;
+}
+
+static PbTask *pb_find_task(void) {
+    int size = __atomic_load_n(&pb_pool.size, __ATOMIC_ACQUIRE);
+    PbTask *t = pb_own_deque ? pb_deque_pop(pb_own_deque) : NULL;
+    for (int i = 0; !t && i < size; ++i)
+        t = pb_deque_steal(&pb_pool.deques[pb_steal_from++ % (unsigned)size]);
+    if (!t && __atomic_load_n(&pb_pool.inject_head, __ATOMIC_RELAXED)) {
+        pthread_mutex_lock(&pb_pool.lock);
+        if ((t = pb_pool.inject_head) != NULL && !(pb_pool.inject_head = t->next))
+            pb_pool.inject_tail = NULL;
+        pthread_mutex_unlock(&pb_pool.lock);
+    }
+    if (t) __atomic_sub_fetch(&pb_pool.queued, 1, __ATOMIC_SEQ_CST);
+    return t;
+}
+
+static void *pb_worker_main(void *deque) {
+    pb_own_deque = deque;
+    pb_steal_from = (unsigned)(pb_own_deque - pb_pool.deques);
+    for (;;) {
+        PbTask *t = pb_find_task();
+        if (t) {
+            pb_run_task(t);
+            continue;
+        }
+        /* `sleepers` goes up before `queued` is read, and a submit bumps
+         * `queued` before reading `sleepers`: one of them sees the other. */
+        pthread_mutex_lock(&pb_pool.lock);
+        __atomic_add_fetch(&pb_pool.sleepers, 1, __ATOMIC_SEQ_CST);
+        while (__atomic_load_n(&pb_pool.queued, __ATOMIC_SEQ_CST) <= 0)
+            pthread_cond_wait(&pb_pool.wake, &pb_pool.lock);
+        __atomic_sub_fetch(&pb_pool.sleepers, 1, __ATOMIC_SEQ_CST);
+        pthread_mutex_unlock(&pb_pool.lock);
+    }
+    return NULL;
+}
+
+static void pb_pool_start(void) {
+    const char *env = getenv("PB_THREADS");
+    long n = env && *env ? strtol(env, NULL, 10) : sysconf(_SC_NPROCESSORS_ONLN);
+    if (n < 1) n = 1;
+    if (n > 256) n = 256;
+    pb_pool.deques = calloc((size_t)n, sizeof *pb_pool.deques);
+    if (!pb_pool.deques) pb_fail("Failed to allocate the thread pool");
+    pb_own_deque = &pb_pool.deques[0];
+    int started = 1;
+    for (; started < n; ++started) {
+        pthread_t thread;
+        if (pthread_create(&thread, NULL, pb_worker_main, &pb_pool.deques[started]) != 0) break;
+        pthread_detach(thread);
+    }
+    /* workers only look at deques below `size`, so publish it last */
+    __atomic_store_n(&pb_pool.size, started, __ATOMIC_RELEASE);
+}
+
+int64_t pb_pool_size(void) {
+    pthread_once(&pb_pool_once, pb_pool_start);
+    return pb_pool.size;
+}
+
+static void pb_submit(PbTask *t) {
+    if (pb_pool_size() == 1 || (pb_own_deque && !pb_deque_push(pb_own_deque, t))) {
+        pb_run_task(t);
+        return;
+    }
+    if (!pb_own_deque) {
+        t->next = NULL;
+        pthread_mutex_lock(&pb_pool.lock);
+        if (pb_pool.inject_tail) pb_pool.inject_tail->next = t;
+        else pb_pool.inject_head = t;
+        pb_pool.inject_tail = t;
+        pthread_mutex_unlock(&pb_pool.lock);
+    }
+    __atomic_add_fetch(&pb_pool.queued, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&pb_pool.sleepers, __ATOMIC_SEQ_CST) > 0) {
+        pthread_mutex_lock(&pb_pool.lock);
+        pthread_cond_signal(&pb_pool.wake);
+        pthread_mutex_unlock(&pb_pool.lock);
+    }
+}
+
+// Wait for `t`, running whatever other tasks can be found meanwhile.
+static void pb_wait(PbTask *t) {
+    while (!__atomic_load_n(&t->done, __ATOMIC_ACQUIRE)) {
+        PbTask *other = pb_find_task();
+        if (other) pb_run_task(other);
+        else sched_yield();
+    }
+}
+#else
+/* No threads: tasks run as soon as they are submitted. */
+int64_t pb_pool_size(void) { return 1; }
+static void pb_submit(PbTask *t) { pb_run_task(t); }
+static void pb_wait(PbTask *t) { (void)t; }
+#endif
+
+typedef struct {
+    PbTask task;
+    PbRangeFn body;
+    int64_t lo, hi;
+} PbRangeTask;
+
+static void pb_range_task_run(PbTask *t) {
+    PbRangeTask *r = (PbRangeTask *)t;
+    r->body(r->lo, r->hi);
+}
+
+void pb_parallel_for(int64_t start, int64_t stop, PbRangeFn body) {
+    if (stop <= start) return;
+    /* a few chunks per thread so stealing can even out uneven ones */
+    uint64_t n = (uint64_t)stop - (uint64_t)start;
+    uint64_t chunks = (uint64_t)pb_pool_size() * 8;
+    if (chunks > n) chunks = n;
+    if (chunks == 1) {
+        PbRangeTask only = {{pb_range_task_run, NULL, 0}, body, start, stop};
+        pb_run_task(&only.task);
+        return;
+    }
+    PbRangeTask *tasks = malloc(chunks * sizeof *tasks);
+    if (!tasks) pb_fail("Failed to allocate parallel_for tasks");
+    uint64_t step = n / chunks, extra = n % chunks, lo = 0;
+    for (uint64_t i = 0; i < chunks; ++i) {
+        uint64_t len = step + (i < extra);
+        tasks[i] = (PbRangeTask){{pb_range_task_run, NULL, 0}, body,
+                                 (int64_t)((uint64_t)start + lo), (int64_t)((uint64_t)start + lo + len)};
+        lo += len;
+    }
+    /* push all but the first, run that one here, then help with the rest */
+    for (uint64_t i = chunks; i-- > 1;) pb_submit(&tasks[i].task);
+    pb_run_task(&tasks[0].task);
+    for (uint64_t i = 1; i < chunks; ++i) pb_wait(&tasks[i].task);
+    free(tasks);
+}
+
+struct PbFuture {
+    PbTask task;
+    int64_t (*fn)(int64_t);
+    int64_t arg, result;
+};
+
+static void pb_future_run(PbTask *t) {
+    PbFuture *f = (PbFuture *)t;
+    f->result = f->fn(f->arg);
+}
+
+PbFuture *pb_spawn(int64_t (*fn)(int64_t), int64_t arg) {
+    PbFuture *f = pb_arena_alloc(pb_current_arena, sizeof *f);
+    *f = (PbFuture){{pb_future_run, NULL, 0}, fn, arg, 0};
+    pb_submit(&f->task);
+    return f;
+}
+
+int64_t pb_future_join(PbFuture *f) {
+    pb_wait(&f->task);
+    return f->result;
 }
 
 /* ------------ FILE ------------- */
 
-PbFile pb_open(const char *path, const char *mode) {
+#define PB_FILE_CHUNK ((size_t)64 * 1024)
+#define PB_NO_HELD_BYTE SIZE_MAX
+
+/* Files that own a write buffer, from every thread; PB_SHARED_LOCK guards
+ * the links. A PbFile itself must be used by one thread at a time.     */
+static PbFile *pb_dirty_files = NULL;
+
+static void pb_file_flush_buffer(PbFile *f);
+
+static void pb_flush_all_files(void) {
+    PB_SHARED_LOCK();
+    for (PbFile *f = pb_dirty_files; f; f = f->next_dirty)
+        pb_file_flush_buffer(f);
+    PB_SHARED_UNLOCK();
+}
+
+PbFile *pb_open(const char *path, const char *mode, int64_t buffering) {
     FILE *fp = fopen(path, mode);
     if (!fp) {
         char buf[256];
         snprintf(buf, sizeof(buf), "Failed to open file %s", path);
         pb_fail(buf);
     }
-    PbFile f = {fp};
+    PbFile *f = calloc(1, sizeof *f);
+    if (!f) pb_fail("Failed to allocate file object");
+    f->handle = fp;
+    f->held = PB_NO_HELD_BYTE;
+    f->line_buffered = buffering == 1;
+    f->wsize = buffering < 0 || buffering == 1 ? PB_FILE_BUF_SIZE : (size_t)buffering;
     return f;
 }
 
-const char *pb_file_read(PbFile f) {
-    fseek(f.handle, 0, SEEK_END);
-    long size = ftell(f.handle);
-    fseek(f.handle, 0, SEEK_SET);
-    char *buf = malloc(size + 1);
-    if (!buf) pb_fail("Out of memory in pb_file_read");
-    size_t n = fread(buf, 1, size, f.handle);
+static void pb_file_check_open(const PbFile *f) {
+    if (PB_UNLIKELY(!f->handle)) pb_raise_msg("ValueError", "I/O operation on closed file.");
+}
+
+// Write `a` then `b` to the file, as one writev where it exists.
+static void pb_file_write_out(PbFile *f, const char *a, size_t alen, const char *b, size_t blen) {
+#if PB_HAVE_MMAP
+    struct iovec iov[2] = {{(void *)a, alen}, {(void *)b, blen}};
+    struct iovec *v = alen ? iov : iov + 1;
+    int count = alen ? 2 : 1;
+    int fd = fileno(f->handle);
+    fflush(f->handle);   /* nothing reaches stdio's buffer, but keep it in sync */
+    while (count > 0) {
+        ssize_t n = writev(fd, v, count);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            pb_fail("Failed to write file");
+        }
+        while (count > 0 && (size_t)n >= v->iov_len) {
+            n -= (ssize_t)v->iov_len;
+            ++v;
+            --count;
+        }
+        if (count > 0) {
+            v->iov_base = (char *)v->iov_base + n;
+            v->iov_len -= (size_t)n;
+        }
+    }
+#else
+    if (fwrite(a, 1, alen, f->handle) != alen || fwrite(b, 1, blen, f->handle) != blen)
+        pb_fail("Failed to write file");
+#endif
+}
+
+static void pb_file_flush_buffer(PbFile *f) {
+    if (f->wlen == 0) return;
+    size_t n = f->wlen;
+    f->wlen = 0;   /* an error exits through pb_fail, whose at-exit flush must not retry */
+    pb_file_write_out(f, NULL, 0, f->wbuf, n);
+}
+
+void pb_file_write_bytes(PbFile *f, const void *data, size_t n) {
+    pb_file_check_open(f);
+    if (PB_UNLIKELY(!f->wbuf) && f->wsize > 0) {
+        f->wbuf = malloc(f->wsize);
+        if (!f->wbuf) pb_fail("Failed to allocate write buffer");
+        f->wcap = f->wsize;
+        pb_register_exit_flush();
+        PB_SHARED_LOCK();
+        f->next_dirty = pb_dirty_files;
+        pb_dirty_files = f;
+        PB_SHARED_UNLOCK();
+    }
+    if (n > f->wcap - f->wlen) {
+        if (n >= f->wcap) {
+            /* too big to buffer: send it together with what is pending */
+            size_t pending = f->wlen;
+            f->wlen = 0;
+            pb_file_write_out(f, f->wbuf, pending, data, n);
+            return;
+        }
+        pb_file_flush_buffer(f);
+    }
+    memcpy(f->wbuf + f->wlen, data, n);
+    f->wlen += n;
+    if (f->line_buffered && memchr(data, '\n', n)) pb_file_flush_buffer(f);
+}
+
+void pb_file_write(PbFile *f, const char *s) {
+    pb_file_write_bytes(f, s, strlen(s));
+}
+
+void pb_file_writelines(PbFile *f, const List_str *lines) {
+    for (int64_t i = 0; i < lines->len; ++i)
+        pb_file_write_bytes(f, lines->data[i], strlen(lines->data[i]));
+}
+
+void pb_file_flush(PbFile *f) {
+    pb_file_check_open(f);
+    pb_file_flush_buffer(f);
+    if (fflush(f->handle) == EOF) pb_fail("Failed to flush file");
+}
+
+// Put back the byte the previous line's terminator replaced.
+static void pb_file_release_line(PbFile *f) {
+    if (f->held != PB_NO_HELD_BYTE) {
+        f->buf[f->held] = f->held_byte;
+        f->held = PB_NO_HELD_BYTE;
+    }
+}
+
+// Bytes left between the stream position and the end of a regular file.
+static bool pb_file_remaining(FILE *fp, size_t *out) {
+    long pos = ftell(fp);
+    if (pos < 0) return false;
+#if PB_HAVE_MMAP
+    struct stat st;
+    if (fstat(fileno(fp), &st) != 0 || !S_ISREG(st.st_mode)) return false;
+    *out = st.st_size > pos ? (size_t)(st.st_size - pos) : 0;
+#else
+    if (fseek(fp, 0, SEEK_END) != 0) return false;
+    long end = ftell(fp);
+    if (fseek(fp, pos, SEEK_SET) != 0 || end < pos) return false;
+    *out = (size_t)(end - pos);
+#endif
+    return true;
+}
+
+// Read to EOF when the size is unknown (pipes, devices, a growing file):
+// `head` is what has been read already.
+static const char *pb_file_read_stream(PbFile *f, const char *head, size_t head_len) {
+    size_t cap = head_len + PB_FILE_CHUNK, n = head_len;
+    char *tmp = malloc(cap);
+    if (!tmp) pb_fail("Failed to allocate memory while reading file");
+    memcpy(tmp, head, head_len);
+    for (;;) {
+        if (cap - n < PB_FILE_CHUNK / 2) {
+            char *grown = realloc(tmp, cap * 2);
+            if (!grown) {
+                free(tmp);
+                pb_fail("Failed to allocate memory while reading file");
+            }
+            tmp = grown;
+            cap *= 2;
+        }
+        size_t got = fread(tmp + n, 1, cap - n, f->handle);
+        n += got;
+        if (got == 0) break;
+    }
+    if (ferror(f->handle)) {
+        free(tmp);
+        pb_fail("Failed to read file");
+    }
+    char *out = pb_arena_alloc(pb_current_arena, n + 1);
+    memcpy(out, tmp, n);
+    out[n] = '\0';
+    free(tmp);
+    return out;
+}
+
+const char *pb_file_read(PbFile *f) {
+    pb_file_check_open(f);
+    pb_file_flush_buffer(f);
+    pb_file_release_line(f);
+    /* bytes the line reader already pulled in come first */
+    const char *pending = f->buf ? f->buf + f->start : "";
+    size_t pending_len = f->buf ? f->end - f->start : 0;
+    f->start = f->end;
+
+    size_t rest;
+    if (!pb_file_remaining(f->handle, &rest)) return pb_file_read_stream(f, pending, pending_len);
+    size_t cap = pending_len + rest + 1;
+    char *buf = pb_arena_alloc(pb_current_arena, cap);
+    memcpy(buf, pending, pending_len);
+    size_t n = pending_len + fread(buf + pending_len, 1, rest, f->handle);
+    if (ferror(f->handle)) pb_fail("Failed to read file");
+    int c;
+    if (n == cap - 1 && (c = fgetc(f->handle)) != EOF) {
+        ungetc(c, f->handle);   /* the file grew since we sized it */
+        return pb_file_read_stream(f, buf, n);
+    }
     buf[n] = '\0';
+    pb_arena_shrink_last(pb_current_arena, buf, cap, n + 1);
     return buf;
 }
 
-void pb_file_write(PbFile f, const char *s) {
-    if (fputs(s, f.handle) == EOF) {
-        pb_fail("Failed to write file");
+const char *pb_file_mmap(PbFile *f) {
+    pb_file_check_open(f);
+    pb_file_flush_buffer(f);
+#if PB_HAVE_MMAP
+    struct stat st;
+    long pos = ftell(f->handle);
+    bool buffered = f->buf && f->start < f->end;
+    if (!buffered && pos >= 0 && fstat(fileno(f->handle), &st) == 0 && S_ISREG(st.st_mode)
+            && st.st_size > pos) {
+        size_t page = (size_t)sysconf(_SC_PAGESIZE);
+        off_t base = (off_t)pos & ~(off_t)(page - 1);
+        size_t len = (size_t)(st.st_size - base);
+        /* Reserve one zero page past the data, then map the file over the
+         * front: the byte after the last one is always a readable NUL. */
+        size_t span = ((len + page - 1) & ~(page - 1)) + page;
+        char *view = mmap(NULL, span, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (view != MAP_FAILED) {
+            if (mmap(view, len, PROT_READ, MAP_PRIVATE | MAP_FIXED, fileno(f->handle), base) != MAP_FAILED) {
+                madvise(view, len, MADV_SEQUENTIAL);
+                fseek(f->handle, 0, SEEK_END);
+                return view + (pos - base);
+            }
+            munmap(view, span);
+        }
     }
+#endif
+    return pb_file_read(f);
 }
 
-void pb_file_close(PbFile f) {
-    fclose(f.handle);
+const char *pb_file_next_line(PbFile *f) {
+    pb_file_check_open(f);
+    pb_file_flush_buffer(f);
+    pb_file_release_line(f);
+    if (!f->buf) {
+        f->buf = malloc(PB_LINE_BUF_SIZE);
+        if (!f->buf) pb_fail("Failed to allocate line buffer");
+        f->cap = PB_LINE_BUF_SIZE;
+        f->start = f->end = 0;
+    }
+    size_t scan = f->start;
+    for (;;) {
+        char *nl = memchr(f->buf + scan, '\n', f->end - scan);
+        if (nl || (f->eof && f->start < f->end)) {
+            size_t stop = nl ? (size_t)(nl - f->buf) + 1 : f->end;
+            char *line = f->buf + f->start;
+            f->held = stop;
+            f->held_byte = f->buf[stop];
+            f->buf[stop] = '\0';
+            f->start = stop;
+            return line;
+        }
+        if (f->eof) return NULL;
+
+        /* No whole line buffered: slide the partial one to the front,
+         * grow when it fills the buffer, then refill behind it. */
+        size_t partial = f->end - f->start;
+        memmove(f->buf, f->buf + f->start, partial);
+        f->start = 0;
+        f->end = scan = partial;
+        if (f->end + 1 >= f->cap) {
+            char *grown = realloc(f->buf, f->cap * 2);
+            if (!grown) pb_fail("Failed to grow line buffer");
+            f->buf = grown;
+            f->cap *= 2;
+        }
+        size_t got = fread(f->buf + f->end, 1, f->cap - 1 - f->end, f->handle);
+        if (got == 0) {
+            if (ferror(f->handle)) pb_fail("Failed to read file");
+            f->eof = true;
+        }
+        f->end += got;
+    }
 }
 
-void pb_index_error(const char *type, const char *op, int64_t index, int64_t len, void *ptr) {
+void pb_file_close(PbFile *f) {
+    if (!f->handle) return;
+    pb_file_flush_buffer(f);
+    if (f->wbuf) {
+        PB_SHARED_LOCK();
+        PbFile **link = &pb_dirty_files;
+        while (*link != f) link = &(*link)->next_dirty;
+        *link = f->next_dirty;
+        PB_SHARED_UNLOCK();
+        free(f->wbuf);
+        f->wbuf = NULL;
+        f->wcap = 0;
+    }
+    FILE *fp = f->handle;
+    f->handle = NULL;
+    free(f->buf);
+    f->buf = NULL;
+    f->held = PB_NO_HELD_BYTE;
+    if (fclose(fp) == EOF) pb_fail("Failed to close file");
+}
+
+PB_COLD PB_NORETURN void pb_index_error(const char *type, const char *op, int64_t index, int64_t len, const void *ptr) {
+    (void)ptr;
     char buf[256];
     if (strcmp(op, "get") == 0) {
         snprintf(buf, sizeof(buf),
@@ -257,492 +1581,1627 @@ void pb_index_error(const char *type, const char *op, int64_t index, int64_t len
     pb_raise_msg("IndexError", pb_strdup(buf));
 }
 
-/* ------------ LIST ------------- */
+/* ------------ HASHING ------------- */
 
-void list_int_grow_if_needed(List_int *lst) {
-    if (lst->len >= lst->capacity) {
-        int64_t new_capacity = (lst->capacity == 0) ? INITIAL_LIST_CAPACITY : (lst->capacity * 2);
-        int64_t *new_data;
-        if (lst->capacity == 0 && lst->data != NULL) {
-            new_data = (int64_t *)malloc(new_capacity * sizeof(int64_t));
-            if (!new_data) {
-                char buf[128];
-                snprintf(buf, sizeof(buf),
-                    "Failed to allocate memory while growing list[%s]: old capacity = %" PRId64,
-                    "int", lst->capacity);
-                pb_fail(buf);
-            }
-            memcpy(new_data, lst->data, lst->len * sizeof(int64_t));
-        } else {
-            new_data = (int64_t *)realloc(lst->data, new_capacity * sizeof(int64_t));
-            if (!new_data) {
-                char buf[128];
-                snprintf(buf, sizeof(buf),
-                    "Failed to allocate memory while growing list[%s]: old capacity = %" PRId64,
-                    "int", lst->capacity);
-                pb_fail(buf);
-            }
-        }
-        lst->data = new_data;
-        lst->capacity = new_capacity;
+uint64_t pb_hash_str(const char *s) {
+    uint64_t h = 14695981039346656037ULL;
+    for (const unsigned char *p = (const unsigned char *)s; *p; ++p) {
+        h ^= *p;
+        h *= 1099511628211ULL;
     }
+    return h ? h : 1;
 }
 
-void list_int_init(List_int *lst) {
-    lst->len = 0;
-    lst->capacity = 0;
-    lst->data = NULL;
+// splitmix64 finalizer: spreads clustered integers over the whole table.
+static uint64_t pb_hash_int(int64_t v) {
+    uint64_t x = (uint64_t)v;
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x;
 }
 
-void list_int_set(List_int *lst, int64_t index, int64_t value) {
-    if (index < 0 || index >= lst->len) {
-        pb_index_error("int", "set", index, lst->len, lst);
-    } else {
-        lst->data[index] = value;
-    }
+static uint64_t pb_hash_float(double v) {
+    uint64_t bits;
+    if (v == 0.0) v = 0.0;   /* -0.0 == 0.0, so both must hash alike */
+    memcpy(&bits, &v, sizeof(bits));
+    return pb_hash_int((int64_t)bits);
 }
 
+static uint64_t pb_hash_bool(bool v) {
+    return pb_hash_int(v ? 1 : 0);
+}
 
-int64_t list_int_get(List_int *lst, int64_t index) {
-    if (index < 0 || index >= lst->len) {
-        pb_index_error("int", "get", index, lst->len, lst);
+// Point the first free probe slot for entry `e` at it.
+static void pb_hash_link(PbHashIndex *ix, int64_t e) {
+    uint64_t mask = (uint64_t)(2 * ix->capacity - 1);
+    uint64_t i = ix->hashes[e] & mask;
+    while (ix->slots[i] >= 0) {
+        i = (i + 1) & mask;
     }
-    return lst->data[index];
+    ix->slots[i] = e;
 }
 
-void list_int_append(List_int *lst, int64_t value) {
-    list_int_grow_if_needed(lst);
-    lst->data[lst->len++] = value;
+// Clear a probe slot using backward-shift deletion, so lookups never
+// have to step over tombstones.
+static void pb_hash_unlink(PbHashIndex *ix, int64_t slot) {
+    uint64_t mask = (uint64_t)(2 * ix->capacity - 1);
+    uint64_t hole = (uint64_t)slot;
+    for (uint64_t i = (hole + 1) & mask;; i = (i + 1) & mask) {
+        int64_t e = ix->slots[i];
+        if (e < 0) break;
+        uint64_t home = ix->hashes[e] & mask;
+        /* Move e back unless its home slot lies between the hole and i. */
+        if (((i - home) & mask) >= ((i - hole) & mask)) {
+            ix->slots[hole] = e;
+            hole = i;
+        }
+    }
+    ix->slots[hole] = -1;
 }
 
-int64_t list_int_pop(List_int *lst) {
-    if (lst->len == 0) {
+/* ------------ LIST ------------- */
+
+void *pb_list_grow(void *data, int64_t len, int64_t *capacity, int64_t new_capacity, size_t elem_size, const char *type) {
+    void *new_data;
+    if (*capacity == 0 && data != NULL) {
+        /* Borrowed storage (a list literal in the arena): copy it out */
+        new_data = malloc((size_t)new_capacity * elem_size);
+        if (new_data && len > 0) memcpy(new_data, data, (size_t)len * elem_size);
+    } else {
+        new_data = realloc(data, (size_t)new_capacity * elem_size);
+    }
+    PB_STAT(pb_prof_list_grow((uint64_t)new_capacity * elem_size));
+    if (!new_data) {
         char buf[128];
-        snprintf(buf, sizeof(buf), "Cannot pop from empty list");
+        snprintf(buf, sizeof(buf),
+            "Failed to allocate memory while growing list[%s]: old capacity = %" PRId64,
+            type, *capacity);
         pb_fail(buf);
     }
-    return lst->data[--lst->len];
+    *capacity = new_capacity;
+    return new_data;
 }
 
-bool list_int_remove(List_int *lst, int64_t value) {
-    for (int64_t i = 0; i < lst->len; ++i) {
-        if (lst->data[i] == value) {
-            /* Move elements to the left */
-            for (int64_t j = i; j + 1 < lst->len; ++j) {
-                lst->data[j] = lst->data[j + 1];
-            }
-            lst->len--;
-            return true;
-        }
-    }
-    return false;
+PB_COLD PB_NORETURN void pb_list_pop_error(void) {
+    pb_fail("Cannot pop from empty list");
 }
 
-void list_int_free(List_int *lst) {
-    if (lst->data) {
-        free(lst->data);
-        lst->data = NULL;
-    }
-    lst->len = 0;
-    lst->capacity = 0;
+PB_COLD PB_NORETURN void pb_list_value_error(const char *op) {
+    pb_raise_msg("ValueError", pb_fstring(32, "list.%s(x): x not in list", op));
 }
 
-void list_int_print(const List_int *lst) {
-    printf("[");
-    for (int64_t i = 0; i < lst->len; ++i) {
-        if (i > 0) printf(", ");
-        printf("%" PRId64, lst->data[i]);
-    }
-    printf("]\n");
+/* ------------ LIST KERNELS ------------- */
+
+/* Vector kernels behind list search, the sum/min/max/dot reductions,
+ * prefix_sum and the elementwise vadd/vsub/vmul builtins. On x86-64 a
+ * kernel takes its AVX2 body when the CPU has it and its SSE2 body
+ * otherwise (every x86-64 has SSE2); built with -mavx2 (the `native`
+ * profile) the check folds away. Elsewhere the scalar loops run, written
+ * with independent accumulators and restrict pointers so the compiler can
+ * vectorize them (NEON on AArch64); they also finish every vector tail.
+ *
+ * Float sum and dot add into eight interleaved partial sums combined in a
+ * fixed order, the same on every path, so results never depend on the CPU.
+ * SSE2 has no 64-bit integer compare, so an int lane matches when both of
+ * its 32-bit halves do; x86 has no 64-bit lane multiply before AVX-512, so
+ * int dot and vmul stay scalar.                                        */
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define PB_SIMD_X86 1
+#define PB_AVX2 __attribute__((target("avx2")))
+#if defined(__AVX2__)
+#define pb_cpu_avx2() 1
+#else
+#define pb_cpu_avx2() __builtin_cpu_supports("avx2")
+#endif
+#endif
+
+#define PB_WRAP_ADD(a, b) ((int64_t)((uint64_t)(a) + (uint64_t)(b)))
+#define PB_WRAP_SUB(a, b) ((int64_t)((uint64_t)(a) - (uint64_t)(b)))
+#define PB_WRAP_MUL(a, b) ((int64_t)((uint64_t)(a) * (uint64_t)(b)))
+#define PB_FADD(a, b) ((a) + (b))
+#define PB_FSUB(a, b) ((a) - (b))
+#define PB_FMUL(a, b) ((a) * (b))
+
+#if PB_SIMD_X86
+#define PB_LD128_int(p)     _mm_loadu_si128((const __m128i *)(p))
+#define PB_ST128_int(p, v)  _mm_storeu_si128((__m128i *)(p), v)
+#define PB_LD256_int(p)     _mm256_loadu_si256((const __m256i *)(p))
+#define PB_ST256_int(p, v)  _mm256_storeu_si256((__m256i *)(p), v)
+#define PB_LD128_float(p)    _mm_loadu_pd(p)
+#define PB_ST128_float(p, v) _mm_storeu_pd(p, v)
+#define PB_LD256_float(p)    _mm256_loadu_pd(p)
+#define PB_ST256_float(p, v) _mm256_storeu_pd(p, v)
+
+static inline __m128i pb_cmpeq_epi64_sse2(__m128i a, __m128i b) {
+    __m128i eq32 = _mm_cmpeq_epi32(a, b);
+    return _mm_and_si128(eq32, _mm_shuffle_epi32(eq32, _MM_SHUFFLE(2, 3, 0, 1)));
 }
+#endif
 
+/* Fixed combination order of the eight float partial sums. */
+static inline double pb_sum8(const double *lanes) {
+    return ((lanes[0] + lanes[4]) + (lanes[2] + lanes[6])) + ((lanes[1] + lanes[5]) + (lanes[3] + lanes[7]));
+}
 
-void list_float_grow_if_needed(List_float *lst) {
-    if (lst->len >= lst->capacity) {
-        int64_t new_capacity = (lst->capacity == 0) ? INITIAL_LIST_CAPACITY : (lst->capacity * 2);
-        double *new_data;
-        if (lst->capacity == 0 && lst->data != NULL) {
-            new_data = (double *)malloc(new_capacity * sizeof(double));
-            if (!new_data) {
-                char buf[128];
-                snprintf(buf, sizeof(buf),
-                    "Failed to allocate memory while growing list[%s]: old capacity = %" PRId64, "int", lst->capacity);
-                pb_fail(buf);
-            }
-            memcpy(new_data, lst->data, lst->len * sizeof(double));
-        } else {
-            new_data = (double *)realloc(lst->data, new_capacity * sizeof(double));
-            if (!new_data) {
-                char buf[128];
-                snprintf(buf, sizeof(buf),
-                    "Failed to allocate memory while growing list[%s]: old capacity = %" PRId64, "int", lst->capacity);
-                pb_fail(buf);
-            }
-        }
-        lst->data = new_data;
-        lst->capacity = new_capacity;
+/* --- search --- */
+
+static inline int64_t pb_find_int_from(const int64_t *data, int64_t i, int64_t n, int64_t value) {
+    for (; i < n; ++i)
+        if (data[i] == value) return i;
+    return -1;
+}
+
+static inline int64_t pb_find_float_from(const double *data, int64_t i, int64_t n, double value) {
+    for (; i < n; ++i)
+        if (data[i] == value) return i;
+    return -1;
+}
+
+#if PB_SIMD_X86
+PB_AVX2 static int64_t pb_find_int_avx2(const int64_t *data, int64_t n, int64_t value) {
+    int64_t i = 0;
+    __m256i needle = _mm256_set1_epi64x(value);
+    for (; i + 8 <= n; i += 8) {
+        __m256i m = _mm256_or_si256(_mm256_cmpeq_epi64(PB_LD256_int(&data[i]), needle),
+                                    _mm256_cmpeq_epi64(PB_LD256_int(&data[i + 4]), needle));
+        if (!_mm256_testz_si256(m, m)) break;
     }
+    return pb_find_int_from(data, i, n, value);
 }
 
-void list_float_init(List_float *lst) {
-    lst->len = 0;
-    lst->capacity = 0;
-    lst->data = NULL;
+PB_AVX2 static int64_t pb_count_int_avx2(const int64_t *data, int64_t n, int64_t value) {
+    int64_t i = 0, lanes[4];
+    __m256i needle = _mm256_set1_epi64x(value), acc = _mm256_setzero_si256();
+    for (; i + 4 <= n; i += 4)   /* a match is -1 in its lane */
+        acc = _mm256_sub_epi64(acc, _mm256_cmpeq_epi64(PB_LD256_int(&data[i]), needle));
+    PB_ST256_int(lanes, acc);
+    int64_t c = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    for (; i < n; ++i)
+        c += data[i] == value;
+    return c;
 }
 
-void list_float_set(List_float *lst, int64_t index, double value) {
-    if (index < 0 || index >= lst->len) {
-        pb_index_error("float", "set", index, lst->len, lst);
-    } else {
-        lst->data[index] = value;
+PB_AVX2 static int64_t pb_find_float_avx2(const double *data, int64_t n, double value) {
+    int64_t i = 0;
+    __m256d needle = _mm256_set1_pd(value);
+    for (; i + 8 <= n; i += 8) {
+        __m256d m = _mm256_or_pd(_mm256_cmp_pd(_mm256_loadu_pd(&data[i]), needle, _CMP_EQ_OQ),
+                                 _mm256_cmp_pd(_mm256_loadu_pd(&data[i + 4]), needle, _CMP_EQ_OQ));
+        if (_mm256_movemask_pd(m)) break;
     }
+    return pb_find_float_from(data, i, n, value);
 }
 
-double list_float_get(List_float *lst, int64_t index) {
-    if (index < 0 || index >= lst->len) {
-        pb_index_error("float", "get", index, lst->len, lst);
+PB_AVX2 static int64_t pb_count_float_avx2(const double *data, int64_t n, double value) {
+    int64_t i = 0, lanes[4];
+    __m256d needle = _mm256_set1_pd(value);
+    __m256i acc = _mm256_setzero_si256();
+    for (; i + 4 <= n; i += 4)
+        acc = _mm256_sub_epi64(acc, _mm256_castpd_si256(_mm256_cmp_pd(_mm256_loadu_pd(&data[i]), needle, _CMP_EQ_OQ)));
+    PB_ST256_int(lanes, acc);
+    int64_t c = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    for (; i < n; ++i)
+        c += data[i] == value;
+    return c;
+}
+#endif
+
+int64_t pb_find_int(const int64_t *data, int64_t n, int64_t value) {
+    int64_t i = 0;
+#if PB_SIMD_X86
+    if (pb_cpu_avx2()) return pb_find_int_avx2(data, n, value);
+    __m128i needle = _mm_set1_epi64x(value);
+    for (; i + 8 <= n; i += 8) {
+        __m128i m = _mm_or_si128(
+            _mm_or_si128(pb_cmpeq_epi64_sse2(PB_LD128_int(&data[i]), needle),
+                         pb_cmpeq_epi64_sse2(PB_LD128_int(&data[i + 2]), needle)),
+            _mm_or_si128(pb_cmpeq_epi64_sse2(PB_LD128_int(&data[i + 4]), needle),
+                         pb_cmpeq_epi64_sse2(PB_LD128_int(&data[i + 6]), needle)));
+        if (_mm_movemask_epi8(m)) break;
     }
-    return lst->data[index];
+#endif
+    return pb_find_int_from(data, i, n, value);
 }
 
-void list_float_append(List_float *lst, double value) {
-    list_float_grow_if_needed(lst);
-    lst->data[lst->len++] = value;
+int64_t pb_count_int(const int64_t *data, int64_t n, int64_t value) {
+    int64_t i = 0, c = 0;
+#if PB_SIMD_X86
+    if (pb_cpu_avx2()) return pb_count_int_avx2(data, n, value);
+    int64_t lanes[2];
+    __m128i needle = _mm_set1_epi64x(value), acc = _mm_setzero_si128();
+    for (; i + 2 <= n; i += 2)
+        acc = _mm_sub_epi64(acc, pb_cmpeq_epi64_sse2(PB_LD128_int(&data[i]), needle));
+    PB_ST128_int(lanes, acc);
+    c = lanes[0] + lanes[1];
+#endif
+    for (; i < n; ++i)
+        c += data[i] == value;
+    return c;
 }
 
-double list_float_pop(List_float *lst) {
-    if (lst->len == 0) {
-        char buf[128];
-        snprintf(buf, sizeof(buf), "Cannot pop from empty list");
-        pb_fail(buf);
+int64_t pb_find_float(const double *data, int64_t n, double value) {
+    int64_t i = 0;
+#if PB_SIMD_X86
+    if (pb_cpu_avx2()) return pb_find_float_avx2(data, n, value);
+    __m128d needle = _mm_set1_pd(value);
+    for (; i + 8 <= n; i += 8) {
+        __m128d m = _mm_or_pd(
+            _mm_or_pd(_mm_cmpeq_pd(_mm_loadu_pd(&data[i]), needle),
+                      _mm_cmpeq_pd(_mm_loadu_pd(&data[i + 2]), needle)),
+            _mm_or_pd(_mm_cmpeq_pd(_mm_loadu_pd(&data[i + 4]), needle),
+                      _mm_cmpeq_pd(_mm_loadu_pd(&data[i + 6]), needle)));
+        if (_mm_movemask_pd(m)) break;
     }
-    return lst->data[--lst->len];
+#endif
+    return pb_find_float_from(data, i, n, value);
 }
 
-bool list_float_remove(List_float *lst, double value) {
-    for (int64_t i = 0; i < lst->len; ++i) {
-        if (lst->data[i] == value) {
-            /* Move elements to the left */
-            for (int64_t j = i; j + 1 < lst->len; ++j) {
-                lst->data[j] = lst->data[j + 1];
-            }
-            lst->len--;
-            return true;
-        }
-    }
-    return false;
+int64_t pb_count_float(const double *data, int64_t n, double value) {
+    int64_t i = 0, c = 0;
+#if PB_SIMD_X86
+    if (pb_cpu_avx2()) return pb_count_float_avx2(data, n, value);
+    int64_t lanes[2];
+    __m128d needle = _mm_set1_pd(value);
+    __m128i acc = _mm_setzero_si128();
+    for (; i + 2 <= n; i += 2)
+        acc = _mm_sub_epi64(acc, _mm_castpd_si128(_mm_cmpeq_pd(_mm_loadu_pd(&data[i]), needle)));
+    PB_ST128_int(lanes, acc);
+    c = lanes[0] + lanes[1];
+#endif
+    for (; i < n; ++i)
+        c += data[i] == value;
+    return c;
 }
 
-void list_float_free(List_float *lst) {
-    if (lst->data) {
-        free(lst->data);
-        lst->data = NULL;
+/* --- reductions --- */
+
+#if PB_SIMD_X86
+PB_AVX2 static int64_t pb_sum_int_avx2(const int64_t *data, int64_t n) {
+    int64_t i = 0, lanes[4];
+    __m256i a0 = _mm256_setzero_si256(), a1 = _mm256_setzero_si256();
+    for (; i + 8 <= n; i += 8) {
+        a0 = _mm256_add_epi64(a0, PB_LD256_int(&data[i]));
+        a1 = _mm256_add_epi64(a1, PB_LD256_int(&data[i + 4]));
     }
-    lst->len = 0;
-    lst->capacity = 0;
+    PB_ST256_int(lanes, _mm256_add_epi64(a0, a1));
+    uint64_t s = (uint64_t)lanes[0] + (uint64_t)lanes[1] + (uint64_t)lanes[2] + (uint64_t)lanes[3];
+    for (; i < n; ++i)
+        s += (uint64_t)data[i];
+    return (int64_t)s;
 }
 
-void list_float_print(const List_float *lst) {
-    printf("[");
-    for (int64_t i = 0; i < lst->len; ++i) {
-        if (i > 0) printf(", ");
-        double x = lst->data[i];
-        if (x == (int64_t)x) {
-            printf("%.1f", x);  // 50.0 (preserve .0)
-        } else {
-            printf("%.15g", x); // Python-like float precision
-        }
+PB_AVX2 static double pb_sum_float_avx2(const double *data, int64_t n) {
+    int64_t i = 0;
+    double lanes[8];
+    __m256d a0 = _mm256_setzero_pd(), a1 = _mm256_setzero_pd();
+    for (; i + 8 <= n; i += 8) {
+        a0 = _mm256_add_pd(a0, _mm256_loadu_pd(&data[i]));
+        a1 = _mm256_add_pd(a1, _mm256_loadu_pd(&data[i + 4]));
     }
-    printf("]\n");
+    _mm256_storeu_pd(&lanes[0], a0);
+    _mm256_storeu_pd(&lanes[4], a1);
+    double s = pb_sum8(lanes);
+    for (; i < n; ++i)
+        s += data[i];
+    return s;
 }
 
+PB_AVX2 static double pb_dot_float_avx2(const double *a, const double *b, int64_t n) {
+    int64_t i = 0;
+    double lanes[8];
+    __m256d a0 = _mm256_setzero_pd(), a1 = _mm256_setzero_pd();
+    for (; i + 8 <= n; i += 8) {
+        a0 = _mm256_add_pd(a0, _mm256_mul_pd(_mm256_loadu_pd(&a[i]), _mm256_loadu_pd(&b[i])));
+        a1 = _mm256_add_pd(a1, _mm256_mul_pd(_mm256_loadu_pd(&a[i + 4]), _mm256_loadu_pd(&b[i + 4])));
+    }
+    _mm256_storeu_pd(&lanes[0], a0);
+    _mm256_storeu_pd(&lanes[4], a1);
+    double s = pb_sum8(lanes);
+    for (; i < n; ++i)
+        s += a[i] * b[i];
+    return s;
+}
 
-void list_bool_grow_if_needed(List_bool *lst) {
-    if (lst->len >= lst->capacity) {
-        int64_t new_capacity = (lst->capacity == 0) ? INITIAL_LIST_CAPACITY : (lst->capacity * 2);
-        bool *new_data;
-        if (lst->capacity == 0 && lst->data != NULL) {
-            new_data = (bool *)malloc(new_capacity * sizeof(bool));
-            if (!new_data) {
-                char buf[128];
-                snprintf(buf, sizeof(buf),
-                    "Failed to allocate memory while growing list[%s]: old capacity = %" PRId64, "int", lst->capacity);
-                pb_fail(buf);
-            }
-            memcpy(new_data, lst->data, lst->len * sizeof(bool));
-        } else {
-            new_data = (bool *)realloc(lst->data, new_capacity * sizeof(bool));
-            if (!new_data) {
-                char buf[128];
-                snprintf(buf, sizeof(buf),
-                    "Failed to allocate memory while growing list[%s]: old capacity = %" PRId64, "int", lst->capacity);
-                pb_fail(buf);
-            }
+/* Smallest element of `data ^ flip` (n >= 1), xor-ed back; flip = -1
+ * turns the minimum of the complements into the maximum.             */
+PB_AVX2 static int64_t pb_min_int_avx2(const int64_t *data, int64_t n, int64_t flip) {
+    int64_t i = 0, m = data[0] ^ flip, lanes[4];
+    if (n >= 4) {
+        __m256i f = _mm256_set1_epi64x(flip);
+        __m256i acc = _mm256_xor_si256(PB_LD256_int(data), f);
+        for (i = 4; i + 4 <= n; i += 4) {
+            __m256i v = _mm256_xor_si256(PB_LD256_int(&data[i]), f);
+            acc = _mm256_blendv_epi8(acc, v, _mm256_cmpgt_epi64(acc, v));
         }
-        lst->data = new_data;
-        lst->capacity = new_capacity;
+        PB_ST256_int(lanes, acc);
+        for (int k = 0; k < 4; ++k)
+            if (lanes[k] < m) m = lanes[k];
     }
+    for (; i < n; ++i)
+        if ((data[i] ^ flip) < m) m = data[i] ^ flip;
+    return m ^ flip;
 }
 
-void list_bool_init(List_bool *lst) {
-    lst->len = 0;
-    lst->capacity = 0;
-    lst->data = NULL;
+/* Smallest element of `data * sign` (n >= 1), times sign again. */
+PB_AVX2 static double pb_min_float_avx2(const double *data, int64_t n, double sign) {
+    int64_t i = 0;
+    double m = data[0] * sign, lanes[4];
+    if (n >= 4) {
+        __m256d s = _mm256_set1_pd(sign);
+        __m256d acc = _mm256_mul_pd(_mm256_loadu_pd(data), s);
+        for (i = 4; i + 4 <= n; i += 4)
+            acc = _mm256_min_pd(_mm256_mul_pd(_mm256_loadu_pd(&data[i]), s), acc);
+        _mm256_storeu_pd(lanes, acc);
+        for (int k = 0; k < 4; ++k)
+            if (lanes[k] < m) m = lanes[k];
+    }
+    for (; i < n; ++i)
+        if (data[i] * sign < m) m = data[i] * sign;
+    return m * sign;
 }
-
-void list_bool_set(List_bool *lst, int64_t index, bool value) {
-    if (index < 0 || index >= lst->len) {
-        pb_index_error("bool", "set", index, lst->len, lst);
-    } else {
-        lst->data[index] = value;
+#endif
+
+static int64_t pb_sum_int(const int64_t *data, int64_t n) {
+    int64_t i = 0;
+    uint64_t s = 0;
+#if PB_SIMD_X86
+    if (pb_cpu_avx2()) return pb_sum_int_avx2(data, n);
+    int64_t lanes[2];
+    __m128i a0 = _mm_setzero_si128(), a1 = _mm_setzero_si128();
+    for (; i + 4 <= n; i += 4) {
+        a0 = _mm_add_epi64(a0, PB_LD128_int(&data[i]));
+        a1 = _mm_add_epi64(a1, PB_LD128_int(&data[i + 2]));
     }
+    PB_ST128_int(lanes, _mm_add_epi64(a0, a1));
+    s = (uint64_t)lanes[0] + (uint64_t)lanes[1];
+#else
+    uint64_t s1 = 0, s2 = 0, s3 = 0;
+    for (; i + 4 <= n; i += 4) {
+        s += (uint64_t)data[i];
+        s1 += (uint64_t)data[i + 1];
+        s2 += (uint64_t)data[i + 2];
+        s3 += (uint64_t)data[i + 3];
+    }
+    s += s1 + s2 + s3;
+#endif
+    for (; i < n; ++i)
+        s += (uint64_t)data[i];
+    return (int64_t)s;
 }
 
-bool list_bool_get(List_bool *lst, int64_t index) {
-    if (index < 0 || index >= lst->len) {
-        pb_index_error("bool", "get", index, lst->len, lst);
+static double pb_sum_float(const double *data, int64_t n) {
+    int64_t i = 0;
+    double lanes[8];
+#if PB_SIMD_X86
+    if (pb_cpu_avx2()) return pb_sum_float_avx2(data, n);
+    __m128d a0 = _mm_setzero_pd(), a1 = _mm_setzero_pd(), a2 = _mm_setzero_pd(), a3 = _mm_setzero_pd();
+    for (; i + 8 <= n; i += 8) {
+        a0 = _mm_add_pd(a0, _mm_loadu_pd(&data[i]));
+        a1 = _mm_add_pd(a1, _mm_loadu_pd(&data[i + 2]));
+        a2 = _mm_add_pd(a2, _mm_loadu_pd(&data[i + 4]));
+        a3 = _mm_add_pd(a3, _mm_loadu_pd(&data[i + 6]));
     }
-    return lst->data[index];
+    _mm_storeu_pd(&lanes[0], a0);
+    _mm_storeu_pd(&lanes[2], a1);
+    _mm_storeu_pd(&lanes[4], a2);
+    _mm_storeu_pd(&lanes[6], a3);
+#else
+    for (int k = 0; k < 8; ++k) lanes[k] = 0.0;
+    for (; i + 8 <= n; i += 8)
+        for (int k = 0; k < 8; ++k) lanes[k] += data[i + k];
+#endif
+    double s = pb_sum8(lanes);
+    for (; i < n; ++i)
+        s += data[i];
+    return s;
 }
 
-void list_bool_append(List_bool *lst, bool value) {
-    list_bool_grow_if_needed(lst);
-    lst->data[lst->len++] = value;
+static int64_t pb_dot_int(const int64_t *restrict a, const int64_t *restrict b, int64_t n) {
+    int64_t i = 0;
+    uint64_t s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+    for (; i + 4 <= n; i += 4) {
+        s0 += (uint64_t)a[i] * (uint64_t)b[i];
+        s1 += (uint64_t)a[i + 1] * (uint64_t)b[i + 1];
+        s2 += (uint64_t)a[i + 2] * (uint64_t)b[i + 2];
+        s3 += (uint64_t)a[i + 3] * (uint64_t)b[i + 3];
+    }
+    s0 += s1 + s2 + s3;
+    for (; i < n; ++i)
+        s0 += (uint64_t)a[i] * (uint64_t)b[i];
+    return (int64_t)s0;
 }
 
-bool list_bool_pop(List_bool *lst) {
-    if (lst->len == 0) {
-        char buf[128];
-        snprintf(buf, sizeof(buf), "Cannot pop from empty list");
-        pb_fail(buf);
+static double pb_dot_float(const double *restrict a, const double *restrict b, int64_t n) {
+    int64_t i = 0;
+    double lanes[8];
+#if PB_SIMD_X86
+    if (pb_cpu_avx2()) return pb_dot_float_avx2(a, b, n);
+    __m128d a0 = _mm_setzero_pd(), a1 = _mm_setzero_pd(), a2 = _mm_setzero_pd(), a3 = _mm_setzero_pd();
+    for (; i + 8 <= n; i += 8) {
+        a0 = _mm_add_pd(a0, _mm_mul_pd(_mm_loadu_pd(&a[i]), _mm_loadu_pd(&b[i])));
+        a1 = _mm_add_pd(a1, _mm_mul_pd(_mm_loadu_pd(&a[i + 2]), _mm_loadu_pd(&b[i + 2])));
+        a2 = _mm_add_pd(a2, _mm_mul_pd(_mm_loadu_pd(&a[i + 4]), _mm_loadu_pd(&b[i + 4])));
+        a3 = _mm_add_pd(a3, _mm_mul_pd(_mm_loadu_pd(&a[i + 6]), _mm_loadu_pd(&b[i + 6])));
     }
-    return lst->data[--lst->len];
+    _mm_storeu_pd(&lanes[0], a0);
+    _mm_storeu_pd(&lanes[2], a1);
+    _mm_storeu_pd(&lanes[4], a2);
+    _mm_storeu_pd(&lanes[6], a3);
+#else
+    for (int k = 0; k < 8; ++k) lanes[k] = 0.0;
+    for (; i + 8 <= n; i += 8)
+        for (int k = 0; k < 8; ++k) lanes[k] += a[i + k] * b[i + k];
+#endif
+    double s = pb_sum8(lanes);
+    for (; i < n; ++i)
+        s += a[i] * b[i];
+    return s;
 }
 
-bool list_bool_remove(List_bool *lst, bool value) {
-    for (int64_t i = 0; i < lst->len; ++i) {
-        if (lst->data[i] == value) {
-            /* Move elements to the left */
-            for (int64_t j = i; j + 1 < lst->len; ++j) {
-                lst->data[j] = lst->data[j + 1];
-            }
-            lst->len--;
-            return true;
-        }
+/* SSE2 lacks 64-bit integer compares, so int min/max uses four scalar
+ * accumulators there. */
+static int64_t pb_min_int(const int64_t *data, int64_t n, int64_t flip) {
+#if PB_SIMD_X86
+    if (pb_cpu_avx2()) return pb_min_int_avx2(data, n, flip);
+#endif
+    int64_t i = 1, m0 = data[0] ^ flip, m1 = m0, m2 = m0, m3 = m0;
+    for (; i + 4 <= n; i += 4) {
+        int64_t v0 = data[i] ^ flip, v1 = data[i + 1] ^ flip, v2 = data[i + 2] ^ flip, v3 = data[i + 3] ^ flip;
+        m0 = v0 < m0 ? v0 : m0;
+        m1 = v1 < m1 ? v1 : m1;
+        m2 = v2 < m2 ? v2 : m2;
+        m3 = v3 < m3 ? v3 : m3;
     }
-    return false;
+    m0 = m1 < m0 ? m1 : m0;
+    m2 = m3 < m2 ? m3 : m2;
+    m0 = m2 < m0 ? m2 : m0;
+    for (; i < n; ++i)
+        if ((data[i] ^ flip) < m0) m0 = data[i] ^ flip;
+    return m0 ^ flip;
 }
 
-void list_bool_free(List_bool *lst) {
-    if (lst->data) {
-        free(lst->data);
-        lst->data = NULL;
+static double pb_min_float(const double *data, int64_t n, double sign) {
+    int64_t i = 1;
+    double m = data[0] * sign, lanes[2];
+#if PB_SIMD_X86
+    if (pb_cpu_avx2()) return pb_min_float_avx2(data, n, sign);
+    if (n >= 3) {
+        __m128d s = _mm_set1_pd(sign);
+        __m128d acc = _mm_mul_pd(_mm_loadu_pd(&data[1]), s);
+        for (i = 3; i + 2 <= n; i += 2)
+            acc = _mm_min_pd(_mm_mul_pd(_mm_loadu_pd(&data[i]), s), acc);
+        _mm_storeu_pd(lanes, acc);
+        if (lanes[0] < m) m = lanes[0];
+        if (lanes[1] < m) m = lanes[1];
     }
-    lst->len = 0;
-    lst->capacity = 0;
+#else
+    (void)lanes;
+#endif
+    for (; i < n; ++i)
+        if (data[i] * sign < m) m = data[i] * sign;
+    return m * sign;
 }
 
-void list_bool_print(const List_bool *lst) {
-    printf("[");
-    for (int64_t i = 0; i < lst->len; ++i) {
-        if (i > 0) printf(", ");
-        printf(lst->data[i] ? "True" : "False");
+/* --- scans and elementwise --- */
+
+#if PB_SIMD_X86
+PB_AVX2 static void pb_prefix_sum_int_avx2(int64_t *restrict out, const int64_t *restrict data, int64_t n) {
+    int64_t i = 0;
+    __m256i zero = _mm256_setzero_si256(), carry = zero;
+    for (; i + 4 <= n; i += 4) {
+        __m256i v = PB_LD256_int(&data[i]);
+        /* [a b c d] + [0 a b c], then + [0 0 a a+b] */
+        v = _mm256_add_epi64(v, _mm256_blend_epi32(_mm256_permute4x64_epi64(v, _MM_SHUFFLE(2, 1, 0, 3)), zero, 0x03));
+        v = _mm256_add_epi64(v, _mm256_permute2x128_si256(v, v, 0x08));
+        v = _mm256_add_epi64(v, carry);
+        PB_ST256_int(&out[i], v);
+        carry = _mm256_permute4x64_epi64(v, _MM_SHUFFLE(3, 3, 3, 3));
     }
-    printf("]\n");
+    uint64_t s = i > 0 ? (uint64_t)out[i - 1] : 0;
+    for (; i < n; ++i)
+        out[i] = (int64_t)(s += (uint64_t)data[i]);
+}
+#endif
+
+static void pb_prefix_sum_int(int64_t *restrict out, const int64_t *restrict data, int64_t n) {
+    int64_t i = 0;
+#if PB_SIMD_X86
+    if (pb_cpu_avx2()) {
+        pb_prefix_sum_int_avx2(out, data, n);
+        return;
+    }
+    __m128i carry = _mm_setzero_si128();
+    for (; i + 2 <= n; i += 2) {
+        __m128i v = PB_LD128_int(&data[i]);
+        v = _mm_add_epi64(v, _mm_slli_si128(v, 8));
+        v = _mm_add_epi64(v, carry);
+        PB_ST128_int(&out[i], v);
+        carry = _mm_shuffle_epi32(v, _MM_SHUFFLE(3, 2, 3, 2));
+    }
+#endif
+    uint64_t s = i > 0 ? (uint64_t)out[i - 1] : 0;
+    for (; i < n; ++i)
+        out[i] = (int64_t)(s += (uint64_t)data[i]);
 }
 
+/* Left to right, so each element matches a running Python sum exactly. */
+static void pb_prefix_sum_float(double *restrict out, const double *restrict data, int64_t n) {
+    double s = 0.0;
+    for (int64_t i = 0; i < n; ++i)
+        out[i] = (s += data[i]);
+}
 
-void list_str_grow_if_needed(List_str *lst) {
-    if (lst->len >= lst->capacity) {
-        int64_t new_capacity = (lst->capacity == 0) ? INITIAL_LIST_CAPACITY : (lst->capacity * 2);
-        const char **new_data;
-        if (lst->capacity == 0 && lst->data != NULL) {
-            new_data = (const char **)malloc(new_capacity * sizeof(const char *));
-            if (!new_data) {
-                char buf[128];
-                snprintf(buf, sizeof(buf),
-                    "Failed to allocate memory while growing list[%s]: old capacity = %" PRId64, "int", lst->capacity);
-                pb_fail(buf);
-            }
-            memcpy(new_data, lst->data, lst->len * sizeof(const char *));
-        } else {
-            new_data = (const char **)realloc(lst->data, new_capacity * sizeof(const char *));
-            if (!new_data) {
-                char buf[128];
-                snprintf(buf, sizeof(buf),
-                    "Failed to allocate memory while growing list[%s]: old capacity = %" PRId64, "int", lst->capacity);
-                pb_fail(buf);
-            }
-        }
-        lst->data = new_data;
-        lst->capacity = new_capacity;
+/* out[i] = a[i] OP b[i], four (AVX2) or two (SSE2) lanes at a time. */
+#if PB_SIMD_X86
+#define PB_DEFINE_ELEMENTWISE(Op, Elem, CType, SCALAR, OP256, OP128)                                 \
+    PB_AVX2 static void pb_##Op##_##Elem##_avx2(CType *restrict out, const CType *restrict a,          \
+                                                const CType *restrict b, int64_t n) {                \
+        int64_t i = 0;                                                                               \
+        for (; i + 4 <= n; i += 4)                                                                   \
+            PB_ST256_##Elem(&out[i], OP256(PB_LD256_##Elem(&a[i]), PB_LD256_##Elem(&b[i])));         \
+        for (; i < n; ++i) out[i] = SCALAR(a[i], b[i]);                                              \
+    }                                                                                                \
+    static void pb_##Op##_##Elem(CType *restrict out, const CType *restrict a,                        \
+                                 const CType *restrict b, int64_t n) {                               \
+        int64_t i = 0;                                                                               \
+        if (pb_cpu_avx2()) {                                                                         \
+            pb_##Op##_##Elem##_avx2(out, a, b, n);                                                   \
+            return;                                                                                  \
+        }                                                                                            \
+        for (; i + 2 <= n; i += 2)                                                                   \
+            PB_ST128_##Elem(&out[i], OP128(PB_LD128_##Elem(&a[i]), PB_LD128_##Elem(&b[i])));         \
+        for (; i < n; ++i) out[i] = SCALAR(a[i], b[i]);                                              \
     }
+#else
+#define PB_DEFINE_ELEMENTWISE(Op, Elem, CType, SCALAR, OP256, OP128)                                 \
+    static void pb_##Op##_##Elem(CType *restrict out, const CType *restrict a,                        \
+                                 const CType *restrict b, int64_t n) {                               \
+        for (int64_t i = 0; i < n; ++i) out[i] = SCALAR(a[i], b[i]);                                 \
+    }
+#endif
+
+PB_DEFINE_ELEMENTWISE(vadd, int, int64_t, PB_WRAP_ADD, _mm256_add_epi64, _mm_add_epi64)
+PB_DEFINE_ELEMENTWISE(vsub, int, int64_t, PB_WRAP_SUB, _mm256_sub_epi64, _mm_sub_epi64)
+PB_DEFINE_ELEMENTWISE(vadd, float, double, PB_FADD, _mm256_add_pd, _mm_add_pd)
+PB_DEFINE_ELEMENTWISE(vsub, float, double, PB_FSUB, _mm256_sub_pd, _mm_sub_pd)
+PB_DEFINE_ELEMENTWISE(vmul, float, double, PB_FMUL, _mm256_mul_pd, _mm_mul_pd)
+
+static void pb_vmul_int(int64_t *restrict out, const int64_t *restrict a, const int64_t *restrict b, int64_t n) {
+    for (int64_t i = 0; i < n; ++i) out[i] = PB_WRAP_MUL(a[i], b[i]);
+}
+
+/* --- list builtins --- */
+
+PB_COLD PB_NORETURN static void pb_list_length_error(const char *fn, int64_t a, int64_t b) {
+    pb_raise_msg("ValueError", pb_fstring(64, "%s(): lists have different lengths (%" PRId64 " and %" PRId64 ")",
+                                          fn, a, b));
 }
 
-void list_str_init(List_str *lst) {
-    lst->len = 0;
-    lst->capacity = 0;
-    lst->data = NULL;
+PB_COLD PB_NORETURN static void pb_list_empty_error(const char *fn) {
+    pb_raise_msg("ValueError", pb_fstring(40, "%s() iterable argument is empty", fn));
 }
 
-void list_str_set(List_str *lst, int64_t index, const char *value) {
-    if (index < 0 || index >= lst->len) {
-        pb_index_error("str", "set", index, lst->len, lst);
-    } else {
-        lst->data[index] = value;  // assumes value is valid for the lifetime of lst
+#define PB_DEFINE_LIST_KERNELS(Name, CType, MIN, MAX)                                                  \
+    CType list_##Name##_sum(const List_##Name *xs) { return pb_sum_##Name(xs->data, xs->len); }       \
+    CType list_##Name##_min(const List_##Name *xs) {                                                  \
+        if (xs->len == 0) pb_list_empty_error("min");                                                \
+        return pb_min_##Name(xs->data, xs->len, MIN);                                                \
+    }                                                                                                \
+    CType list_##Name##_max(const List_##Name *xs) {                                                  \
+        if (xs->len == 0) pb_list_empty_error("max");                                                \
+        return pb_min_##Name(xs->data, xs->len, MAX);                                                \
+    }                                                                                                \
+    CType list_##Name##_dot(const List_##Name *a, const List_##Name *b) {                             \
+        if (a->len != b->len) pb_list_length_error("dot", a->len, b->len);                           \
+        return pb_dot_##Name(a->data, b->data, a->len);                                              \
+    }                                                                                                \
+    List_##Name list_##Name##_prefix_sum(const List_##Name *xs) {                                     \
+        List_##Name out;                                                                             \
+        list_##Name##_init(&out);                                                                    \
+        list_##Name##_reserve(&out, xs->len);                                                        \
+        pb_prefix_sum_##Name(out.data, xs->data, xs->len);                                           \
+        out.len = xs->len;                                                                           \
+        return out;                                                                                  \
+    }                                                                                                \
+    PB_DEFINE_LIST_BINARY(Name, vadd)                                                                \
+    PB_DEFINE_LIST_BINARY(Name, vsub)                                                                \
+    PB_DEFINE_LIST_BINARY(Name, vmul)
+
+#define PB_DEFINE_LIST_BINARY(Name, Op)                                                              \
+    List_##Name list_##Name##_##Op(const List_##Name *a, const List_##Name *b) {                      \
+        if (a->len != b->len) pb_list_length_error(#Op, a->len, b->len);                             \
+        List_##Name out;                                                                             \
+        list_##Name##_init(&out);                                                                    \
+        list_##Name##_reserve(&out, a->len);                                                         \
+        pb_##Op##_##Name(out.data, a->data, b->data, a->len);                                        \
+        out.len = a->len;                                                                            \
+        return out;                                                                                  \
     }
-}
 
-const char* list_str_get(List_str *lst, int64_t index) {
-    if (index < 0 || index >= lst->len) {
-        pb_index_error("str", "get", index, lst->len, lst);
+/* max(xs) is the complement (int) or negation (float) of the minimum
+ * over the complements or negations. */
+PB_DEFINE_LIST_KERNELS(int, int64_t, 0, -1)
+PB_DEFINE_LIST_KERNELS(float, double, 1.0, -1.0)
+
+/* ------------ SORTING ------------- */
+
+/* list.sort() and sorted(): LSD radix sort for int, pattern-defeating
+ * quicksort (Orson Peters' pdqsort) for float and str, counting for bool.
+ * None of them is stable; only equal floats such as 0.0 and -0.0 can tell,
+ * and NaNs end up in an unspecified order.                             */
+
+#define PB_INSERTION_SORT_MAX 24
+#define PB_NINTHER_MIN 128
+#define PB_PARTIAL_INSERTION_LIMIT 8
+#define PB_RADIX_MIN 256
+
+#define PB_LESS_VALUE(a, b) ((a) < (b))
+#define PB_LESS_STR(a, b)   (strcmp((a), (b)) < 0)
+
+#define PB_DEFINE_PDQSORT(Name, T, LESS)                                                          \
+    static void pb_insertion_sort_##Name(T *begin, T *end) {                                       \
+        if (begin == end) return;                                                                  \
+        for (T *cur = begin + 1; cur != end; ++cur) {                                              \
+            T *sift = cur, *sift_1 = cur - 1;                                                      \
+            if (LESS(*sift, *sift_1)) {                                                            \
+                T tmp = *sift;                                                                     \
+                do { *sift-- = *sift_1; } while (sift != begin && LESS(tmp, *--sift_1));          \
+                *sift = tmp;                                                                       \
+            }                                                                                      \
+        }                                                                                          \
+    }                                                                                              \
+    /* Needs an element before `begin` that is <= everything in the range. */                     \
+    static void pb_unguarded_insertion_sort_##Name(T *begin, T *end) {                             \
+        if (begin == end) return;                                                                  \
+        for (T *cur = begin + 1; cur != end; ++cur) {                                              \
+            T *sift = cur, *sift_1 = cur - 1;                                                      \
+            if (LESS(*sift, *sift_1)) {                                                            \
+                T tmp = *sift;                                                                     \
+                do { *sift-- = *sift_1; } while (LESS(tmp, *--sift_1));                            \
+                *sift = tmp;                                                                       \
+            }                                                                                      \
+        }                                                                                          \
+    }                                                                                              \
+    /* Insertion sort that gives up after a few moves; true if it finished. */                     \
+    static bool pb_partial_insertion_sort_##Name(T *begin, T *end) {                               \
+        if (begin == end) return true;                                                             \
+        int64_t limit = 0;                                                                         \
+        for (T *cur = begin + 1; cur != end; ++cur) {                                              \
+            if (limit > PB_PARTIAL_INSERTION_LIMIT) return false;                                  \
+            T *sift = cur, *sift_1 = cur - 1;                                                      \
+            if (LESS(*sift, *sift_1)) {                                                            \
+                T tmp = *sift;                                                                     \
+                do { *sift-- = *sift_1; } while (sift != begin && LESS(tmp, *--sift_1));          \
+                *sift = tmp;                                                                       \
+                limit += cur - sift;                                                               \
+            }                                                                                      \
+        }                                                                                          \
+        return true;                                                                               \
+    }                                                                                              \
+    static inline void pb_swap_##Name(T *a, T *b) { T t = *a; *a = *b; *b = t; }                   \
+    static inline void pb_sort2_##Name(T *a, T *b) { if (LESS(*b, *a)) pb_swap_##Name(a, b); }     \
+    static inline void pb_sort3_##Name(T *a, T *b, T *c) {                                         \
+        pb_sort2_##Name(a, b);                                                                     \
+        pb_sort2_##Name(b, c);                                                                     \
+        pb_sort2_##Name(a, b);                                                                     \
+    }                                                                                              \
+    static void pb_heapsort_##Name(T *a, int64_t n) {                                              \
+        for (int64_t start = n / 2 - 1; start >= 0; --start) {                                    \
+            for (int64_t root = start, child; (child = 2 * root + 1) < n; root = child) {          \
+                if (child + 1 < n && LESS(a[child], a[child + 1])) ++child;                        \
+                if (!LESS(a[root], a[child])) break;                                               \
+                pb_swap_##Name(&a[root], &a[child]);                                               \
+            }                                                                                      \
+        }                                                                                          \
+        for (int64_t end = n - 1; end > 0; --end) {                                                \
+            pb_swap_##Name(&a[0], &a[end]);                                                        \
+            for (int64_t root = 0, child; (child = 2 * root + 1) < end; root = child) {            \
+                if (child + 1 < end && LESS(a[child], a[child + 1])) ++child;                      \
+                if (!LESS(a[root], a[child])) break;                                               \
+                pb_swap_##Name(&a[root], &a[child]);                                               \
+            }                                                                                      \
+        }                                                                                          \
+    }                                                                                              \
+    /* Partition around *begin: smaller elements to its left, the rest to its                      \
+     * right. Returns the pivot's final position; `*already` is set when no                        \
+     * element had to move.                                                 */                     \
+    static T *pb_partition_right_##Name(T *begin, T *end, bool *already) {                         \
+        T pivot = *begin;                                                                          \
+        T *first = begin, *last = end;                                                             \
+        while (LESS(*++first, pivot));                                                             \
+        if (first - 1 == begin)                                                                    \
+            while (first < last && !LESS(*--last, pivot));                                         \
+        else                                                                                       \
+            while (!LESS(*--last, pivot));                                                         \
+        *already = first >= last;                                                                  \
+        while (first < last) {                                                                     \
+            pb_swap_##Name(first, last);                                                           \
+            while (LESS(*++first, pivot));                                                         \
+            while (!LESS(*--last, pivot));                                                         \
+        }                                                                                          \
+        T *pivot_pos = first - 1;                                                                  \
+        *begin = *pivot_pos;                                                                       \
+        *pivot_pos = pivot;                                                                        \
+        return pivot_pos;                                                                          \
+    }                                                                                              \
+    /* Like partition_right, but elements equal to the pivot go left. Used when                    \
+     * the pivot equals the element before the range, so they are all done.  */                   \
+    static T *pb_partition_left_##Name(T *begin, T *end) {                                         \
+        T pivot = *begin;                                                                          \
+        T *first = begin, *last = end;                                                             \
+        while (LESS(pivot, *--last));                                                              \
+        if (last + 1 == end)                                                                       \
+            while (first < last && !LESS(pivot, *++first));                                        \
+        else                                                                                       \
+            while (!LESS(pivot, *++first));                                                        \
+        while (first < last) {                                                                     \
+            pb_swap_##Name(first, last);                                                           \
+            while (LESS(pivot, *--last));                                                          \
+            while (!LESS(pivot, *++first));                                                        \
+        }                                                                                          \
+        *begin = *last;                                                                            \
+        *last = pivot;                                                                             \
+        return last;                                                                               \
+    }                                                                                              \
+    static void pb_pdqsort_loop_##Name(T *begin, T *end, int bad_allowed, bool leftmost) {         \
+        for (;;) {                                                                                 \
+            int64_t size = end - begin;                                                            \
+            if (size < PB_INSERTION_SORT_MAX) {                                                    \
+                if (leftmost) pb_insertion_sort_##Name(begin, end);                                \
+                else pb_unguarded_insertion_sort_##Name(begin, end);                               \
+                return;                                                                            \
+            }                                                                                      \
+            int64_t s2 = size / 2;                                                                 \
+            if (size > PB_NINTHER_MIN) {                                                           \
+                pb_sort3_##Name(begin, begin + s2, end - 1);                                       \
+                pb_sort3_##Name(begin + 1, begin + (s2 - 1), end - 2);                             \
+                pb_sort3_##Name(begin + 2, begin + (s2 + 1), end - 3);                             \
+                pb_sort3_##Name(begin + (s2 - 1), begin + s2, begin + (s2 + 1));                   \
+                pb_swap_##Name(begin, begin + s2);                                                 \
+            } else {                                                                               \
+                pb_sort3_##Name(begin + s2, begin, end - 1);                                       \
+            }                                                                                      \
+            if (!leftmost && !LESS(*(begin - 1), *begin)) {                                        \
+                begin = pb_partition_left_##Name(begin, end) + 1;                                  \
+                continue;                                                                          \
+            }                                                                                      \
+            bool already;                                                                          \
+            T *pivot_pos = pb_partition_right_##Name(begin, end, &already);                        \
+            int64_t l_size = pivot_pos - begin, r_size = end - (pivot_pos + 1);                    \
+            if (l_size < size / 8 || r_size < size / 8) {                                          \
+                if (--bad_allowed == 0) {                                                          \
+                    pb_heapsort_##Name(begin, size);                                               \
+                    return;                                                                        \
+                }                                                                                  \
+                /* Break up the pattern that made this partition bad. */                           \
+                if (l_size >= PB_INSERTION_SORT_MAX) {                                             \
+                    pb_swap_##Name(begin, begin + l_size / 4);                                     \
+                    pb_swap_##Name(pivot_pos - 1, pivot_pos - l_size / 4);                         \
+                    if (l_size > PB_NINTHER_MIN) {                                                 \
+                        pb_swap_##Name(begin + 1, begin + (l_size / 4 + 1));                       \
+                        pb_swap_##Name(begin + 2, begin + (l_size / 4 + 2));                       \
+                        pb_swap_##Name(pivot_pos - 2, pivot_pos - (l_size / 4 + 1));               \
+                        pb_swap_##Name(pivot_pos - 3, pivot_pos - (l_size / 4 + 2));               \
+                    }                                                                              \
+                }                                                                                  \
+                if (r_size >= PB_INSERTION_SORT_MAX) {                                             \
+                    pb_swap_##Name(pivot_pos + 1, pivot_pos + (1 + r_size / 4));                   \
+                    pb_swap_##Name(end - 1, end - r_size / 4);                                     \
+                    if (r_size > PB_NINTHER_MIN) {                                                 \
+                        pb_swap_##Name(pivot_pos + 2, pivot_pos + (2 + r_size / 4));               \
+                        pb_swap_##Name(pivot_pos + 3, pivot_pos + (3 + r_size / 4));               \
+                        pb_swap_##Name(end - 2, end - (1 + r_size / 4));                           \
+                        pb_swap_##Name(end - 3, end - (2 + r_size / 4));                           \
+                    }                                                                              \
+                }                                                                                  \
+            } else if (already && pb_partial_insertion_sort_##Name(begin, pivot_pos)               \
+                       && pb_partial_insertion_sort_##Name(pivot_pos + 1, end)) {                  \
+                return;                                                                            \
+            }                                                                                      \
+            pb_pdqsort_loop_##Name(begin, pivot_pos, bad_allowed, leftmost);                       \
+            begin = pivot_pos + 1;                                                                 \
+            leftmost = false;                                                                      \
+        }                                                                                          \
+    }                                                                                              \
+    static void pb_pdqsort_##Name(T *data, int64_t n) {                                            \
+        int bad_allowed = 1;                                                                       \
+        for (int64_t m = n; m > 1; m >>= 1) ++bad_allowed;                                         \
+        if (n > 1) pb_pdqsort_loop_##Name(data, data + n, bad_allowed, true);                      \
     }
-    return lst->data[index];
+
+PB_DEFINE_PDQSORT(int, int64_t, PB_LESS_VALUE)
+PB_DEFINE_PDQSORT(float, double, PB_LESS_VALUE)
+typedef const char *pb_cstr;   /* T is pasted into multi-declarator lines */
+PB_DEFINE_PDQSORT(str, pb_cstr, PB_LESS_STR)
+
+/* Eight byte-wide passes over keys with the sign bit flipped, so they
+ * order as unsigned; passes where every key has the same byte are skipped.
+ * Small inputs, or a failed scratch allocation, go to pdqsort instead, and
+ * already sorted ones return after one scan.                                                    */
+static void pb_radix_sort_int(int64_t *data, int64_t n) {
+    int64_t i = 1;
+    while (i < n && data[i - 1] <= data[i]) ++i;
+    if (i >= n) return;
+    uint64_t *tmp = n >= PB_RADIX_MIN ? malloc((size_t)n * sizeof(uint64_t)) : NULL;
+    if (!tmp) {
+        pb_pdqsort_int(data, n);
+        return;
+    }
+
+    const uint64_t sign = UINT64_C(1) << 63;
+    size_t counts[8][256] = {{0}};
+    uint64_t *src = (uint64_t *)data, *dst = tmp;
+    for (i = 0; i < n; ++i) {
+        uint64_t k = src[i] ^ sign;
+        for (int b = 0; b < 8; ++b)
+            counts[b][(k >> (8 * b)) & 0xff]++;
+    }
+    for (int b = 0; b < 8; ++b) {
+        int shift = 8 * b;
+        if (counts[b][((src[0] ^ sign) >> shift) & 0xff] == (size_t)n) continue;
+        size_t offset = 0;
+        for (int d = 0; d < 256; ++d) {
+            size_t c = counts[b][d];
+            counts[b][d] = offset;
+            offset += c;
+        }
+        for (i = 0; i < n; ++i)
+            dst[counts[b][((src[i] ^ sign) >> shift) & 0xff]++] = src[i];
+        uint64_t *t = src;
+        src = dst;
+        dst = t;
+    }
+    if (src != (uint64_t *)data) memcpy(data, src, (size_t)n * sizeof(uint64_t));
+    free(tmp);
 }
 
-void list_str_append(List_str *lst, const char *value) {
-    list_str_grow_if_needed(lst);
-    lst->data[lst->len++] = value;
+void list_int_sort(List_int *xs) { pb_radix_sort_int(xs->data, xs->len); }
+void list_float_sort(List_float *xs) { pb_pdqsort_float(xs->data, xs->len); }
+void list_str_sort(List_str *xs) { pb_pdqsort_str(xs->data, xs->len); }
+
+void list_bool_sort(List_bool *xs) {
+    int64_t falses = 0;
+    for (int64_t i = 0; i < xs->len; ++i)
+        falses += !xs->data[i];
+    for (int64_t i = 0; i < xs->len; ++i)
+        xs->data[i] = i >= falses;
 }
 
-const char *list_str_pop(List_str *lst) {
-    if (lst->len == 0) {
-        char buf[128];
-        snprintf(buf, sizeof(buf), "Cannot pop from empty list");
-        pb_fail(buf);
+#define PB_DEFINE_LIST_SORTED(Name)                                                               \
+    List_##Name list_##Name##_sorted(const List_##Name *xs) {                                      \
+        List_##Name out;                                                                           \
+        list_##Name##_init(&out);                                                                  \
+        list_##Name##_reserve(&out, xs->len);                                                      \
+        if (xs->len > 0) memcpy(out.data, xs->data, (size_t)xs->len * sizeof *xs->data);           \
+        out.len = xs->len;                                                                         \
+        list_##Name##_sort(&out);                                                                  \
+        return out;                                                                                \
     }
-    return lst->data[--lst->len];
+
+PB_DEFINE_LIST_SORTED(int)
+PB_DEFINE_LIST_SORTED(float)
+PB_DEFINE_LIST_SORTED(bool)
+PB_DEFINE_LIST_SORTED(str)
+
+void list_int_print(const List_int *lst) {
+    pb_out_char('[');
+    for (int64_t i = 0; i < lst->len; ++i) {
+        if (i > 0) pb_out_write(", ", 2);
+        pb_out_int(lst->data[i]);
+    }
+    pb_out_char(']');
+    pb_out_endline();
 }
 
-bool list_str_remove(List_str *lst, const char *value) {
+
+void list_float_print(const List_float *lst) {
+    pb_out_char('[');
     for (int64_t i = 0; i < lst->len; ++i) {
-        if (strcmp(lst->data[i], value) == 0) {
-            /* Move elements to the left */
-            for (int64_t j = i; j + 1 < lst->len; ++j) {
-                lst->data[j] = lst->data[j + 1];
-            }
-            lst->len--;
-            return true;
-        }
+        if (i > 0) pb_out_write(", ", 2);
+        pb_out_double(lst->data[i]);
     }
-    return false;
+    pb_out_char(']');
+    pb_out_endline();
 }
 
-void list_str_free(List_str *lst) {
-    if (lst->data) {
-        free(lst->data);
-        lst->data = NULL;
+
+void list_bool_print(const List_bool *lst) {
+    pb_out_char('[');
+    for (int64_t i = 0; i < lst->len; ++i) {
+        if (i > 0) pb_out_write(", ", 2);
+        pb_out_str(lst->data[i] ? "True" : "False");
     }
-    lst->len = 0;
-    lst->capacity = 0;
+    pb_out_char(']');
+    pb_out_endline();
 }
 
+
 void list_str_print(const List_str *lst) {
     assert(lst != NULL && "list is NULL");
     assert(lst->data != NULL && "list data is NULL");
 
-    printf("[");
+    pb_out_char('[');
     for (int64_t i = 0; i < lst->len; ++i) {
         const char *s = lst->data[i];
         assert(s != NULL && "list element is NULL");
 
-        if (i > 0) printf(", ");
+        if (i > 0) pb_out_write(", ", 2);
 
-        bool has_single_quote = strchr(s, '\'') != NULL;
-        if (has_single_quote) {
-            printf("\"%s\"", s);
-        } else {
-            printf("'%s'", s);
+        char quote = strchr(s, '\'') != NULL ? '"' : '\'';
+        pb_out_char(quote);
+        pb_out_str(s);
+        pb_out_char(quote);
+    }
+    pb_out_char(']');
+    pb_out_endline();
+}
+
+/* ------------ SET ------------- */
+
+bool pb_bitset_init_range(PbBitset *b, int64_t lo, int64_t hi) {
+    uint64_t span = (uint64_t)hi - (uint64_t)lo + 1;
+    b->base = lo;
+    b->nbits = 0;
+    b->words = NULL;
+    if (hi < lo || span > (uint64_t)PB_BITSET_MAX_SPAN) return false;
+    b->words = calloc((size_t)((span + 63) / 64), sizeof(uint64_t));
+    if (!b->words) return false;
+    b->nbits = (int64_t)span;
+    return true;
+}
+
+void pb_bitset_free(PbBitset *b) {
+    free(b->words);
+    b->words = NULL;
+    b->nbits = 0;
+}
+
+#define PB_EQ_SCALAR(a, b) ((a) == (b))
+
+/* Typed set implementation. HASH and EQ must agree: equal values hash alike.
+ * Hashes cached in one set are reused when probing another, so the set
+ * algebra kernels never rehash an element.                               */
+#define PB_SET_DEFINE(Name, CType, HASH, EQ)                                            \
+void set_##Name##_init(Set_##Name *s) {                                                 \
+    memset(s, 0, sizeof(*s));                                                           \
+}                                                                                       \
+                                                                                        \
+/* Return the entry number holding `value`, or -1; `*slot_out` gets its slot. */        \
+static int64_t set_##Name##_find(const Set_##Name *s, CType value, uint64_t hash,       \
+                                 int64_t *slot_out) {                                   \
+    const PbHashIndex *ix = &s->index;                                                  \
+    if (ix->capacity == 0) return -1;                                                   \
+    uint64_t mask = (uint64_t)(2 * ix->capacity - 1);                                   \
+    for (uint64_t i = hash & mask;; i = (i + 1) & mask) {                               \
+        int64_t e = ix->slots[i];                                                       \
+        if (e < 0) return -1;                                                           \
+        if (ix->hashes[e] == hash && EQ(s->data[e], value)) {                           \
+            if (slot_out) *slot_out = (int64_t)i;                                       \
+            return e;                                                                   \
+        }                                                                               \
+    }                                                                                   \
+}                                                                                       \
+                                                                                        \
+static void set_##Name##_reserve(Set_##Name *s, int64_t n) {                            \
+    PbHashIndex *ix = &s->index;                                                        \
+    if (n <= ix->capacity) return;                                                      \
+    int64_t capacity = ix->capacity ? ix->capacity : INITIAL_SET_CAPACITY;              \
+    while (capacity < n) {                                                              \
+        capacity *= 2;                                                                  \
+    }                                                                                   \
+    CType *new_data = realloc(s->data, (size_t)capacity * sizeof(CType));               \
+    uint64_t *new_hashes = realloc(ix->hashes, (size_t)capacity * sizeof(uint64_t));    \
+    int64_t *new_slots = realloc(ix->slots, (size_t)(2 * capacity) * sizeof(int64_t));  \
+    if (!new_data || !new_hashes || !new_slots) {                                       \
+        char buf[128];                                                                  \
+        snprintf(buf, sizeof(buf),                                                      \
+            "Failed to allocate memory while growing set[%s]: old capacity = %" PRId64, \
+            #Name, ix->capacity);                                                       \
+        pb_fail(buf);                                                                   \
+    }                                                                                   \
+    s->data = new_data;                                                                 \
+    ix->hashes = new_hashes;                                                            \
+    ix->slots = new_slots;                                                              \
+    ix->capacity = capacity;                                                            \
+    memset(ix->slots, 0xff, (size_t)(2 * capacity) * sizeof(int64_t));   /* all -1 */   \
+    for (int64_t e = 0; e < s->len; ++e) {                                              \
+        pb_hash_link(ix, e);                                                            \
+    }                                                                                   \
+}                                                                                       \
+                                                                                        \
+/* Append a value already known to be absent. */                                       \
+static void set_##Name##_push(Set_##Name *s, CType value, uint64_t hash) {              \
+    set_##Name##_reserve(s, s->len + 1);                                                \
+    int64_t e = s->len++;                                                               \
+    s->data[e] = value;                                                                 \
+    s->index.hashes[e] = hash;                                                          \
+    s->index.used = s->len;                                                             \
+    pb_hash_link(&s->index, e);                                                         \
+}                                                                                       \
+                                                                                        \
+bool set_##Name##_add(Set_##Name *s, CType value) {                                     \
+    uint64_t hash = HASH(value);                                                        \
+    if (set_##Name##_find(s, value, hash, NULL) >= 0) return false;                     \
+    set_##Name##_push(s, value, hash);                                                  \
+    return true;                                                                        \
+}                                                                                       \
+                                                                                        \
+bool set_##Name##_contains(const Set_##Name *s, CType value) {                          \
+    return set_##Name##_find(s, value, HASH(value), NULL) >= 0;                         \
+}                                                                                       \
+                                                                                        \
+bool set_##Name##_discard(Set_##Name *s, CType value) {                                 \
+    PbHashIndex *ix = &s->index;                                                        \
+    int64_t slot;                                                                       \
+    int64_t e = set_##Name##_find(s, value, HASH(value), &slot);                        \
+    if (e < 0) return false;                                                            \
+    pb_hash_unlink(ix, slot);                                                           \
+    int64_t last = --s->len;                                                            \
+    ix->used = s->len;                                                                  \
+    if (e != last) {                                                                    \
+        /* Move the last element into the hole and repoint its slot. */                 \
+        uint64_t mask = (uint64_t)(2 * ix->capacity - 1);                               \
+        uint64_t i = ix->hashes[last] & mask;                                           \
+        while (ix->slots[i] != last) {                                                  \
+            i = (i + 1) & mask;                                                         \
+        }                                                                               \
+        ix->slots[i] = e;                                                               \
+        s->data[e] = s->data[last];                                                     \
+        ix->hashes[e] = ix->hashes[last];                                               \
+    }                                                                                   \
+    return true;                                                                        \
+}                                                                                       \
+                                                                                        \
+static Set_##Name set_##Name##_from_array_hashed(const CType *values, int64_t n) {      \
+    Set_##Name s;                                                                       \
+    set_##Name##_init(&s);                                                              \
+    set_##Name##_reserve(&s, n);                                                        \
+    for (int64_t i = 0; i < n; ++i) {                                                   \
+        set_##Name##_add(&s, values[i]);                                                \
+    }                                                                                   \
+    return s;                                                                           \
+}                                                                                       \
+                                                                                        \
+Set_##Name set_##Name##_from_list(const List_##Name *lst) {                             \
+    return set_##Name##_from_array(lst->data, lst->len);                                \
+}                                                                                       \
+                                                                                        \
+Set_##Name set_##Name##_union(const Set_##Name *a, const Set_##Name *b) {               \
+    Set_##Name r;                                                                       \
+    set_##Name##_init(&r);                                                              \
+    set_##Name##_reserve(&r, a->len + b->len);                                          \
+    for (int64_t i = 0; i < a->len; ++i) {                                              \
+        set_##Name##_push(&r, a->data[i], a->index.hashes[i]);                          \
+    }                                                                                   \
+    for (int64_t i = 0; i < b->len; ++i) {                                              \
+        if (set_##Name##_find(&r, b->data[i], b->index.hashes[i], NULL) < 0) {          \
+            set_##Name##_push(&r, b->data[i], b->index.hashes[i]);                      \
+        }                                                                               \
+    }                                                                                   \
+    return r;                                                                           \
+}                                                                                       \
+                                                                                        \
+Set_##Name set_##Name##_intersection(const Set_##Name *a, const Set_##Name *b) {        \
+    /* Walk the smaller side and probe the larger one. */                              \
+    const Set_##Name *small = a->len <= b->len ? a : b;                                 \
+    const Set_##Name *large = a->len <= b->len ? b : a;                                 \
+    Set_##Name r;                                                                       \
+    set_##Name##_init(&r);                                                              \
+    for (int64_t i = 0; i < small->len; ++i) {                                          \
+        uint64_t hash = small->index.hashes[i];                                         \
+        if (set_##Name##_find(large, small->data[i], hash, NULL) >= 0) {                \
+            set_##Name##_push(&r, small->data[i], hash);                                \
+        }                                                                               \
+    }                                                                                   \
+    return r;                                                                           \
+}                                                                                       \
+                                                                                        \
+Set_##Name set_##Name##_difference(const Set_##Name *a, const Set_##Name *b) {          \
+    Set_##Name r;                                                                       \
+    set_##Name##_init(&r);                                                              \
+    for (int64_t i = 0; i < a->len; ++i) {                                              \
+        uint64_t hash = a->index.hashes[i];                                             \
+        if (set_##Name##_find(b, a->data[i], hash, NULL) < 0) {                         \
+            set_##Name##_push(&r, a->data[i], hash);                                    \
+        }                                                                               \
+    }                                                                                   \
+    return r;                                                                           \
+}                                                                                       \
+                                                                                        \
+void set_##Name##_free(Set_##Name *s) {                                                 \
+    free(s->data);                                                                      \
+    free(s->index.slots);                                                               \
+    free(s->index.hashes);                                                              \
+    set_##Name##_init(s);                                                               \
+}
+
+PB_SET_DEFINE(int, int64_t, pb_hash_int, PB_EQ_SCALAR)
+PB_SET_DEFINE(float, double, pb_hash_float, PB_EQ_SCALAR)
+PB_SET_DEFINE(bool, bool, pb_hash_bool, PB_EQ_SCALAR)
+PB_SET_DEFINE(str, const char *, pb_hash_str, PB_EQ_STR)
+
+/* Integers drawn from a narrow range (IDs, indices) are deduplicated with a
+ * bitset in one linear pass; the hash index is then built without any
+ * probing for duplicates. Wide or tiny inputs take the hashed path.      */
+Set_int set_int_from_array(const int64_t *values, int64_t n) {
+    if (n < 32) return set_int_from_array_hashed(values, n);
+
+    int64_t lo = values[0], hi = values[0];
+    for (int64_t i = 1; i < n; ++i) {
+        if (values[i] < lo) lo = values[i];
+        if (values[i] > hi) hi = values[i];
+    }
+    PbBitset seen;
+    if ((uint64_t)hi - (uint64_t)lo >= (uint64_t)n * 64 || !pb_bitset_init_range(&seen, lo, hi)) {
+        return set_int_from_array_hashed(values, n);
+    }
+
+    Set_int s;
+    set_int_init(&s);
+    set_int_reserve(&s, n);
+    for (int64_t i = 0; i < n; ++i) {
+        if (pb_bitset_insert(&seen, values[i])) {
+            set_int_push(&s, values[i], pb_hash_int(values[i]));
         }
     }
-    printf("]\n");
+    pb_bitset_free(&seen);
+    return s;
+}
+
+Set_float set_float_from_array(const double *values, int64_t n) {
+    return set_float_from_array_hashed(values, n);
+}
+
+Set_bool set_bool_from_array(const bool *values, int64_t n) {
+    return set_bool_from_array_hashed(values, n);
+}
+
+Set_str set_str_from_array(const char *const *values, int64_t n) {
+    return set_str_from_array_hashed((const char **)values, n);
 }
 
 void set_int_print(const Set_int *s) {
-    printf("{");
+    pb_out_char('{');
     for (int64_t i = 0; i < s->len; ++i) {
-        if (i > 0) printf(", ");
-        printf("%" PRId64, s->data[i]);
+        if (i > 0) pb_out_write(", ", 2);
+        pb_out_int(s->data[i]);
     }
-    printf("}\n");
+    pb_out_char('}');
+    pb_out_endline();
 }
 
 void set_float_print(const Set_float *s) {
-    printf("{");
+    pb_out_char('{');
     for (int64_t i = 0; i < s->len; ++i) {
-        if (i > 0) printf(", ");
-        printf("%g", s->data[i]);
+        if (i > 0) pb_out_write(", ", 2);
+        pb_out_double(s->data[i]);
     }
-    printf("}\n");
+    pb_out_char('}');
+    pb_out_endline();
 }
 
 void set_bool_print(const Set_bool *s) {
-    printf("{");
+    pb_out_char('{');
     for (int64_t i = 0; i < s->len; ++i) {
-        if (i > 0) printf(", ");
-        printf(s->data[i] ? "True" : "False");
+        if (i > 0) pb_out_write(", ", 2);
+        pb_out_str(s->data[i] ? "True" : "False");
     }
-    printf("}\n");
+    pb_out_char('}');
+    pb_out_endline();
 }
 
 void set_str_print(const Set_str *s) {
-    printf("{");
+    pb_out_char('{');
     for (int64_t i = 0; i < s->len; ++i) {
         const char *str = s->data[i];
-        if (i > 0) printf(", ");
-        bool has_single_quote = strchr(str, '\'') != NULL;
-        if (has_single_quote) {
-            printf("\"%s\"", str);
-        } else {
-            printf("'%s'", str);
+        if (i > 0) pb_out_write(", ", 2);
+        char quote = strchr(str, '\'') != NULL ? '"' : '\'';
+        pb_out_char(quote);
+        pb_out_str(str);
+        pb_out_char(quote);
+    }
+    pb_out_char('}');
+    pb_out_endline();
+}
+
+/* ------------ DICT ------------- */
+
+/* Every Pair_str_* starts with its key, so the type-erased core below can
+ * read keys out of any entry array given only the entry size.            */
+#define PB_DICT_KEY(data, entry_size, e) \
+    (*(const char *const *)((const char *)(data) + (size_t)(e) * (entry_size)))
+
+// Return the entry number holding `key`, or -1 if it is absent.
+// On a hit `*slot_out` receives the probe slot pointing at the entry.
+static int64_t pb_dict_find(const PbHashIndex *ix, const void *data, size_t entry_size,
+                            const char *key, uint64_t hash, int64_t *slot_out) {
+    if (ix->capacity == 0) return -1;
+    uint64_t mask = (uint64_t)(2 * ix->capacity - 1);
+    for (uint64_t i = hash & mask;; i = (i + 1) & mask) {
+        int64_t e = ix->slots[i];
+        if (e < 0) {
+            PB_STAT(pb_prof_probe(((i - hash) & mask) + 1));
+            return -1;
+        }
+        if (ix->hashes[e] == hash && pb_str_eq(PB_DICT_KEY(data, entry_size, e), key)) {
+            PB_STAT(pb_prof_probe(((i - hash) & mask) + 1));
+            if (slot_out) *slot_out = (int64_t)i;
+            return e;
         }
     }
-    printf("}\n");
 }
 
+// Squeeze out deleted entries (keeping insertion order), make room for at
+// least `min_capacity` entries and rebuild the probe slots.
+// Returns the possibly moved entry array.
+static void *pb_dict_resize(PbHashIndex *ix, void *data, size_t entry_size, int64_t min_capacity) {
+    char *bytes = data;
+    int64_t live = 0;
+    for (int64_t e = 0; e < ix->used; ++e) {
+        if (PB_DICT_KEY(bytes, entry_size, e) == NULL) continue;
+        if (live != e) {
+            memcpy(bytes + (size_t)live * entry_size, bytes + (size_t)e * entry_size, entry_size);
+            ix->hashes[live] = ix->hashes[e];
+        }
+        live++;
+    }
 
-/* ------------ DICT ------------- */
+    int64_t capacity = INITIAL_DICT_CAPACITY;
+    while (capacity < min_capacity || capacity < live) {
+        capacity *= 2;
+    }
+    if (capacity != ix->capacity) {
+        char *new_data = realloc(bytes, (size_t)capacity * entry_size);
+        uint64_t *new_hashes = realloc(ix->hashes, (size_t)capacity * sizeof(uint64_t));
+        int64_t *new_slots = realloc(ix->slots, (size_t)(2 * capacity) * sizeof(int64_t));
+        if (!new_data || !new_hashes || !new_slots) {
+            char buf[128];
+            snprintf(buf, sizeof(buf),
+                "Failed to allocate memory while growing dict: old capacity = %" PRId64,
+                ix->capacity);
+            pb_fail(buf);
+        }
+        bytes = new_data;
+        ix->hashes = new_hashes;
+        ix->slots = new_slots;
+        ix->capacity = capacity;
+    }
+    ix->used = live;
 
-int64_t pb_dict_get_str_int(Dict_str_int d, const char *key) {
-    for (int64_t i = 0; i < d.len; ++i) {
-        if (strcmp(d.data[i].key, key) == 0) return d.data[i].value;
+    memset(ix->slots, 0xff, (size_t)(2 * capacity) * sizeof(int64_t));   /* all -1 */
+    for (int64_t e = 0; e < live; ++e) {
+        pb_hash_link(ix, e);
     }
-    char buf[128];
-    snprintf(buf, sizeof(buf),
-        "Key '%s' not found in dict[%s]", key, "str->int");
-    pb_fail(buf);
-    return 0;
+    return bytes;
+}
+
+// Make sure one more entry can be appended. Doubles the storage when at
+// least half of it is live, otherwise just compacts deleted entries away.
+static void *pb_dict_reserve_one(PbHashIndex *ix, void *data, size_t entry_size, int64_t len) {
+    if (ix->used < ix->capacity) return data;
+    int64_t target = (len * 2 >= ix->capacity) ? ix->capacity * 2 : ix->capacity;
+    return pb_dict_resize(ix, data, entry_size, target);
+}
+
+static void pb_key_error(const char *key, const char *type) {
+    char buf[256];
+    snprintf(buf, sizeof(buf), "Key '%s' not found in dict[%s]", key, type);
+    pb_raise_msg("KeyError", pb_strdup(buf));
+}
+
+/* Typed front-ends over the shared core, one set per specialization. */
+#define PB_DICT_DEFINE(Name, CType, TypeLabel)                                          \
+void pb_dict_init_str_##Name(Dict_str_##Name *d) {                                      \
+    memset(d, 0, sizeof(*d));                                                           \
+}                                                                                       \
+                                                                                        \
+void pb_dict_set_str_##Name(Dict_str_##Name *d, const char *key, CType value) {         \
+    uint64_t hash = pb_hash_str(key);                                                   \
+    int64_t e = pb_dict_find(&d->index, d->data, sizeof(Pair_str_##Name), key, hash, NULL); \
+    if (e >= 0) {                                                                       \
+        d->data[e].value = value;                                                       \
+        return;                                                                         \
+    }                                                                                   \
+    d->data = pb_dict_reserve_one(&d->index, d->data, sizeof(Pair_str_##Name), d->len); \
+    e = d->index.used++;                                                                \
+    d->data[e].key = key;                                                               \
+    d->data[e].value = value;                                                           \
+    d->index.hashes[e] = hash;                                                          \
+    pb_hash_link(&d->index, e);                                                         \
+    d->len++;                                                                           \
+}                                                                                       \
+                                                                                        \
+Dict_str_##Name pb_dict_from_pairs_str_##Name(const Pair_str_##Name *pairs, int64_t n) { \
+    Dict_str_##Name d;                                                                  \
+    pb_dict_init_str_##Name(&d);                                                        \
+    if (n > 0) {                                                                        \
+        d.data = pb_dict_resize(&d.index, NULL, sizeof(Pair_str_##Name), n);            \
+    }                                                                                   \
+    for (int64_t i = 0; i < n; ++i) {                                                   \
+        pb_dict_set_str_##Name(&d, pairs[i].key, pairs[i].value);                       \
+    }                                                                                   \
+    return d;                                                                           \
+}                                                                                       \
+                                                                                        \
+CType pb_dict_get_str_##Name(const Dict_str_##Name *d, const char *key) {               \
+    int64_t e = pb_dict_find(&d->index, d->data, sizeof(Pair_str_##Name),               \
+                             key, pb_hash_str(key), NULL);                              \
+    if (e < 0) {                                                                        \
+        pb_key_error(key, TypeLabel);                                                   \
+        return (CType)0;                                                                \
+    }                                                                                   \
+    return d->data[e].value;                                                            \
+}                                                                                       \
+                                                                                        \
+bool pb_dict_contains_str_##Name(const Dict_str_##Name *d, const char *key) {           \
+    return pb_dict_find(&d->index, d->data, sizeof(Pair_str_##Name),                    \
+                        key, pb_hash_str(key), NULL) >= 0;                              \
+}                                                                                       \
+                                                                                        \
+bool pb_dict_del_str_##Name(Dict_str_##Name *d, const char *key) {                      \
+    int64_t slot;                                                                       \
+    int64_t e = pb_dict_find(&d->index, d->data, sizeof(Pair_str_##Name),               \
+                             key, pb_hash_str(key), &slot);                             \
+    if (e < 0) return false;                                                            \
+    pb_hash_unlink(&d->index, slot);                                                    \
+    d->data[e].key = NULL;                                                              \
+    d->len--;                                                                           \
+    return true;                                                                        \
+}                                                                                       \
+                                                                                        \
+void pb_dict_free_str_##Name(Dict_str_##Name *d) {                                      \
+    free(d->data);                                                                      \
+    free(d->index.slots);                                                               \
+    free(d->index.hashes);                                                              \
+    pb_dict_init_str_##Name(d);                                                         \
+}
+
+PB_DICT_DEFINE(int, int64_t, "str->int")
+PB_DICT_DEFINE(float, double, "str->float")
+PB_DICT_DEFINE(bool, bool, "str->bool")
+PB_DICT_DEFINE(str, const char *, "str->str")
+
+/* ------------ RANDOM ------------- */
+
+/* Generators are xoshiro256** (Blackman and Vigna), seeded through
+ * splitmix64. seed() publishes a new `pb_rng_seed` and bumps
+ * `pb_rng_epoch`. A thread whose state is older than the current epoch
+ * reseeds before its next draw and takes the next stream ticket. Stream k
+ * is the seed's stream 0 jumped k times.                               */
+static uint64_t pb_rng_seed = 0;
+static uint64_t pb_rng_epoch = 1;
+static uint64_t pb_rng_tickets = 0;
+static PB_THREAD_LOCAL uint64_t pb_rng[4];
+static PB_THREAD_LOCAL uint64_t pb_rng_seen = 0;   /* epoch of this thread's state */
+
+#if defined(__SIZEOF_INT128__)
+__extension__ typedef unsigned __int128 pb_u128;
+#endif
+
+static inline uint64_t pb_rotl64(uint64_t x, int k) {
+    return (x << k) | (x >> (64 - k));
+}
+
+static uint64_t pb_splitmix64(uint64_t *x) {
+    uint64_t z = (*x += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+static inline uint64_t pb_xoshiro_next(uint64_t s[4]) {
+    uint64_t result = pb_rotl64(s[1] * 5, 7) * 9;
+    uint64_t t = s[1] << 17;
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = pb_rotl64(s[3], 45);
+    return result;
+}
+
+/* Advance `s` by 2^128 draws. */
+static void pb_xoshiro_jump(uint64_t s[4]) {
+    static const uint64_t JUMP[4] = {0x180ec6d33cfd0abaULL, 0xd5a61266f0c9392cULL,
+                                     0xa9582618e03fc9aaULL, 0x39abdc4529b1661cULL};
+    uint64_t t[4] = {0, 0, 0, 0};
+    for (int i = 0; i < 4; ++i)
+        for (int b = 0; b < 64; ++b) {
+            if (JUMP[i] & (UINT64_C(1) << b))
+                for (int w = 0; w < 4; ++w) t[w] ^= s[w];
+            pb_xoshiro_next(s);
+        }
+    memcpy(s, t, sizeof t);
+}
+
+static void pb_rng_start(uint64_t seed, uint64_t stream) {
+    for (int w = 0; w < 4; ++w) pb_rng[w] = pb_splitmix64(&seed);
+    while (stream--) pb_xoshiro_jump(pb_rng);
+}
+
+PB_COLD static void pb_rng_reseed(uint64_t epoch) {
+    uint64_t stream = __atomic_fetch_add(&pb_rng_tickets, 1, __ATOMIC_RELAXED);
+    pb_rng_start(__atomic_load_n(&pb_rng_seed, __ATOMIC_RELAXED), stream);
+    pb_rng_seen = epoch;
+}
+
+static inline uint64_t pb_rng_next(void) {
+    uint64_t epoch = __atomic_load_n(&pb_rng_epoch, __ATOMIC_ACQUIRE);
+    if (PB_UNLIKELY(pb_rng_seen != epoch)) pb_rng_reseed(epoch);
+    return pb_xoshiro_next(pb_rng);
 }
 
-const char* pb_dict_get_str_str(Dict_str_str d, const char *key) {
-    for (int64_t i = 0; i < d.len; ++i) {
-        if (strcmp(d.data[i].key, key) == 0) return d.data[i].value;
+/* High 64 bits of a * b; the low ones go to *lo. */
+static inline uint64_t pb_mulhi64(uint64_t a, uint64_t b, uint64_t *lo) {
+#if defined(__SIZEOF_INT128__)
+    pb_u128 p = (pb_u128)a * b;
+    *lo = (uint64_t)p;
+    return (uint64_t)(p >> 64);
+#else
+    uint64_t a_lo = a & 0xffffffffu, a_hi = a >> 32, b_lo = b & 0xffffffffu, b_hi = b >> 32;
+    uint64_t ll = a_lo * b_lo, lh = a_lo * b_hi, hl = a_hi * b_lo;
+    uint64_t mid = (ll >> 32) + (lh & 0xffffffffu) + (hl & 0xffffffffu);
+    *lo = (mid << 32) | (ll & 0xffffffffu);
+    return a_hi * b_hi + (lh >> 32) + (hl >> 32) + (mid >> 32);
+#endif
+}
+
+/* `x` mapped onto [0, span) without bias: Lemire's multiply-shift, which
+ * needs a fresh draw for fewer than span / 2^64 of its inputs.          */
+static inline uint64_t pb_rng_below(uint64_t x, uint64_t span) {
+    uint64_t lo, hi = pb_mulhi64(x, span, &lo);
+    if (PB_UNLIKELY(lo < span)) {
+        uint64_t threshold = (0 - span) % span;
+        while (lo < threshold) hi = pb_mulhi64(pb_rng_next(), span, &lo);
+    }
+    return hi;
+}
+
+PB_COLD PB_NORETURN static void pb_random_range_error(const char *fn, int64_t a, int64_t b) {
+    pb_raise_msg("ValueError", pb_fstring(64, "empty range for %s(%" PRId64 ", %" PRId64 ")", fn, a, b));
+}
+
+PB_COLD PB_NORETURN static void pb_random_fill_error(const char *fn, int64_t n, int64_t len) {
+    pb_raise_msg("ValueError", pb_fstring(80, "%s(): n must be between 0 and len(xs) (%" PRId64 "), got %" PRId64,
+                                          fn, len, n));
+}
+
+void pb_random_seed(int64_t x) {
+    uint64_t epoch = __atomic_load_n(&pb_rng_epoch, __ATOMIC_RELAXED) + 1;
+    __atomic_store_n(&pb_rng_seed, (uint64_t)x, __ATOMIC_RELAXED);
+    __atomic_store_n(&pb_rng_tickets, (uint64_t)1, __ATOMIC_RELAXED);   /* stream 0 is ours */
+    __atomic_store_n(&pb_rng_epoch, epoch, __ATOMIC_RELEASE);
+    pb_rng_start((uint64_t)x, 0);
+    pb_rng_seen = epoch;
+}
+
+double pb_random_random(void) {
+    return (double)(pb_rng_next() >> 11) * 0x1.0p-53;
+}
+
+int64_t pb_random_randint(int64_t a, int64_t b) {
+    if (PB_UNLIKELY(a > b)) pb_random_range_error("randint", a, b);
+    uint64_t span = (uint64_t)b - (uint64_t)a + 1;   /* 0: every int64 */
+    uint64_t x = pb_rng_next();
+    return (int64_t)((uint64_t)a + (span ? pb_rng_below(x, span) : x));
+}
+
+double pb_random_uniform(double a, double b) {
+    return a + (b - a) * pb_random_random();
+}
+
+/* --- batches --- */
+
+#define PB_RNG_LANES 4
+#define PB_RNG_ONE_BITS 0x3ff0000000000000ULL   /* 1.0: a draw's top 52 bits fill its mantissa */
+
+/* Four generators stored word-major: s[w][lane] is word w of `lane`. */
+typedef struct { uint64_t s[4][PB_RNG_LANES]; } PbRngLanes;
+
+static void pb_rng_lanes_seed(PbRngLanes *g) {
+    for (int lane = 0; lane < PB_RNG_LANES; ++lane) {
+        uint64_t x = pb_rng_next();
+        for (int w = 0; w < 4; ++w) g->s[w][lane] = pb_splitmix64(&x);
     }
-    char buf[128];
-    snprintf(buf, sizeof(buf),
-        "Key '%s' not found in dict[%s]", key, "str->str");
-    pb_fail(buf);
-    return "";
 }
 
-double pb_dict_get_str_float(Dict_str_float d, const char *key) {
-    for (int64_t i = 0; i < d.len; ++i) {
-        if (strcmp(d.data[i].key, key) == 0) return d.data[i].value;
+/* One draw from every lane */
+static inline void pb_rng_lanes_step(PbRngLanes *g, uint64_t out[PB_RNG_LANES]) {
+    for (int lane = 0; lane < PB_RNG_LANES; ++lane) {
+        uint64_t s1 = g->s[1][lane], t = s1 << 17;
+        out[lane] = pb_rotl64(s1 * 5, 7) * 9;
+        g->s[2][lane] ^= g->s[0][lane];
+        g->s[3][lane] ^= s1;
+        g->s[1][lane] = s1 ^ g->s[2][lane];
+        g->s[0][lane] ^= g->s[3][lane];
+        g->s[2][lane] ^= t;
+        g->s[3][lane] = pb_rotl64(g->s[3][lane], 45);
     }
-    char buf[128];
-    snprintf(buf, sizeof(buf),
-        "Key '%s' not found in dict[%s]", key, "str->float");
-    pb_fail(buf);
-    return 0.0;
 }
 
-bool pb_dict_get_str_bool(Dict_str_bool d, const char *key) {
-    for (int64_t i = 0; i < d.len; ++i) {
-        if (strcmp(d.data[i].key, key) == 0) return d.data[i].value;
+#if PB_SIMD_X86
+#define PB_ROTL256(x, k) _mm256_or_si256(_mm256_slli_epi64(x, k), _mm256_srli_epi64(x, 64 - (k)))
+
+/* The lanes of pb_rng_lanes_step as one AVX2 register per word; the
+ * multiplies by 5 and 9 are a shift and an add. Stops at a multiple of
+ * PB_RNG_LANES and returns where it stopped.                           */
+PB_AVX2 static int64_t pb_rng_fill_avx2(PbRngLanes *g, void *out, int64_t n, bool unit) {
+    __m256i s0 = PB_LD256_int(g->s[0]), s1 = PB_LD256_int(g->s[1]);
+    __m256i s2 = PB_LD256_int(g->s[2]), s3 = PB_LD256_int(g->s[3]);
+    const __m256i one_bits = _mm256_set1_epi64x((long long)PB_RNG_ONE_BITS);
+    const __m256d one = _mm256_set1_pd(1.0);
+    int64_t i = 0;
+    for (; i + PB_RNG_LANES <= n; i += PB_RNG_LANES) {
+        __m256i x5 = _mm256_add_epi64(_mm256_slli_epi64(s1, 2), s1);
+        __m256i r = PB_ROTL256(x5, 7);
+        r = _mm256_add_epi64(_mm256_slli_epi64(r, 3), r);
+        __m256i t = _mm256_slli_epi64(s1, 17);
+        s2 = _mm256_xor_si256(s2, s0);
+        s3 = _mm256_xor_si256(s3, s1);
+        s1 = _mm256_xor_si256(s1, s2);
+        s0 = _mm256_xor_si256(s0, s3);
+        s2 = _mm256_xor_si256(s2, t);
+        s3 = PB_ROTL256(s3, 45);
+        if (unit) {
+            __m256d d = _mm256_castsi256_pd(_mm256_or_si256(_mm256_srli_epi64(r, 12), one_bits));
+            _mm256_storeu_pd((double *)out + i, _mm256_sub_pd(d, one));
+        } else {
+            PB_ST256_int((uint64_t *)out + i, r);
+        }
     }
-    char buf[128];
-    snprintf(buf, sizeof(buf),
-        "Key '%s' not found in dict[%s]", key, "str->bool");
-    pb_fail(buf);
-    return false;
+    PB_ST256_int(g->s[0], s0);
+    PB_ST256_int(g->s[1], s1);
+    PB_ST256_int(g->s[2], s2);
+    PB_ST256_int(g->s[3], s3);
+    return i;
+}
+#endif
+
+/* out[0..n) from the lanes, element i from lane i % PB_RNG_LANES: raw
+ * draws, or with `unit` doubles in [0, 1) (`out` is then a double *).  */
+static void pb_rng_lanes_fill(PbRngLanes *g, void *out, int64_t n, bool unit) {
+    int64_t i = 0;
+#if PB_SIMD_X86
+    if (pb_cpu_avx2()) i = pb_rng_fill_avx2(g, out, n, unit);
+#endif
+    uint64_t r[PB_RNG_LANES];
+    for (; i < n; i += PB_RNG_LANES) {
+        pb_rng_lanes_step(g, r);
+        for (int lane = 0; lane < PB_RNG_LANES && i + lane < n; ++lane) {
+            if (unit) {
+                uint64_t bits = (r[lane] >> 12) | PB_RNG_ONE_BITS;
+                double d;
+                memcpy(&d, &bits, sizeof d);
+                ((double *)out)[i + lane] = d - 1.0;
+            } else {
+                ((uint64_t *)out)[i + lane] = r[lane];
+            }
+        }
+    }
+}
+
+void pb_random_fill_floats(List_float xs, int64_t n) {
+    if (PB_UNLIKELY(n < 0 || n > xs.len)) pb_random_fill_error("fill_floats", n, xs.len);
+    if (n == 0) return;
+    PbRngLanes g;
+    pb_rng_lanes_seed(&g);
+    pb_rng_lanes_fill(&g, xs.data, n, true);
+}
+
+void pb_random_fill_ints(List_int xs, int64_t n, int64_t a, int64_t b) {
+    if (PB_UNLIKELY(n < 0 || n > xs.len)) pb_random_fill_error("fill_ints", n, xs.len);
+    if (PB_UNLIKELY(a > b)) pb_random_range_error("fill_ints", a, b);
+    if (n == 0) return;
+    PbRngLanes g;
+    pb_rng_lanes_seed(&g);
+    pb_rng_lanes_fill(&g, xs.data, n, false);
+    uint64_t span = (uint64_t)b - (uint64_t)a + 1;
+    if (span == 0) return;   /* every int64: the raw draws already are */
+    for (int64_t i = 0; i < n; ++i)
+        xs.data[i] = (int64_t)((uint64_t)a + pb_rng_below((uint64_t)xs.data[i], span));
 }
@@ -10,62 +10,451 @@
 #include <inttypes.h>
 #include <assert.h>
 
+/* Branch hints and function attributes; they expand to nothing on
+ * compilers without the GNU extensions.                              */
+#if defined(__GNUC__)
+#define PB_LIKELY(x)   __builtin_expect(!!(x), 1)
+#define PB_UNLIKELY(x) __builtin_expect(!!(x), 0)
+#define PB_COLD        __attribute__((cold, noinline))
+#define PB_NORETURN    __attribute__((noreturn))
+#else
+#define PB_LIKELY(x)   (x)
+#define PB_UNLIKELY(x) (x)
+#define PB_COLD
+#define PB_NORETURN
+#endif
+
+/* Storage class of the runtime's per-thread state: C11 _Thread_local,
+ * or the compiler's own spelling when building as C99.              */
+#if defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L
+#define PB_THREAD_LOCAL _Thread_local
+#elif defined(__GNUC__)
+#define PB_THREAD_LOCAL __thread
+#elif defined(_MSC_VER)
+#define PB_THREAD_LOCAL __declspec(thread)
+#else
+#define PB_THREAD_LOCAL   /* no TLS: single-threaded use only */
+#endif
+
+/* ------------ OUTPUT ------------- */
+
+/* Buffered stdout shared by every print helper. Each thread fills its
+ * own buffer, so threads interleave output only at flushes. The text is
+ * written out when the buffer fills, on pb_out_flush() and at exit
+ * (pb_fail flushes before reporting). Line mode also flushes after every
+ * printed line; it is enabled per thread by pb_out_set_line_buffered(true)
+ * or everywhere by running with PB_LINE_BUFFERED=1 in the environment. */
+#define PB_OUT_BUF_SIZE (64 * 1024)
+void pb_out_write(const char *s, size_t n);
+void pb_out_str(const char *s);
+void pb_out_char(char c);
+void pb_out_int(int64_t x);
+void pb_out_double(double x);
+void pb_out_flush(void);
+void pb_out_set_line_buffered(bool on);
+
 /* ------------ PRINT ------------- */
 
 void pb_print_int(int64_t x);    
 void pb_print_double(double x);  
 void pb_print_str(const char *s);
 void pb_print_bool(bool b);      
-
+/* printf-style print with a trailing newline; used for print(f"...") */
+void pb_print_fmt(const char *fmt, ...);
+
+/* Number formatting into a caller buffer of at least PB_FMT_BUF bytes;
+ * returns the length written (excluding the terminator). Doubles use the
+ * shortest round-trip form, like Python's repr().                      */
+#define PB_FMT_BUF 32
+size_t pb_format_int_to(char *buf, int64_t x);
+size_t pb_format_double_to(char *buf, double x);
+size_t pb_format_hex_to(char *buf, int64_t x);
+
+/* Same, returning a fresh string from the current arena */
 const char *pb_format_double(double x);
 const char *pb_format_int(int64_t x);
 const char *pb_format_hex(int64_t x);
 
 /* ------------ ERROR HANDLING ------------- */
 
-void pb_fail(const char *msg);
+PB_NORETURN void pb_fail(const char *msg);
+
+/* Called by pb_fail on this thread instead of printing and exiting. It
+ * must not return: longjmp back to the embedder, or end the thread.
+ * `msg` is only valid during the call. NULL restores the default.    */
+typedef void (*PbFailHandler)(const char *msg);
+void pb_set_fail_handler(PbFailHandler handler);
+
+/* ------------ THREADS ------------- */
+
+/* The try stack, current exception, output buffer and arena are all per
+ * thread, so compiled code may run on several threads at once as long as
+ * they share no mutable objects (a PbFile included). A thread that ran
+ * PB code calls pb_thread_exit() before it ends: it flushes the thread's
+ * output and frees its arena, and with it every string and object
+ * allocated there. The main thread's state is released at exit.        */
+void pb_thread_exit(void);
+
+/* ------------ ARENA ------------- */
+
+/* Bump allocator over a chain of chunks. Allocation is a pointer bump;
+ * memory is released only in bulk, by resetting to an earlier mark or
+ * freeing the whole arena. Runtime string producers (error messages,
+ * file reads, ...) allocate from `pb_current_arena`: the calling
+ * thread's own `pb_thread_arena`.                                      */
+typedef struct PbArenaChunk PbArenaChunk;
+
+typedef struct {
+    PbArenaChunk *head;     /* newest chunk; older ones chain behind it */
+    PbArenaChunk *spare;    /* one released chunk kept for reuse */
+    size_t chunk_size;      /* payload size of a regular chunk; 0 = default */
+} PbArena;
+
+typedef struct {
+    PbArenaChunk *chunk;
+    size_t used;
+} PbArenaMark;
+
+#define PB_ARENA_CHUNK_SIZE ((size_t)64 * 1024)
+#define PB_ARENA_ALIGN 16
+
+extern PB_THREAD_LOCAL PbArena pb_thread_arena;
+#define pb_current_arena (&pb_thread_arena)
+
+void pb_arena_init(PbArena *a, size_t chunk_size);
+void *pb_arena_alloc(PbArena *a, size_t size);
+char *pb_arena_strdup(PbArena *a, const char *s);
+PbArenaMark pb_arena_mark(const PbArena *a);
+/* Release everything allocated since `mark` was taken, in O(chunks). */
+void pb_arena_reset(PbArena *a, PbArenaMark mark);
+void pb_arena_free(PbArena *a);
+
+/* ------------ OBJECT POOLS ------------- */
+
+/* Class instances that outlive the scope that constructs them. Objects
+ * are carved from 64 KiB slabs, one free list and bump region per
+ * 16-byte size class, so classes of similar size reuse each other's
+ * slots. Pools belong to the calling thread; an object freed on
+ * another thread joins that thread's pool. Objects over
+ * PB_POOL_MAX_SIZE bytes fall back to malloc/free.                    */
+#define PB_POOL_GRANULE 16
+#define PB_POOL_MAX_SIZE 256
+#define PB_POOL_SLAB_SIZE ((size_t)64 * 1024)
+
+typedef struct PbPoolSlot { struct PbPoolSlot *next; } PbPoolSlot;
+
+typedef struct {
+    PbPoolSlot *free;   /* released slots, most recent first */
+    char *bump;         /* unused tail of the newest slab */
+    char *end;
+} PbPool;
+
+extern PB_THREAD_LOCAL PbPool pb_pools[PB_POOL_MAX_SIZE / PB_POOL_GRANULE];
+
+void *pb_pool_refill(PbPool *pool, size_t slot);
+void *pb_obj_alloc_large(size_t size);
+
+/* `size` is a sizeof at every call site, so the size class folds away. */
+static inline void *pb_obj_alloc(size_t size) {
+    if (size > PB_POOL_MAX_SIZE) return pb_obj_alloc_large(size);
+    size_t slot = (size + PB_POOL_GRANULE - 1) & ~(size_t)(PB_POOL_GRANULE - 1);
+    PbPool *pool = &pb_pools[slot / PB_POOL_GRANULE - 1];
+    PbPoolSlot *p = pool->free;
+    if (p) {
+        pool->free = p->next;
+        return p;
+    }
+    if ((size_t)(pool->end - pool->bump) >= slot) {
+        void *q = pool->bump;
+        pool->bump += slot;
+        return q;
+    }
+    return pb_pool_refill(pool, slot);
+}
+
+/* Hand `obj` (from pb_obj_alloc(size)) back to its size class. */
+static inline void pb_obj_free(void *obj, size_t size) {
+    if (size > PB_POOL_MAX_SIZE) {
+        free(obj);
+        return;
+    }
+    size_t slot = (size + PB_POOL_GRANULE - 1) & ~(size_t)(PB_POOL_GRANULE - 1);
+    PbPool *pool = &pb_pools[slot / PB_POOL_GRANULE - 1];
+    PbPoolSlot *p = obj;
+    p->next = pool->free;
+    pool->free = p;
+}
+
+/* ------------ STRINGS ------------- */
+
+/* Format into a fresh string from the current arena. `size_hint` is the
+ * code generator's estimate of the result length: when it is large
+ * enough the text is formatted once and the unused tail is handed back
+ * to the arena, so the result costs exactly strlen + 1 bytes.         */
+const char *pb_fstring(size_t size_hint, const char *fmt, ...);
+
+/* String equality for `==`, dict keys and list/set searches. Interned
+ * strings are equal exactly when their pointers are. So are identical
+ * literals, which the compiler and linker merge. The pointer test
+ * settles those without reading either string.                        */
+static inline bool pb_str_eq(const char *a, const char *b) {
+    return a == b || strcmp(a, b) == 0;
+}
+
+/* `for c in s`: the character at `*p` as a string of its own, advancing
+ * `*p` past it. Characters are UTF-8 code points. ASCII ones come from a
+ * static table, so a loop over ASCII text allocates nothing; the others
+ * are copied into the current arena.                                  */
+extern const char pb_ascii_chars[128][2];
+const char *pb_str_next_utf8(const char **p);
+
+static inline const char *pb_str_next_char(const char **p) {
+    unsigned char c = (unsigned char)**p;
+    if (PB_LIKELY(c < 0x80)) {
+        ++*p;
+        return pb_ascii_chars[c];
+    }
+    return pb_str_next_utf8(p);
+}
+
+/* ------------ INTERNING ------------- */
+
+/* One table, shared by every thread, maps each distinct text to a
+ * canonical copy that lives until exit. Every module registers its string
+ * literals from a constructor (PB_CONSTRUCTOR, where the compiler has
+ * them). The table reads them in on the first pb_intern call, so
+ * interning a literal's text returns the literal itself and registration
+ * costs startup nothing.                                              */
+typedef struct PbInternBlock {
+    const char *const *strs;
+    int64_t n;
+    struct PbInternBlock *next;
+} PbInternBlock;
+
+#if defined(__GNUC__)
+#define PB_CONSTRUCTOR __attribute__((constructor))
+#endif
+
+void pb_intern_register(PbInternBlock *block);
+/* `intern(s)`: the canonical pointer for the text of `s`. */
+const char *pb_intern(const char *s);
+
+/* ------------ MODULE INIT ------------- */
+
+/* Globals with a static initializer are in the executable image and cost
+ * nothing at startup. The rest of a module's globals are set by its
+ * `<module>__init_globals`, which runs on first use, not at launch: every
+ * function that reads them starts with PB_INIT_MODULE. It runs once even
+ * when threads race. A re-entrant use from inside it sees the globals set
+ * so far, like a Python import cycle. Its allocations come from an arena
+ * that lives until exit, not from the caller's scope.                 */
+enum { PB_MODULE_UNINIT, PB_MODULE_RUNNING, PB_MODULE_READY };
+
+typedef struct {
+    int state;
+} PbModuleInit;
+
+void pb_module_init(PbModuleInit *m, void (*init)(void));
+
+#define PB_INIT_MODULE(mod)                                                         \
+    do {                                                                            \
+        if (PB_UNLIKELY(__atomic_load_n(&mod##__module.state, __ATOMIC_ACQUIRE)    \
+                        != PB_MODULE_READY))                                        \
+            pb_module_init(&mod##__module, mod##__init_globals);                    \
+    } while (0)
 
 /* ------------ EXCEPTIONS ------------- */
 
 #include <setjmp.h>
 #include <assert.h>
 
+/* The active exception. `id` is pb_exc_id(type); except clauses compare
+ * it against the PB_EXC_<Name> constants the code generator emits.
+ * `msg` is the text reported if the exception is never caught.       */
 typedef struct {
+    uint32_t id;
     const char *type;
     void *value;
+    const char *msg;
 } PbException;
 
+/* A setjmp handler. Handlers lowered to pending-flag checks only bump
+ * pb_checked_depth, so whichever kind was entered last can be told by
+ * comparing the depth with the one recorded here.                     */
 typedef struct PbTryContext {
     jmp_buf env;
     struct PbTryContext *prev;
+    int checked_depth;
 } PbTryContext;
 
-extern PbTryContext *pb_current_try;
-extern PbException pb_current_exc;
+/* All per thread: an exception never crosses threads. */
+extern PB_THREAD_LOCAL PbTryContext *pb_current_try;
+extern PB_THREAD_LOCAL PbException pb_current_exc;
+extern PB_THREAD_LOCAL int pb_checked_depth;   /* checked try blocks currently open */
+extern PB_THREAD_LOCAL bool pb_exc_pending;    /* raised, not yet seen by a handler */
+
+/* FNV-1a of the type name: the same function as `_exc_id` in codegen. */
+uint32_t pb_exc_id(const char *type);
 
 void pb_push_try(PbTryContext *ctx);
 void pb_pop_try(void);
 
-/* Raise a simple exception whose payload is a C string.*/
-void pb_raise_msg(const char *type, const char *msg);
+/* Raise a simple exception whose payload is a C string. Never returns:
+ * used by the runtime, and by generated code outside checked handlers. */
+PB_NORETURN void pb_raise_msg(const char *type, const char *msg);
+
+/* Like pb_raise_msg, but when the innermost handler is a checked one it
+ * sets pb_exc_pending and returns; the caller then propagates.          */
+void pb_throw_msg(const char *type, const char *msg);
 
 /* Raise an “exception object”.                                       *
- * The object must have ‘const char *msg’ as its first field.          */
+ * The object must have ‘const char *msg’ as its first field.          *
+ * Returns like pb_throw_msg under a checked handler.                  */
 void pb_raise_obj(const char *type, void *obj);
 
 void pb_clear_exc(void);
+/* Raise the current exception again; returns like pb_throw_msg. */
 void pb_reraise(void);
 
+/* ------------ TASKS ------------- */
+
+/* A pool of pb_pool_size() - 1 worker threads, started on first use;
+ * a thread waiting for tasks runs them too. The size is the number of
+ * online CPUs, or PB_THREADS from the environment. Every worker owns a
+ * work-stealing deque: it pushes and pops at the bottom while idle
+ * threads steal from the top. The thread that starts the pool owns one
+ * more; other threads hand tasks over through a shared queue. A task
+ * starts outside every try block, so an exception escaping it ends the
+ * program like an uncaught one.                                       */
+int64_t pb_pool_size(void);
+
+/* parallel_for(range(start, stop), fn): calls body(lo, hi) on chunks
+ * that cover [start, stop) and returns once all of them have run.    */
+typedef void (*PbRangeFn)(int64_t lo, int64_t hi);
+void pb_parallel_for(int64_t start, int64_t stop, PbRangeFn body);
+
+/* spawn(fn, arg): fn(arg) runs on the pool. Joining waits for it,
+ * running other tasks meanwhile, and returns the result; joining again
+ * returns it again. The future lives in the spawning thread's arena.  */
+typedef struct PbFuture PbFuture;
+PbFuture *pb_spawn(int64_t (*fn)(int64_t), int64_t arg);
+int64_t pb_future_join(PbFuture *f);
+
+/* An int shared between threads, for counters and reductions; every
+ * operation is sequentially consistent. add() returns the new value.  */
+typedef struct {
+    int64_t value;
+} PbAtomic;
+
+PbAtomic *pb_atomic_new(int64_t value);
+
+#if defined(__GNUC__)
+static inline int64_t pb_atomic_add(PbAtomic *a, int64_t n) { return __atomic_add_fetch(&a->value, n, __ATOMIC_SEQ_CST); }
+static inline int64_t pb_atomic_get(PbAtomic *a) { return __atomic_load_n(&a->value, __ATOMIC_SEQ_CST); }
+static inline void pb_atomic_set(PbAtomic *a, int64_t v) { __atomic_store_n(&a->value, v, __ATOMIC_SEQ_CST); }
+#else
+static inline int64_t pb_atomic_add(PbAtomic *a, int64_t n) { return a->value += n; }
+static inline int64_t pb_atomic_get(PbAtomic *a) { return a->value; }
+static inline void pb_atomic_set(PbAtomic *a, int64_t v) { a->value = v; }
+#endif
+
+/* ------------ INSTRUMENTATION ------------- */
+
+/* `--instrument` builds define PB_INSTRUMENT for the runtime and every
+ * module. The runtime then counts list grows and the bytes they allocate,
+ * dict lookups and their probe lengths, raises by type and the deepest
+ * nesting of try blocks. Every generated function becomes a timed wrapper
+ * around its body. Counters, and each function's record, are per thread
+ * and summed at exit into one flat profile, printed to stderr or to the
+ * file named in PB_PROFILE_OUT. Without PB_INSTRUMENT the hooks expand
+ * to nothing.                                                         */
+typedef struct PbProfFn {
+    const char *name;
+    uint64_t calls;
+    uint64_t self_ticks;    /* time in the body, callees excluded */
+    uint64_t total_ticks;   /* time in outermost activations */
+    int64_t active;         /* activations on the stack */
+    struct PbProfFn *next;  /* this thread's list of called functions */
+} PbProfFn;
+
+#ifdef PB_INSTRUMENT
+void pb_prof_enter(PbProfFn *fn);
+void pb_prof_exit(void);
+void pb_prof_checked_try(void);
+#define PB_PROF_FN(var, name) static PB_THREAD_LOCAL PbProfFn var = {name, 0, 0, 0, 0, NULL};
+#define PB_PROF_ENTER(var)    pb_prof_enter(&(var))
+#define PB_PROF_EXIT()        pb_prof_exit()
+#define PB_PROF_CHECKED_TRY() pb_prof_checked_try()
+#else
+#define PB_PROF_FN(var, name)
+#define PB_PROF_ENTER(var)    ((void)0)
+#define PB_PROF_EXIT()        ((void)0)
+#define PB_PROF_CHECKED_TRY() ((void)0)
+#endif
+
 /* ------------ FILE ------------- */
 
-typedef struct {
+/* An open file. The object outlives close(), which sets `handle` to NULL,
+ * so later calls can raise ValueError instead of touching freed memory.
+ * Iterating lines reads into `buf`: a line sits in place at buf[start..]
+ * with its terminator written over the next byte (kept in `held_byte`
+ * until the following call restores it). Writes collect in `wbuf` and
+ * go out when it fills, on flush() or close(), before the next read, and
+ * at exit.                                                           */
+typedef struct PbFile {
     FILE *handle;
+    char *buf;          /* line buffer, allocated on the first line read */
+    size_t cap;         /* always > end, so buf[end] can hold a NUL */
+    size_t start, end;  /* unread bytes are buf[start, end) */
+    size_t held;        /* index of the byte the last line's NUL replaced */
+    char held_byte;
+    bool eof;
+    char *wbuf;         /* write buffer, allocated on the first write */
+    size_t wlen, wcap;  /* wcap 0 with a NULL wbuf: not yet allocated */
+    size_t wsize;       /* buffer size to allocate; 0 = unbuffered */
+    bool line_buffered; /* also flush after writes containing '\n' */
+    struct PbFile *next_dirty;  /* files with a write buffer, see pb_open */
 } PbFile;
 
-PbFile pb_open(const char *path, const char *mode);
-const char *pb_file_read(PbFile f);
-void pb_file_write(PbFile f, const char *s);
-void pb_file_close(PbFile f);
+#define PB_LINE_BUF_SIZE ((size_t)256 * 1024)
+#define PB_FILE_BUF_SIZE ((size_t)256 * 1024)
+
+/* `buffering` follows Python's open(): -1 for the default write buffer,
+ * 0 for none, 1 for line buffering, larger values for a buffer size.  */
+PbFile *pb_open(const char *path, const char *mode, int64_t buffering);
+/* The rest of the file as a string from the current arena. */
+const char *pb_file_read(PbFile *f);
+/* The rest of a regular file as a read-only, NUL-terminated view of its
+ * pages, mapped without copying; it stays valid after close() until the
+ * program exits. Falls back to pb_file_read where mapping is unavailable
+ * (pipes, empty files, non-POSIX targets).                            */
+const char *pb_file_mmap(PbFile *f);
+/* Next line including its '\n', or NULL at end of file. The text lives in
+ * the file's line buffer and is valid until the next call on `f`.     */
+const char *pb_file_next_line(PbFile *f);
+void pb_file_write(PbFile *f, const char *s);
+void pb_file_write_bytes(PbFile *f, const void *data, size_t n);
+/* Push buffered writes to the operating system. */
+void pb_file_flush(PbFile *f);
+void pb_file_close(PbFile *f);
+
+/* ------------ HASHING ------------- */
+
+/* 64-bit FNV-1a string hash. Never returns 0. */
+uint64_t pb_hash_str(const char *s);
+
+/* Open-addressing index shared by every Set_* and Dict_str_* specialization.
+ * Entries are kept in the container's `data` array; `slots` maps a
+ * linear-probe position to an entry number (-1 = empty) and `hashes`
+ * caches each entry's hash so probing rarely touches the entry itself.
+ * Dicts keep insertion order and mark a deleted entry with a NULL key;
+ * sets stay dense by moving their last element into the hole.         */
+typedef struct {
+    int64_t used;       /* entries consumed, including deleted ones */
+    int64_t capacity;   /* allocated entries; slots has 2 * capacity */
+    int64_t *slots;
+    uint64_t *hashes;
+} PbHashIndex;
 
 /* ------------ LIST ------------- */
 
@@ -83,11 +472,12 @@ PB_DECLARE_LIST(float, double)
 PB_DECLARE_LIST(bool, bool)
 PB_DECLARE_LIST(str, const char *)
 
-/* Generic set declaration helper. */
+/* Generic set declaration helper. Elements live densely in `data`, so
+ * sets iterate and print like lists. A zero-initialized set is empty.  */
 #define PB_DECLARE_SET(Name, CType)          \
     typedef struct {                        \
         int64_t len;                        \
-        int64_t capacity;                   \
+        PbHashIndex index;                  \
         CType *data;                        \
     } Set_##Name;
 
@@ -99,54 +489,325 @@ PB_DECLARE_SET(str, const char *)
 
 #define INITIAL_LIST_CAPACITY 4
 
-void list_int_grow_if_needed(List_int *lst);
-void list_int_init(List_int *lst);
-void list_int_set(List_int *lst, int64_t index, int64_t value);
-int64_t list_int_get(List_int *lst, int64_t index);
-void list_int_append(List_int *lst, int64_t value);
-int64_t list_int_pop(List_int *lst);
-bool list_int_remove(List_int *lst, int64_t value);
-void list_int_free(List_int *lst);
-void list_int_print(const List_int *lst);
+/* Growth policy for a full list holding `n` elements; it must return
+ * more than `n`. Define before including this header to tune it.      */
+#ifndef PB_LIST_GROWTH
+#define PB_LIST_GROWTH(n) ((n) * 2)
+#endif
+
+/* Resize a list's storage to exactly `new_capacity` elements and return
+ * the new data pointer. A list with capacity 0 but non-NULL data borrows
+ * its array (list literals live in the arena) and is copied out rather
+ * than reallocated.                                                    */
+void *pb_list_grow(void *data, int64_t len, int64_t *capacity, int64_t new_capacity, size_t elem_size, const char *type);
+
+static inline int64_t pb_list_next_capacity(int64_t len, int64_t capacity) {
+    int64_t next = PB_LIST_GROWTH(capacity > len ? capacity : len);
+    if (next < INITIAL_LIST_CAPACITY) next = INITIAL_LIST_CAPACITY;
+    return next > len ? next : len + 1;
+}
+
+/* Raises IndexError for a failed list access; `op` is "get" or "set". */
+PB_COLD PB_NORETURN void pb_index_error(const char *type, const char *op, int64_t index, int64_t len, const void *ptr);
+PB_COLD PB_NORETURN void pb_list_pop_error(void);
+PB_COLD PB_NORETURN void pb_list_value_error(const char *op);
+
+/* Vectorized search kernels for list[int] and list[float]: index of the
+ * first element equal to `value` (or -1), and the number of matches.  */
+int64_t pb_find_int(const int64_t *data, int64_t n, int64_t value);
+int64_t pb_count_int(const int64_t *data, int64_t n, int64_t value);
+int64_t pb_find_float(const double *data, int64_t n, double value);
+int64_t pb_count_float(const double *data, int64_t n, double value);
+
+/* Element equality used by list_*_remove. */
+#define PB_EQ_VALUE(a, b) ((a) == (b))
+#define PB_EQ_STR(a, b)   pb_str_eq((a), (b))
+#define PB_EQ_BYTES(a, b) (memcmp(&(a), &(b), sizeof(a)) == 0)
+
+/* Every list operation for one element type, defined here so callers can
+ * inline them; only growth and error reporting go out of line. Searches
+ * go through FIND/COUNT, functions of (CType const *, n, CType) returning
+ * an index or -1 and a match count. Bounds checks are a single unsigned
+ * compare, which also catches negative indices; `insert` and `slice`
+ * clamp like Python.                                                  */
+#define PB_DEFINE_LIST_OPS(Name, CType, EQ, FIND, COUNT)                                \
+    static inline void list_##Name##_init(List_##Name *lst) {                          \
+        lst->len = 0;                                                                  \
+        lst->capacity = 0;                                                             \
+        lst->data = NULL;                                                              \
+    }                                                                                  \
+    /* A list literal: `n` values copied into borrowed arena storage */             \
+    static inline List_##Name list_##Name##_from_array(CType const *values, int64_t n) { \
+        List_##Name out = { n, 0, (CType *)pb_arena_alloc(pb_current_arena, (size_t)n * sizeof(CType)) }; \
+        memcpy(out.data, values, (size_t)n * sizeof(CType));                           \
+        return out;                                                                    \
+    }                                                                                  \
+    /* Exactly `n` slots; never shrinks */                                             \
+    static inline void list_##Name##_reserve(List_##Name *lst, int64_t n) {            \
+        if (n > lst->capacity)                                                         \
+            lst->data = (CType *)pb_list_grow(lst->data, lst->len, &lst->capacity, n,  \
+                                              sizeof(CType), #Name);                   \
+    }                                                                                  \
+    static inline void list_##Name##_grow_if_needed(List_##Name *lst) {                \
+        if (PB_UNLIKELY(lst->len >= lst->capacity))                                    \
+            list_##Name##_reserve(lst, pb_list_next_capacity(lst->len, lst->capacity)); \
+    }                                                                                  \
+    static inline CType list_##Name##_get(const List_##Name *lst, int64_t index) {     \
+        if (PB_UNLIKELY((uint64_t)index >= (uint64_t)lst->len))                       \
+            pb_index_error(#Name, "get", index, lst->len, lst);                        \
+        return lst->data[index];                                                       \
+    }                                                                                  \
+    static inline CType *list_##Name##_at(List_##Name *lst, int64_t index) {           \
+        if (PB_UNLIKELY((uint64_t)index >= (uint64_t)lst->len))                       \
+            pb_index_error(#Name, "get", index, lst->len, lst);                        \
+        return &lst->data[index];                                                      \
+    }                                                                                  \
+    static inline void list_##Name##_set(List_##Name *lst, int64_t index, CType value) { \
+        if (PB_UNLIKELY((uint64_t)index >= (uint64_t)lst->len))                       \
+            pb_index_error(#Name, "set", index, lst->len, lst);                        \
+        lst->data[index] = value;                                                      \
+    }                                                                                  \
+    static inline void list_##Name##_append(List_##Name *lst, CType value) {           \
+        list_##Name##_grow_if_needed(lst);                                             \
+        lst->data[lst->len++] = value;                                                 \
+    }                                                                                  \
+    static inline CType list_##Name##_pop(List_##Name *lst) {                          \
+        if (PB_UNLIKELY(lst->len == 0))                                                \
+            pb_list_pop_error();                                                       \
+        return lst->data[--lst->len];                                                  \
+    }                                                                                  \
+    static inline int64_t list_##Name##_index(const List_##Name *lst, CType value) {   \
+        int64_t i = FIND(lst->data, lst->len, value);                                  \
+        if (PB_UNLIKELY(i < 0))                                                        \
+            pb_list_value_error("index");                                              \
+        return i;                                                                      \
+    }                                                                                  \
+    static inline bool list_##Name##_contains(const List_##Name *lst, CType value) {   \
+        return FIND(lst->data, lst->len, value) >= 0;                                  \
+    }                                                                                  \
+    static inline int64_t list_##Name##_count(const List_##Name *lst, CType value) {   \
+        return COUNT(lst->data, lst->len, value);                                      \
+    }                                                                                  \
+    /* First match only; false if absent */                                           \
+    static inline bool list_##Name##_remove(List_##Name *lst, CType value) {           \
+        int64_t i = FIND(lst->data, lst->len, value);                                  \
+        if (i < 0) return false;                                                       \
+        memmove(&lst->data[i], &lst->data[i + 1],                                      \
+                (size_t)(lst->len - i - 1) * sizeof(CType));                           \
+        lst->len--;                                                                    \
+        return true;                                                                   \
+    }                                                                                  \
+    /* Every match in one compaction pass; returns how many were removed */            \
+    static inline int64_t list_##Name##_remove_all(List_##Name *lst, CType value) {    \
+        int64_t out = FIND(lst->data, lst->len, value);                                \
+        if (out < 0) return 0;                                                         \
+        for (int64_t i = out + 1; i < lst->len; ++i) {                                 \
+            if (!EQ(lst->data[i], value))                                              \
+                lst->data[out++] = lst->data[i];                                       \
+        }                                                                              \
+        int64_t removed = lst->len - out;                                              \
+        lst->len = out;                                                                \
+        return removed;                                                                \
+    }                                                                                  \
+    /* O(1) unordered removal: the last element fills the hole */                      \
+    static inline CType list_##Name##_swap_remove(List_##Name *lst, int64_t index) {   \
+        if (PB_UNLIKELY((uint64_t)index >= (uint64_t)lst->len))                       \
+            pb_index_error(#Name, "swap_remove", index, lst->len, lst);                \
+        CType value = lst->data[index];                                                \
+        lst->data[index] = lst->data[--lst->len];                                      \
+        return value;                                                                  \
+    }                                                                                  \
+    static inline void list_##Name##_insert(List_##Name *lst, int64_t index, CType value) { \
+        if (index < 0) index += lst->len;                                              \
+        if (index < 0) index = 0;                                                      \
+        if (index > lst->len) index = lst->len;                                        \
+        list_##Name##_grow_if_needed(lst);                                             \
+        memmove(&lst->data[index + 1], &lst->data[index],                              \
+                (size_t)(lst->len - index) * sizeof(CType));                           \
+        lst->data[index] = value;                                                      \
+        lst->len++;                                                                    \
+    }                                                                                  \
+    static inline void list_##Name##_extend(List_##Name *lst, const List_##Name *other) { \
+        int64_t n = other->len;                                                        \
+        if (n == 0) return;                                                            \
+        /* `other` may share storage with `lst` (lists copy by value) */               \
+        bool shared = other->data == lst->data;                                        \
+        if (lst->len + n > lst->capacity) {                                            \
+            int64_t next = pb_list_next_capacity(lst->len, lst->capacity);             \
+            list_##Name##_reserve(lst, next > lst->len + n ? next : lst->len + n);     \
+        }                                                                              \
+        memmove(&lst->data[lst->len], shared ? lst->data : other->data,                \
+                (size_t)n * sizeof(CType));                                            \
+        lst->len += n;                                                                 \
+    }                                                                                  \
+    static inline List_##Name list_##Name##_slice(const List_##Name *lst, int64_t start, int64_t stop) { \
+        int64_t len = lst->len;                                                        \
+        if (start < 0) start += len;                                                   \
+        if (stop < 0) stop += len;                                                     \
+        if (start < 0) start = 0;                                                      \
+        if (stop > len) stop = len;                                                    \
+        List_##Name out;                                                               \
+        list_##Name##_init(&out);                                                      \
+        if (stop > start) {                                                            \
+            list_##Name##_reserve(&out, stop - start);                                 \
+            memcpy(out.data, &lst->data[start], (size_t)(stop - start) * sizeof(CType)); \
+            out.len = stop - start;                                                    \
+        }                                                                              \
+        return out;                                                                    \
+    }                                                                                  \
+    static inline void list_##Name##_free(List_##Name *lst) {                          \
+        if (lst->capacity > 0)                                                         \
+            free(lst->data);                                                           \
+        list_##Name##_init(lst);                                                       \
+    }
+
+/* Scalar search loops, for element types without a dedicated kernel */
+#define PB_DEFINE_LIST_SCAN(Name, CType, EQ)                                            \
+    static inline int64_t list_##Name##_scan_find(CType const *data, int64_t n, CType value) { \
+        for (int64_t i = 0; i < n; ++i)                                                \
+            if (EQ(data[i], value)) return i;                                          \
+        return -1;                                                                     \
+    }                                                                                  \
+    static inline int64_t list_##Name##_scan_count(CType const *data, int64_t n, CType value) { \
+        int64_t c = 0;                                                                 \
+        for (int64_t i = 0; i < n; ++i)                                                \
+            c += EQ(data[i], value);                                                   \
+        return c;                                                                      \
+    }
+
+#define PB_DEFINE_LIST(Name, CType, EQ)                                                 \
+    PB_DEFINE_LIST_SCAN(Name, CType, EQ)                                               \
+    PB_DEFINE_LIST_OPS(Name, CType, EQ, list_##Name##_scan_find, list_##Name##_scan_count)
+
+/* The built-ins expand the parts directly: passing `bool` through
+ * PB_DEFINE_LIST would expand it to `_Bool` before pasting.           */
+PB_DEFINE_LIST_OPS(int, int64_t, PB_EQ_VALUE, pb_find_int, pb_count_int)
+PB_DEFINE_LIST_OPS(float, double, PB_EQ_VALUE, pb_find_float, pb_count_float)
+PB_DEFINE_LIST_SCAN(bool, bool, PB_EQ_VALUE)
+PB_DEFINE_LIST_OPS(bool, bool, PB_EQ_VALUE, list_bool_scan_find, list_bool_scan_count)
+PB_DEFINE_LIST_SCAN(str, const char *, PB_EQ_STR)
+PB_DEFINE_LIST_OPS(str, const char *, PB_EQ_STR, list_str_scan_find, list_str_scan_count)
 
-void list_float_grow_if_needed(List_float *lst);
-void list_float_init(List_float *lst);
-void list_float_set(List_float *lst, int64_t index, double value);
-double list_float_get(List_float *lst, int64_t index);
-void list_float_append(List_float *lst, double value);
-double list_float_pop(List_float *lst);
-bool list_float_remove(List_float *lst, double value);
-void list_float_free(List_float *lst);
+void list_int_print(const List_int *lst);
 void list_float_print(const List_float *lst);
 
-void list_bool_grow_if_needed(List_bool *lst);
-void list_bool_init(List_bool *lst);
-void list_bool_set(List_bool *lst, int64_t index, bool value);
-bool list_bool_get(List_bool *lst, int64_t index);
-void list_bool_append(List_bool *lst, bool value);
-bool list_bool_pop(List_bool *lst);
-bool list_bool_remove(List_bool *lst, bool value);
-void list_bool_free(List_bool *lst);
+/* Numeric list builtins, vectorized in pb_runtime.c: sum/min/max/dot
+ * reduce, prefix_sum returns the running sums, and vadd/vsub/vmul are
+ * elementwise. min/max of an empty list and mismatched lengths raise
+ * ValueError; int arithmetic wraps. */
+#define PB_DECLARE_LIST_KERNELS(Name, CType)                                          \
+    CType list_##Name##_sum(const List_##Name *xs);                                   \
+    CType list_##Name##_min(const List_##Name *xs);                                   \
+    CType list_##Name##_max(const List_##Name *xs);                                   \
+    CType list_##Name##_dot(const List_##Name *a, const List_##Name *b);              \
+    List_##Name list_##Name##_prefix_sum(const List_##Name *xs);                      \
+    List_##Name list_##Name##_vadd(const List_##Name *a, const List_##Name *b);       \
+    List_##Name list_##Name##_vsub(const List_##Name *a, const List_##Name *b);       \
+    List_##Name list_##Name##_vmul(const List_##Name *a, const List_##Name *b);
+PB_DECLARE_LIST_KERNELS(int, int64_t)
+PB_DECLARE_LIST_KERNELS(float, double)
+
+/* In-place sort and sorted copy; see pb_runtime.c for the algorithms. */
+#define PB_DECLARE_LIST_SORT(Name)                                                    \
+    void list_##Name##_sort(List_##Name *xs);                                         \
+    List_##Name list_##Name##_sorted(const List_##Name *xs);
+PB_DECLARE_LIST_SORT(int)
+PB_DECLARE_LIST_SORT(float)
+PB_DECLARE_LIST_SORT(bool)
+PB_DECLARE_LIST_SORT(str)
+
+/* file.writelines(lines): every string goes through the write buffer. */
+void pb_file_writelines(PbFile *f, const List_str *lines);
 void list_bool_print(const List_bool *lst);
-
-void list_str_grow_if_needed(List_str *lst);
-void list_str_init(List_str *lst);
-void list_str_set(List_str *lst, int64_t index, const char *value);
-const char* list_str_get(List_str *lst, int64_t index);
-void list_str_append(List_str *lst, const char *value);
-const char *list_str_pop(List_str *lst);
-bool list_str_remove(List_str *lst, const char *value);
-void list_str_free(List_str *lst);
 void list_str_print(const List_str *lst);
 
+/* ------------ SET ------------- */
+
+#define INITIAL_SET_CAPACITY 8
+
+void set_int_init(Set_int *s);
+Set_int set_int_from_array(const int64_t *values, int64_t n);
+Set_int set_int_from_list(const List_int *lst);
+bool set_int_add(Set_int *s, int64_t value);
+bool set_int_contains(const Set_int *s, int64_t value);
+bool set_int_discard(Set_int *s, int64_t value);
+Set_int set_int_union(const Set_int *a, const Set_int *b);
+Set_int set_int_intersection(const Set_int *a, const Set_int *b);
+Set_int set_int_difference(const Set_int *a, const Set_int *b);
+void set_int_free(Set_int *s);
 void set_int_print(const Set_int *s);
+
+void set_float_init(Set_float *s);
+Set_float set_float_from_array(const double *values, int64_t n);
+Set_float set_float_from_list(const List_float *lst);
+bool set_float_add(Set_float *s, double value);
+bool set_float_contains(const Set_float *s, double value);
+bool set_float_discard(Set_float *s, double value);
+Set_float set_float_union(const Set_float *a, const Set_float *b);
+Set_float set_float_intersection(const Set_float *a, const Set_float *b);
+Set_float set_float_difference(const Set_float *a, const Set_float *b);
+void set_float_free(Set_float *s);
 void set_float_print(const Set_float *s);
+
+void set_bool_init(Set_bool *s);
+Set_bool set_bool_from_array(const bool *values, int64_t n);
+Set_bool set_bool_from_list(const List_bool *lst);
+bool set_bool_add(Set_bool *s, bool value);
+bool set_bool_contains(const Set_bool *s, bool value);
+bool set_bool_discard(Set_bool *s, bool value);
+Set_bool set_bool_union(const Set_bool *a, const Set_bool *b);
+Set_bool set_bool_intersection(const Set_bool *a, const Set_bool *b);
+Set_bool set_bool_difference(const Set_bool *a, const Set_bool *b);
+void set_bool_free(Set_bool *s);
 void set_bool_print(const Set_bool *s);
+
+void set_str_init(Set_str *s);
+Set_str set_str_from_array(const char *const *values, int64_t n);
+Set_str set_str_from_list(const List_str *lst);
+bool set_str_add(Set_str *s, const char *value);
+bool set_str_contains(const Set_str *s, const char *value);
+bool set_str_discard(Set_str *s, const char *value);
+Set_str set_str_union(const Set_str *a, const Set_str *b);
+Set_str set_str_intersection(const Set_str *a, const Set_str *b);
+Set_str set_str_difference(const Set_str *a, const Set_str *b);
+void set_str_free(Set_str *s);
 void set_str_print(const Set_str *s);
 
+/* Dense bitset over the closed range [base, base + nbits). Set_int uses it
+ * internally to dedupe and intersect clustered integers (IDs, indices) in
+ * one linear pass; it is also usable directly from native code.         */
+typedef struct {
+    int64_t base;
+    int64_t nbits;
+    uint64_t *words;
+} PbBitset;
+
+/* Largest span (max - min + 1) for which a bitset is preferred over
+ * hashing; also bounded relative to the element count.                  */
+#define PB_BITSET_MAX_SPAN ((int64_t)1 << 24)
+
+bool pb_bitset_init_range(PbBitset *b, int64_t lo, int64_t hi);
+void pb_bitset_free(PbBitset *b);
+
+static inline bool pb_bitset_test(const PbBitset *b, int64_t v) {
+    uint64_t off = (uint64_t)v - (uint64_t)b->base;
+    return off < (uint64_t)b->nbits && ((b->words[off >> 6] >> (off & 63)) & 1u);
+}
+
+/* Set bit `v` (which must be in range); returns true if it was clear. */
+static inline bool pb_bitset_insert(PbBitset *b, int64_t v) {
+    uint64_t off = (uint64_t)v - (uint64_t)b->base;
+    uint64_t bit = (uint64_t)1 << (off & 63);
+    uint64_t *w = &b->words[off >> 6];
+    if (*w & bit) return false;
+    *w |= bit;
+    return true;
+}
+
 /* ------------ DICT ------------- */
 
-/* Generic dict declaration helper. */
+
+/* Generic dict declaration helper. A zero-initialized dict is empty. */
 #define PB_DECLARE_DICT(Name, CType)          \
     typedef struct {                         \
         const char *key;                     \
@@ -154,6 +815,7 @@ void set_str_print(const Set_str *s);
     } Pair_str_##Name;                       \
     typedef struct {                         \
         int64_t len;                         \
+        PbHashIndex index;                   \
         Pair_str_##Name *data;               \
     } Dict_str_##Name;
 
@@ -163,14 +825,57 @@ PB_DECLARE_DICT(float, double)
 PB_DECLARE_DICT(bool, bool)
 PB_DECLARE_DICT(str, const char *)
 
-// Dict lookup helpers
-int64_t pb_dict_get_str_int(Dict_str_int d, const char *key);
-
-const char* pb_dict_get_str_str(Dict_str_str d, const char *key);
-
-double pb_dict_get_str_float(Dict_str_float d, const char *key);
-
-bool pb_dict_get_str_bool(Dict_str_bool d, const char *key);
-
+#define INITIAL_DICT_CAPACITY 8
+
+void pb_dict_init_str_int(Dict_str_int *d);
+Dict_str_int pb_dict_from_pairs_str_int(const Pair_str_int *pairs, int64_t n);
+void pb_dict_set_str_int(Dict_str_int *d, const char *key, int64_t value);
+int64_t pb_dict_get_str_int(const Dict_str_int *d, const char *key);
+bool pb_dict_contains_str_int(const Dict_str_int *d, const char *key);
+bool pb_dict_del_str_int(Dict_str_int *d, const char *key);
+void pb_dict_free_str_int(Dict_str_int *d);
+
+void pb_dict_init_str_float(Dict_str_float *d);
+Dict_str_float pb_dict_from_pairs_str_float(const Pair_str_float *pairs, int64_t n);
+void pb_dict_set_str_float(Dict_str_float *d, const char *key, double value);
+double pb_dict_get_str_float(const Dict_str_float *d, const char *key);
+bool pb_dict_contains_str_float(const Dict_str_float *d, const char *key);
+bool pb_dict_del_str_float(Dict_str_float *d, const char *key);
+void pb_dict_free_str_float(Dict_str_float *d);
+
+void pb_dict_init_str_bool(Dict_str_bool *d);
+Dict_str_bool pb_dict_from_pairs_str_bool(const Pair_str_bool *pairs, int64_t n);
+void pb_dict_set_str_bool(Dict_str_bool *d, const char *key, bool value);
+bool pb_dict_get_str_bool(const Dict_str_bool *d, const char *key);
+bool pb_dict_contains_str_bool(const Dict_str_bool *d, const char *key);
+bool pb_dict_del_str_bool(Dict_str_bool *d, const char *key);
+void pb_dict_free_str_bool(Dict_str_bool *d);
+
+void pb_dict_init_str_str(Dict_str_str *d);
+Dict_str_str pb_dict_from_pairs_str_str(const Pair_str_str *pairs, int64_t n);
+void pb_dict_set_str_str(Dict_str_str *d, const char *key, const char *value);
+const char *pb_dict_get_str_str(const Dict_str_str *d, const char *key);
+bool pb_dict_contains_str_str(const Dict_str_str *d, const char *key);
+bool pb_dict_del_str_str(Dict_str_str *d, const char *key);
+void pb_dict_free_str_str(Dict_str_str *d);
+
+/* ------------ RANDOM ------------- */
+
+/* xoshiro256** generators behind the stdlib `random` module. Every thread
+ * draws from its own state and takes no lock. seed(x) restarts the calling
+ * thread on stream 0 of `x`. Any other thread reseeds on its next draw,
+ * onto a stream 2^128 draws further along the same sequence, so streams
+ * never overlap. Unseeded programs behave as if they called seed(0).   */
+void pb_random_seed(int64_t x);
+double pb_random_random(void);                      /* [0.0, 1.0) in steps of 2^-53 */
+int64_t pb_random_randint(int64_t a, int64_t b);    /* a <= N <= b, unbiased        */
+double pb_random_uniform(double a, double b);
+
+/* Overwrite the first `n` elements of `xs` in one call. Four interleaved
+ * generators run one per 64-bit vector lane (AVX2 when the CPU has it).
+ * They are seeded from the calling thread's state, and the results never
+ * depend on the CPU. fill_floats values are multiples of 2^-52.        */
+void pb_random_fill_floats(List_float xs, int64_t n);
+void pb_random_fill_ints(List_int xs, int64_t n, int64_t a, int64_t b);
 
 #endif // PB_RUNTIME_H
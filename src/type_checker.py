@@ -14,6 +14,7 @@ Environment:
 - `self.instance_fields`: Instance fields per class (class_name → field_name → type); includes inherited fields
 - `self.class_bases`:     Single inheritance graph (subclass → base class)
 - `self.known_classes`:   Set of all declared class names
+- `self.soa_classes`:     Classes declared `@soa`; their lists store one array per field
 - `self.current_return_type`: Return type expected in the current function
 - `self.current_function_name`: Name of current function or method
 - `self.in_loop`:         Tracks whether inside a loop (for `break` / `continue` validation)
@@ -23,7 +24,8 @@ Supported Expression Types:
 - `Literal`:          int, float, str, bool, None
 - `Identifier`:       Variable reference (must be declared)
 - `UnaryOp`:          Supports `-`, `not`; type depends on operand
-- `BinOp`:            Arithmetic, logical, comparison, identity (`is`, `is not`)
+- `BinOp`:            Arithmetic, logical, comparison, identity (`is`, `is not`),
+                      membership (`in`, `not in`) on dict keys, set and list elements
 - `CallExpr`:         Top-level or static method calls (`ClassName.method(...)`)
                       - Default arguments supported
                       - Subclass argument types are allowed where base is expected
@@ -31,6 +33,7 @@ Supported Expression Types:
 - `AttributeExpr`:    Supports `self.field` and `ClassName.attr`
                       - Validates fields based on class or instance context
 - `IndexExpr`:        Supports `list[T]` and `dict[str, T]` indexing
+- `SliceExpr`:        `xs[a:b]` on `list[T]` copies into a new `list[T]`
 - `ListExpr`:         Homogeneous list literals (type inferred or declared)
 - `SetExpr`:          Homogeneous set literals (type inferred or declared)
 - `DictExpr`:         Homogeneous `dict[str, T]` literals
@@ -47,10 +50,12 @@ Supported Statement Types:
 - `PassStmt`:          Always valid; checked for consistency
 - `AssertStmt`:        Expression must be boolean
 - `RaiseStmt`:         Only known exception types may be raised; value must be valid expression
+- `DelStmt`:           Only dict items (`del d[key]`) may be deleted
 - `GlobalStmt`:        Declares intention to assign to top-level variable
 - `IfStmt`:            All conditions must be bool; checked per branch
 - `WhileStmt`:         Condition must be bool; body checked with loop context
-- `ForStmt`:           Iterates over `list[T]` or `set[T]`; loop var declared with element type `T`
+- `ForStmt`:           Iterates over a list, set, dict (keys), str (characters) or file; loop vars
+                       get the element types, unpacking enumerate/zip/items into several
 - `FunctionDef`:       Parameters must be typed; default values checked; return statements validated
 - `ClassDef`:          Fields and methods validated; base class resolved and fields inherited
 - `TryExceptStmt`:     Validates try body and each except-block separately
@@ -108,12 +113,14 @@ from lang_ast import (
     ClassDef,
     AttributeExpr,
     IndexExpr,
+    SliceExpr,
     ListExpr,
     SetExpr,
     DictExpr,
     EllipsisLiteral,
     AssertStmt,
     RaiseStmt,
+    DelStmt,
     GlobalStmt,
     TryExceptStmt,
     ExceptBlock,
@@ -122,6 +129,28 @@ from lang_ast import (
     ImportFromStmt,
 )
 
+# ─── Vectorized builtins over list[int] / list[float] ───
+# name -> (number of list arguments, whether the result is a list)
+NUMERIC_LIST_BUILTINS = {
+    "sum": (1, False),
+    "min": (1, False),
+    "max": (1, False),
+    "dot": (2, False),
+    "prefix_sum": (1, True),
+    "vadd": (2, True),
+    "vsub": (2, True),
+    "vmul": (2, True),
+}
+
+# Element types `list.sort()` and `sorted()` accept
+SORTABLE_ELEMENT_TYPES = {"int", "float", "bool", "str"}
+
+# Methods of the task pool's handle types: name → (param types, return type)
+HANDLE_METHODS = {
+    "future": {"join": ([], "int")},
+    "atomic": {"add": (["int"], "int"), "get": ([], "int"), "set": (["int"], "None")},
+}
+
 # ─── Type precedence for numeric promotions (higher wins) ───
 # Higher index means higher precision/priority.
 PROMOTION_ORDER = ["bool", "int", "float"]
@@ -190,6 +219,7 @@ class ModuleSymbol:
         self.program: Program | None = program
         self.vendor_metadata: dict | None = vendor_metadata
         self.native_binding: bool = native_binding
+        self.cache_key: str | None = None  # set when loaded through a build cache
 
 
 class TypeError(Exception):
@@ -231,6 +261,7 @@ class TypeChecker:
         self.class_attrs: Dict[str, Dict[str, str]] = {}
         self.instance_fields: Dict[str, Dict[str, str]] = {}
         self.class_bases: Dict[str, str] = {}  # child class → base class
+        self.soa_classes: Set[str] = set()
 
         # class-scoped method registry
         # class_name → method_name → (param_types, return_type, num_required)
@@ -244,13 +275,17 @@ class TypeChecker:
         }
         self.class_bases["Exception"] = None
 
-        for exc in ["RuntimeError", "ValueError", "IndexError", "TypeError"]:
+        for exc in ["RuntimeError", "ValueError", "IndexError", "KeyError", "TypeError"]:
             self.known_classes.add(exc)
             self.methods[exc] = {}  # no own methods
             self.class_bases[exc] = "Exception"
 
         # Track whether a function was imported from a native module
         self.native_functions: Dict[str, bool] = {}
+        # Global variables brought in by `from m import ...`: name -> module
+        self.imported_globals: Dict[str, str] = {}
+        # Modules whose names `from m import ...` brings in: module name -> symbol
+        self.imported_modules: Dict[str, ModuleSymbol] = {}
 
     def _attr_full_name(self, expr: Expr) -> str | None:
         if isinstance(expr, Identifier):
@@ -281,9 +316,11 @@ class TypeChecker:
 
         program.inferred_instance_fields = dict(self.instance_fields)
         program.import_aliases = {alias: mod.name for alias, mod in self.modules.items()}
-        program.native_modules = {mod.name: mod.native_binding for mod in self.modules.values()}
+        loaded = [*self.modules.values(), *self.imported_modules.values()]
+        program.native_modules = {mod.name: mod.native_binding for mod in loaded}
         program.native_imports = {alias: mod.native_binding for alias, mod in self.modules.items()}
         program.native_functions = dict(self.native_functions)
+        program.imported_globals = dict(self.imported_globals)
         return program
 
     def check_stmt(self, stmt: Stmt, parent: Stmt | None = None):
@@ -310,6 +347,8 @@ class TypeChecker:
             self.check_assert_stmt(stmt)
         elif isinstance(stmt, RaiseStmt):
             self.check_raise_stmt(stmt)
+        elif isinstance(stmt, DelStmt):
+            self.check_del_stmt(stmt)
         elif isinstance(stmt, GlobalStmt):
             self.check_global_stmt(stmt)
         elif isinstance(stmt, TryExceptStmt):
@@ -353,6 +392,16 @@ class TypeChecker:
 
         decl.inferred_type = actual
 
+    def check_task_function(self, fn: Expr, builtin: str, return_type: str) -> None:
+        """`fn` must name a top-level function taking one int and returning `return_type`."""
+        if not isinstance(fn, Identifier) or fn.name not in self.functions or fn.name in self.env:
+            raise TypeError(f"Function '{builtin}' expects the name of a function")
+        param_types, ret, _ = self.functions[fn.name]
+        if param_types != ["int"] or (ret or "None") != return_type:
+            raise TypeError(f"Function '{builtin}' expects a function (int) -> {return_type}, "
+                            f"'{fn.name}' does not match")
+        fn.inferred_type = "function"
+
     def check_arg_compatibility(self, actual: str, expected: str, index: int, context: str):
         """
         Validate whether `actual` type can be passed to a parameter of type `expected`.
@@ -477,6 +526,21 @@ class TypeChecker:
                 expr.inferred_type = result_type
                 return result_type
 
+            # Membership
+            elif op in {"in", "not in"}:
+                if right_type.startswith("dict[") and right_type.endswith("]"):
+                    key_type = "str"
+                elif right_type.startswith("set[") and right_type.endswith("]"):
+                    key_type = right_type[4:-1]
+                elif right_type.startswith("list[") and right_type.endswith("]"):
+                    key_type = right_type[5:-1]
+                else:
+                    raise TypeError(f"Operator '{op}' not supported for container type {right_type}")
+                if left_type != key_type:
+                    raise TypeError(f"Operator '{op}' expects a {key_type} operand for {right_type}, got {left_type}")
+                expr.inferred_type = "bool"
+                return "bool"
+
             # Comparison
             elif op in {"==", "!=", "<", "<=", ">", ">=", "is", "is not"}:
                 if left_type != right_type:
@@ -616,16 +680,67 @@ class TypeChecker:
                         raise TypeError(f"Function 'hex' expects int, got {arg_type}")
                     expr.inferred_type = "str"
                     return "str"
+                if fname == "intern":
+                    if len(expr.args) != 1:
+                        raise TypeError("Function 'intern' expects exactly one argument")
+                    arg_type = self.check_expr(expr.args[0])
+                    if arg_type != "str":
+                        raise TypeError(f"Function 'intern' expects str, got {arg_type}")
+                    expr.inferred_type = "str"
+                    return "str"
                 if fname == "open":
-                    if len(expr.args) != 2:
-                        raise TypeError("Function 'open' expects exactly two arguments")
+                    if len(expr.args) not in (2, 3):
+                        raise TypeError("Function 'open' expects two or three arguments")
                     a0 = self.check_expr(expr.args[0])
                     a1 = self.check_expr(expr.args[1])
                     if a0 != "str" or a1 != "str":
                         raise TypeError("Function 'open' expects (str, str)")
+                    if len(expr.args) == 3 and self.check_expr(expr.args[2]) != "int":
+                        raise TypeError("Function 'open' buffering argument must be int")
                     expr.inferred_type = "file"
                     return "file"
 
+                if fname == "parallel_for" and fname not in self.functions:
+                    if len(expr.args) != 2:
+                        raise TypeError("Function 'parallel_for' expects a range and a function")
+                    rng = expr.args[0]
+                    if not (isinstance(rng, CallExpr) and isinstance(rng.func, Identifier)
+                            and rng.func.name == "range" and len(rng.args) in (1, 2)):
+                        raise TypeError("Function 'parallel_for' expects range(stop) or range(start, stop) first")
+                    for bound in rng.args:
+                        if self.check_expr(bound) != "int":
+                            raise TypeError("Function 'parallel_for' range bounds must be int")
+                    self.check_task_function(expr.args[1], fname, "None")
+                    expr.inferred_type = "None"
+                    return "None"
+
+                if fname == "spawn" and fname not in self.functions:
+                    if len(expr.args) != 2:
+                        raise TypeError("Function 'spawn' expects a function and its int argument")
+                    self.check_task_function(expr.args[0], fname, "int")
+                    if self.check_expr(expr.args[1]) != "int":
+                        raise TypeError("Function 'spawn' argument must be int")
+                    expr.inferred_type = "future"
+                    return "future"
+
+                if fname == "atomic" and fname not in self.functions:
+                    if len(expr.args) != 1 or self.check_expr(expr.args[0]) != "int":
+                        raise TypeError("Function 'atomic' expects one int argument")
+                    expr.inferred_type = "atomic"
+                    return "atomic"
+
+                if fname == "set":
+                    if len(expr.args) != 1:
+                        raise TypeError("Function 'set' expects exactly one argument")
+                    arg_type = self.check_expr(expr.args[0])
+                    if not (arg_type.startswith("list[") and arg_type.endswith("]")):
+                        raise TypeError(f"Function 'set' expects a list, got {arg_type}")
+                    elem_type = arg_type[5:-1]
+                    if elem_type not in {"int", "float", "bool", "str"}:
+                        raise TypeError(f"Function 'set' not supported for list[{elem_type}]")
+                    expr.inferred_type = f"set[{elem_type}]"
+                    return expr.inferred_type
+
                 if fname == "len":
                     if len(expr.args) != 1:
                         raise TypeError("Function 'len' expects exactly one argument")
@@ -635,6 +750,28 @@ class TypeChecker:
                         return "int"
                     raise TypeError(f"Function 'len' not supported for type {arg_type}")
 
+                if fname == "sorted" and fname not in self.functions:
+                    if len(expr.args) != 1:
+                        raise TypeError("Function 'sorted' expects exactly one argument")
+                    arg_type = self.check_expr(expr.args[0])
+                    if not (arg_type.startswith("list[") and arg_type[5:-1] in SORTABLE_ELEMENT_TYPES):
+                        raise TypeError(f"Function 'sorted' expects a list of int, float, bool or str, got {arg_type}")
+                    expr.inferred_type = arg_type
+                    return arg_type
+
+                if fname in NUMERIC_LIST_BUILTINS and fname not in self.functions:
+                    arity, returns_list = NUMERIC_LIST_BUILTINS[fname]
+                    if len(expr.args) != arity:
+                        raise TypeError(f"Function '{fname}' expects exactly {'one' if arity == 1 else 'two'} "
+                                        f"argument{'s' if arity > 1 else ''}")
+                    arg_types = [self.check_expr(arg) for arg in expr.args]
+                    if arg_types[0] not in ("list[int]", "list[float]"):
+                        raise TypeError(f"Function '{fname}' expects list[int] or list[float], got {arg_types[0]}")
+                    if any(t != arg_types[0] for t in arg_types[1:]):
+                        raise TypeError(f"Function '{fname}' expects lists of the same type, got {', '.join(arg_types)}")
+                    expr.inferred_type = arg_types[0] if returns_list else arg_types[0][5:-1]
+                    return expr.inferred_type
+
                 if fname not in self.functions:
                     raise TypeError(f"Call to undefined function '{fname}'")
                 param_types, return_type, num_required = self.functions[fname]
@@ -669,9 +806,9 @@ class TypeChecker:
 
                 if isinstance(base, Identifier) and base.name in self.env and self.env[base.name] == "file":
                     base.inferred_type = "file"
-                    if attr == "read":
+                    if attr in ("read", "mmap"):
                         if len(expr.args) != 0:
-                            raise TypeError("File.read expects no arguments")
+                            raise TypeError(f"File.{attr} expects no arguments")
                         expr.inferred_type = "str"
                         return "str"
                     if attr == "write":
@@ -681,19 +818,41 @@ class TypeChecker:
                             raise TypeError("File.write argument must be str")
                         expr.inferred_type = "None"
                         return "None"
-                    if attr == "close":
+                    if attr == "writelines":
+                        if len(expr.args) != 1:
+                            raise TypeError("File.writelines expects one argument")
+                        if self.check_expr(expr.args[0]) != "list[str]":
+                            raise TypeError("File.writelines argument must be list[str]")
+                        expr.inferred_type = "None"
+                        return "None"
+                    if attr in ("flush", "close"):
                         if len(expr.args) != 0:
-                            raise TypeError("File.close expects no arguments")
+                            raise TypeError(f"File.{attr} expects no arguments")
                         expr.inferred_type = "None"
                         return "None"
                     raise TypeError(f"File object has no method '{attr}'")
 
+                if isinstance(base, Identifier) and self.env.get(base.name) in HANDLE_METHODS:
+                    kind = self.env[base.name]
+                    base.inferred_type = kind
+                    if attr not in HANDLE_METHODS[kind]:
+                        raise TypeError(f"{kind} object has no method '{attr}'")
+                    params, ret = HANDLE_METHODS[kind][attr]
+                    if len(expr.args) != len(params):
+                        raise TypeError(f"{kind}.{attr} expects {len(params)} argument(s), got {len(expr.args)}")
+                    for i, (arg, expected) in enumerate(zip(expr.args, params)):
+                        self.check_arg_compatibility(self.check_expr(arg), expected, i + 1, f"{kind}.{attr}")
+                    expr.inferred_type = ret
+                    return ret
+
                 try:
                     base_type = self.check_expr(base)
                 except TypeError:
                     base_type = None
                 if base_type and base_type.startswith("list[") and base_type.endswith("]"):
                     elem_type = base_type[5:-1]
+                    if elem_type in self.soa_classes and attr not in ("append", "reserve"):
+                        raise TypeError(f"list[{elem_type}] of an @soa class supports only append and reserve")
                     if attr == "append":
                         if len(expr.args) != 1:
                             raise TypeError("List.append expects one argument")
@@ -706,6 +865,13 @@ class TypeChecker:
                             raise TypeError("List.pop expects no arguments")
                         expr.inferred_type = elem_type
                         return elem_type
+                    if attr == "sort":
+                        if len(expr.args) != 0:
+                            raise TypeError("List.sort expects no arguments")
+                        if elem_type not in SORTABLE_ELEMENT_TYPES:
+                            raise TypeError(f"List.sort not supported for list[{elem_type}]")
+                        expr.inferred_type = "None"
+                        return "None"
                     if attr == "remove":
                         if len(expr.args) != 1:
                             raise TypeError("List.remove expects one argument")
@@ -713,6 +879,62 @@ class TypeChecker:
                         self.check_arg_compatibility(arg_ty, elem_type, 1, "remove")
                         expr.inferred_type = "bool"
                         return "bool"
+                    if attr in ("index", "count", "remove_all"):
+                        if len(expr.args) != 1:
+                            raise TypeError(f"List.{attr} expects one argument")
+                        arg_ty = self.check_expr(expr.args[0])
+                        self.check_arg_compatibility(arg_ty, elem_type, 1, attr)
+                        expr.inferred_type = "int"
+                        return "int"
+                    if attr == "swap_remove":
+                        if len(expr.args) != 1:
+                            raise TypeError("List.swap_remove expects one argument")
+                        if self.check_expr(expr.args[0]) != "int":
+                            raise TypeError("List.swap_remove index must be int")
+                        expr.inferred_type = elem_type
+                        return elem_type
+                    if attr == "insert":
+                        if len(expr.args) != 2:
+                            raise TypeError("List.insert expects two arguments")
+                        if self.check_expr(expr.args[0]) != "int":
+                            raise TypeError("List.insert index must be int")
+                        arg_ty = self.check_expr(expr.args[1])
+                        self.check_arg_compatibility(arg_ty, elem_type, 2, "insert")
+                        expr.inferred_type = "None"
+                        return "None"
+                    if attr == "extend":
+                        if len(expr.args) != 1:
+                            raise TypeError("List.extend expects one argument")
+                        arg_ty = self.check_expr(expr.args[0], base_type)
+                        if arg_ty != base_type:
+                            raise TypeError(f"List.extend expects {base_type}, got {arg_ty}")
+                        expr.inferred_type = "None"
+                        return "None"
+                    if attr == "reserve":
+                        if len(expr.args) != 1:
+                            raise TypeError("List.reserve expects one argument")
+                        if self.check_expr(expr.args[0]) != "int":
+                            raise TypeError("List.reserve expects an int capacity")
+                        expr.inferred_type = "None"
+                        return "None"
+                if base_type and base_type.startswith("set[") and base_type.endswith("]"):
+                    elem_type = base_type[4:-1]
+                    if attr in {"add", "discard"}:
+                        if len(expr.args) != 1:
+                            raise TypeError(f"Set.{attr} expects one argument")
+                        arg_ty = self.check_expr(expr.args[0])
+                        self.check_arg_compatibility(arg_ty, elem_type, 1, attr)
+                        expr.inferred_type = "None"
+                        return "None"
+                    if attr in {"union", "intersection", "difference"}:
+                        if len(expr.args) != 1:
+                            raise TypeError(f"Set.{attr} expects one argument")
+                        arg_ty = self.check_expr(expr.args[0])
+                        if arg_ty != base_type:
+                            raise TypeError(f"Set.{attr} expects {base_type}, got {arg_ty}")
+                        expr.inferred_type = base_type
+                        return base_type
+                    raise TypeError(f"Set object has no method '{attr}'")
 
                 # --- INSTANCE OR STATIC CLASS METHOD CALL ---
                 obj = base
@@ -805,6 +1027,10 @@ class TypeChecker:
                 expr.inferred_type = mod.exports[expr.attr]
                 return expr.inferred_type
 
+            if isinstance(expr.obj, IndexExpr):
+                expr.inferred_type = self.check_element_attr(expr)
+                return expr.inferred_type
+
             if not isinstance(expr.obj, Identifier):
                 raise TypeError("Attribute access must be through an identifier")
 
@@ -819,12 +1045,20 @@ class TypeChecker:
 
             # --- instance-field on any variable (including self) ---
             if obj_name in self.env and self.env[obj_name] == "file":
-                if expr.attr not in {"read", "write", "close"}:
+                if expr.attr not in {"read", "mmap", "write", "writelines", "flush", "close"}:
                     raise TypeError(f"File object has no attribute '{expr.attr}'")
                 expr.obj.inferred_type = "file"
                 expr.inferred_type = "function"
                 return "function"
 
+            if self.env.get(obj_name) in HANDLE_METHODS:
+                kind = self.env[obj_name]
+                if expr.attr not in HANDLE_METHODS[kind]:
+                    raise TypeError(f"{kind} object has no attribute '{expr.attr}'")
+                expr.obj.inferred_type = kind
+                expr.inferred_type = "function"
+                return "function"
+
             if obj_name in self.env:
                 class_type = self.env[obj_name]
                 expr.obj.inferred_type = class_type
@@ -873,6 +1107,9 @@ class TypeChecker:
                 if index_type != "int":
                     raise TypeError(f"List index must be int, got {index_type}")
                 elem = base_type[5:-1]
+                if elem in self.soa_classes and not getattr(expr, "field_base", False):
+                    raise TypeError(f"list[{elem}] stores @soa objects field by field; "
+                                    f"use xs[i].<field> instead of xs[i]")
                 expr.elem_type = elem
                 expr.inferred_type = base_type
                 return elem
@@ -888,6 +1125,17 @@ class TypeChecker:
             else:
                 raise TypeError(f"Cannot index into value of type '{base_type}'")
 
+        # list[T][a:b] → list[T], a copy
+        elif isinstance(expr, SliceExpr):
+            base_type = self.check_expr(expr.base)
+            if not (base_type.startswith("list[") and base_type.endswith("]")):
+                raise TypeError(f"Slicing is only supported on lists, got '{base_type}'")
+            for bound in (expr.start, expr.stop):
+                if bound is not None and self.check_expr(bound) != "int":
+                    raise TypeError("Slice bounds must be int")
+            expr.inferred_type = base_type
+            return base_type
+
         # PB supports:
         # ListExpr(elements=[...])        → list[T]
         #
@@ -905,6 +1153,8 @@ class TypeChecker:
             elem_types = {self.check_expr(e) for e in expr.elements}
             if len(elem_types) > 1:
                 raise TypeError(f"List elements must be the same type, got: {elem_types}")
+            if elem_types & self.soa_classes:
+                raise TypeError("A list of @soa objects starts empty; fill it with append()")
 
             elem_type = elem_types.pop()
             expr.elem_type = elem_type
@@ -1120,6 +1370,14 @@ class TypeChecker:
             if isinstance(obj, Identifier) and obj.name in self.modules:
                 raise TypeError(f"Cannot assign to attribute '{field_name}' of imported module '{obj.name}'")
 
+            if isinstance(obj, IndexExpr):
+                expected = self.check_element_attr(stmt.target, store=True)
+                value_type = self.check_expr(stmt.value)
+                if not types_match(value_type, expected):
+                    raise TypeError(f"Type mismatch for instance attribute '{field_name}': expected {expected}, got {value_type}")
+                stmt.inferred_type = value_type
+                return
+
             # figure out what class this instance is
             if isinstance(obj, Identifier) and obj.name in self.env:
                 class_type = self.env[obj.name]
@@ -1186,7 +1444,9 @@ class TypeChecker:
             if isinstance(target.obj, Identifier) and target.obj.name in self.modules:
                 raise TypeError(f"Cannot assign to attribute '{target.attr}' of imported module '{target.obj.name}'")
 
-            if isinstance(target.obj, Identifier) and target.obj.name == "self":
+            if isinstance(target.obj, IndexExpr):
+                expected_type = self.check_element_attr(target, store=True)
+            elif isinstance(target.obj, Identifier) and target.obj.name == "self":
                 # self.field → valid only if inside method
                 if not self.inside_method:
                     raise TypeError("'self' is not valid outside of method")
@@ -1259,29 +1519,37 @@ class TypeChecker:
         self.in_loop -= 1
 
     def check_for_stmt(self, stmt: ForStmt):
-        """Type-check a for loop over list[T] or set[T].
+        """Type-check a for loop over a list, set, dict, str or the lines of a file.
 
         Type-checking requirements:
-        - Iterable must be a list[T] or set[T]
-        - var_name is assigned elements of type T
-        - Body type-checks with var_name bound to T
+        - Iterable must be a list[T], set[T], dict[str, V] (its keys), str
+          (its characters) or file (its lines)
+        - Two or more loop variables unpack one of the forms the compiler
+          lowers itself: enumerate(xs[, start]) gives (int, T), zip(xs, ys, ...)
+          over lists and sets gives one element of each, d.items() gives (str, V)
+        - Each loop variable is bound to its element type in the body
         - Must track loop context for break / continue
         """
-        iterable_type = self.check_expr(stmt.iterable)
-
-        if iterable_type.startswith("list[") and iterable_type.endswith("]"):
-            element_type = iterable_type[5:-1]
-        elif iterable_type.startswith("set[") and iterable_type.endswith("]"):
-            element_type = iterable_type[4:-1]
-        else:
-            raise TypeError(
-                f"For loop requires iterable of type list[T] or set[T], got {iterable_type}"
-            )
-        stmt.elem_type = element_type
+        names = [stmt.var_name] + stmt.extra_vars
+        element_types = self.check_for_unpacking(stmt.iterable, len(names))
+        if element_types is None:
+            iterable_type = self.check_expr(stmt.iterable)
+            element_type = self.iterated_type(iterable_type, allow_file=True)
+            if element_type is None:
+                raise TypeError(
+                    f"For loop requires iterable of type list[T], set[T], dict[str, V], str or file, got {iterable_type}"
+                )
+            if len(names) > 1:
+                raise TypeError(f"Cannot unpack the elements of {iterable_type} into {len(names)} loop variables")
+            element_types = [element_type]
+        if len(set(names)) != len(names):
+            raise TypeError("For loop variables must be distinct")
+        stmt.elem_type = element_types[0]
 
         # Extend environment with loop variable
         old_env = self.env.copy()
-        self.env[stmt.var_name] = element_type
+        for name, element_type in zip(names, element_types):
+            self.env[name] = element_type
 
         self.in_loop += 1
         for s in stmt.body:
@@ -1290,6 +1558,66 @@ class TypeChecker:
 
         self.env = old_env
 
+    def iterated_type(self, iterable_type: str, allow_file: bool = False) -> Optional[str]:
+        """What a for loop over a value of `iterable_type` binds, or None if it cannot loop over it."""
+        if iterable_type.startswith("list[") and iterable_type.endswith("]"):
+            element_type = iterable_type[5:-1]
+            if element_type in self.soa_classes:
+                raise TypeError(f"list[{element_type}] stores @soa objects field by field; "
+                                f"loop over range(len(xs)) and use xs[i].<field>")
+            return element_type
+        if iterable_type.startswith("set[") and iterable_type.endswith("]"):
+            return iterable_type[4:-1]
+        if iterable_type.startswith("dict[") and iterable_type.endswith("]"):
+            return "str"
+        if iterable_type == "str" or (allow_file and iterable_type == "file"):
+            return "str"
+        return None
+
+    def check_for_unpacking(self, iterable: Expr, n_vars: int) -> Optional[list[str]]:
+        """
+        Element types for `for a, b, ... in` enumerate(...), zip(...) or
+        d.items(), which exist only as for-loop iterables. None for any other
+        iterable (and for a user function named enumerate or zip).
+        """
+        if not isinstance(iterable, CallExpr):
+            return None
+        func = iterable.func
+        if isinstance(func, Identifier) and func.name in ("enumerate", "zip") and func.name not in self.functions:
+            name = func.name
+            if name == "enumerate":
+                if len(iterable.args) not in (1, 2):
+                    raise TypeError("enumerate() expects an iterable and an optional int start")
+                if len(iterable.args) == 2 and self.check_expr(iterable.args[1]) != "int":
+                    raise TypeError("enumerate() start must be int")
+                arg_type = self.check_expr(iterable.args[0])
+                element_type = self.iterated_type(arg_type)
+                if element_type is None:
+                    raise TypeError(f"enumerate() requires a list, set, dict or str, got {arg_type}")
+                types = ["int", element_type]
+            else:
+                if len(iterable.args) < 2:
+                    raise TypeError("zip() expects at least two lists or sets")
+                types = []
+                for arg in iterable.args:
+                    arg_type = self.check_expr(arg)
+                    if not arg_type.startswith(("list[", "set[")):
+                        raise TypeError(f"zip() arguments must be lists or sets, got {arg_type}")
+                    types.append(self.iterated_type(arg_type))
+            if n_vars != len(types):
+                raise TypeError(f"{name}() here gives {len(types)} values per iteration, "
+                                f"but the loop has {n_vars} variable(s)")
+            iterable.inferred_type = name
+            return types
+        if isinstance(func, AttributeExpr) and func.attr == "items" and not iterable.args:
+            obj_type = self.check_expr(func.obj)
+            if obj_type.startswith("dict[") and obj_type.endswith("]"):
+                if n_vars != 2:
+                    raise TypeError("Loop over dict.items() needs two variables, for the key and the value")
+                iterable.inferred_type = "items"
+                return ["str", obj_type[len("dict[str, "):-1]]
+        return None
+
     def is_subclass(self, sub: str, sup: str) -> bool:
         """
         Determines whether `sub` is the same as or a subclass of `sup`.
@@ -1314,6 +1642,27 @@ class TypeChecker:
             sub = self.class_bases[sub]
         return sub == sup
 
+    def check_element_attr(self, expr: AttributeExpr, store: bool = False) -> str:
+        """Type of `xs[i].attr` where `xs` is a list of class objects.
+
+        This is the only way to reach an element of an `@soa` list, whose
+        objects exist only as one slot per field array. Stores must target
+        an instance field; loads may also read a class attribute.
+        """
+        obj = expr.obj
+        obj.field_base = True
+        class_type = self.check_expr(obj)
+        if class_type not in self.instance_fields:
+            raise TypeError(f"Elements of '{obj.inferred_type}' have no attributes")
+        fields = self.instance_fields[class_type]
+        if expr.attr in fields:
+            return fields[expr.attr]
+        if not store:
+            class_attr_type = self.lookup_class_attr(class_type, expr.attr)
+            if class_attr_type is not None:
+                return class_attr_type
+        raise TypeError(f"Class '{class_type}' has no instance attribute '{expr.attr}'")
+
     def lookup_class_attr(self, class_name: str, attr: str) -> str | None:
         """Return the type of a class attribute by walking the inheritance chain."""
         c = class_name
@@ -1360,8 +1709,17 @@ class TypeChecker:
         if cls.base:
             if cls.base not in self.known_classes:
                 raise TypeError(f"Base class '{cls.base}' not defined before '{name}'")
+            if cls.base in self.soa_classes:
+                raise TypeError(f"Cannot subclass @soa class '{cls.base}'")
             self.class_bases[cls.name] = cls.base
 
+        for decorator in cls.decorators:
+            if decorator != "soa":
+                raise TypeError(f"Unknown class decorator '@{decorator}' on '{name}'")
+            if cls.base:
+                raise TypeError(f"@soa class '{name}' cannot have a base class")
+            self.soa_classes.add(name)
+
         # Register class early
         self.known_classes.add(name)
         self.instance_fields[name] = {}
@@ -1447,6 +1805,16 @@ class TypeChecker:
                     f"Cannot raise value of type None — expression was: {stmt.exception}"
                 )
 
+    def check_del_stmt(self, stmt: DelStmt):
+        """Check a del statement; only dict items (`del d[key]`) can be deleted."""
+        target = stmt.target
+        if not isinstance(target, IndexExpr):
+            raise TypeError("'del' only supports dict items, e.g. del d[key]")
+        self.check_expr(target)
+        base_type = target.inferred_type
+        if not base_type.startswith("dict["):
+            raise TypeError(f"'del' not supported for items of type {base_type}")
+
     def check_global_stmt(self, stmt: GlobalStmt):
         """Ensure global declaration is inside a function body.
 
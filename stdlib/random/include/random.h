@@ -0,0 +1,15 @@
+#ifndef PB_STDLIB_RANDOM_H
+#define PB_STDLIB_RANDOM_H
+
+/* Calls into a native module keep their PB names; these route the
+ * `random` module's functions to the runtime generators.           */
+#include "pb_runtime.h"
+
+#define seed(x)                pb_random_seed(x)
+#define random()               pb_random_random()
+#define randint(a, b)          pb_random_randint(a, b)
+#define uniform(a, b)          pb_random_uniform(a, b)
+#define fill_floats(xs, n)     pb_random_fill_floats(xs, n)
+#define fill_ints(xs, n, a, b) pb_random_fill_ints(xs, n, a, b)
+
+#endif
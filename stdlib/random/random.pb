@@ -0,0 +1,28 @@
+# Native binding for the PB runtime's random number generators (see the
+# RANDOM section of pb_runtime.h). Every thread draws from its own
+# xoshiro256** state. A program that never calls seed() behaves as if it
+# had called seed(0).
+
+def seed(x: int) -> None:
+    """Restart the calling thread's generator; other threads reseed on their next draw."""
+    ...
+
+def random() -> float:
+    """Return a float in [0.0, 1.0)."""
+    ...
+
+def randint(a: int, b: int) -> int:
+    """Return a random integer N such that a <= N <= b."""
+    ...
+
+def uniform(a: float, b: float) -> float:
+    """Return a float in [a, b]."""
+    ...
+
+def fill_floats(xs: list[float], n: int) -> None:
+    """Overwrite xs[0:n] with floats in [0.0, 1.0); n must not exceed len(xs)."""
+    ...
+
+def fill_ints(xs: list[int], n: int, a: int, b: int) -> None:
+    """Overwrite xs[0:n] with integers N such that a <= N <= b; n must not exceed len(xs)."""
+    ...
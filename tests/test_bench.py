@@ -0,0 +1,124 @@
+import contextlib
+import io
+import json
+import os
+import tempfile
+import unittest
+
+from bench import BenchError, compile_benchmark, discover, generate_module, percentile, run_benchmarks
+
+
+def write(path: str, text: str) -> None:
+    with open(path, "w") as f:
+        f.write(text)
+
+
+TINY_PB = (
+    "def main():\n"
+    "    total: int = 0\n"
+    "    for i in range(1000):\n"
+    "        total += i\n"
+    "    print(total)\n"
+    "\n"
+    "if __name__ == \"__main__\":\n"
+    "    main()\n"
+)
+
+
+class TestBenchHelpers(unittest.TestCase):
+
+    def test_percentile_is_nearest_rank(self):
+        samples = [float(v) for v in range(20, 0, -1)]
+        self.assertEqual(percentile(samples, 50), 10.0)
+        self.assertEqual(percentile(samples, 95), 19.0)
+        self.assertEqual(percentile([3.0], 95), 3.0)
+
+    def test_discover_rejects_unknown_names(self):
+        with tempfile.TemporaryDirectory() as tmp:
+            write(os.path.join(tmp, "a.pb"), TINY_PB)
+            self.assertEqual(discover(tmp), [os.path.join(tmp, "a.pb")])
+            with self.assertRaises(BenchError) as ctx:
+                discover(tmp, ["b"])
+            self.assertIn("Unknown benchmark(s): b", str(ctx.exception))
+
+    def test_suite_programs_all_have_c_baselines(self):
+        for path in discover():
+            name = os.path.splitext(os.path.basename(path))[0]
+            with self.subTest(bench=name):
+                self.assertTrue(os.path.isfile(os.path.join(os.path.dirname(path), "c", f"{name}.c")))
+
+
+class TestRunBenchmarks(unittest.TestCase):
+
+    def run_quietly(self, **kwargs) -> tuple[dict, str]:
+        out = io.StringIO()
+        with contextlib.redirect_stdout(out):
+            report = run_benchmarks(**kwargs)
+        return report, out.getvalue()
+
+    def test_results_cover_every_variant_and_are_saved(self):
+        with tempfile.TemporaryDirectory() as tmp:
+            write(os.path.join(tmp, "bench_tiny.pb"), TINY_PB)
+            os.makedirs(os.path.join(tmp, "c"))
+            write(os.path.join(tmp, "c", "bench_tiny.c"),
+                  "#include <stdio.h>\nint main(void) { printf(\"499500\\n\"); return 0; }\n")
+            out_path = os.path.join(tmp, "results.json")
+
+            report, table = self.run_quietly(profiles=["debug"], repeat=3, out_path=out_path, bench_dir=tmp)
+
+            self.assertEqual([r["impl"] for r in report["results"]], ["pb-debug", "cpython", "c"])
+            for r in report["results"]:
+                self.assertEqual(len(r["runs_s"]), 3)
+                self.assertLessEqual(r["median_s"], r["p95_s"])
+                if os.name != "nt":
+                    self.assertGreater(r["peak_rss_kb"], 0)
+            with open(out_path) as f:
+                self.assertEqual(json.load(f)["results"], report["results"])
+            self.assertIn("bench_tiny    pb-debug", table)
+
+            # A second run compares its medians against the first
+            _, table = self.run_quietly(profiles=["debug"], repeat=1, out_path=os.path.join(tmp, "again.json"),
+                                        baseline=out_path, bench_dir=tmp)
+            self.assertIn("vs base", table)
+
+    def test_output_differing_from_cpython_fails(self):
+        with tempfile.TemporaryDirectory() as tmp:
+            write(os.path.join(tmp, "bench_tiny.pb"), TINY_PB)
+            os.makedirs(os.path.join(tmp, "c"))
+            write(os.path.join(tmp, "c", "bench_tiny.c"),
+                  "#include <stdio.h>\nint main(void) { printf(\"0\\n\"); return 0; }\n")
+            with self.assertRaises(BenchError) as ctx:
+                self.run_quietly(profiles=["debug"], repeat=1, out_path=os.path.join(tmp, "r.json"), bench_dir=tmp)
+            self.assertIn("bench_tiny [c] printed something other than CPython", str(ctx.exception))
+
+
+class TestCompileBenchmark(unittest.TestCase):
+
+    def test_generated_module_has_the_requested_size(self):
+        for lines in (1, 500, 5000):
+            with self.subTest(lines=lines):
+                source = generate_module(lines)
+                self.assertGreaterEqual(source.count("\n"), lines)
+                self.assertLess(source.count("\n"), lines + 40)
+                compile(source, "<generated>", "exec")  # also valid Python
+
+    def test_every_phase_is_timed_and_saved(self):
+        with tempfile.TemporaryDirectory() as tmp:
+            out_path = os.path.join(tmp, "compile.json")
+            with contextlib.redirect_stdout(io.StringIO()):
+                report = compile_benchmark(300, repeat=2, out_path=out_path)
+            self.assertEqual([r["impl"] for r in report["results"]], ["lex", "parse", "check", "fold", "codegen"])
+            self.assertTrue(all(len(r["runs_s"]) == 2 for r in report["results"]))
+            self.assertGreaterEqual(report["lines"], 300)
+            self.assertGreater(report["lines_per_s"], 0)
+            with open(out_path) as f:
+                self.assertEqual(json.load(f)["results"], report["results"])
+
+            out = io.StringIO()
+            with contextlib.redirect_stdout(out):
+                compile_benchmark(300, repeat=1, out_path=os.path.join(tmp, "again.json"), baseline=out_path)
+            self.assertIn("vs base", out.getvalue())
+
+
+if __name__ == "__main__":
+    unittest.main()
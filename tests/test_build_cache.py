@@ -0,0 +1,125 @@
+import os
+import subprocess
+import tempfile
+import time
+import unittest
+
+from build_cache import ModuleCache, object_key
+from module_loader import load_module
+from main import build, get_build_output_path
+from pb_pipeline import compile_code_to_ast
+
+
+def write(path: str, text: str) -> None:
+    with open(path, "w") as f:
+        f.write(text)
+
+
+class TestModuleCache(unittest.TestCase):
+
+    def test_unchanged_module_is_reused(self):
+        with tempfile.TemporaryDirectory() as tmp:
+            write(os.path.join(tmp, "foo.pb"), "def f() -> int:\n    return 1\n")
+            cache = ModuleCache(os.path.join(tmp, "cache"))
+
+            first = load_module(["foo"], [tmp], {}, cache=cache)
+            second = load_module(["foo"], [tmp], {}, cache=cache)
+
+            self.assertEqual((cache.hits, cache.misses), (1, 1))
+            self.assertEqual(second.exports, {"f": "function"})
+            self.assertEqual(first.cache_key, second.cache_key)
+
+    def test_importer_is_invalidated_by_dependency_change(self):
+        with tempfile.TemporaryDirectory() as tmp:
+            write(os.path.join(tmp, "leaf.pb"), "def f() -> int:\n    return 1\n")
+            write(os.path.join(tmp, "top.pb"), "import leaf\n\ndef g() -> int:\n    return leaf.f()\n")
+            cache = ModuleCache(os.path.join(tmp, "cache"))
+            load_module(["top"], [tmp], {}, cache=cache)
+
+            write(os.path.join(tmp, "leaf.pb"), "def f() -> int:\n    return 2\n\ndef h() -> int:\n    return 3\n")
+            loaded = {}
+            load_module(["top"], [tmp], loaded, cache=cache)
+
+            self.assertEqual(cache.hits, 0)
+            self.assertIn("h", loaded[("leaf",)].exports)
+
+    def test_body_only_edit_keeps_other_modules_cached(self):
+        with tempfile.TemporaryDirectory() as tmp:
+            write(os.path.join(tmp, "a.pb"), "def f() -> int:\n    return 1\n")
+            write(os.path.join(tmp, "b.pb"), "def g() -> int:\n    return 2\n")
+            cache = ModuleCache(os.path.join(tmp, "cache"))
+            load_module(["a"], [tmp], {}, cache=cache)
+            load_module(["b"], [tmp], {}, cache=cache)
+
+            write(os.path.join(tmp, "a.pb"), "def f() -> int:\n    return 10\n")
+            load_module(["a"], [tmp], {}, cache=cache)
+            load_module(["b"], [tmp], {}, cache=cache)
+
+            self.assertEqual((cache.hits, cache.misses), (1, 3))
+
+    def test_shared_dependency_is_loaded_once_per_build(self):
+        with tempfile.TemporaryDirectory() as tmp:
+            write(os.path.join(tmp, "common.pb"), "def c() -> int:\n    return 1\n")
+            write(os.path.join(tmp, "a.pb"), "import common\n\ndef fa() -> int:\n    return common.c()\n")
+            write(os.path.join(tmp, "b.pb"), "from common import c\n\ndef fb() -> int:\n    return c()\n")
+            main_path = os.path.join(tmp, "main.pb")
+            source = "import a\nimport b\n\ndef main():\n    print(a.fa() + b.fb())\n"
+            cache = ModuleCache(os.path.join(tmp, "cache"))
+            compile_code_to_ast(source, pb_path=main_path, cache=cache)
+
+            # Validating main's entry loads a and common; the import pass must reuse them
+            write(os.path.join(tmp, "common.pb"), "def c() -> int:\n    return 2\n")
+            cache.hits = cache.misses = 0
+            _, loaded = compile_code_to_ast(source, pb_path=main_path, cache=cache)
+
+            self.assertEqual((cache.hits, cache.misses), (0, 4))
+            self.assertEqual(sorted(loaded), [("a",), ("b",), ("common",)])
+
+
+class TestObjectKey(unittest.TestCase):
+
+    def test_key_follows_included_headers_and_flags(self):
+        with tempfile.TemporaryDirectory() as tmp:
+            c_path = os.path.join(tmp, "m.c")
+            write(c_path, '#include "m.h"\nint x;\n')
+            write(os.path.join(tmp, "m.h"), '#include "dep.h"\n')
+            write(os.path.join(tmp, "dep.h"), "typedef int T;\n")
+
+            key = object_key(c_path, [], ["-O0"])
+            self.assertEqual(key, object_key(c_path, [], ["-O0"]))
+            self.assertNotEqual(key, object_key(c_path, [], ["-O2"]))
+
+            write(os.path.join(tmp, "dep.h"), "typedef long T;\n")
+            self.assertNotEqual(key, object_key(c_path, [], ["-O0"]))
+
+
+class TestIncrementalBuild(unittest.TestCase):
+
+    def test_only_the_edited_module_is_recompiled(self):
+        with tempfile.TemporaryDirectory() as tmp:
+            lib_path = os.path.join(tmp, "cachelib.pb")
+            main_path = os.path.join(tmp, "cachemain.pb")
+            write(lib_path, "def value() -> int:\n    return 1\n")
+            main_src = "import cachelib\n\ndef main():\n    print(cachelib.value())\n"
+            write(main_path, main_src)
+            exe = get_build_output_path("cachemain")
+
+            self.assertTrue(build(main_src, main_path, "cachemain")[0])
+            self.assertEqual(subprocess.run([exe], capture_output=True, text=True).stdout, "1\n")
+            main_obj = get_build_output_path(os.path.join("obj", "cachemain.o"))
+            lib_obj = get_build_output_path(os.path.join("obj", "cachelib.o"))
+            stamps = (os.path.getmtime(main_obj), os.path.getmtime(lib_obj), os.path.getmtime(exe))
+
+            time.sleep(0.01)
+            self.assertTrue(build(main_src, main_path, "cachemain")[0])
+            self.assertEqual(stamps, (os.path.getmtime(main_obj), os.path.getmtime(lib_obj), os.path.getmtime(exe)))
+
+            write(lib_path, "def value() -> int:\n    return 2\n")
+            self.assertTrue(build(main_src, main_path, "cachemain")[0])
+            self.assertEqual(subprocess.run([exe], capture_output=True, text=True).stdout, "2\n")
+            self.assertEqual(stamps[0], os.path.getmtime(main_obj))
+            self.assertNotEqual(stamps[1], os.path.getmtime(lib_obj))
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -3,6 +3,13 @@ from codegen import CodeGen
 from type_checker import TypeChecker
 from lang_ast import *
 
+def _fnv1a(name: str) -> int:
+    """Exception type id, as `pb_exc_id` computes it."""
+    h = 2166136261
+    for b in name.encode():
+        h = ((h ^ b) * 16777619) % 2**32
+    return h
+
 def assert_all_inferred_types_filled(program: Program):
     def visit_expr(e: Expr):
         if hasattr(e, "inferred_type") and getattr(e, "inferred_type") is None:
@@ -205,13 +212,13 @@ class TestCodeGen(unittest.TestCase):
         # Expected generated code contains:
         # int64_t value = 42;
         # const char * name = "Alice";
-        # pb_print_str((snprintf(__fbuf, 256, "Value is %lld", value), __fbuf));
-        # pb_print_str((snprintf(__fbuf, 256, "Hello, %s!", name), __fbuf));
+        # pb_print_fmt("Value is %" PRId64, value);
+        # pb_print_fmt("Hello, %s!", name);
         self.assertIn('int main(void)', output)
         self.assertIn('int64_t value = 42;', output)
         self.assertIn('const char * name = "Alice";', output)
-        self.assertIn('pb_print_str((snprintf(__fbuf, 256, "Value is %lld", value), __fbuf));', output)
-        self.assertIn('pb_print_str((snprintf(__fbuf, 256, "Hello, %s!", name), __fbuf));', output)
+        self.assertIn('pb_print_fmt("Value is %" PRId64, value);', output)
+        self.assertIn('pb_print_fmt("Hello, %s!", name);', output)
         self.assertIn('return 0;', output)
 
     def test_include_dotted_module_header(self):
@@ -414,8 +421,7 @@ class TestCodeGen(unittest.TestCase):
         ])
         output = codegen_output(program)
         assert_contains_all(self, output, [
-            "int64_t __tmp_list_1[] = {10, 20, 30}",
-            "List_int nums = (List_int){ .len=3, .data=__tmp_list_1 };",
+            "List_int nums = list_int_from_array((int64_t[]){10, 20, 30}, 3);",
             "int64_t first = list_int_get(&nums, 0);",
             "pb_print_int(first);",
             "return 0;"
@@ -459,10 +465,8 @@ class TestCodeGen(unittest.TestCase):
         ])
         output = codegen_output(program)
         assert_contains_all(self, output, [
-            "bool __tmp_list_1[] = {true, false};",
-            "List_bool arr = (List_bool){ .len=2, .data=__tmp_list_1 };",
-            "const char * __tmp_list_2[] = {\"true\", \"true\"};",
-            "List_str arr2 = (List_str){ .len=2, .data=__tmp_list_2 };",
+            "List_bool arr = list_bool_from_array((bool[]){true, false}, 2);",
+            "List_str arr2 = list_str_from_array((const char *[]){\"true\", \"true\"}, 2);",
             "List_int __tmp_list_3;",
             "list_int_init(&__tmp_list_3);",
             "List_int arr3 = __tmp_list_3;",
@@ -527,15 +531,12 @@ class TestCodeGen(unittest.TestCase):
         ])
         output = codegen_output(program)
         assert_contains_all(self, output, [
-            'Pair_str_int __tmp_dict_1[] = {{"a", 1}, {"b", 2}};',
-            'Dict_str_int d = (Dict_str_int){ .len=2, .data=__tmp_dict_1 };',
-            'pb_print_int(pb_dict_get_str_int(d, "a"));',
-            'Pair_str_str __tmp_dict_2[] = {{"a", "sth here"}, {"b", "and here"}};',
-            'Dict_str_str d2 = (Dict_str_str){ .len=2, .data=__tmp_dict_2 };',
-            'pb_print_str(pb_dict_get_str_str(d2, "a"));',
-            'Pair_str_bool __tmp_dict_3[] = {{"a", true}, {"b", false}};',
-            'Dict_str_bool d3 = (Dict_str_bool){ .len=2, .data=__tmp_dict_3 };',
-            'pb_print_bool(pb_dict_get_str_bool(d3, "a"));',
+            'Dict_str_int d = pb_dict_from_pairs_str_int((Pair_str_int[]){{"a", 1}, {"b", 2}}, 2);',
+            'pb_print_int(pb_dict_get_str_int(&d, "a"));',
+            'Dict_str_str d2 = pb_dict_from_pairs_str_str((Pair_str_str[]){{"a", "sth here"}, {"b", "and here"}}, 2);',
+            'pb_print_str(pb_dict_get_str_str(&d2, "a"));',
+            'Dict_str_bool d3 = pb_dict_from_pairs_str_bool((Pair_str_bool[]){{"a", true}, {"b", false}}, 2);',
+            'pb_print_bool(pb_dict_get_str_bool(&d3, "a"));',
             'return 0;'
         ])     
 
@@ -582,9 +583,13 @@ class TestCodeGen(unittest.TestCase):
             )
         ])
         output = codegen_output(program)
-        self.assertIn('pb_push_try(&', output)
+        # only the raise statement can raise: no setjmp needed
+        self.assertNotIn('setjmp', output)
+        self.assertIn('++pb_checked_depth;', output)
         self.assertIn('pb_raise_obj("RuntimeError"', output)
-        self.assertIn('strcmp(pb_current_exc.type, "RuntimeError") == 0', output)
+        self.assertIn('goto __exc_catch_', output)
+        self.assertIn('#define PB_EXC_RuntimeError 0x%08xu' % _fnv1a("RuntimeError"), output)
+        self.assertIn('pb_current_exc.id == PB_EXC_RuntimeError', output)
         self.assertIn('pb_clear_exc();', output)
         self.assertIn('pb_reraise();', output)
 
@@ -1286,8 +1291,7 @@ class TestCodeGen(unittest.TestCase):
         ])
         output = codegen_output(prog)
         assert_contains_all(self, output, [
-            "int64_t __tmp_list_1[] = {100};",
-            "List_int arr = (List_int){ .len=1, .data=__tmp_list_1 };",
+            "List_int arr = list_int_from_array((int64_t[]){100}, 1);",
             "pb_print_int(list_int_get(&arr, 0));",
             "list_int_set(&arr, 0, 1);",
             "int64_t x = list_int_get(&arr, 0);",
@@ -1320,8 +1324,7 @@ class TestCodeGen(unittest.TestCase):
         ])
         output = codegen_output(prog)
         assert_contains_all(self, output, [
-            "double __tmp_list_1[] = {0.1, 0.2};",
-            "List_float arr = (List_float){ .len=2, .data=__tmp_list_1 };",
+            "List_float arr = list_float_from_array((double[]){0.1, 0.2}, 2);",
             "list_float_set(&arr, 0, 0.125);",
             "list_float_print(&arr);"
         ])
@@ -1350,8 +1353,7 @@ class TestCodeGen(unittest.TestCase):
         ])
         output = codegen_output(prog)
         assert_contains_all(self, output, [
-            "bool __tmp_list_1[] = {true, true};",
-            "List_bool arr = (List_bool){ .len=2, .data=__tmp_list_1 };",
+            "List_bool arr = list_bool_from_array((bool[]){true, true}, 2);",
             "list_bool_set(&arr, 0, false);",
             "list_bool_print(&arr);"
         ])
@@ -1381,8 +1383,7 @@ class TestCodeGen(unittest.TestCase):
         output = codegen_output(prog)
 
         assert_contains_all(self, output, [
-            'const char * __tmp_list_1[] = {"a", "b"};',
-            "List_str arr = (List_str){ .len=2, .data=__tmp_list_1 };",
+            'List_str arr = list_str_from_array((const char *[]){"a", "b"}, 2);',
             "list_str_set(&arr, 0, \"c\");",
             "list_str_print(&arr);"
         ])
@@ -1411,8 +1412,7 @@ class TestCodeGen(unittest.TestCase):
         ])
         output = codegen_output(prog)
         assert_contains_all(self, output, [
-            "int64_t __tmp_list_1[] = {0};",
-            "List_int a = (List_int){ .len=1, .data=__tmp_list_1 };",
+            "List_int a = list_int_from_array((int64_t[]){0}, 1);",
             "list_int_set(&a, 0, 10);",
             "int64_t x = list_int_get(&a, 0);",
             "list_int_print(&a);",
@@ -1602,8 +1602,7 @@ class TestCodeGen(unittest.TestCase):
         ])
         output = codegen_output(prog)
         assert_contains_all(self, output, [
-            "int64_t __tmp_set_1[] = {1, 2}",
-            "Set_int s = (Set_int){ .len=2, .data=__tmp_set_1 };",
+            "Set_int s = set_int_from_array((int64_t[]){1, 2}, 2);",
             "set_int_print(&s);",
             "return 0;",
         ])
@@ -1786,8 +1785,8 @@ class TestCodeGen(unittest.TestCase):
 
         output = codegen_output(prog)
         self.assertIn('int64_t x = 1;', output)
-        self.assertIn('pb_print_str((snprintf(__fbuf, 256, "%s", pb_format_double((x * 2.0))), __fbuf));', output)
-        self.assertIn('pb_print_str((snprintf(__fbuf, 256, "%lld", (x * false)), __fbuf));', output)
+        self.assertIn('pb_print_fmt("%s", pb_format_double((x * 2.0)));', output)
+        self.assertIn('pb_print_fmt("%" PRId64, (x * false));', output)
 
     def test_global_class_instances_codegen(self):
         prog = Program(body=[
@@ -1805,7 +1804,8 @@ class TestCodeGen(unittest.TestCase):
 
         output = codegen_output(prog)
         assert_contains_all(self, output, [
-            "__attribute__((constructor)) static void main__init_globals",
+            "PbModuleInit main__module;",
+            "void main__init_globals(void)",
             "struct Empty __tmp_empty_",
             "struct ClassWithUserDefinedAttr __tmp_classwithuserdefinedattr_",
         ])
@@ -1827,8 +1827,7 @@ class TestCodeGen(unittest.TestCase):
         ])
         output = codegen_output(prog)
         assert_contains_all(self, output, [
-            "int64_t __tmp_list_1[] = {1, 2, 3};",
-            "List_int arr = (List_int){ .len=3, .data=__tmp_list_1 };",
+            "List_int arr = list_int_from_array((int64_t[]){1, 2, 3}, 3);",
             "int64_t l = arr.len;",
             "pb_print_int(l);",
         ])
@@ -1851,8 +1850,7 @@ class TestCodeGen(unittest.TestCase):
         ])
         output = codegen_output(prog)
         assert_contains_all(self, output, [
-            "int64_t __tmp_list_1[] = {1, 2};",
-            "List_int arr = (List_int){ .len=2, .data=__tmp_list_1 };",
+            "List_int arr = list_int_from_array((int64_t[]){1, 2}, 2);",
             "list_int_append(&arr, 3);",
             "int64_t x = list_int_pop(&arr);",
             "bool r = list_int_remove(&arr, 1);",
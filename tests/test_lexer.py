@@ -359,10 +359,10 @@ class TestLexer(unittest.TestCase):
         self.assertTrue(dedents and all(d.column == 1 for d in dedents))
 
     def test_unknown_token_includes_lexeme(self):
-        code = "a @ b\n"
+        code = "a $ b\n"
         with self.assertRaises(LexerError) as cm:
             Lexer(code).tokenize()
-        self.assertIn("@", str(cm.exception))
+        self.assertIn("$", str(cm.exception))
 
 
 class TestLexerEdgeCases(unittest.TestCase):
@@ -465,6 +465,12 @@ class TestFStringLexing(unittest.TestCase):
             ("FSTRING_END", '"')
         ])
 
+    def test_f_string_decodes_escapes(self):
+        code = 'a = f"{n}\\t\\"q\\"\\n"\nb = f\'it\\\'s {n}\'\n'
+        tokens = Lexer(code).tokenize()
+        middles = [t.value for t in tokens if t.type.name == "FSTRING_MIDDLE"]
+        self.assertEqual(middles, ['\t"q"\n', "it's "])
+
     # NOT SUPPORTED YET
     # def test_f_string_with_conversion(self):
     #     code = 'g = f"{value!r}"\n'
@@ -36,6 +36,18 @@ class TestModuleLoader(unittest.TestCase):
             self.assertTrue(os.path.isfile(result))
             self.assertTrue(result.endswith(os.path.join("foo", "bar.pb")))
 
+    def test_package_file_is_not_its_own_submodule(self):
+        with tempfile.TemporaryDirectory() as tempdir:
+            os.makedirs(os.path.join(tempdir, "foo"))
+            with open(os.path.join(tempdir, "foo", "foo.pb"), "w") as f:
+                f.write("def foo() -> None:\n    pass\n")
+
+            self.assertEqual(resolve_module(['foo'], search_paths=[tempdir]),
+                             os.path.join(tempdir, "foo", "foo.pb"))
+            # so `from foo import foo` imports the function
+            with self.assertRaises(ModuleNotFoundError):
+                resolve_module(['foo', 'foo'], search_paths=[tempdir])
+
     def test_module_not_found_message(self):
         try:
             resolve_module(['not_there'])
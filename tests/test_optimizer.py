@@ -0,0 +1,181 @@
+import unittest
+
+from lexer import Lexer
+from parser import Parser
+from type_checker import TypeChecker
+from optimizer import fold_constants
+from lang_ast import (
+    Literal, StringLiteral, FStringLiteral, FStringText, FStringExpr, Identifier, BinOp,
+    IfStmt, ReturnStmt, PassStmt,
+)
+from pb_pipeline import compile_code_to_c_and_h
+from tests.test_runtime import compile_and_run
+
+
+def folded(code: str):
+    program = Parser(Lexer(code).tokenize()).parse()
+    TypeChecker().check(program)
+    return fold_constants(program)
+
+
+def returned(code: str):
+    """The folded expression of the first function's first return."""
+    fn = folded(code).body[0]
+    return next(st.value for st in fn.body if isinstance(st, ReturnStmt))
+
+
+class TestFoldExpressions(unittest.TestCase):
+
+    def test_arithmetic_folds_to_one_literal(self):
+        cases = {
+            "1 + 2 * 3": ("7", "int"),
+            "(10 - 4) * -2": ("-12", "int"),
+            "2.5 * 4": ("10.0", "float"),
+            "1 / 4.0": ("0.25", "float"),
+            "3 + 0.5": ("3.5", "float"),
+            "1.0 / 100000.0": ("1.0e-05", "float"),
+        }
+        for src, (raw, ty) in cases.items():
+            with self.subTest(src=src):
+                ret = "float" if ty == "float" else "int"
+                e = returned(f"def f() -> {ret}:\n    return {src}\n")
+                self.assertEqual((e.raw, e.inferred_type), (raw, ty))
+
+    def test_integer_division_truncates_like_c(self):
+        for src, raw in {"7 // 2": "3", "-7 // 2": "-3", "-7 % 2": "-1", "7 % -2": "1", "9 / 2": "4"}.items():
+            with self.subTest(src=src):
+                self.assertEqual(returned(f"def f() -> int:\n    return {src}\n").raw, raw)
+
+    def test_unsafe_operations_are_left_for_run_time(self):
+        for src in ("1 // 0", "5 % 0", "9223372036854775807 + 1", "7.0 // 2.0", "True + 1"):
+            with self.subTest(src=src):
+                ret = "float" if "." in src else "int"
+                self.assertIsInstance(returned(f"def f() -> {ret}:\n    return {src}\n"), BinOp)
+
+    def test_comparisons_and_logic(self):
+        self.assertEqual(returned("def f() -> bool:\n    return 2 < 3 and not 1 == 2\n").raw, "True")
+        self.assertEqual(returned("def f() -> bool:\n    return 2.0 >= 3.0\n").raw, "False")
+        # a constant left operand decides the short circuit
+        e = returned("def f(b: bool) -> bool:\n    return True and b\n")
+        self.assertEqual(e, Identifier("b", inferred_type="bool"))
+        self.assertEqual(returned("def f(b: bool) -> bool:\n    return False and b\n").raw, "False")
+        self.assertIsInstance(returned("def f(b: bool) -> bool:\n    return b and True\n"), BinOp)
+
+    def test_constant_fstring_becomes_a_string_literal(self):
+        e = returned("def f() -> str:\n    return f\"n={2 * 21} ok={1 < 2} x={0.5 + 1}\"\n")
+        self.assertEqual(e, StringLiteral("n=42 ok=True x=1.5", inferred_type="str"))
+
+    def test_fstring_keeps_only_the_runtime_placeholders(self):
+        e = returned("def f(n: int) -> str:\n    return f\"{1 + 1} and {n} of {3}\"\n")
+        self.assertIsInstance(e, FStringLiteral)
+        self.assertEqual(e.parts[0], FStringText("2 and "))
+        self.assertIsInstance(e.parts[1], FStringExpr)
+        self.assertEqual(e.parts[2], FStringText(" of 3"))
+
+    def test_parameter_defaults_fold(self):
+        fn = folded("def f(n: int = 60 * 60, x: float = -0.5) -> int:\n    return n\n").body[0]
+        self.assertEqual([p.default.raw for p in fn.params], ["3600", "-0.5"])
+
+
+class TestFoldGlobals(unittest.TestCase):
+
+    def test_unchanged_globals_are_propagated(self):
+        program = folded(
+            "LIMIT: int = 10 + 5\n"
+            "SCALE: float = 2.0 * 1.25\n"
+            "NAME: str = \"pb\"\n"
+            "def f() -> int:\n    return LIMIT * 2\n"
+            "def g() -> str:\n    return f\"{NAME}-{SCALE}\"\n"
+        )
+        # the declarations stay so importers can still link against them
+        self.assertEqual(program.body[0].value, Literal("15", inferred_type="int"))
+        self.assertEqual(program.body[3].body[0].value.raw, "30")
+        self.assertEqual(program.body[4].body[0].value, StringLiteral("pb-2.5", inferred_type="str"))
+
+    def test_string_constants_fold_in_comparisons(self):
+        fn = folded(
+            "MODE: str = \"fast\"\n"
+            "def f() -> int:\n"
+            "    if MODE == \"slow\":\n        return 1\n"
+            "    if MODE != \"fast\" or \"a\" == \"a\":\n        return 2\n"
+            "    return 3\n"
+        ).body[1]
+        self.assertEqual(len(fn.body), 2)
+        self.assertEqual(fn.body[0].branches[0].condition.raw, "True")
+
+    def test_rebound_or_shadowed_globals_are_not(self):
+        program = folded(
+            "count: int = 0\n"
+            "limit: int = 3\n"
+            "def bump():\n    global count\n    count += 1\n"
+            "def f(limit: int) -> int:\n    return count + limit\n"
+        )
+        value = program.body[3].body[0].value
+        self.assertEqual((value.left, value.right), (Identifier("count", inferred_type="int"),
+                                                     Identifier("limit", inferred_type="int")))
+
+
+class TestFoldBranches(unittest.TestCase):
+
+    def test_false_branches_are_removed(self):
+        fn = folded(
+            "DEBUG: bool = False\n"
+            "def f(n: int) -> int:\n"
+            "    if DEBUG:\n        print(n)\n"
+            "    while 1 > 2:\n        n += 1\n"
+            "    if DEBUG or n > 0:\n        return 1\n"
+            "    elif 1 == 1:\n        return 2\n"
+            "    else:\n        return 3\n"
+        ).body[1]
+        self.assertEqual(len(fn.body), 1)
+        ifs = fn.body[0]
+        # the always-taken elif becomes the else; nothing after it survives
+        self.assertEqual([br.condition is None for br in ifs.branches], [False, True])
+        self.assertEqual(ifs.branches[1].body[0].value, Literal("2", inferred_type="int"))
+
+    def test_only_an_else_left_stays_a_block(self):
+        fn = folded("def f() -> int:\n    if 1 > 2:\n        return 1\n    else:\n        return 2\n").body[0]
+        self.assertIsInstance(fn.body[0], IfStmt)
+        self.assertEqual(fn.body[0].branches[0].condition.raw, "True")
+        self.assertEqual(len(fn.body[0].branches), 1)
+
+    def test_a_body_left_empty_gets_a_pass(self):
+        fn = folded("def f(n: int):\n    for i in range(n):\n        if False:\n            print(i)\n").body[0]
+        self.assertEqual(fn.body[0].body, [PassStmt()])
+
+
+class TestFoldedCode(unittest.TestCase):
+
+    def test_folding_reaches_the_generated_c(self):
+        _, c, *_ = compile_code_to_c_and_h(
+            "WIDTH: int = 80\n"
+            "def f(n: int = WIDTH // 2) -> int:\n    return n\n"
+            "def main():\n"
+            "    print(f\"{WIDTH}x{WIDTH * 3 // 4}\")\n"
+            "    print(f() - -1)\n"
+        )
+        self.assertIn('pb_print_str("80x60");', c)
+        self.assertIn("f(40)", c)
+        self.assertNotIn("pb_fstring", c)
+
+    def test_folded_values_match_the_unfolded_program(self):
+        # the same expressions over parameters, which cannot fold, must print the same
+        exprs = ["$a // $b", "$a % $b", "-$a // $b", "-$a % $b", "$a / $b", "$a * $b - $b", "$x / $y",
+                 "$x * $y + $x", "$a < $b", "$x >= $y", "f\"{$a * $b}|{$x / $y}|{$a > $b}\""]
+        values = {"$a": "17", "$b": "5", "$x": "0.1", "$y": "3.0"}
+
+        def body(names: dict[str, str]) -> str:
+            lines = []
+            for e in exprs:
+                for var, name in names.items():
+                    e = e.replace(var, name)
+                lines.append(f"    print({e})\n")
+            return "".join(lines)
+
+        runtime = ("def run(a: int, b: int, x: float, y: float):\n" + body({v: v[1] for v in values})
+                   + f"def main():\n    run({', '.join(values.values())})\n")
+        constant = "def run():\n" + body(values) + "def main():\n    run()\n"
+        self.assertEqual(compile_and_run(constant), compile_and_run(runtime))
+
+if __name__ == "__main__":
+    unittest.main()
@@ -20,6 +20,7 @@ from lang_ast import (
     TryExceptStmt,
     ExceptBlock,
     RaiseStmt,
+    DelStmt,
     ReturnStmt,
     AssertStmt,
     BreakStmt,
@@ -41,6 +42,7 @@ from lang_ast import (
     CallExpr,
     AttributeExpr,
     IndexExpr,
+    SliceExpr,
     ListExpr,
     SetExpr,
     DictExpr,
@@ -270,6 +272,18 @@ class TestParseExpressions(ParserTestCase):
         self.assertEqual(base.index.name, "i")
         self.assertEqual(expr.index.name, "j")
 
+    def test_parse_slice_expr(self):
+        expr = self.parse_tokens("xs[1:n]").parse_expr()
+        self.assertIsInstance(expr, SliceExpr)
+        self.assertEqual(expr.base.name, "xs")
+        self.assertEqual(expr.start.raw, "1")
+        self.assertEqual(expr.stop.name, "n")
+
+        open_ended = self.parse_tokens("xs[:]").parse_expr()
+        self.assertIsInstance(open_ended, SliceExpr)
+        self.assertIsNone(open_ended.start)
+        self.assertIsNone(open_ended.stop)
+
     def test_parse_primary_identifier(self):
         parser = self.parse_tokens("foo")
         expr = parser.parse_primary()
@@ -489,6 +503,25 @@ class TestParseExpressions(ParserTestCase):
         self.assertIsInstance(expr.values[1], BinOp)
         self.assertEqual(expr.values[1].op, "+")
 
+    def test_parse_in_and_not_in(self):
+        parser = self.parse_tokens('"a" in d')
+        expr = parser.parse_expr()
+        self.assertIsInstance(expr, BinOp)
+        self.assertEqual(expr.op, "in")
+
+        parser = self.parse_tokens('"a" not in d')
+        expr = parser.parse_expr()
+        self.assertIsInstance(expr, BinOp)
+        self.assertEqual(expr.op, "not in")
+        self.assertIsInstance(expr.right, Identifier)
+
+    def test_parse_del_stmt(self):
+        parser = self.parse_tokens('del d["a"]\n')
+        stmt = parser.parse_statement()
+        self.assertIsInstance(stmt, DelStmt)
+        self.assertIsInstance(stmt.target, IndexExpr)
+        self.assertEqual(stmt.target.index.value, "a")
+
     def test_parse_set_expr(self):
         parser = self.parse_tokens("{1, x + 2}")
         expr = parser.parse_expr()
@@ -665,6 +698,12 @@ class TestParseStatements(ParserTestCase):
         self.assertIsInstance(stmt.iterable, Identifier)
         self.assertIsInstance(stmt.body[0], ExprStmt)
 
+    def test_parse_for_stmt_with_several_targets(self):
+        parser = self.parse_tokens("for i, k, v in data:\n    pass\n")
+        stmt = parser.parse_for_stmt()
+        self.assertEqual(stmt.var_name, "i")
+        self.assertEqual(stmt.extra_vars, ["k", "v"])
+
     def test_parse_simple_statements(self):
         code = (
             "while True:\n"
@@ -810,6 +849,21 @@ class TestParseStatements(ParserTestCase):
         self.assertEqual(stmt.methods[0].name, "move")
         self.assertEqual(stmt.methods[0].return_type, "None")
 
+    def test_parse_class_decorator(self):
+        code = (
+            "@soa\n"
+            "class Particle:\n"
+            "    x: float = 0.0\n"
+        )
+        parser = self.parse_tokens(code)
+        stmt = parser.parse_statement()
+        self.assertIsInstance(stmt, ClassDef)
+        self.assertEqual(stmt.name, "Particle")
+        self.assertEqual(stmt.decorators, ["soa"])
+
+        with self.assertRaises(ParserError):
+            self.parse_tokens("@soa\ndef f() -> None:\n    pass\n").parse_statement()
+
     def test_parse_global_inside_function(self):
         code = (
             "def use_globals() -> None:\n"
@@ -20,10 +20,10 @@ class RuntimeHelper(unittest.TestCase):
         self.assertEqual(result.returncode, 0, f"Python run failed for {path}:\n{result.stderr}")
         return result.stdout.strip().splitlines()
 
-    def _run_pb(self, path):
+    def _run_pb(self, path, *options):
         pb_main = os.path.join(root_dir, "src", "main.py")
         result = subprocess.run(
-            [sys.executable, pb_main, "run", path],
+            [sys.executable, pb_main, "run", path, *options],
             capture_output=True,
             text=True,
             cwd=os.path.join(root_dir, "src"),
@@ -41,6 +41,18 @@ class TestRefLangOutputMatch(RuntimeHelper):
         self.assertEqual(out_py, out_pb)
 
 
+class TestBuildProfilesOutputMatch(RuntimeHelper):
+
+    def test_ref_lang_output_matches_in_every_profile(self):
+        lang_path = os.path.join(root_dir, "ref", "lang.pb")
+        out_py = self._run_python(lang_path)
+        for profile in ("release", "native", "pgo"):
+            with self.subTest(profile=profile):
+                self.assertEqual(out_py, self._run_pb(lang_path, "--profile", profile))
+        # leave the default runtime archive behind for the other tests
+        self.assertEqual(out_py, self._run_pb(lang_path))
+
+
 class TestExamplesPythonVsPb(RuntimeHelper):
 
     def test_adv_fstrings(self):
@@ -87,6 +99,12 @@ class TestExamplesPythonVsPb(RuntimeHelper):
     #         out_pb = self._run_pb(path)
     #         self.assertEqual(out_py, out_pb)
 
+    def test_for_each(self):
+        path = os.path.join(examples_dir, "for_each.pb")
+        out_py = self._run_python(path)
+        out_pb = self._run_pb(path)
+        self.assertEqual(out_py, out_pb)
+
     def test_functions(self):
         path = os.path.join(examples_dir, "functions.pb")
         out_py = self._run_python(path)
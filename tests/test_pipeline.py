@@ -91,7 +91,7 @@ class TestCodeGenFromSource(unittest.TestCase):
             "    return 0\n"
         )
         h, c = self.compile_pipeline(code)
-        self.assertIn('pb_print_str((snprintf(__fbuf, 256, "Hello, %s!", name), __fbuf));', c)
+        self.assertIn('pb_print_fmt("Hello, %s!", name);', c)
 
     def test_aug_assign_stmt_from_source(self):
         code = (
@@ -104,6 +104,30 @@ class TestCodeGenFromSource(unittest.TestCase):
         self.assertIn("int64_t x = 0;", c_code)
         self.assertIn("x += 1;", c_code)
 
+    def test_constant_globals_are_static_initializers(self):
+        code = (
+            "XS: list[int] = [1, 2, 3]\n"
+            "NAMES: list[str] = []\n"
+            "SCALE: float = 2.5\n"
+            "TABLE: dict[str, int] = {\"a\": 1}\n"
+            "\n"
+            "def scale() -> float:\n"
+            "    return SCALE * float(len(XS))\n"
+            "\n"
+            "def lookup() -> int:\n"
+            "    return TABLE[\"a\"]\n"
+        )
+        h, c = self.compile_pipeline(code)
+        self.assertIn("List_int XS = {3, 0, (int64_t[]){1, 2, 3}};", c)
+        self.assertIn("List_str NAMES = {0};", c)
+        self.assertIn("double SCALE = 2.5;", c)
+        # only the dict needs code, run by the first function that reads it
+        self.assertIn("Dict_str_int TABLE;\n", c)
+        self.assertIn("void main__init_globals(void)\n{\n    TABLE = ", c)
+        self.assertEqual(c.count("PB_INIT_main();"), 1)
+        self.assertIn("{\n    PB_INIT_main();\n    return pb_dict_get_str_int(&TABLE", c)
+        self.assertIn("#define PB_INIT_main() PB_INIT_MODULE(main)", h)
+
     def test_global_class_instances(self):
         code = (
             "class Empty:\n"
@@ -119,7 +143,8 @@ class TestCodeGenFromSource(unittest.TestCase):
             "    return 0\n"
         )
         h, c = self.compile_pipeline(code)
-        self.assertIn("__attribute__((constructor)) static void main__init_globals", c)
+        self.assertIn("void main__init_globals(void)", c)
+        self.assertNotIn("__attribute__((constructor))", c)
         self.assertIn("struct Empty __tmp_empty_", c)
         self.assertIn("struct ClassWithUserDefinedAttr __tmp_classwithuserdefinedattr_", c)
 
@@ -189,14 +214,14 @@ class TestCodeGenFromSource(unittest.TestCase):
     def test_if_stmt_from_source(self):
         code = (
             "def main(a: int) -> int:\n"
-            "    if True:\n"
+            "    if a > 0:\n"
             "        pass\n"
             "    else:\n"
             "        pass\n"
             "    return a\n"
         )
         h, c = self.compile_pipeline(code)
-        self.assertIn("if (true) {", c)
+        self.assertIn("if ((a > 0)) {", c)
         self.assertIn("else  {", c)
         self.assertIn(";  // pass", c)
 
@@ -261,8 +286,7 @@ class TestCodeGenFromSource(unittest.TestCase):
             "    return 0\n"
         )
         header, c_code = self.compile_pipeline(code)
-        self.assertIn('bool __tmp_list_1[] = {true, false, true};', c_code)
-        self.assertIn('List_bool flags = (List_bool){ .len=3, .data=__tmp_list_1 };', c_code)
+        self.assertIn('List_bool flags = list_bool_from_array((bool[]){true, false, true}, 3);', c_code)
         self.assertIn('bool x = list_bool_get(&flags, 0);', c_code)
         self.assertIn('pb_print_bool(x);', c_code)
 
@@ -288,8 +312,7 @@ class TestCodeGenFromSource(unittest.TestCase):
             "    return 0\n"
         )
         h, c_code = self.compile_pipeline(code)
-        self.assertIn('int64_t __tmp_set_1[] = {1, 2};', c_code)
-        self.assertIn('Set_int s = (Set_int){ .len=2, .data=__tmp_set_1 };', c_code)
+        self.assertIn('Set_int s = set_int_from_array((int64_t[]){1, 2}, 2);', c_code)
         self.assertIn('set_int_print(&s);', c_code)
 
     def test_set_str_literal(self):
@@ -300,8 +323,7 @@ class TestCodeGenFromSource(unittest.TestCase):
             "    return 0\n"
         )
         h, c_code = self.compile_pipeline(code)
-        self.assertIn('const char * __tmp_set_1[] = {"a", "b"};', c_code)
-        self.assertIn('Set_str s = (Set_str){ .len=2, .data=__tmp_set_1 };', c_code)
+        self.assertIn('Set_str s = set_str_from_array((const char *[]){"a", "b"}, 2);', c_code)
         self.assertIn('set_str_print(&s);', c_code)
 
     def test_set_custom_type_decl(self):
@@ -333,7 +355,7 @@ class TestCodeGenFromSource(unittest.TestCase):
             "    return 0\n"
         )
         h, c = self.compile_pipeline(code)
-        self.assertIn("List_int nums = (List_int){ .len=3, .data=__tmp_list_1 };", c)
+        self.assertIn("List_int nums = list_int_from_array((int64_t[]){10, 20, 30}, 3);", c)
         self.assertIn("int64_t first = list_int_get(&nums, 0);", c)
         self.assertIn("pb_print_int(first);", c)
         self.assertIn("pb_print_int(list_int_get(&nums, 0));", c)
@@ -362,9 +384,8 @@ class TestCodeGenFromSource(unittest.TestCase):
             "    return 0\n"
         )
         h, c = self.compile_pipeline(code)
-        self.assertIn('Pair_str_int __tmp_dict_1[] = {{"a", 1}, {"b", 2}};', c)
-        self.assertIn("Dict_str_int d = (Dict_str_int){ .len=2, .data=__tmp_dict_1 };", c)
-        self.assertIn('pb_print_int(pb_dict_get_str_int(d, "a"));', c)
+        self.assertIn('Dict_str_int d = pb_dict_from_pairs_str_int((Pair_str_int[]){{"a", 1}, {"b", 2}}, 2);', c)
+        self.assertIn('pb_print_int(pb_dict_get_str_int(&d, "a"));', c)
 
     def test_dict_str_literal_access_from_source(self):
         code = (
@@ -374,9 +395,8 @@ class TestCodeGenFromSource(unittest.TestCase):
             "    return 0\n"
         )
         h, c = self.compile_pipeline(code)
-        self.assertIn('Pair_str_str __tmp_dict_1[] = {{"a", "sth"}, {"b", "here"}};', c)
-        self.assertIn("Dict_str_str d = (Dict_str_str){ .len=2, .data=__tmp_dict_1 };", c)
-        self.assertIn('pb_print_str(pb_dict_get_str_str(d, "a"));', c)
+        self.assertIn('Dict_str_str d = pb_dict_from_pairs_str_str((Pair_str_str[]){{"a", "sth"}, {"b", "here"}}, 2);', c)
+        self.assertIn('pb_print_str(pb_dict_get_str_str(&d, "a"));', c)
 
     def test_dict_bool_literal_access_from_source(self):
         code = (
@@ -386,9 +406,8 @@ class TestCodeGenFromSource(unittest.TestCase):
             "    return 0\n"
         )
         h, c = self.compile_pipeline(code)
-        self.assertIn('Pair_str_bool __tmp_dict_1[] = {{"a", true}, {"b", false}};', c)
-        self.assertIn("Dict_str_bool d = (Dict_str_bool){ .len=2, .data=__tmp_dict_1 };", c)
-        self.assertIn('pb_print_bool(pb_dict_get_str_bool(d, "a"));', c)
+        self.assertIn('Dict_str_bool d = pb_dict_from_pairs_str_bool((Pair_str_bool[]){{"a", true}, {"b", false}}, 2);', c)
+        self.assertIn('pb_print_bool(pb_dict_get_str_bool(&d, "a"));', c)
 
     def test_dict_float_literal_access_from_source(self):
         code = (
@@ -398,9 +417,304 @@ class TestCodeGenFromSource(unittest.TestCase):
             "    return 0\n"
         )
         h, c = self.compile_pipeline(code)
-        self.assertIn('Pair_str_float __tmp_dict_1[] = {{"a", 1.0}, {"b", 2.0}};', c)
-        self.assertIn("Dict_str_float d = (Dict_str_float){ .len=2, .data=__tmp_dict_1 };", c)
-        self.assertIn('pb_print_double(pb_dict_get_str_float(d, "a"));', c)
+        self.assertIn('Dict_str_float d = pb_dict_from_pairs_str_float((Pair_str_float[]){{"a", 1.0}, {"b", 2.0}}, 2);', c)
+        self.assertIn('pb_print_double(pb_dict_get_str_float(&d, "a"));', c)
+
+    def test_fstring_value_exact_size(self):
+        code = (
+            "def main() -> int:\n"
+            "    name: str = \"pb\"\n"
+            "    n: int = 3\n"
+            "    s: str = f\"{name} has {n} letters\"\n"
+            "    t: str = f\"plain\"\n"
+            "    return 0\n"
+        )
+        h, c = self.compile_pipeline(code)
+        self.assertIn('const char * s = pb_fstring(33 + strlen(name), "%s has %" PRId64 " letters", name, n);', c)
+        self.assertIn('const char * t = "plain";', c)
+        self.assertNotIn("__fbuf", c)
+
+    # arena scopes ---------------------------------------------------
+
+    def test_arena_function_scope(self):
+        code = (
+            "def count(n: int) -> int:\n"
+            "    total: int = 0\n"
+            "    for i in range(n):\n"
+            "        total += len(str(i))\n"
+            "    return total\n"
+        )
+        h, c, *_ = compile_code_to_c_and_h(code, arena_scope="function")
+        self.assertIn("PbArenaMark __arena_mark = pb_arena_mark(pb_current_arena);", c)
+        self.assertIn("int64_t __ret = total;", c)
+        self.assertIn("pb_arena_reset(pb_current_arena, __arena_mark);", c)
+
+    def test_arena_function_scope_resets_where_void_function_falls_off_its_end(self):
+        code = (
+            "def work(i: int) -> None:\n"
+            "    s: str = f\"w{i}\"\n"
+            "    print(s)\n"
+        )
+        h, c, *_ = compile_code_to_c_and_h(code, arena_scope="function")
+        body = c.split("void main_work(int64_t i)")[1]
+        self.assertIn("PbArenaMark __arena_mark = pb_arena_mark(pb_current_arena);", body)
+        self.assertIn("pb_arena_reset(pb_current_arena, __arena_mark);\n}", body)
+
+    def test_arena_function_scope_skipped_for_str_return(self):
+        code = (
+            "def name() -> str:\n"
+            "    return \"pb\"\n"
+        )
+        h, c, *_ = compile_code_to_c_and_h(code, arena_scope="function")
+        self.assertNotIn("pb_arena_mark", c)
+
+    def test_arena_loop_scope(self):
+        code = (
+            "def main() -> int:\n"
+            "    for i in range(3):\n"
+            "        s: str = str(i)\n"
+            "        print(s)\n"
+            "    return 0\n"
+        )
+        h, c, *_ = compile_code_to_c_and_h(code, arena_scope="loop")
+        self.assertIn("PbArenaMark __arena_loop_1 = pb_arena_mark(pb_current_arena);", c)
+        self.assertEqual(c.count("pb_arena_reset(pb_current_arena, __arena_loop_1);"), 2)
+
+    def test_arena_loop_scope_skipped_when_string_escapes(self):
+        code = (
+            "def main() -> int:\n"
+            "    last: str = \"\"\n"
+            "    names: list[str] = []\n"
+            "    for i in range(3):\n"
+            "        last = str(i)\n"
+            "    for i in range(3):\n"
+            "        names.append(str(i))\n"
+            "    return 0\n"
+        )
+        h, c, *_ = compile_code_to_c_and_h(code, arena_scope="loop")
+        self.assertNotIn("pb_arena_mark", c)
+
+    def test_arena_loop_scope_skipped_when_callee_stores_a_string(self):
+        code = (
+            "names: list[str] = []\n"
+            "\n"
+            "def keep(i: int):\n"
+            "    names.append(f\"item-{i}\")\n"
+            "\n"
+            "def main() -> int:\n"
+            "    for i in range(5):\n"
+            "        keep(i)\n"
+            "    return 0\n"
+        )
+        h, c, *_ = compile_code_to_c_and_h(code, arena_scope="loop")
+        self.assertNotIn("pb_arena_mark", c)
+
+    # bounds-check elision -----------------------------------------
+
+    def test_range_len_loop_indexes_without_bounds_check(self):
+        code = (
+            "def scale(xs: list[float], k: float) -> float:\n"
+            "    total: float = 0.0\n"
+            "    for i in range(len(xs)):\n"
+            "        xs[i] = xs[i] * k\n"
+            "        total += xs[i]\n"
+            "    return total\n"
+        )
+        h, c = self.compile_pipeline(code)
+        self.assertIn("for (int64_t i = 0, __stop_1 = xs.len; i < __stop_1; ++i) {", c)
+        self.assertIn("xs.data[i] = (xs.data[i] * k);", c)
+        self.assertIn("total += xs.data[i];", c)
+        self.assertNotIn("list_float_get", c)
+        self.assertNotIn("list_float_set", c)
+
+    def test_bounds_check_kept_when_loop_may_resize_or_rebind(self):
+        cases = {
+            "append": "        xs.append(i)\n        t += xs[i]\n",
+            "rebind": "        xs = [1]\n        t += xs[i]\n",
+            "index var": "        t += xs[i]\n        i = 0\n",
+            "other var": "        t += xs[t]\n",
+        }
+        for name, body in cases.items():
+            with self.subTest(case=name):
+                code = (
+                    "def f(xs: list[int]) -> int:\n"
+                    "    t: int = 0\n"
+                    "    for i in range(len(xs)):\n" + body +
+                    "    return t\n"
+                )
+                h, c = self.compile_pipeline(code)
+                self.assertIn("list_int_get(&xs, ", c)
+
+    def test_global_list_keeps_bounds_check_around_user_calls(self):
+        code = (
+            "g: list[int] = [1, 2]\n"
+            "def touch() -> None:\n"
+            "    pass\n"
+            "def f() -> int:\n"
+            "    t: int = 0\n"
+            "    for i in range(len(g)):\n"
+            "        touch()\n"
+            "        t += g[i]\n"
+            "    return t\n"
+        )
+        h, c = self.compile_pipeline(code)
+        self.assertIn("list_int_get(&g, i)", c)
+
+    def test_unchecked_mode_drops_all_list_bounds_checks(self):
+        code = (
+            "def f(xs: list[int], j: int) -> int:\n"
+            "    xs[j] = 1\n"
+            "    return xs[j + 1]\n"
+        )
+        h, c, *_ = compile_code_to_c_and_h(code, unchecked=True)
+        self.assertIn("xs.data[j] = 1;", c)
+        self.assertIn("return xs.data[(j + 1)];", c)
+        self.assertNotIn("list_int_", c)
+
+    def test_range_loop_reserves_appended_lists(self):
+        code = (
+            "def f(n: int) -> list[int]:\n"
+            "    out: list[int] = []\n"
+            "    for i in range(2, n):\n"
+            "        out.append(i)\n"
+            "        out.append(-i)\n"
+            "    return out\n"
+            "\n"
+            "def g(n: int) -> list[int]:\n"
+            "    out: list[int] = []\n"
+            "    for i in range(n):\n"
+            "        if i > 3:\n"
+            "            break\n"
+            "        out.append(i)\n"
+            "    return out\n"
+        )
+        h, c = self.compile_pipeline(code)
+        self.assertIn("list_int_reserve(&out, out.len + 2 * (n - 2));", c)
+        self.assertEqual(c.count("_reserve("), 1)
+
+    def test_file_line_loop_copies_only_escaping_lines(self):
+        code = (
+            "def count(path: str) -> int:\n"
+            "    f: file = open(path, \"r\")\n"
+            "    n: int = 0\n"
+            "    for line in f:\n"
+            "        n += len(line)\n"
+            "    return n\n"
+            "\n"
+            "def keep(path: str) -> list[str]:\n"
+            "    out: list[str] = []\n"
+            "    f: file = open(path, \"r\")\n"
+            "    for line in f:\n"
+            "        out.append(line)\n"
+            "    return out\n"
+        )
+        h, c = self.compile_pipeline(code)
+        self.assertIn("(line = pb_file_next_line(__file_", c)
+        self.assertEqual(c.count("line = pb_arena_strdup(pb_current_arena, line);"), 1)
+
+    def test_for_each_walks_lists_by_pointer(self):
+        code = (
+            "def total(xs: list[int]) -> int:\n"
+            "    t: int = 0\n"
+            "    for x in xs:\n"
+            "        t += x\n"
+            "    return t\n"
+            "\n"
+            "def dot(xs: list[float], ys: list[float]) -> float:\n"
+            "    t: float = 0.0\n"
+            "    for i, x in enumerate(xs):\n"
+            "        t += x * ys[i]\n"
+            "    return t\n"
+            "\n"
+            "def shout(names: list[str], tags: set[str]):\n"
+            "    for s in names:\n"
+            "        print(s)\n"
+            "    for t in tags:\n"
+            "        print(t)\n"
+        )
+        h, c = self.compile_pipeline(code)
+        self.assertIn("for (int64_t *__it_", c)
+        self.assertIn("__it_1_0 != __end_1; ++__it_1_0)", c)
+        self.assertIn("int64_t x = *__it_1_0;", c)
+        self.assertIn("double *__it_2_0 = xs.data, *__end_2 = __it_2_0 + xs.len;", c)
+        self.assertIn("int64_t i = __count_2++;", c)
+        self.assertIn("(void)i;", c)
+        self.assertIn("const char **__it_3_0 = names.data, **__end_3 = __it_3_0 + names.len;", c)
+        self.assertIn("const char * s = *__it_3_0;", c)
+        self.assertIn("const char **__it_4_0 = tags.data, **__end_4 = __it_4_0 + tags.len;", c)
+        self.assertNotIn("list_int_get", c.split("total(")[1].split("}")[0])
+
+    def test_for_each_rereads_length_of_a_list_it_grows(self):
+        code = (
+            "def main() -> int:\n"
+            "    xs: list[int] = [1, 2]\n"
+            "    for x in xs:\n"
+            "        if x < 4:\n"
+            "            xs.append(x + 2)\n"
+            "    return 0\n"
+        )
+        h, c = self.compile_pipeline(code)
+        self.assertIn("for (int64_t __i_1 = 0; __i_1 < xs.len; ++__i_1) {", c)
+        self.assertIn("int64_t x = xs.data[__i_1];", c)
+
+    def test_for_each_over_dict_skips_deleted_entries(self):
+        code = (
+            "def main() -> int:\n"
+            "    d: dict[str, int] = {\"a\": 1}\n"
+            "    for k, v in d.items():\n"
+            "        print(v)\n"
+            "    for c in \"ab\":\n"
+            "        print(c)\n"
+            "    return 0\n"
+        )
+        h, c = self.compile_pipeline(code)
+        self.assertIn("+ d.index.used; ", c)
+        self.assertIn("if (__entry_1->key == NULL) continue;", c)
+        self.assertIn("int64_t v = __entry_1->value;", c)
+        self.assertIn("const char *c = pb_str_next_char(&__chars_2);", c)
+
+    def test_for_each_rejects_soa_lists(self):
+        code = (
+            "@soa\n"
+            "class P:\n"
+            "    def __init__(self, x: float):\n"
+            "        self.x = x\n"
+            "\n"
+            "def main() -> int:\n"
+            "    ps: list[P] = [P(1.0)]\n"
+            "    for p in ps:\n"
+            "        print(p.x)\n"
+            "    return 0\n"
+        )
+        with self.assertRaises(Exception) as ctx:
+            self.compile_pipeline(code)
+        self.assertIn("@soa", str(ctx.exception))
+
+    def test_parallel_for_uses_one_range_trampoline(self):
+        code = (
+            "hits: atomic = atomic(0)\n"
+            "\n"
+            "def mark(i: int):\n"
+            "    hits.add(i)\n"
+            "\n"
+            "def square(x: int) -> int:\n"
+            "    return x * x\n"
+            "\n"
+            "def main() -> int:\n"
+            "    parallel_for(range(100), mark)\n"
+            "    parallel_for(range(5, 50), mark)\n"
+            "    f: future = spawn(square, 7)\n"
+            "    print(f.join() + hits.get())\n"
+            "    return 0\n"
+        )
+        h, c = self.compile_pipeline(code)
+        self.assertEqual(c.count("static void __range_main_mark(int64_t __lo, int64_t __hi)"), 1)
+        self.assertIn("for (int64_t __i = __lo; __i < __hi; ++__i) main_mark(__i);", c)
+        self.assertIn("pb_parallel_for(0, 100, __range_main_mark);", c)
+        self.assertIn("pb_parallel_for(5, 50, __range_main_mark);", c)
+        self.assertIn("PbFuture * f = pb_spawn(main_square, 7);", c)
+        self.assertIn("hits = pb_atomic_new(0);", c)
+        self.assertLess(c.index("__range_main_mark(int64_t"), c.index("void main_mark(int64_t i)"))
 
     # logical ------------------------------------------------------
 
@@ -431,6 +745,20 @@ class TestCodeGenFromSource(unittest.TestCase):
         h, c = self.compile_pipeline(code)
         self.assertIn("if ((x && !(y))) {", c)
 
+    def test_string_comparisons_and_literal_registration(self):
+        code = (
+            "def f(a: str, b: str) -> bool:\n"
+            "    return a == b or a != \"x\" or a < b or intern(a) is b\n"
+        )
+        h, c = self.compile_pipeline(code)
+        self.assertIn('pb_str_eq(a, b)', c)
+        self.assertIn('!pb_str_eq(a, "x")', c)
+        self.assertIn('(strcmp(a, b) < 0)', c)
+        self.assertIn('(pb_intern(a) == b)', c)
+        # every literal is handed to the intern table once, from a constructor
+        self.assertIn('static const char *const __pb_literals[] = {\n    "x",\n};', c)
+        self.assertIn("pb_intern_register(&__pb_literal_block);", c)
+
     def test_chained_comparison_from_source(self):
         code = (
             "def main() -> int:\n"
@@ -498,6 +826,164 @@ class TestCodeGenFromSource(unittest.TestCase):
         # Optional: confirm static field initialization
         self.assertIn("int64_t Player_mp = 100;", c)
 
+    def test_class_layout_packs_fields_and_drops_shadowed_ones(self):
+        code = (
+            "class Player:\n"
+            "    def __init__(self, mp: int):\n"
+            "        self.alive = True\n"
+            "        self.mp = mp\n"
+            "        self.speed = 1.5\n"
+            "\n"
+            "class Mage(Player):\n"
+            "    def __init__(self):\n"
+            "        Player.__init__(self, 10)\n"
+            "        self.mp = 200\n"
+            "        self.casting = False\n"
+            "        self.power = 3\n"
+        )
+        h, c = self.compile_pipeline(code)
+        self.assertIn("typedef struct Player {\n    int64_t mp;\n    double speed;\n    bool alive;\n} Player;", h)
+        self.assertIn("typedef struct Mage {\n    Player base;\n    int64_t power;\n    bool casting;\n} Mage;", h)
+        self.assertIn("self->base.mp = 200;", c)
+
+    def test_soa_list_stores_one_array_per_field(self):
+        code = (
+            "@soa\n"
+            "class P:\n"
+            "    def __init__(self, x: int, v: float):\n"
+            "        self.x = x\n"
+            "        self.v = v\n"
+            "\n"
+            "def main() -> int:\n"
+            "    ps: list[P] = []\n"
+            "    for i in range(10):\n"
+            "        ps.append(P(i, 0.5))\n"
+            "    for i in range(len(ps)):\n"
+            "        ps[i].x += 1\n"
+            "    print(ps[3].v)\n"
+            "    return 0\n"
+        )
+        h, c = self.compile_pipeline(code)
+        self.assertIn("    int64_t *x;\n    double *v;\n} Soa_P;", h)
+        self.assertIn("Soa_P ps = ", c)
+        self.assertIn("soa_P_append(&ps, &__tmp_p_", c)
+        self.assertIn("ps.x[i] += 1;", c)
+        self.assertIn("pb_print_double(ps.v[soa_P_index(&ps, 3)]);", c)
+        self.assertNotIn("List_P", h + c)
+
+    def test_escaping_objects_come_from_pools(self):
+        code = (
+            "class V:\n"
+            "    def __init__(self, x: int):\n"
+            "        self.x = x\n"
+            "\n"
+            "class Box:\n"
+            "    def __init__(self):\n"
+            "        self.v = V(0)\n"
+            "    def put(self, v: V):\n"
+            "        self.v = v\n"
+            "\n"
+            "def peek(v: V) -> int:\n"
+            "    return v.x\n"
+            "\n"
+            "def make(x: int) -> V:\n"
+            "    return V(x)\n"
+            "\n"
+            "def main() -> int:\n"
+            "    a: V = V(1)\n"
+            "    print(peek(a))\n"
+            "    b: Box = Box()\n"
+            "    c: V = V(2)\n"
+            "    b.put(c)\n"
+            "    vs: list[V] = []\n"
+            "    for i in range(4):\n"
+            "        vs.append(V(i))\n"
+            "    vs.pop()\n"
+            "    d: V = make(3)\n"
+            "    print(d.x + len(vs))\n"
+            "    return 0\n"
+        )
+        h, c = self.compile_pipeline(code)
+        # a and b never outlive main: stack temporaries as before
+        self.assertIn("V____init__(&__tmp_v_", c)
+        self.assertIn("Box____init__(&__tmp_box_", c)
+        # returned, stored in a field, passed to put() and appended: pooled
+        self.assertEqual(c.count("pb_obj_alloc(sizeof(struct V))"), 4)
+        self.assertIn("pb_obj_free(list_V_pop(&vs), sizeof(struct V));", c)
+
+    def test_shared_list_elements_are_not_freed(self):
+        code = (
+            "class V:\n"
+            "    def __init__(self, x: int):\n"
+            "        self.x = x\n"
+            "\n"
+            "def main() -> int:\n"
+            "    vs: list[V] = []\n"
+            "    vs.append(V(1))\n"
+            "    vs.append(V(2))\n"
+            "    first: V = vs[0]\n"
+            "    vs.swap_remove(0)\n"
+            "    print(first.x)\n"
+            "    return 0\n"
+        )
+        h, c = self.compile_pipeline(code)
+        self.assertIn("list_V_swap_remove(&vs, 0);", c)
+        self.assertNotIn("pb_obj_free", c)
+
+    def test_elements_read_out_by_a_callee_are_not_freed(self):
+        code = (
+            "class V:\n"
+            "    def __init__(self, x: int):\n"
+            "        self.x = x\n"
+            "\n"
+            "keep: list[V] = []\n"
+            "\n"
+            "def grab(xs: list[V]):\n"
+            "    keep.append(xs[len(xs) - 1])\n"
+            "\n"
+            "def main() -> int:\n"
+            "    vs: list[V] = []\n"
+            "    vs.append(V(1))\n"
+            "    vs.append(V(2))\n"
+            "    grab(vs)\n"
+            "    vs.pop()\n"
+            "    vs.append(V(99))\n"
+            "    print(keep[0].x)\n"
+            "    return 0\n"
+        )
+        h, c = self.compile_pipeline(code)
+        self.assertIn("list_V_pop(&vs);", c)
+        self.assertNotIn("pb_obj_free", c)
+
+    def test_instrument_wraps_every_function_in_timing_hooks(self):
+        code = (
+            "def twice(x: int) -> int:\n"
+            "    return x * 2\n"
+            "\n"
+            "def hello():\n"
+            "    print(\"hi\")\n"
+            "\n"
+            "def main() -> int:\n"
+            "    hello()\n"
+            "    print(twice(4))\n"
+            "    return 0\n"
+        )
+        _, plain = self.compile_pipeline(code)
+        self.assertNotIn("PB_PROF", plain)
+        _, c, *_ = compile_code_to_c_and_h(code, instrument=True)
+        self.assertIn("static int64_t main_twice__pb_body(int64_t x)", c)
+        self.assertIn('PB_PROF_FN(pb_prof_main_twice, "main_twice")\n'
+                      'int64_t main_twice(int64_t x)\n'
+                      '{\n'
+                      '    PB_PROF_ENTER(pb_prof_main_twice);\n'
+                      '    int64_t __ret = main_twice__pb_body(x);\n'
+                      '    PB_PROF_EXIT();\n'
+                      '    return __ret;\n'
+                      '}', c)
+        self.assertIn("    main_hello__pb_body();\n    PB_PROF_EXIT();\n}", c)
+        self.assertIn("static int main__pb_body(void)", c)
+        self.assertIn("    int __ret = main__pb_body();", c)
+
     def test_class_field_without_initializer_pipeline(self):
         code = (
             "class Foo:\n"
@@ -653,8 +1139,9 @@ class TestCodeGenFromSource(unittest.TestCase):
         )
         h, c = self.compile_pipeline(code)
         self.assertIn('int64_t x = 1;', c)
-        self.assertIn('pb_print_str((snprintf(__fbuf, 256, "%s", pb_format_double((x * 2.0))), __fbuf));', c)
-        self.assertIn('pb_print_str((snprintf(__fbuf, 256, "%lld", (x * false)), __fbuf));', c)
+        # x is never rebound, so it folds into both f-strings
+        self.assertIn('pb_print_str("2.0");', c)
+        self.assertIn('pb_print_fmt("%" PRId64, (1 * false));', c)
 
     # global ------------------------------------------------------
 
@@ -681,7 +1168,9 @@ class TestCodeGenFromSource(unittest.TestCase):
         )
         header, c_code = self.compile_pipeline(code)
         self.assertIn('int64_t x = 100;', c_code)
-        self.assertIn('pb_print_int(x);', c_code)
+        # never rebound: every read folds to the initializer
+        self.assertIn('pb_print_int(100);', c_code)
+        self.assertIn('return 100;', c_code)
 
     def test_global_write_with_global(self):
         code = (
@@ -867,15 +1356,15 @@ class TestCodeGenFromSource(unittest.TestCase):
         h, c = self.compile_pipeline(code)
 
         # f-string expansions
-        self.assertIn('pb_print_str((snprintf(__fbuf, 256, "Simple fstring: x=%lld", x), __fbuf));', c)
-        self.assertIn('pb_print_str((snprintf(__fbuf, 256, "x + 1: %lld", (x + 1)), __fbuf));', c)
-        self.assertIn('pb_print_str((snprintf(__fbuf, 256, "Float conversion: %s", pb_format_double((double)(2))), __fbuf));', c)
+        self.assertIn('pb_print_fmt("Simple fstring: x=%" PRId64, x);', c)
+        self.assertIn('pb_print_fmt("x + 1: %" PRId64, (x + 1));', c)
+        self.assertIn('pb_print_fmt("Float conversion: %s", pb_format_double((double)(2)));', c)
         self.assertIn('pb_print_str("-----', c)
 
         # player expressions
-        self.assertIn('pb_print_str((snprintf(__fbuf, 256, "player.hp: %lld", p->hp), __fbuf));', c)
-        self.assertIn('pb_print_str((snprintf(__fbuf, 256, "player get_name: %s", Player__get_name(p)), __fbuf));', c)
-        self.assertIn('pb_print_str((snprintf(__fbuf, 256, "Player.species: %s", Player_species), __fbuf));', c)
+        self.assertIn('pb_print_fmt("player.hp: %" PRId64, p->hp);', c)
+        self.assertIn('pb_print_fmt("player get_name: %s", Player__get_name(p));', c)
+        self.assertIn('pb_print_fmt("Player.species: %s", Player_species);', c)
 
     def test_raw_and_multiline_string_codegen(self):
         code = (
@@ -910,8 +1399,10 @@ class TestCodeGenFromSource(unittest.TestCase):
             "        print(\"caught KeyError\")\n"
         )
         header, c_code = self.compile_pipeline(code)
-        self.assertIn('pb_print_int(pb_dict_get_str_int(d, "b"));', c_code)
-        self.assertIn('if (strcmp(pb_current_exc.type, "KeyError") == 0)', c_code)
+        self.assertIn('pb_print_int(pb_dict_get_str_int(&d, "b"));', c_code)
+        # a missing key is raised by the runtime, which can only longjmp
+        self.assertIn('pb_push_try(&', c_code)
+        self.assertIn('if (pb_current_exc.id == PB_EXC_KeyError)', c_code)
         self.assertIn('pb_print_str("caught KeyError");', c_code)
 
     def test_reraise_in_except(self):
@@ -927,10 +1418,11 @@ class TestCodeGenFromSource(unittest.TestCase):
             "        print(\"caught outer\")\n"
         )
         header, c_code = self.compile_pipeline(code)
-        self.assertIn('pb_raise_msg("ValueError", "bad");', c_code)
-        self.assertIn('if (strcmp(pb_current_exc.type, "ValueError") == 0)', c_code)
-        self.assertIn('pb_print_str("re-raising");', c_code)
-        self.assertIn('if (__exc_flag_2 && !__exc_handled_2) pb_reraise();', c_code)
+        self.assertNotIn('setjmp', c_code)
+        self.assertIn('pb_throw_msg("ValueError", "bad");\n            goto __exc_catch_2;', c_code)
+        self.assertIn('if (pb_current_exc.id == PB_EXC_ValueError)', c_code)
+        # the bare raise in the inner handler goes to the outer one
+        self.assertIn('pb_print_str("re-raising");\n                pb_reraise();\n                goto __exc_catch_1;', c_code)
         self.assertIn('pb_print_str("caught outer");', c_code)
 
     def test_raise_custom_struct(self):
@@ -947,7 +1439,7 @@ class TestCodeGenFromSource(unittest.TestCase):
         )
         header, c_code = self.compile_pipeline(code)
         self.assertIn('pb_raise_obj("MyError", e);', c_code)
-        self.assertIn('if (strcmp(pb_current_exc.type, "MyError") == 0)', c_code)
+        self.assertIn('if (pb_current_exc.id == PB_EXC_MyError)', c_code)
         self.assertIn('struct MyError * err = (struct MyError *)pb_current_exc.value;', c_code)
         self.assertIn('pb_print_str(err->msg);', c_code)
 
@@ -960,8 +1452,8 @@ class TestCodeGenFromSource(unittest.TestCase):
             "        print(\"caught generic error\")\n"
         )
         header, c_code = self.compile_pipeline(code)
-        self.assertIn('pb_raise_msg("str", "basic failure");', c_code)
-        self.assertIn('if (strcmp(pb_current_exc.type, "Exception") == 0)', c_code)
+        self.assertIn('pb_throw_msg("str", "basic failure");', c_code)
+        self.assertIn('if (pb_current_exc.id == PB_EXC_Exception)', c_code)
         self.assertIn('pb_print_str("caught generic error");', c_code)
 
     def test_raise_without_except(self):
@@ -973,7 +1465,7 @@ class TestCodeGenFromSource(unittest.TestCase):
             "        print(\"caught generic error\")\n"
         )
         header, c_code = self.compile_pipeline(code)
-        self.assertIn('pb_raise_msg("str", "basic failure");', c_code)
+        self.assertIn('pb_throw_msg("str", "basic failure");', c_code)
         self.assertIn('if (1)', c_code)
         self.assertIn('pb_print_str("caught generic error");', c_code)
 
@@ -987,7 +1479,7 @@ class TestCodeGenFromSource(unittest.TestCase):
         )
         header, c_code = self.compile_pipeline(code)
         self.assertIn('pb_reraise();', c_code)
-        self.assertIn('if (strcmp(pb_current_exc.type, "Exception") == 0)', c_code)
+        self.assertIn('if (pb_current_exc.id == PB_EXC_Exception)', c_code)
         self.assertIn('pb_print_str("caught generic error");', c_code)
 
     def test_pipeline_import_with_alias(self):
@@ -1116,6 +1608,17 @@ class TestCodeGenFromSource(unittest.TestCase):
         header, c_code = self.compile_pipeline(code, pb_path="test.pb")
         self.assertIn('InitWindow(800, 600, "Hello");', c_code)
 
+    def test_native_module_global_from_import_has_no_init_guard(self):
+        code = (
+            "from raylib import ClearBackground, RAYWHITE\n"
+            "def main() -> int:\n"
+            "    ClearBackground(RAYWHITE)\n"
+            "    return 0\n"
+        )
+        header, c_code = self.compile_pipeline(code, pb_path="test.pb")
+        self.assertIn("ClearBackground(RAYWHITE);", c_code)
+        self.assertNotIn("PB_INIT_", c_code)
+
 
 if __name__ == "__main__":
     unittest.main()
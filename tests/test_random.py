@@ -0,0 +1,141 @@
+import os
+import subprocess
+import tempfile
+import unittest
+
+from main import build, get_build_output_path
+
+MASK = (1 << 64) - 1
+
+
+def rotl(x: int, k: int) -> int:
+    return ((x << k) | (x >> (64 - k))) & MASK
+
+
+class Xoshiro:
+    """Reference xoshiro256** seeded through splitmix64, as in pb_runtime.c."""
+
+    def __init__(self, seed: int):
+        self.x = seed & MASK
+        self.s = [self.splitmix() for _ in range(4)]
+
+    def splitmix(self) -> int:
+        self.x = (self.x + 0x9e3779b97f4a7c15) & MASK
+        z = self.x
+        z = ((z ^ (z >> 30)) * 0xbf58476d1ce4e5b9) & MASK
+        z = ((z ^ (z >> 27)) * 0x94d049bb133111eb) & MASK
+        return z ^ (z >> 31)
+
+    def next(self) -> int:
+        s = self.s
+        result = (rotl((s[1] * 5) & MASK, 7) * 9) & MASK
+        t = (s[1] << 17) & MASK
+        s[2] ^= s[0]
+        s[3] ^= s[1]
+        s[1] ^= s[2]
+        s[0] ^= s[3]
+        s[2] ^= t
+        s[3] = rotl(s[3], 45)
+        return result
+
+    def below(self, x: int, span: int) -> int:
+        product = x * span
+        while product & MASK < (-span) % span:
+            product = self.next() * span
+        return product >> 64
+
+    def lanes(self, n: int) -> list[int]:
+        """The raw draws of one fill_* call of `n` elements."""
+        lanes = [Xoshiro(self.next()) for _ in range(4)]
+        return [lanes[i % 4].next() for i in range(n)]
+
+
+def run_pb(body: str) -> list[str]:
+    """Build and run a program importing `random` whose main() is `body`."""
+    src = "import random\n\ndef main():\n" + body
+    with tempfile.TemporaryDirectory() as tmp:
+        path = os.path.join(tmp, "randmain.pb")
+        with open(path, "w") as f:
+            f.write(src)
+        ok, _ = build(src, path, "randmain")
+    if not ok:
+        raise RuntimeError("build failed")
+    out = subprocess.run([get_build_output_path("randmain")], capture_output=True, text=True)
+    return (out.stdout + out.stderr).split()
+
+
+FILL = (
+    "    xs: list[float] = []\n"
+    "    ns: list[int] = []\n"
+    "    for i in range(11):\n"
+    "        xs.append(-1.0)\n"
+    "        ns.append(-1)\n"
+)
+
+
+class TestNativeRandom(unittest.TestCase):
+
+    def test_scalar_draws_match_the_reference(self):
+        out = run_pb(
+            "    random.seed(42)\n"
+            "    for i in range(3):\n        print(random.random())\n"
+            "    for i in range(50):\n        print(random.randint(-3, 3))\n"
+            "    print(random.randint(-9223372036854775807 - 1, 9223372036854775807))\n"
+            "    print(random.uniform(2.0, 4.0))\n"
+        )
+        ref = Xoshiro(42)
+        expected = [str((ref.next() >> 11) * 2.0 ** -53) for _ in range(3)]
+        expected += [str(-3 + ref.below(ref.next(), 7)) for _ in range(50)]
+        expected.append(str(ref.next() - (1 << 63)))
+        expected.append(str(2.0 + 2.0 * ((ref.next() >> 11) * 2.0 ** -53)))
+        self.assertEqual(out, expected)
+        self.assertEqual({int(v) for v in out[3:53]}, set(range(-3, 4)))
+
+    def test_unseeded_program_behaves_as_seed_zero(self):
+        draws = "    print(random.randint(0, 1000000))\n    print(random.random())\n"
+        self.assertEqual(run_pb(draws), run_pb("    random.seed(0)\n" + draws))
+
+    def test_batches_match_the_reference_on_every_lane_and_tail(self):
+        out = run_pb(
+            "    random.seed(7)\n" + FILL +
+            "    random.fill_floats(xs, 10)\n"
+            "    random.fill_ints(ns, 9, 1, 6)\n"
+            "    for x in range(11):\n        print(xs[x])\n"
+            "    for x in range(11):\n        print(ns[x])\n"
+        )
+        ref = Xoshiro(7)
+        floats = [str((r >> 12) * 2.0 ** -52) for r in ref.lanes(10)]
+        ints = [str(1 + ref.below(r, 6)) for r in ref.lanes(9)]
+        self.assertEqual(out, floats + ["-1.0"] + ints + ["-1", "-1"])
+
+    def test_batch_is_uniform(self):
+        out = run_pb(
+            "    random.seed(1)\n"
+            "    xs: list[float] = []\n"
+            "    ns: list[int] = []\n"
+            "    for i in range(100000):\n        xs.append(0.0)\n        ns.append(0)\n"
+            "    random.fill_floats(xs, len(xs))\n"
+            "    random.fill_ints(ns, len(ns), 0, 9)\n"
+            "    print(sum(xs) / 100000.0)\n"
+            "    counts: list[int] = []\n"
+            "    for d in range(10):\n        counts.append(0)\n"
+            "    for i in range(len(ns)):\n        counts[ns[i]] = counts[ns[i]] + 1\n"
+            "    for d in range(10):\n        print(counts[d])\n"
+        )
+        self.assertAlmostEqual(float(out[0]), 0.5, delta=0.005)
+        chi2 = sum((int(c) - 10000) ** 2 / 10000 for c in out[1:])
+        self.assertLess(chi2, 30.0)   # 9 degrees of freedom: p < 0.001
+
+    def test_bad_arguments_raise_value_error(self):
+        out = run_pb(
+            FILL +
+            "    try:\n        random.fill_floats(xs, 12)\n"
+            "    except ValueError as e:\n        print(\"caught\")\n"
+            "    try:\n        print(random.randint(2, 1))\n"
+            "    except ValueError as e:\n        print(\"caught\")\n"
+        )
+        self.assertEqual(out, ["caught", "caught"])
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -5,6 +5,7 @@ import sys
 import os
 import shutil
 import ast
+from unittest import mock
 
 from type_checker import TypeError
 from lexer import Lexer
@@ -17,10 +18,13 @@ from main import get_build_output_path
 from tests import build_dir
 
 
-def _compile_and_run_modules(modules: dict[str, str]) -> str:
+def _compile_and_run_modules(modules: dict[str, str], c_sources: dict[str, str] | None = None,
+                             cflags: tuple[str, ...] = ()) -> str:
     """
     Compiles and runs PB code from multiple in-memory modules.
     Writes each to disk to support real module imports.
+    `c_sources` adds hand-written C files (name -> code) to the build,
+    and `cflags` extra GCC options (e.g. -Werror).
     """
     with tempfile.TemporaryDirectory() as tmpdir:
         c_files = []
@@ -56,6 +60,12 @@ def _compile_and_run_modules(modules: dict[str, str]) -> str:
 
             c_files.append(c_path)
 
+        for name, code in (c_sources or {}).items():
+            c_path = os.path.join(tmpdir, name)
+            with open(c_path, "w", encoding="utf-8") as f:
+                f.write(code)
+            c_files.append(c_path)
+
         exe_path = os.path.join(tmpdir, "main")
         if sys.platform == "win32":
             exe_path += ".exe"
@@ -70,7 +80,8 @@ def _compile_and_run_modules(modules: dict[str, str]) -> str:
         shutil.copy2(runtime_header, os.path.join(tmpdir, "pb_runtime.h"))
 
         compile_cmd = [
-            "gcc", "-std=c99", "-W",
+            "gcc", "-std=c99", "-W", *cflags,
+            *([] if sys.platform == "win32" else ["-pthread"]),
             *c_files,
             "-o", exe_path,
             "-I", tmpdir,
@@ -87,11 +98,11 @@ def _compile_and_run_modules(modules: dict[str, str]) -> str:
 
 
 
-def compile_and_run(code: str) -> str:
+def compile_and_run(code: str, cflags: tuple[str, ...] = ()) -> str:
     """
     Compiles and runs a single-module PB program (as 'main').
     """
-    return _compile_and_run_modules({"main": code})
+    return _compile_and_run_modules({"main": code}, cflags=cflags)
 
 
 def compile_modules_and_run_main(modules: dict[str, str]) -> str:
@@ -197,6 +208,23 @@ class TestImportUtilsHelper(unittest.TestCase):
 
 class TestPipelineRuntime(unittest.TestCase):
 
+    def test_object_list_searches_compile_without_warnings(self):
+        code = (
+            "class P:\n"
+            "    def __init__(self, n: int):\n"
+            "        self.n = n\n"
+            "\n"
+            "def main() -> int:\n"
+            "    a: P = P(1)\n"
+            "    b: P = P(2)\n"
+            "    ps: list[P] = [a, b, a]\n"
+            "    print(ps.index(b))\n"
+            "    print(a in ps)\n"
+            "    print(ps.count(a))\n"
+            "    return 0\n"
+        )
+        self.assertEqual(compile_and_run(code, cflags=("-Wall", "-Werror")).split(), ["1", "True", "2"])
+
     def test_global_runtime_update(self):
         code = (
             "x: int = 10\n"
@@ -254,6 +282,41 @@ class TestPipelineRuntime(unittest.TestCase):
         self.assertEqual(lines[0], "1.5")
         self.assertEqual(lines[1], "3.5")
 
+    def test_module_globals_initialize_on_first_use(self):
+        cfg = (
+            "def build(n: int) -> list[int]:\n"
+            "    print(\"building\")\n"
+            "    out: list[int] = []\n"
+            "    for i in range(n):\n"
+            "        out.append(i * i)\n"
+            "    return out\n"
+            "\n"
+            "SQUARES: list[int] = build(4)\n"
+            "LIMITS: list[int] = [1, 2, 3]\n"
+            "GRID: list[list[int]] = [[1], [2, 3]]\n"
+            "\n"
+            "def grow() -> list[int]:\n"
+            "    LIMITS.append(len(GRID[1]) + 2)\n"
+            "    LIMITS[0] = 9\n"
+            "    return LIMITS\n"
+            "\n"
+            "def square(i: int) -> int:\n"
+            "    return SQUARES[i]\n"
+        )
+        main = (
+            "import cfg\n"
+            "\n"
+            "def main() -> int:\n"
+            "    print(\"start\")\n"
+            "    print(cfg.grow())\n"
+            "    print(cfg.square(3))\n"
+            "    print(cfg.square(2))\n"
+            "    return 0\n"
+        )
+        output = compile_modules_and_run_main({"cfg": cfg, "main": main})
+        # the static lists need no init; SQUARES is built once, when first read
+        self.assertEqual(output.splitlines(), ["start", "[9, 2, 3, 4]", "building", "9", "4"])
+
     def test_chained_comparison_runtime(self):
         code = (
             "def main() -> int:\n"
@@ -346,6 +409,323 @@ class TestPipelineRuntime(unittest.TestCase):
         self.assertEqual(lines[2], 'a')
         self.assertEqual(lines[3], "['a', 'b']")
 
+    def test_negative_and_past_end_index_raise(self):
+        code = (
+            "def main() -> int:\n"
+            "    xs: list[float] = [1.5]\n"
+            "    i: int = -1\n"
+            "    try:\n"
+            "        print(xs[i])\n"
+            "    except IndexError:\n"
+            "        print('caught')\n"
+            "    for k in range(100):\n"
+            "        xs.append(2.0)\n"
+            "    print(len(xs))\n"
+            "    print(xs[101])\n"
+            "    return 0\n"
+        )
+        output = compile_and_run(code)
+        self.assertEqual(output.splitlines(), [
+            "caught",
+            "101",
+            "IndexError: cannot get index 101 from list[float] of length 101 (valid range: 0 to 100)",
+        ])
+
+    def test_lists_of_objects_and_nested_lists(self):
+        code = (
+            "class Player:\n"
+            "    def __init__(self, name: str, score: int):\n"
+            "        self.name = name\n"
+            "        self.score = score\n"
+            "\n"
+            "def total(ps: list[Player]) -> int:\n"
+            "    t: int = 0\n"
+            "    for i in range(len(ps)):\n"
+            "        p: Player = ps[i]\n"
+            "        t += p.score\n"
+            "    return t\n"
+            "\n"
+            "def main() -> int:\n"
+            "    ps: list[Player] = [Player(\"a\", 1), Player(\"b\", 2)]\n"
+            "    for k in range(10):\n"
+            "        ps.append(Player(\"c\", 3))\n"
+            "    ps.insert(0, Player(\"z\", 100))\n"
+            "    first: Player = ps[0]\n"
+            "    print(first.name)\n"
+            "    print(total(ps))\n"
+            "    ps.remove(first)\n"
+            "    print(total(ps[1:]))\n"
+            "    grid: list[list[int]] = [[1, 2], [3]]\n"
+            "    grid.append([5, 6])\n"
+            "    grid[1].append(4)\n"
+            "    grid[1][0] = 30\n"
+            "    print(grid[1])\n"
+            "    print(grid[2][1])\n"
+            "    return 0\n"
+        )
+        output = compile_and_run(code)
+        self.assertEqual(output.splitlines(), ["z", "133", "32", "[30, 4]", "6"])
+
+    def test_list_literal_outlives_its_frame(self):
+        code = (
+            "def make() -> list[int]:\n"
+            "    return [1, 2, 3]\n"
+            "\n"
+            "def main() -> int:\n"
+            "    xs: list[int] = make()\n"
+            "    ys: list[int] = make()\n"
+            "    for i in range(100):\n"
+            "        xs.append(i)\n"
+            "    print(len(xs))\n"
+            "    print(ys)\n"
+            "    return 0\n"
+        )
+        output = compile_and_run(code)
+        self.assertEqual(output.splitlines(), ["103", "[1, 2, 3]"])
+
+    def test_list_removal_and_search(self):
+        code = (
+            "class Exception:\n"
+            "    def __init__(self, msg: str):\n"
+            "        self.msg = msg\n"
+            "\n"
+            "class ValueError(Exception):\n"
+            "    pass\n"
+            "\n"
+            "def main() -> int:\n"
+            "    xs: list[int] = []\n"
+            "    for i in range(1000):\n"
+            "        xs.append(i % 7)\n"
+            "    print(xs.count(3))\n"
+            "    print(xs.index(5))\n"
+            "    print(3 in xs, 9 in xs, 9 not in xs)\n"
+            "    print(xs.remove_all(3))\n"
+            "    print(len(xs), xs.count(3), xs[0:8])\n"
+            "    xs.remove(0)\n"
+            "    print(xs[0:6])\n"
+            "    print(xs.swap_remove(0), xs[0], len(xs))\n"
+            "    fs: list[float] = [0.5, 1.5, 0.5, 2.5, 0.5, 1.5, 0.5, 2.5, 0.5, 9.0]\n"
+            "    print(fs.index(9.0), fs.count(0.5), 2.5 in fs)\n"
+            "    names: list[str] = ['a', 'b', 'a']\n"
+            "    print(names.remove_all('a'), names)\n"
+            "    try:\n"
+            "        xs.index(42)\n"
+            "    except ValueError:\n"
+            "        print('missing')\n"
+            "    return 0\n"
+        )
+        output = compile_and_run(code)
+        # print() puts each argument on its own line
+        self.assertEqual(output.splitlines(), [
+            "143", "5",
+            "True", "False", "True",
+            "143",
+            "857", "0", "[0, 1, 2, 4, 5, 6, 0, 1]",
+            "[1, 2, 4, 5, 6, 0]",
+            "1", "5", "855",
+            "9", "5", "True",
+            "2", "['b']",
+            "missing",
+        ])
+
+    def test_numeric_list_builtins(self):
+        code = (
+            "class Exception:\n"
+            "    def __init__(self, msg: str):\n"
+            "        self.msg = msg\n"
+            "\n"
+            "class ValueError(Exception):\n"
+            "    pass\n"
+            "\n"
+            "def main() -> int:\n"
+            "    xs: list[int] = []\n"
+            "    fs: list[float] = []\n"
+            "    for i in range(21):\n"
+            "        xs.append((i * 7) % 11 - 5)\n"
+            "        fs.append(float(i) * 0.25)\n"
+            "    ones: list[int] = []\n"
+            "    for i in range(21):\n"
+            "        ones.append(1)\n"
+            "    print(sum(xs))\n"
+            "    print(min(xs))\n"
+            "    print(max(xs))\n"
+            "    print(dot(xs, xs))\n"
+            "    print(prefix_sum(xs)[20])\n"
+            "    print(vadd(xs, ones)[0:5])\n"
+            "    print(vsub(xs, ones)[16:21])\n"
+            "    print(vmul(xs, xs)[0:5])\n"
+            "    print(sum(fs))\n"
+            "    print(max(fs))\n"
+            "    print(dot(fs, fs))\n"
+            "    print(prefix_sum([1.5, 2.0, -0.5]))\n"
+            "    print(vmul(fs, fs)[1:4])\n"
+            "    empty: list[int] = []\n"
+            "    print(sum(empty))\n"
+            "    try:\n"
+            "        max(empty)\n"
+            "    except ValueError:\n"
+            "        print('empty')\n"
+            "    try:\n"
+            "        vadd(xs, empty)\n"
+            "    except ValueError:\n"
+            "        print('mismatch')\n"
+            "    return 0\n"
+        )
+        xs = [(i * 7) % 11 - 5 for i in range(21)]
+        fs = [i * 0.25 for i in range(21)]
+        output = compile_and_run(code)
+        self.assertEqual(output.splitlines(), [
+            str(sum(xs)), str(min(xs)), str(max(xs)),
+            str(sum(x * x for x in xs)), str(sum(xs)),
+            str([x + 1 for x in xs[0:5]]),
+            str([x - 1 for x in xs[16:21]]),
+            str([x * x for x in xs[0:5]]),
+            str(sum(fs)), str(max(fs)), str(sum(f * f for f in fs)),
+            "[1.5, 3.5, 3.0]",
+            str([f * f for f in fs[1:4]]),
+            "0", "empty", "mismatch",
+        ])
+
+    def test_sort_and_sorted_match_python(self):
+        code = (
+            "def main() -> int:\n"
+            "    xs: list[int] = []\n"
+            "    fs: list[float] = []\n"
+            "    for i in range(3000):\n"
+            "        xs.append((i * 7919) % 2003 - 1000)\n"
+            "        fs.append(float((i * 31) % 97) * 0.5 - 20.0)\n"
+            "    ys: list[int] = sorted(xs)\n"
+            "    print(xs[0:4])\n"
+            "    xs.sort()\n"
+            "    ok: bool = True\n"
+            "    for i in range(1, len(xs)):\n"
+            "        if xs[i - 1] > xs[i] or xs[i] != ys[i]:\n"
+            "            ok = False\n"
+            "    print(ok)\n"
+            "    print(xs[0:3])\n"
+            "    print(xs[2997:3000])\n"
+            "    fs.sort()\n"
+            "    print(fs[0:3])\n"
+            "    print(fs[2997:3000])\n"
+            "    names: list[str] = ['pear', 'apple', 'fig', 'apple', 'Fig']\n"
+            "    names.sort()\n"
+            "    print(names)\n"
+            "    print(sorted([True, False, True]))\n"
+            "    print(sorted([2.5, -1.0, 2.5, 0.0]))\n"
+            "    return 0\n"
+        )
+        xs = [(i * 7919) % 2003 - 1000 for i in range(3000)]
+        fs = sorted((i * 31) % 97 * 0.5 - 20.0 for i in range(3000))
+        output = compile_and_run(code)
+        self.assertEqual(output.splitlines(), [
+            str(xs[0:4]), "True",
+            str(sorted(xs)[0:3]), str(sorted(xs)[2997:3000]),
+            str(fs[0:3]), str(fs[2997:3000]),
+            str(sorted(['pear', 'apple', 'fig', 'apple', 'Fig'])),
+            "[False, True, True]", "[-1.0, 0.0, 2.5, 2.5]",
+        ])
+
+    def test_file_lines_read_and_mmap(self):
+        with tempfile.TemporaryDirectory() as tmp:
+            path = os.path.join(tmp, "data.txt").replace("\\", "/")
+            with open(path, "w", newline="") as f:
+                f.write("x" * 300000 + "\nshort\n\nlast")
+            code = (
+                "def main() -> int:\n"
+                f"    f: file = open(\"{path}\", \"r\")\n"
+                "    lens: list[int] = []\n"
+                "    kept: list[str] = []\n"
+                "    for line in f:\n"
+                "        lens.append(len(line))\n"
+                "        if len(line) < 10:\n"
+                "            kept.append(line)\n"
+                "    f.close()\n"
+                "    print(lens)\n"
+                "    print(len(kept[0]), len(kept[1]), len(kept[2]))\n"
+                f"    g: file = open(\"{path}\", \"r\")\n"
+                "    print(len(g.mmap()))\n"
+                "    g.close()\n"
+                f"    h: file = open(\"{path}\", \"r\")\n"
+                "    for line in h:\n"
+                "        break\n"
+                "    print(h.read())\n"
+                "    h.close()\n"
+                "    h.close()\n"
+                "    return 0\n"
+            )
+            output = compile_and_run(code)
+        self.assertEqual(output.splitlines(), [
+            "[300001, 6, 1, 4]", "6", "1", "4", "300012", "short", "", "last",
+        ])
+
+    def test_buffered_file_writes(self):
+        with tempfile.TemporaryDirectory() as tmp:
+            out = os.path.join(tmp, "out.txt").replace("\\", "/")
+            raw = os.path.join(tmp, "raw.txt").replace("\\", "/")
+            left = os.path.join(tmp, "left.txt").replace("\\", "/")
+            code = (
+                "def main() -> int:\n"
+                f"    f: file = open(\"{out}\", \"w\")\n"
+                "    for i in range(20000):\n"
+                "        f.write(f\"{i},\")\n"
+                "    f.writelines(['a', 'b', '\\n'])\n"
+                "    f.flush()\n"
+                f"    g: file = open(\"{out}\", \"r\")\n"
+                "    print(len(g.read()))\n"
+                "    g.close()\n"
+                "    big: str = 'x'\n"
+                "    for i in range(19):\n"
+                "        big = f\"{big}{big}\"\n"
+                "    f.write(big)\n"
+                "    f.write('end')\n"
+                "    f.close()\n"
+                "    f.close()\n"
+                f"    r: file = open(\"{raw}\", \"w\", 0)\n"
+                "    r.write('one ')\n"
+                "    r.writelines(['two', ' three'])\n"
+                f"    l: file = open(\"{left}\", \"w\", 1)\n"
+                "    l.write('kept open')\n"
+                "    return 0\n"
+            )
+            output = compile_and_run(code)
+            expected = "".join(f"{i}," for i in range(20000)) + "ab\n"
+            self.assertEqual(output.strip(), str(len(expected)))
+            with open(out, newline="") as f:
+                self.assertEqual(f.read(), expected + "x" * 2 ** 19 + "end")
+            with open(raw) as f:
+                self.assertEqual(f.read(), "one two three")
+            with open(left) as f:
+                self.assertEqual(f.read(), "kept open")
+
+    def test_list_bulk_operations_match_python(self):
+        code = (
+            "def main() -> int:\n"
+            "    xs: list[int] = [1, 2, 3]\n"
+            "    xs.extend(xs)\n"
+            "    xs.extend([7, 8])\n"
+            "    print(xs)\n"
+            "    print(xs[-3:])\n"
+            "    print(xs[:2])\n"
+            "    print(xs[2:-2])\n"
+            "    print(xs[5:1])\n"
+            "    ys: list[str] = []\n"
+            "    ys.reserve(64)\n"
+            "    ys.insert(5, 'b')\n"
+            "    ys.insert(-1, 'a')\n"
+            "    ys.insert(len(ys), 'c')\n"
+            "    print(ys)\n"
+            "    return 0\n"
+        )
+        output = compile_and_run(code)
+        self.assertEqual(output.splitlines(), [
+            "[1, 2, 3, 1, 2, 3, 7, 8]",
+            "[3, 7, 8]",
+            "[1, 2]",
+            "[3, 1, 2, 3]",
+            "[]",
+            "['a', 'b', 'c']",
+        ])
+
     def test_set_literal_runtime(self):
         code = (
             "def main() -> int:\n"
@@ -379,6 +759,33 @@ class TestPipelineRuntime(unittest.TestCase):
         lines = output.strip().splitlines()
         self.assertEqual(lines[0], "{True, False}")
 
+    def test_set_hashed_ops_runtime(self):
+        code = (
+            "def main() -> int:\n"
+            "    x: int = 2\n"
+            "    s: set[int] = {1, x, 2, 1 + 1}\n"
+            "    print(len(s))\n"
+            "    s.add(3)\n"
+            "    s.add(3)\n"
+            "    t: set[int] = {3, 4}\n"
+            "    print(s.union(t))\n"
+            "    print(s.intersection(t))\n"
+            "    print(s.difference(t))\n"
+            "    s.discard(1)\n"
+            "    print(1 in s)\n"
+            "    print(3 in s)\n"
+            "    ids: list[int] = []\n"
+            "    for i in range(1000):\n"
+            "        ids.append(i % 100)\n"
+            "    print(len(set(ids)))\n"
+            "    return 0\n"
+        )
+        output = compile_and_run(code)
+        self.assertEqual(
+            output.splitlines(),
+            ["2", "{1, 2, 3, 4}", "{3}", "{1, 2}", "False", "True", "100"],
+        )
+
     def test_type_conversions_and_printing(self):
         code = (
             "def main() -> int:\n"
@@ -482,6 +889,49 @@ class TestPipelineRuntime(unittest.TestCase):
         self.assertEqual(lines[5], "player get_name: Hero")
         self.assertEqual(lines[6], "Player.species: Human")
 
+    def test_fstring_values_are_independent_and_untruncated(self):
+        code = (
+            "def tag(n: int) -> str:\n"
+            "    return f\"<{n}>\"\n"
+            "\n"
+            "def main() -> int:\n"
+            "    word: str = \"abcdefghij\"\n"
+            "    many: str = f\"{word}{word}{word}{word}{word}\"\n"
+            "    longer: str = f\"{many}{many}{many}{many}{many}{many}\"\n"
+            "    print(len(longer))\n"
+            "    a: str = tag(1)\n"
+            "    b: str = tag(2)\n"
+            "    print(f\"{a}{b} 100%\")\n"
+            "    return 0\n"
+        )
+        output = compile_and_run(code)
+        self.assertEqual(output.splitlines(), ["300", "<1><2> 100%"])
+
+    def test_number_formatting_is_independent_and_round_trips(self):
+        code = (
+            "def main() -> int:\n"
+            "    a: str = str(1.5)\n"
+            "    b: str = str(2)\n"
+            "    c: str = hex(255)\n"
+            "    d: str = str(0.1 + 0.2)\n"
+            "    e: str = str(-7)\n"
+            "    print(f\"{a} {b} {c} {d} {e}\")\n"
+            "    x: float = 0.25\n"
+            "    print(f\"{x} {x * 2.0} {x * 4.0} {x * 8.0} {x * 16.0} {x / 1000.0}\")\n"
+            "    print(1e16)\n"
+            "    print(123456789.125)\n"
+            "    print([0.1, 2.0, 1e-05])\n"
+            "    return 0\n"
+        )
+        output = compile_and_run(code)
+        self.assertEqual(output.splitlines(), [
+            "1.5 2 0x000000ff 0.30000000000000004 -7",
+            "0.25 0.5 1.0 2.0 4.0 0.00025",
+            "1e+16",
+            "123456789.125",
+            "[0.1, 2.0, 1e-05]",
+        ])
+
     def test_runtime_exception_is_raised(self):
         code = (
             "class Exception:\n"
@@ -501,6 +951,52 @@ class TestPipelineRuntime(unittest.TestCase):
         output = compile_and_run(code)
         self.assertIn("RuntimeError: division by zero", output)
 
+    def test_range_bound_is_evaluated_once(self):
+        code = (
+            "def main() -> int:\n"
+            "    xs: list[int] = [1, 2, 3]\n"
+            "    for i in range(len(xs)):\n"
+            "        xs.append(xs[i] * 10)\n"
+            "    print(xs)\n"
+            "    total: int = 0\n"
+            "    for j in range(1, len(xs)):\n"
+            "        xs[j] = xs[j] + xs[j - 1]\n"
+            "        total += xs[j]\n"
+            "    print(total)\n"
+            "    return 0\n"
+        )
+        output = compile_and_run(code)
+        self.assertEqual(output.splitlines(), ["[1, 2, 3, 10, 20, 30]", "127"])
+
+    def test_buffered_output_is_flushed_before_uncaught_exception(self):
+        code = (
+            "class Exception:\n"
+            "    def __init__(self, msg: str):\n"
+            "        self.msg = msg\n"
+            "\n"
+            "def main():\n"
+            "    print(\"before\")\n"
+            "    raise Exception(\"boom\")\n"
+        )
+        output = compile_and_run(code)
+        self.assertEqual(output.splitlines(), ["before", "Exception: boom"])
+
+    def test_large_list_print_matches_python(self):
+        code = (
+            "def main() -> int:\n"
+            "    xs: list[int] = []\n"
+            "    i: int = 0\n"
+            "    while i < 20000:\n"
+            "        xs.append(i * 7919 - 50000)\n"
+            "        i += 1\n"
+            "    print(xs)\n"
+            "    print(\"done\")\n"
+            "    return 0\n"
+        )
+        output = compile_and_run(code)
+        expected = str([i * 7919 - 50000 for i in range(20000)])
+        self.assertEqual(output.splitlines(), [expected, "done"])
+
     def test_reraise(self):
         code = (
             "class Exception:\n"
@@ -525,6 +1021,83 @@ class TestPipelineRuntime(unittest.TestCase):
         output = compile_and_run(code)
         self.assertEqual(output.strip(), "oops")
 
+    def test_checked_and_setjmp_exceptions_mix(self):
+        # checked (flag based) handlers, setjmp handlers around runtime
+        # errors, and returns that leave a setjmp try, all in one program
+        code = (
+            "class Exception:\n"
+            "    def __init__(self, msg: str):\n"
+            "        self.msg = msg\n"
+            "\n"
+            "class ParseError(Exception):\n"
+            "    pass\n"
+            "\n"
+            "class Fatal(Exception):\n"
+            "    pass\n"
+            "\n"
+            "def parse(n: int) -> int:\n"
+            "    if n < 0:\n"
+            "        raise ParseError(f\"negative {n}\")\n"
+            "    if n > 100:\n"
+            "        raise Fatal(\"too big\")\n"
+            "    return n * 2\n"
+            "\n"
+            "def only_parse_errors(n: int) -> int:\n"
+            "    r: int = 0\n"
+            "    try:\n"
+            "        r = parse(n)\n"
+            "    except ParseError:\n"
+            "        r = -1\n"
+            "    return r\n"
+            "\n"
+            "def lookup(xs: list[int], i: int) -> int:\n"
+            "    try:\n"
+            "        v: int = xs[i]\n"
+            "        return parse(v)\n"
+            "    except IndexError:\n"
+            "        return -2\n"
+            "\n"
+            "def main() -> int:\n"
+            "    caught: int = 0\n"
+            "    for i in range(1000):\n"
+            "        try:\n"
+            "            parse(0 - i)\n"
+            "        except ParseError:\n"
+            "            caught += 1\n"
+            "    print(caught)\n"
+            "    xs: list[int] = [1, -5, 200]\n"
+            "    misses: int = 0\n"
+            "    for i in range(1000):\n"
+            "        try:\n"
+            "            misses -= xs[i + 3]\n"
+            "        except IndexError:\n"
+            "            misses += 1\n"
+            "    print(misses)\n"
+            "    print(only_parse_errors(-3))\n"
+            "    print(lookup(xs, 0), lookup(xs, 7))\n"
+            "    try:\n"
+            "        print(lookup(xs, 1))\n"
+            "    except ParseError as e:\n"
+            "        print(e.msg)\n"
+            "    try:\n"
+            "        only_parse_errors(500)\n"
+            "    except Fatal as f:\n"
+            "        print(f.msg)\n"
+            "    try:\n"
+            "        try:\n"
+            "            parse(1000)\n"
+            "        finally:\n"
+            "            print(\"inner finally\")\n"
+            "    except Fatal:\n"
+            "        print(\"outer got it\")\n"
+            "    return 0\n"
+        )
+        output = compile_and_run(code)
+        self.assertEqual(output.strip().splitlines(), [
+            "999", "1000", "-1", "2", "-2", "negative -5", "too big",
+            "inner finally", "outer got it",
+        ])
+
     def test_finally_runs(self):
         code = (
             "def main():\n"
@@ -688,6 +1261,83 @@ class TestPipelineRuntime(unittest.TestCase):
             ["P", "P", "P", "200", "150", "360"],
         )
 
+    def test_object_lists_in_both_layouts(self):
+        code = (
+            "@soa\n"
+            "class Dot:\n"
+            "    kind: str = 'dust'\n"
+            "    def __init__(self, x: int, v: float):\n"
+            "        self.alive = True\n"
+            "        self.x = x\n"
+            "        self.v = v\n"
+            "\n"
+            "class Box:\n"
+            "    def __init__(self, x: int):\n"
+            "        self.x = x\n"
+            "\n"
+            "def main() -> int:\n"
+            "    dots: list[Dot] = []\n"
+            "    boxes: list[Box] = []\n"
+            "    for i in range(1000):\n"
+            "        dots.append(Dot(i, 0.5))\n"
+            "        boxes.append(Box(i * 10))\n"
+            "    for i in range(len(dots)):\n"
+            "        dots[i].v += 1.0\n"
+            "        dots[i].x = dots[i].x * 2\n"
+            "        boxes[i].x += 1\n"
+            "    dots[999].alive = False\n"
+            "    print(dots[999].x)\n"
+            "    print(dots[2].v)\n"
+            "    print(dots[998].alive)\n"
+            "    print(dots[999].alive)\n"
+            "    print(dots[1].kind)\n"
+            "    print(boxes[3].x + boxes[999].x)\n"
+            "    print(len(dots))\n"
+            "    try:\n"
+            "        print(dots[1000].x)\n"
+            "    except IndexError:\n"
+            "        print('out of range')\n"
+            "    return 0\n"
+        )
+        output = compile_and_run(code)
+        self.assertEqual(
+            output.strip().splitlines(),
+            ["1998", "1.5", "True", "False", "dust", "10022", "1000", "out of range"],
+        )
+
+    def test_pooled_objects_outlive_their_frame(self):
+        code = (
+            "class Cell:\n"
+            "    def __init__(self, v: int):\n"
+            "        self.v = v\n"
+            "\n"
+            "def make(v: int) -> Cell:\n"
+            "    c: Cell = Cell(v)\n"
+            "    return c\n"
+            "\n"
+            "def clobber(n: int) -> int:\n"
+            "    c: Cell = Cell(n * 7)\n"
+            "    return c.v\n"
+            "\n"
+            "def main() -> int:\n"
+            "    a: Cell = make(11)\n"
+            "    b: Cell = make(22)\n"
+            "    print(clobber(3))\n"
+            "    print(a.v + b.v)\n"
+            "    cells: list[Cell] = []\n"
+            "    total: int = 0\n"
+            "    for i in range(20000):\n"
+            "        cells.append(Cell(i))\n"
+            "        if len(cells) > 8:\n"
+            "            total += cells[0].v\n"
+            "            cells.swap_remove(0)\n"
+            "    print(total)\n"
+            "    print(len(cells))\n"
+            "    return 0\n"
+        )
+        output = compile_and_run(code)
+        self.assertEqual(output.strip().splitlines(), ["21", "33", "199969973", "8"])
+
     def test_import_mathlib_add(self):
         modules = {
             "mathlib": (
@@ -768,6 +1418,28 @@ class TestPipelineRuntime(unittest.TestCase):
         output = compile_and_run(code)
         self.assertEqual(output.strip(), "3")
 
+    def test_dict_set_contains_del_runtime(self):
+        code = (
+            "def main() -> int:\n"
+            "    d: dict[str, int] = {\"a\": 1, \"b\": 2}\n"
+            "    d[\"c\"] = 3\n"
+            "    d[\"a\"] = 10\n"
+            "    for i in range(100):\n"
+            "        d[str(i)] = i\n"
+            "    del d[\"b\"]\n"
+            "    print(len(d))\n"
+            "    print(d[\"a\"] + d[\"c\"] + d[\"99\"])\n"
+            "    print(\"b\" in d)\n"
+            "    print(\"b\" not in d)\n"
+            "    try:\n"
+            "        del d[\"b\"]\n"
+            "    except KeyError:\n"
+            "        print(\"missing\")\n"
+            "    return 0\n"
+        )
+        output = compile_and_run(code)
+        self.assertEqual(output.splitlines(), ["102", "112", "False", "True", "missing"])
+
     def test_numeric_literal_underscores_runtime(self):
         code = (
             "def main() -> int:\n"
@@ -801,6 +1473,241 @@ class TestPipelineRuntime(unittest.TestCase):
         output = compile_and_run(code)
         self.assertEqual(output.strip(), "-0x0000000a")
 
+    def test_strings_compare_by_value(self):
+        code = (
+            "def main() -> int:\n"
+            "    n: int = 1\n"
+            "    a: str = f\"k{n}\"\n"
+            "    b: str = f\"k{n}\"\n"
+            "    print(a == b)\n"
+            "    print(a != \"k1\")\n"
+            "    print(a < f\"k{n + 1}\")\n"
+            "    print(\"z\" >= a)\n"
+            "    xs: list[str] = [\"k0\", \"k1\", \"k2\"]\n"
+            "    xs.remove(a)\n"
+            "    print(len(xs))\n"
+            "    return 0\n"
+        )
+        self.assertEqual(compile_and_run(code).splitlines(), ["True", "False", "True", "True", "2"])
+
+    def test_intern_returns_one_pointer_per_text(self):
+        code = (
+            "def main() -> int:\n"
+            "    n: int = 7\n"
+            "    a: str = f\"key{n}\"\n"
+            "    k: str = intern(a)\n"
+            "    print(k == a)\n"
+            "    print(k is a)\n"
+            "    print(k is intern(f\"key{n}\"))\n"
+            "    # literals are interned up front: the literal is the canonical copy\n"
+            "    t: str = \"t\"\n"
+            "    print(intern(f\"li{t}\") is \"lit\")\n"
+            "    d: dict[str, int] = {\"key7\": 1}\n"
+            "    d[k] = 2\n"
+            "    print(len(d))\n"
+            "    print(d[\"key7\"])\n"
+            "    return 0\n"
+        )
+        self.assertEqual(compile_and_run(code).splitlines(), ["True", "False", "True", "True", "1", "2"])
+
+
+
+@unittest.skipIf(sys.platform == "win32", "uses pthreads")
+class TestThreadedRuntime(unittest.TestCase):
+    """Compiled modules called from a multithreaded C host."""
+
+    WORKER = (
+        "class Exception:\n"
+        "    def __init__(self, msg: str):\n"
+        "        self.msg = msg\n"
+        "\n"
+        "class BadInput(Exception):\n"
+        "    pass\n"
+        "\n"
+        "def check(n: int) -> int:\n"
+        "    if n % 7 == 3:\n"
+        "        raise BadInput(f\"bad {n}\")\n"
+        "    return n % 5\n"
+        "\n"
+        "def work(seed: int) -> int:\n"
+        "    total: int = 0\n"
+        "    xs: list[int] = [1, 2]\n"
+        "    for i in range(20000):\n"
+        "        try:\n"
+        "            total += check(seed + i)\n"
+        "        except BadInput as e:\n"
+        "            total += len(e.msg)\n"
+        "        try:\n"
+        "            total += xs[i % 3]\n"
+        "        except IndexError:\n"
+        "            total -= 1\n"
+        "    return total\n"
+        "\n"
+        "def explode(n: int) -> int:\n"
+        "    xs: list[int] = []\n"
+        "    return xs[n]\n"
+    )
+
+    HOST = r"""
+#include <pthread.h>
+#include <setjmp.h>
+#include "worker.h"
+
+#define THREADS 4
+static int64_t results[THREADS];
+static PB_THREAD_LOCAL jmp_buf recover;
+static PB_THREAD_LOCAL char failure[128];
+
+static void on_fail(const char *msg) {
+    snprintf(failure, sizeof failure, "%s", msg);
+    longjmp(recover, 1);
+}
+
+static void *run(void *arg) {
+    int t = (int)(intptr_t)arg;
+    results[t] = worker_work(t * 1000);
+    pb_set_fail_handler(on_fail);
+    if (setjmp(recover) == 0) worker_explode(t);
+    else if (strncmp(failure, "IndexError", 10) != 0) results[t] = -1;
+    pb_thread_exit();
+    return NULL;
+}
+
+int main(void) {
+    pthread_t threads[THREADS];
+    for (int t = 0; t < THREADS; ++t)
+        pthread_create(&threads[t], NULL, run, (void *)(intptr_t)t);
+    for (int t = 0; t < THREADS; ++t)
+        pthread_join(threads[t], NULL);
+    for (int t = 0; t < THREADS; ++t)
+        printf("%s\n", results[t] == worker_work(t * 1000) ? "ok" : "mismatch");
+    return 0;
+}
+"""
+
+    def test_parallel_for_spawn_and_atomics(self):
+        code = (
+            "hits: atomic = atomic(0)\n"
+            "total: atomic = atomic(0)\n"
+            "\n"
+            "def mark(i: int):\n"
+            "    total.add(i * i)\n"
+            "    if i % 3 == 0:\n"
+            "        hits.add(1)\n"
+            "\n"
+            "def fib(n: int) -> int:\n"
+            "    if n < 2:\n"
+            "        return n\n"
+            "    f: future = spawn(fib, n - 1)\n"
+            "    return f.join() + fib(n - 2)\n"
+            "\n"
+            "def main() -> int:\n"
+            "    parallel_for(range(1000), mark)\n"
+            "    parallel_for(range(10, 10), mark)\n"
+            "    print(hits.get())\n"
+            "    print(total.get())\n"
+            "    c: atomic = atomic(5)\n"
+            "    c.set(c.add(2) * 10)\n"
+            "    print(c.get())\n"
+            "    print(fib(15))\n"
+            "    return 0\n"
+        )
+        expected = ["334", str(sum(i * i for i in range(1000))), "70", "610"]
+        for threads in ("1", "4"):
+            with mock.patch.dict(os.environ, {"PB_THREADS": threads}):
+                self.assertEqual(compile_and_run(code).splitlines(), expected)
+
+    def test_exception_state_is_per_thread(self):
+        output = _compile_and_run_modules({"worker": self.WORKER}, {"host.c": self.HOST})
+        self.assertEqual(output.splitlines(), ["ok"] * 4)
+
+
+class TestInstrumentedRuntime(unittest.TestCase):
+    """`--instrument` builds: runtime counters and per-function timing."""
+
+    CODE = (
+        "def check(i: int) -> int:\n"
+        "    if i % 4 == 0:\n"
+        "        raise ValueError(\"multiple of four\")\n"
+        "    return i\n"
+        "\n"
+        "def look(d: dict[str, int], k: str) -> int:\n"
+        "    return d[k]\n"
+        "\n"
+        "def main() -> int:\n"
+        "    xs: list[int] = []\n"
+        "    d: dict[str, int] = {\"a\": 1}\n"
+        "    total: int = 0\n"
+        "    n: int = 100\n"
+        "    for i in range(n):\n"
+        "        xs.append(i)\n"
+        "        try:\n"
+        "            total += check(i)\n"
+        "        except ValueError:\n"
+        "            total += 1000\n"
+        "        try:\n"
+        "            total += look(d, \"b\")\n"
+        "        except KeyError:\n"
+        "            total -= 1\n"
+        "    print(total + len(xs))\n"
+        "    return 0\n"
+    )
+
+    def build_and_run(self, defines: list[str], code: str = CODE,
+                      env: dict[str, str] | None = None) -> subprocess.CompletedProcess:
+        with tempfile.TemporaryDirectory() as tmpdir:
+            h_code, c_code, _, _ = compile_code_to_c_and_h(code, module_name="main", instrument=True)
+            for name, text in (("main.h", h_code), ("main.c", c_code)):
+                with open(os.path.join(tmpdir, name), "w") as f:
+                    f.write(text)
+            src_dir = os.path.join(os.path.dirname(__file__), "..", "src")
+            shutil.copy2(os.path.join(src_dir, "pb_runtime.h"), tmpdir)
+            exe = os.path.join(tmpdir, "main")
+            result = subprocess.run(
+                ["gcc", "-std=c99", "-W", *defines, *([] if sys.platform == "win32" else ["-pthread"]),
+                 os.path.join(tmpdir, "main.c"), os.path.join(src_dir, "pb_runtime.c"), "-I", tmpdir, "-o", exe],
+                capture_output=True, text=True)
+            self.assertEqual(result.returncode, 0, result.stderr)
+            return subprocess.run([exe], capture_output=True, text=True, env={**os.environ, **(env or {})})
+
+    def test_profile_is_printed_at_exit(self):
+        run = self.build_and_run(["-DPB_INSTRUMENT"])
+        self.assertEqual(run.stdout.strip(), "28750")
+        profile = run.stderr
+        self.assertIn("== PB profile ==", profile)
+        self.assertRegex(profile, r"list grows: +[1-9]")
+        # building the literal looks its key up once too
+        self.assertIn("dict lookups:   101 (1.00 probes each, longest 1)", profile)
+        self.assertIn("try depth max:  1", profile)
+        self.assertIn("raises:         125", profile)
+        self.assertRegex(profile, r" +25  ValueError")
+        self.assertRegex(profile, r" +100  KeyError")
+        self.assertRegex(profile, r" +100  main_check\n")
+        self.assertRegex(profile, r" +100  main_look\n")
+        self.assertRegex(profile, r" +1  main\n")
+
+    @unittest.skipIf(sys.platform == "win32", "uses pthreads")
+    def test_profile_sums_every_thread(self):
+        code = (
+            "hits: atomic = atomic(0)\n"
+            "\n"
+            "def work(i: int):\n"
+            "    hits.add(1)\n"
+            "\n"
+            "def main() -> int:\n"
+            "    parallel_for(range(0, 1000), work)\n"
+            "    print(hits.get())\n"
+            "    return 0\n"
+        )
+        run = self.build_and_run(["-DPB_INSTRUMENT"], code, env={"PB_THREADS": "4"})
+        self.assertEqual(run.stdout.strip(), "1000")
+        self.assertRegex(run.stderr, r" +1000  main_work\n")
+
+    def test_hooks_compile_out_without_pb_instrument(self):
+        run = self.build_and_run([])
+        self.assertEqual(run.stdout.strip(), "28750")
+        self.assertEqual(run.stderr, "")
+
 
 if __name__ == "__main__":
     unittest.main()
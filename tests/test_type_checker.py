@@ -19,6 +19,7 @@ from lang_ast import (
     FunctionDef,
     AssignStmt,
     IndexExpr,
+    SliceExpr,
     AugAssignStmt,
     IfStmt,
     IfBranch,
@@ -35,6 +36,7 @@ from lang_ast import (
     DictExpr,
     AssertStmt,
     RaiseStmt,
+    DelStmt,
     GlobalStmt,
     TryExceptStmt,
     ExceptBlock,
@@ -383,6 +385,39 @@ class TestTypeCheckerInternals(unittest.TestCase):
         with self.assertRaises(TypeError):
             self.tc.check_for_stmt(stmt)
 
+    def test_for_loop_unpacks_enumerate_zip_and_items(self):
+        self.tc.env["xs"] = "list[int]"
+        self.tc.env["ys"] = "set[float]"
+        self.tc.env["d"] = "dict[str, bool]"
+        enum = ForStmt("i", CallExpr(Identifier("enumerate"), [Identifier("xs"), Literal("1")]), [],
+                       extra_vars=["x"])
+        self.tc.check_for_stmt(enum)
+        self.assertEqual(enum.iterable.inferred_type, "enumerate")
+        self.tc.check_for_stmt(ForStmt("a", CallExpr(Identifier("zip"), [Identifier("xs"), Identifier("ys")]),
+                                       [], extra_vars=["b"]))
+        items = ForStmt("k", CallExpr(AttributeExpr(Identifier("d"), "items"), []), [], extra_vars=["v"])
+        self.tc.check_for_stmt(items)
+        self.assertEqual(items.iterable.inferred_type, "items")
+        self.tc.check_for_stmt(ForStmt("k", Identifier("d"), []))
+        self.assertNotIn("k", self.tc.env)
+
+    def test_for_loop_unpacking_errors(self):
+        self.tc.env["xs"] = "list[int]"
+        self.tc.env["s"] = "str"
+        cases = [
+            (ForStmt("a", Identifier("xs"), [], extra_vars=["b"]), "Cannot unpack"),
+            (ForStmt("i", CallExpr(Identifier("enumerate"), [Identifier("xs")]), []), "gives 2 values"),
+            (ForStmt("a", CallExpr(Identifier("zip"), [Identifier("xs"), Identifier("s")]), [],
+                     extra_vars=["b"]), "must be lists or sets"),
+            (ForStmt("i", CallExpr(Identifier("enumerate"), [Identifier("xs")]), [], extra_vars=["i"]),
+             "distinct"),
+        ]
+        for stmt, message in cases:
+            with self.subTest(message=message):
+                with self.assertRaises(TypeError) as ctx:
+                    self.tc.check_for_stmt(stmt)
+                self.assertIn(message, str(ctx.exception))
+
     def test_class_def_simple(self):
         """
         class C:
@@ -429,6 +464,22 @@ class TestTypeCheckerInternals(unittest.TestCase):
         with self.assertRaises(TypeError):
             self.tc.check_class_def(cls)
 
+    def test_soa_class_rules(self):
+        self.tc.check_class_def(ClassDef(name="P", base=None, fields=[], methods=[], decorators=["soa"]))
+        self.assertIn("P", self.tc.soa_classes)
+        self.tc.instance_fields["P"] = {"x": "int"}
+        self.tc.env["ps"] = "list[P]"
+        elem = IndexExpr(Identifier("ps"), Literal("0"))
+        self.assertEqual(self.tc.check_expr(AttributeExpr(elem, "x")), "int")
+        with self.assertRaises(TypeError):
+            self.tc.check_expr(IndexExpr(Identifier("ps"), Literal("1")))
+        with self.assertRaises(TypeError):
+            self.tc.check_expr(CallExpr(AttributeExpr(Identifier("ps"), "pop"), []))
+        with self.assertRaises(TypeError):
+            self.tc.check_class_def(ClassDef(name="Q", base="P", fields=[], methods=[]))
+        with self.assertRaises(TypeError):
+            self.tc.check_class_def(ClassDef(name="R", base=None, fields=[], methods=[], decorators=["dataclass"]))
+
     def test_class_def_with_method(self):
         cls = ClassDef(
             name="Greeter",
@@ -483,6 +534,56 @@ class TestTypeCheckerInternals(unittest.TestCase):
         with self.assertRaises(TypeError):
             self.tc.check_expr(expr)
 
+    def test_slice_expr_list_keeps_list_type(self):
+        self.tc.env["nums"] = "list[int]"
+        expr = SliceExpr(Identifier("nums"), Literal("1"), None)
+        self.assertEqual(self.tc.check_expr(expr), "list[int]")
+
+    def test_slice_expr_rejects_non_list(self):
+        self.tc.env["scores"] = "dict[str, int]"
+        with self.assertRaises(TypeError):
+            self.tc.check_expr(SliceExpr(Identifier("scores"), None, None))
+
+    def test_numeric_list_builtins_types(self):
+        self.tc.env["fs"] = "list[float]"
+        self.tc.env["xs"] = "list[int]"
+        self.assertEqual(self.tc.check_expr(CallExpr(Identifier("sum"), [Identifier("fs")])), "float")
+        self.assertEqual(self.tc.check_expr(CallExpr(Identifier("vadd"), [Identifier("xs"), Identifier("xs")])), "list[int]")
+        with self.assertRaises(TypeError):
+            self.tc.check_expr(CallExpr(Identifier("dot"), [Identifier("xs"), Identifier("fs")]))
+        self.tc.env["names"] = "list[str]"
+        with self.assertRaises(TypeError):
+            self.tc.check_expr(CallExpr(Identifier("max"), [Identifier("names")]))
+
+    def test_sort_requires_ordered_elements(self):
+        self.tc.env["names"] = "list[str]"
+        self.assertEqual(self.tc.check_expr(CallExpr(Identifier("sorted"), [Identifier("names")])), "list[str]")
+        self.tc.env["grid"] = "list[list[int]]"
+        with self.assertRaises(TypeError):
+            self.tc.check_expr(CallExpr(AttributeExpr(Identifier("grid"), "sort"), []))
+        with self.assertRaises(TypeError):
+            self.tc.check_expr(CallExpr(Identifier("sorted"), [Identifier("grid")]))
+
+    def test_task_pool_builtins(self):
+        self.tc.functions["work"] = (["int"], None, 1)
+        self.tc.functions["square"] = (["int"], "int", 1)
+        rng = CallExpr(Identifier("range"), [Literal("0"), Literal("10")])
+        self.assertEqual(self.tc.check_expr(CallExpr(Identifier("parallel_for"), [rng, Identifier("work")])), "None")
+        self.assertEqual(self.tc.check_expr(CallExpr(Identifier("spawn"), [Identifier("square"), Literal("3")])), "future")
+        self.assertEqual(self.tc.check_expr(CallExpr(Identifier("atomic"), [Literal("0")])), "atomic")
+        self.tc.env["f"] = "future"
+        self.tc.env["n"] = "atomic"
+        self.assertEqual(self.tc.check_expr(CallExpr(AttributeExpr(Identifier("f"), "join"), [])), "int")
+        self.assertEqual(self.tc.check_expr(CallExpr(AttributeExpr(Identifier("n"), "add"), [Literal("2")])), "int")
+        with self.assertRaises(TypeError):
+            self.tc.check_expr(CallExpr(Identifier("parallel_for"), [rng, Identifier("square")]))
+        with self.assertRaises(TypeError):
+            self.tc.check_expr(CallExpr(Identifier("parallel_for"), [Identifier("n"), Identifier("work")]))
+        with self.assertRaises(TypeError):
+            self.tc.check_expr(CallExpr(Identifier("spawn"), [Identifier("work"), Literal("1")]))
+        with self.assertRaises(TypeError):
+            self.tc.check_expr(CallExpr(AttributeExpr(Identifier("n"), "add"), [StringLiteral("x")]))
+
     def test_index_expr_dict_str(self):
         self.tc.env["scores"] = "dict[str, int]"
         expr = IndexExpr(Identifier("scores"), Literal('"math"'))
@@ -494,6 +595,42 @@ class TestTypeCheckerInternals(unittest.TestCase):
         with self.assertRaises(TypeError):
             self.tc.check_expr(expr)
 
+    def test_dict_membership(self):
+        self.tc.env["scores"] = "dict[str, int]"
+        expr = BinOp(StringLiteral("math"), "in", Identifier("scores"))
+        self.assertEqual(self.tc.check_expr(expr), "bool")
+        expr = BinOp(StringLiteral("math"), "not in", Identifier("scores"))
+        self.assertEqual(self.tc.check_expr(expr), "bool")
+
+    def test_dict_membership_wrong_key(self):
+        self.tc.env["scores"] = "dict[str, int]"
+        expr = BinOp(Literal("0"), "in", Identifier("scores"))
+        with self.assertRaises(TypeError):
+            self.tc.check_expr(expr)
+
+    def test_set_membership_and_algebra(self):
+        self.tc.env["a"] = "set[int]"
+        self.tc.env["b"] = "set[int]"
+        self.assertEqual(self.tc.check_expr(BinOp(Literal("1"), "in", Identifier("a"))), "bool")
+        union = CallExpr(AttributeExpr(Identifier("a"), "union"), [Identifier("b")])
+        self.assertEqual(self.tc.check_expr(union), "set[int]")
+
+    def test_set_algebra_type_mismatch(self):
+        self.tc.env["a"] = "set[int]"
+        self.tc.env["b"] = "set[str]"
+        expr = CallExpr(AttributeExpr(Identifier("a"), "intersection"), [Identifier("b")])
+        with self.assertRaises(TypeError):
+            self.tc.check_expr(expr)
+
+    def test_del_stmt_dict(self):
+        self.tc.env["scores"] = "dict[str, int]"
+        self.tc.check_stmt(DelStmt(IndexExpr(Identifier("scores"), StringLiteral("math"))))
+
+    def test_del_stmt_non_dict(self):
+        self.tc.env["x"] = "int"
+        with self.assertRaises(TypeError):
+            self.tc.check_stmt(DelStmt(Identifier("x")))
+
     def test_index_expr_invalid_base(self):
         self.tc.env["x"] = "int"
         expr = IndexExpr(Identifier("x"), Literal("0"))